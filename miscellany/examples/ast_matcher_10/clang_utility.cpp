@@ -1,44 +1,35 @@
 #include <format>
 #include <tuple>
 #include <clang/Lex/Lexer.h>
+#include <cal/main.hpp>
 
 #include "clang_utility.hpp"
 
-std::pair<bool, std::string> sourceRangeToText(const clang::SourceManager&
+std::pair<bool, llvm::StringRef> sourceRangeToText(const clang::SourceManager&
   sourceManager, clang::SourceRange sourceRange, bool tokenRange) {
-	if (sourceRange.isValid()) {
-		bool invalid = true;
-		auto text = std::string(clang::Lexer::getSourceText(
-		  (tokenRange ? clang::CharSourceRange::getTokenRange(sourceRange) :
-		  clang::CharSourceRange::getCharRange(sourceRange)),
-		  sourceManager,
-		  clang::LangOptions(), &invalid));
-		return {!invalid, text};
-	} else {
-		return {false, ""};
-	}
+	return charSourceRangeToText(sourceManager, tokenRange ?
+	  clang::CharSourceRange::getTokenRange(sourceRange) :
+	  clang::CharSourceRange::getCharRange(sourceRange));
 }
 
-std::pair<bool, std::string> charSourceRangeToText(const clang::SourceManager&
-  sourceManager, clang::CharSourceRange charSourceRange) {
-	if (charSourceRange.isValid()) {
-		bool invalid = true;
-		auto text = std::string(clang::Lexer::getSourceText(charSourceRange,
-		  sourceManager, clang::LangOptions(), &invalid));
-		return {!invalid, text};
-	} else {
-		return {false, ""};
-	}
+std::pair<bool, llvm::StringRef> charSourceRangeToText(
+  const clang::SourceManager& sourceManager,
+  clang::CharSourceRange charSourceRange) {
+	// NOTE: A range in a macro expansion is mapped to the corresponding file
+	// range (as clang::Lexer::getSourceText does).
+	cal::SourceText sourceText = cal::getSourceText(sourceManager,
+	  charSourceRange, nullptr, cal::MacroRangePolicy::expansion);
+	return {static_cast<bool>(sourceText), sourceText.text};
 }
 
 clang::SourceLocation getBeginningOfToken(const clang::SourceManager&
   sourceManager, clang::SourceLocation loc) {
 	return clang::Lexer::GetBeginningOfToken(loc, sourceManager,
-	  clang::LangOptions());
+	  cal::getDefaultLangOptions());
 }
 
 clang::SourceLocation getEndOfToken(const clang::SourceManager& sourceManager,
   clang::SourceLocation startOfToken) {
 	return clang::Lexer::getLocForEndOfToken(startOfToken, 0, sourceManager,
-	  clang::LangOptions());
+	  cal::getDefaultLangOptions());
 }
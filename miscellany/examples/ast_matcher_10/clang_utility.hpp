@@ -1,12 +1,16 @@
 #pragma once
 
-#include <string>
+#include <utility>
 #include <clang/Basic/SourceManager.h>
 #include <clang/Basic/SourceLocation.h>
+#include <llvm/ADT/StringRef.h>
 
-std::pair<bool, std::string> charSourceRangeToText(const clang::SourceManager&
-  sourceManager, clang::CharSourceRange charSourceRange);
-std::pair<bool, std::string> sourceRangeToText(const clang::SourceManager&
+// NOTE: The text returned refers to the buffer of the source manager (i.e.,
+// it is not copied).
+std::pair<bool, llvm::StringRef> charSourceRangeToText(
+  const clang::SourceManager& sourceManager,
+  clang::CharSourceRange charSourceRange);
+std::pair<bool, llvm::StringRef> sourceRangeToText(const clang::SourceManager&
   sourceManager, clang::SourceRange sourceRange, bool tokenRange = true);
 clang::SourceLocation getBeginningOfToken(const clang::SourceManager&
   sourceManager, clang::SourceLocation loc);
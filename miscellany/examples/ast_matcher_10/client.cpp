@@ -0,0 +1,118 @@
+#include <format>
+#include <memory>
+#include <string>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cal/main.hpp>
+
+namespace json = llvm::json;
+
+static llvm::cl::OptionCategory optionCategory("Tool options");
+static int clVerbose = 0;
+static llvm::cl::opt<bool> clDummyVerbose("v", llvm::cl::cat(optionCategory),
+  llvm::cl::callback([](const bool& value){++clVerbose;}));
+static llvm::cl::opt<std::string> clSocketPath(
+  "socket", llvm::cl::desc("Socket of the server"), llvm::cl::Required,
+  llvm::cl::cat(optionCategory));
+static llvm::cl::opt<std::string> clBuildDir(
+  "p", llvm::cl::desc("Build directory"), llvm::cl::cat(optionCategory));
+static llvm::cl::opt<int> clDeclMatcherId(
+  "d", llvm::cl::desc("Matcher ID"), llvm::cl::value_desc("matcher_id"),
+  llvm::cl::cat(optionCategory), llvm::cl::init(-1));
+static llvm::cl::opt<int> clStmtMatcherId(
+  "s", llvm::cl::desc("Matcher ID"), llvm::cl::value_desc("matcher_id"),
+  llvm::cl::cat(optionCategory), llvm::cl::init(-1));
+static llvm::cl::opt<std::string> clQueryFile(
+  "query-file", llvm::cl::desc("File of named matcher queries"),
+  llvm::cl::value_desc("path"), llvm::cl::cat(optionCategory));
+static llvm::cl::opt<bool> clIgnoreImplicit(
+  "ignore-implicit", llvm::cl::desc("Ignore implicit nodes"),
+  llvm::cl::cat(optionCategory), llvm::cl::init(false));
+static llvm::cl::opt<bool> clJsonLines(
+  "jsonl", llvm::cl::desc("Output one JSON record per match"),
+  llvm::cl::cat(optionCategory), llvm::cl::init(false));
+static llvm::cl::opt<bool> clDumpAst(
+  "dump-ast", llvm::cl::desc("Dump AST for match"),
+  llvm::cl::cat(optionCategory), llvm::cl::init(false));
+static llvm::cl::opt<std::string> clCfgFunction(
+  "cfg", llvm::cl::desc("Dump the CFG of the functions whose names match "
+  "the specified regular expression (instead of running a matcher)"),
+  llvm::cl::value_desc("regex"), llvm::cl::cat(optionCategory));
+static llvm::cl::opt<bool> clMainFileOnly(
+  "main-file-only",
+  llvm::cl::desc("Only traverse the top-level declarations of the main file"),
+  llvm::cl::cat(optionCategory), llvm::cl::init(false));
+static llvm::cl::opt<bool> clStats(
+  "stats", llvm::cl::desc("Print server statistics"),
+  llvm::cl::cat(optionCategory), llvm::cl::init(false));
+static llvm::cl::opt<bool> clShutdown(
+  "shutdown", llvm::cl::desc("Shut down the server"),
+  llvm::cl::cat(optionCategory), llvm::cl::init(false));
+static llvm::cl::list<std::string> clSourcePaths(llvm::cl::Positional,
+  llvm::cl::desc("<source files>"), llvm::cl::cat(optionCategory));
+
+int main(int argc, const char **argv) {
+	llvm::cl::HideUnrelatedOptions(optionCategory);
+	llvm::cl::ParseCommandLineOptions(argc, argv,
+	  "Send a request to a matcher server\n");
+	json::Object request;
+	if (clShutdown) {
+		request["command"] = "shutdown";
+	} else if (clStats) {
+		request["command"] = "stats";
+	} else {
+		// NOTE: The paths are made absolute, since the server has its own
+		// working directory.
+		json::Array files;
+		for (const auto& sourcePath : clSourcePaths) {
+			files.push_back(cal::getNormalizedPath(sourcePath));
+		}
+		request["build_dir"] = cal::getNormalizedPath(
+		  clBuildDir.empty() ? std::string(".") : clBuildDir);
+		request["files"] = std::move(files);
+		request["main_file_only"] = static_cast<bool>(clMainFileOnly);
+		if (!clCfgFunction.empty()) {
+			request["command"] = "cfg";
+			request["function"] = std::string(clCfgFunction);
+		} else {
+			request["command"] = "match";
+			// NOTE: The queries are sent as text, since the server may
+			// not be able to read the query file.
+			if (!clQueryFile.empty()) {
+				llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+				  llvm::MemoryBuffer::getFile(clQueryFile);
+				if (!buffer) {
+					llvm::errs() << std::format("ERROR: cannot read {}\n",
+					  std::string(clQueryFile));
+					return 2;
+				}
+				request["queries"] = std::string((*buffer)->getBuffer());
+			}
+			if (clDeclMatcherId < 0 && clStmtMatcherId < 0 &&
+			  clQueryFile.empty()) {
+				clDeclMatcherId = 0;
+			}
+			if (clDeclMatcherId >= 0) {
+				request["decl_matcher"] = static_cast<int>(clDeclMatcherId);
+			}
+			if (clStmtMatcherId >= 0) {
+				request["stmt_matcher"] = static_cast<int>(clStmtMatcherId);
+			}
+			request["ignore_implicit"] = static_cast<bool>(clIgnoreImplicit);
+			request["dump_ast"] = static_cast<bool>(clDumpAst);
+			request["format"] = clJsonLines ? "jsonl" : "text";
+			request["verbose"] = clVerbose;
+		}
+	}
+	llvm::Expected<int> status = cal::sendServerRequest(clSocketPath,
+	  std::move(request), llvm::outs());
+	if (!status) {
+		llvm::errs() << std::format("ERROR: {}\n",
+		  llvm::toString(status.takeError()));
+		return 2;
+	}
+	return *status;
+}
@@ -1,4 +1,12 @@
+#include <cstdint>
 #include <format>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/StringRef.h>
 #include <llvm/Support/raw_ostream.h>
 #include <clang/ASTMatchers/ASTMatchers.h>
 #include <clang/ASTMatchers/ASTMatchFinder.h>
@@ -6,12 +14,10 @@
 #include <clang/Tooling/CommonOptionsParser.h>
 #include <clang/Tooling/Tooling.h>
 #include <llvm/Support/CommandLine.h>
+#include <llvm/Support/VirtualFileSystem.h>
 #include <cal/main.hpp>
 
-#include "clang_utility.hpp"
-#ifdef ENABLE_EXPERIMENTAL
-#include "clang_experimental.hpp"
-#endif
+#include "matchers.hpp"
 
 namespace ct = clang::tooling;
 namespace cam = clang::ast_matchers;
@@ -30,509 +36,432 @@ static llvm::cl::opt<int> clDeclMatcherId(
 static llvm::cl::opt<int> clStmtMatcherId(
   "s", llvm::cl::desc("Matcher ID"), llvm::cl::value_desc("matcher_id"),
   llvm::cl::cat(optionCategory), llvm::cl::init(-1));
+static llvm::cl::opt<std::string> clQueryFile(
+  "query-file",
+  llvm::cl::desc("File of named matcher queries (all of which are run in a "
+  "single traversal of the AST)"), llvm::cl::value_desc("path"),
+  llvm::cl::cat(optionCategory));
+static llvm::cl::list<std::string> clQueries(
+  "query", llvm::cl::desc("Matcher expression (in the clang-query "
+  "language)"), llvm::cl::value_desc("expression"),
+  llvm::cl::cat(optionCategory), llvm::cl::ZeroOrMore);
 static llvm::cl::opt<bool> clIgnoreImplicit(
   "ignore-implicit", llvm::cl::desc("Ignore implicit nodes"),
   llvm::cl::cat(optionCategory), llvm::cl::init(false));
 static llvm::cl::opt<bool> clDumpAst(
   "dump-ast", llvm::cl::desc("Dump AST for match"),
   llvm::cl::cat(optionCategory), llvm::cl::init(false));
+static llvm::cl::opt<OutputFormat> clOutputFormat(
+  "output-format", llvm::cl::desc("Format of the match output"),
+  llvm::cl::values(
+  clEnumValN(OutputFormat::Text, "text", "human-readable text"),
+  clEnumValN(OutputFormat::JsonLines, "jsonl",
+  "one JSON record per match (other output goes to stderr)")),
+  llvm::cl::cat(optionCategory), llvm::cl::init(OutputFormat::Text));
+static llvm::cl::opt<bool> clMainFileOnly(
+  "main-file-only",
+  llvm::cl::desc("Only match nodes within the top-level declarations of the "
+  "main file (so that headers are not traversed)"),
+  llvm::cl::cat(optionCategory), llvm::cl::init(false));
+static llvm::cl::opt<bool> clCacheFileSystem(
+  "cache-fs", llvm::cl::desc("Cache file status and contents across TUs"),
+  llvm::cl::cat(optionCategory), llvm::cl::init(false));
+static llvm::cl::opt<bool> clExpandResponseFiles(
+  "expand-response-files",
+  llvm::cl::desc("Expand response files in the compile commands "
+  "(with caching)"), llvm::cl::cat(optionCategory), llvm::cl::init(false));
+static llvm::cl::opt<std::string> clResponseFileCacheDir(
+  "response-file-cache-dir",
+  llvm::cl::desc("Directory in which tokenized response files are cached "
+  "across runs (implies -expand-response-files)"),
+  llvm::cl::cat(optionCategory));
+static llvm::cl::opt<std::string> clShard(
+  "shard", llvm::cl::desc("Process only shard i of n of the source files"),
+  llvm::cl::value_desc("i/n"), llvm::cl::cat(optionCategory));
+static llvm::cl::opt<std::string> clCheckpointDir(
+  "checkpoint-dir",
+  llvm::cl::desc("Directory for the checkpoint journal and outputs "
+  "(allows an interrupted run to be resumed)"),
+  llvm::cl::cat(optionCategory));
+static llvm::cl::opt<bool> clMergeShards(
+  "merge-shards",
+  llvm::cl::desc("Merge the outputs of all shards in the checkpoint "
+  "directory"), llvm::cl::cat(optionCategory), llvm::cl::init(false));
+static llvm::cl::opt<bool> clWatch(
+  "watch",
+  llvm::cl::desc("Watch the source files and their dependencies, and "
+  "reanalyze the affected source files whenever they change"),
+  llvm::cl::cat(optionCategory), llvm::cl::init(false));
+static llvm::cl::opt<bool> clProfileMatchers(
+  "profile-matchers",
+  llvm::cl::desc("Print the time spent in each matcher (aggregated over all "
+  "source files)"), llvm::cl::cat(optionCategory), llvm::cl::init(false));
+static llvm::cl::opt<std::string> clProfileJson(
+  "profile-json",
+  llvm::cl::desc("Write the time spent in each matcher as JSON to the "
+  "specified file"), llvm::cl::value_desc("path"),
+  llvm::cl::cat(optionCategory));
+static llvm::cl::opt<unsigned> clPreforkWorkers(
+  "prefork-workers",
+  llvm::cl::desc("Process the source files in the specified number of "
+  "worker processes forked after initialization (so that a crash only "
+  "affects the source file being processed)"),
+  llvm::cl::value_desc("count"), llvm::cl::cat(optionCategory),
+  llvm::cl::init(0));
+static llvm::cl::opt<unsigned> clMaxAttempts(
+  "max-attempts",
+  llvm::cl::desc("Maximum number of attempts for a source file whose worker "
+  "crashes, after which the source file is skipped (with -prefork-workers)"),
+  llvm::cl::cat(optionCategory), llvm::cl::init(2));
+static llvm::cl::opt<std::string> clTimeTrace(
+  "time-trace",
+  llvm::cl::desc("Write a Chrome trace of the tool phases to the specified "
+  "file"), llvm::cl::value_desc("path"), llvm::cl::cat(optionCategory));
+static llvm::cl::opt<unsigned> clTimeTraceGranularity(
+  "time-trace-granularity",
+  llvm::cl::desc("Minimum duration of a traced span (in microseconds)"),
+  llvm::cl::cat(optionCategory), llvm::cl::init(500));
 
-unsigned int getDepth(clang::ASTContext& astContext,
-  const clang::DynTypedNode* node) {
-	unsigned int count = 0;
-	const clang::DynTypedNode* curNode = node;
-	for (;;) {
-		auto parents = astContext.getParents(*curNode);
-		if (parents.size() == 0) {
-			break;
-		}
-		if (parents.size() > 1) {
-			llvm::outs() << std::format("multiple parents {}\n",
-			  parents.size());
-		}
-		++count;
-		curNode = &parents[0];
+int main(int argc, const char **argv) {
+	clClangIncludeDir = cal::getClangIncludeDirPath();
+	auto expectedParser = ct::CommonOptionsParser::create(argc, argv,
+	  optionCategory);
+	if (!expectedParser) {
+		llvm::errs() << llvm::toString(expectedParser.takeError());
+		return 1;
 	}
-	return count;
-}
-
-clang::DynTypedNode getFarAncestor(clang::ASTContext& astContext,
-  const clang::DynTypedNode* node) {
-	const clang::DynTypedNode* curNode = node;
-	clang::DynTypedNode parentNode;
-	for (;;) {
-		auto parents = astContext.getParents(*curNode);
-		if (parents.size() == 0) {
-			break;
+	ct::CommonOptionsParser& optionsParser = expectedParser.get();
+	// The configuration key identifies the options that affect the output,
+	// so that checkpointed files are not reused by a run with different
+	// matchers, queries, or flags.
+	std::string configKey = cal::Hasher()
+	  .add(static_cast<std::uint64_t>(clDeclMatcherId))
+	  .add(static_cast<std::uint64_t>(clStmtMatcherId))
+	  .add(clQueryFile.empty() ? std::string() : cal::hashFile(clQueryFile))
+	  .add(std::vector<std::string>(clQueries.begin(), clQueries.end()))
+	  .add(static_cast<std::uint64_t>(clIgnoreImplicit))
+	  .add(static_cast<std::uint64_t>(clDumpAst))
+	  .add(static_cast<std::uint64_t>(clOutputFormat.getValue()))
+	  .add(static_cast<std::uint64_t>(clMainFileOnly))
+	  .add(static_cast<std::uint64_t>(clVerbose))
+	  .add(clClangIncludeDir.getValue())
+	  .finalize();
+	if (clMergeShards) {
+		if (clCheckpointDir.empty()) {
+			llvm::errs() << "no checkpoint directory specified\n";
+			return 1;
 		}
-		if (parents.size() > 1) {
-			llvm::outs() << std::format("multiple parents {}\n",
-			  parents.size());
+		if (llvm::Error error = cal::mergeShardOutputs(clCheckpointDir,
+		  configKey, llvm::outs())) {
+			llvm::errs() << llvm::toString(std::move(error)) << '\n';
+			return 1;
 		}
-		curNode = &parents[0];
-		parentNode = *curNode;
+		return 0;
 	}
-	return parentNode;
-}
-
-clang::DynTypedNode getParent(clang::ASTContext& astContext,
-  const clang::DynTypedNode* node) {
-	auto parents = astContext.getParents(*node);
-	clang::DynTypedNode parentNode;
-	if (parents.size() > 0) {
-		if (parents.size() > 1) {
-			llvm::outs() << std::format("multiple parents {}\n",
-			  parents.size());
-		}
-		parentNode = parents[0];
-	} else {
-		parentNode = clang::DynTypedNode();
+	cal::ShardOptions shardOptions;
+	if (!clShard.empty() && !cal::parseShardSpec(clShard,
+	  shardOptions.shardIndex, shardOptions.numShards)) {
+		llvm::errs() << std::format("invalid shard {}\n",
+		  std::string(clShard));
+		return 1;
 	}
-	return parentNode;
-}
-
-clang::SourceRange charSourceRangeToSourceRange(const clang::SourceManager&
-  sourceManager, clang::CharSourceRange charSourceRange) {
-	return clang::SourceRange(
-	  getBeginningOfToken(sourceManager, charSourceRange.getBegin()),
-	  getBeginningOfToken(sourceManager, charSourceRange.getEnd()));
-}
-
-AST_MATCHER(clang::Decl, hasComment) {
-	if (auto p = Finder->getASTContext().getCommentForDecl(&Node, nullptr)) {
-		return true;
-	} else {
-		return false;
+	shardOptions.checkpointDir = clCheckpointDir;
+	shardOptions.configKey = configKey;
+	if (clWatch && (clCacheFileSystem || !clShard.empty() ||
+	  !clCheckpointDir.empty() || clProfileMatchers ||
+	  !clProfileJson.empty() || clOutputFormat != OutputFormat::Text ||
+	  !clTimeTrace.empty() || clPreforkWorkers)) {
+		llvm::errs() << "-watch cannot be used with -cache-fs, -shard, "
+		  "-checkpoint-dir, matcher profiling, JSON Lines output, "
+		  "-time-trace, or -prefork-workers\n";
+		return 1;
 	}
-}
-
-AST_MATCHER(clang::CXXMethodDecl, isSpecialMember) {
-	bool result;
-	if (auto p = llvm::dyn_cast<clang::CXXConstructorDecl>(&Node)) {
-		result = p->isDefaultConstructor() || p->isCopyConstructor() ||
-		  p->isMoveConstructor();
-	} else if (auto p = llvm::dyn_cast<clang::CXXDestructorDecl>(&Node)) {
-		result = true;
-	} else {
-		result = Node.isCopyAssignmentOperator() ||
-		  Node.isMoveAssignmentOperator();
+	// NOTE: The state of a worker process (e.g., matcher profiles or time
+	// traces) is lost when the worker exits.
+	if (clPreforkWorkers && (!clShard.empty() || !clCheckpointDir.empty() ||
+	  clProfileMatchers || !clProfileJson.empty() || !clTimeTrace.empty())) {
+		llvm::errs() << "-prefork-workers cannot be used with -shard, "
+		  "-checkpoint-dir, matcher profiling, or -time-trace\n";
+		return 1;
 	}
-	return result;
-}
-
-AST_MATCHER_P(clang::CXXMethodDecl, paramCountAtLeast, unsigned, Threshold) {
-	return Node.param_size() >= Threshold;
-}
-
-AST_MATCHER_P(clang::CXXMethodDecl, hasNumOverrides, unsigned, N) {
-	const auto& node = Node;
-	return node.size_overridden_methods() >= N;
-}
-
-AST_MATCHER_P(clang::NamedDecl, nameLengthAtLeast, unsigned, Threshold) {
-	return Node.getIdentifier() && Node.getName().size() >= Threshold;
-}
-
-cam::DeclarationMatcher getDeclMatcher(int id) {
-	using namespace cam;
-	switch (id) {
-	default:
-	case 0:
-		return decl().bind("x");
-	case 1:
-		return namedDecl().bind("x");
-	case 2:
-		return varDecl().bind("x");
-	case 3:
-		return functionDecl().bind("x");
-	case 4:
-		return cxxMethodDecl().bind("x");
-	case 5:
-		return recordDecl().bind("x");
-	case 6:
-		return cxxRecordDecl().bind("x");
-	// gap in numbering of cases
-	case 40:
-		return decl(hasComment()).bind("x");
-	// gap in numbering of cases
-	case 50:
-		return cxxMethodDecl(isDefinition(), isSpecialMember(),
-		  unless(isImplicit())).bind("x");
-	case 51:
-		return cxxMethodDecl(paramCountAtLeast(4)).bind("x");
-	case 52:
-		return cxxMethodDecl(hasNumOverrides(1)).bind("x");
-	case 53:
-		return namedDecl(nameLengthAtLeast(6)).bind("x");
+	if (!clTimeTrace.empty()) {
+		cal::startTimeTrace("ast_matcher_10", clTimeTraceGranularity);
 	}
-}
-
-cam::StatementMatcher getStmtMatcher(int id) {
-	using namespace cam;
-	switch (id) {
-	default:
-	case 0:
-		return stmt().bind("x");
-	case 1:
-		return expr().bind("x");
-	case 2:
-		return callExpr().bind("x");
-	case 3:
-		return ifStmt().bind("x");
-	case 4:
-		return switchStmt().bind("x");
-	case 5:
-		return forStmt().bind("x");
-	case 6:
-		return whileStmt().bind("x");
-	case 7:
-		return doStmt().bind("x");
-	case 8:
-		return materializeTemporaryExpr().bind("x");
+	// NOTE: With JSON Lines output, the standard output contains only the
+	// match records (so that it can be consumed directly).
+	llvm::raw_ostream& infoOut = clOutputFormat == OutputFormat::JsonLines ?
+	  llvm::errs() : llvm::outs();
+	std::shared_ptr<cal::FileSystemCache> fileSysCache;
+	llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fileSys =
+	  llvm::vfs::getRealFileSystem();
+	if (clCacheFileSystem) {
+		fileSysCache = std::make_shared<cal::FileSystemCache>();
+		fileSys = cal::createCachingFileSystem(fileSysCache, fileSys);
 	}
-}
-
-bool printMatch(clang::SourceManager& sourceManager, clang::SourceRange
-  sourceRange) {
-	bool status = true;
-
-	assert(sourceRange.isValid());
-
-	clang::CharSourceRange expRange = sourceManager.getExpansionRange(
-	  sourceRange);
-	clang::SourceRange expTokenRange = charSourceRangeToSourceRange(
-	  sourceManager, expRange);
-	auto expFileName = std::string(sourceManager.getFilename(
-	  sourceManager.getExpansionLoc(expRange.getBegin())));
-	unsigned expBeginLineNum = sourceManager.getExpansionLineNumber(
-	  expRange.getBegin());
-	unsigned expBeginColumnNum = sourceManager.getExpansionColumnNumber(
-	  expRange.getBegin());
-	unsigned expEndLineNum = sourceManager.getExpansionLineNumber(
-	  expRange.getEnd());
-	unsigned expEndColumnNum = sourceManager.getExpansionColumnNumber(
-	  expRange.getEnd());
-	auto expEndFileName = std::string(sourceManager.getFilename(
-	  sourceManager.getExpansionLoc(expRange.getEnd())));
-
-	auto [validText, text] = charSourceRangeToText(sourceManager, expRange);
-	if (!validText) {
-		status = false;
+	const ct::CompilationDatabase* compDatabase =
+	  &optionsParser.getCompilations();
+	std::shared_ptr<cal::ResponseFileCache> responseFileCache;
+	std::unique_ptr<ct::CompilationDatabase> expandedCompDatabase;
+	if (clExpandResponseFiles || !clResponseFileCacheDir.empty()) {
+		responseFileCache = std::make_shared<cal::ResponseFileCache>(
+		  clResponseFileCacheDir);
+		expandedCompDatabase =
+		  std::make_unique<cal::ResponseFileExpandingDatabase>(*compDatabase,
+		  responseFileCache);
+		compDatabase = expandedCompDatabase.get();
 	}
-	llvm::outs()
-	  << std::format("expansion range {}:{}({})-{}:{}({})\n", expFileName,
-	  expBeginLineNum, expBeginColumnNum, expEndFileName, expEndLineNum,
-	  expEndColumnNum)
-	  << std::format("\nexpansion range text:\n{}\n",
-	  validText ?  cal::addLineNumbers(text, expBeginLineNum,
-	  expBeginColumnNum, true, true) : "[invalid]\n");
-
-	llvm::outs()
-	  << std::format("spelling location {}:{}({})\n",
-	  std::string(sourceManager.getFilename(sourceManager.getSpellingLoc(
-	  sourceRange.getBegin()))),
-	  sourceManager.getSpellingLineNumber(sourceRange.getBegin()),
-	  sourceManager.getSpellingColumnNumber(sourceRange.getBegin()));
-
-#if 0
-	clang::SourceLocation spellRangeBegin = sourceManager.getSpellingLoc(
-	  sourceRange.getBegin());
-	clang::SourceLocation spellRangeEnd = sourceManager.getSpellingLoc(
-	  sourceRange.getEnd());
-	unsigned spellBeginLineNum = sourceManager.getSpellingLineNumber(
-      spellRangeBegin);
-	unsigned spellBeginColumnNum = sourceManager.getSpellingColumnNumber(
-      spellRangeBegin);
-	clang::SourceRange spellRange(spellRangeBegin, spellRangeEnd);
-	llvm::outs()
-	  << std::format("\nspelling range text:\n{}\n",
-	  cal::addLineNumbers(sourceRangeToText(sourceManager, spellRange, true).second,
-	  spellBeginLineNum, spellBeginColumnNum, true, true));
-#endif
-
-	if (expTokenRange != sourceRange) {
-		auto [valid, text] = sourceRangeToText(sourceManager, sourceRange);
-		if (valid) {
-			llvm::outs() << std::format("\nsource range:\n{}\n",
-			  cal::addLineNumbers(text, 1, 1, true, true));
-		} else {
-			llvm::outs() <<
-			  "cannot print range (probably in macro expansion)\n";
+	if (!clClangIncludeDir.empty() && clVerbose >= 1) {
+		infoOut << std::format("Clang include directory: {}\n",
+		  std::string(clClangIncludeDir));
+	}
+	std::optional<cam::DeclarationMatcher> declMatcher;
+	std::optional<cam::StatementMatcher> stmtMatcher;
+	if (clDeclMatcherId >= 0) {
+		infoOut << std::format("decl matcher {}\n",
+		  static_cast<int>(clDeclMatcherId));
+		declMatcher = getDeclMatcher(clDeclMatcherId);
+		if (clIgnoreImplicit) {
+			infoOut << "NOTE: IGNORING IMPLICIT NODES\n";
+			declMatcher = clang::ast_matchers::traverse(
+			  clang::TK_IgnoreUnlessSpelledInSource, *declMatcher);
 		}
-	} else {
-		llvm::outs() << "source range same as expansion range\n";
 	}
-
-	llvm::outs()
-	  << std::format("expansion is token range: {}\n",
-	  expRange.isTokenRange())
-	  << std::format("sourceRange.getBegin().isMacroID(): {}\n",
-	  sourceRange.getBegin().isMacroID());
-
-#ifdef ENABLE_EXPERIMENTAL
-	examineSourceLocation(llvm::outs(), sourceManager, sourceRange.getBegin());
-	examineSourceLocation(llvm::outs(), sourceManager, sourceRange.getEnd());
-#endif
-	return status;
-}
-
-class MyMatchCallback : public cam::MatchFinder::MatchCallback {
-public:
-	MyMatchCallback() : count_(0) {}
-	void run(const cam::MatchFinder::MatchResult& result) override {
-		clang::ASTContext& astContext = *result.Context;
-		clang::SourceManager& sourceManager = astContext.getSourceManager();
-		clang::SourceRange sourceRange;
-		clang::SourceRange altSourceRange;
-		clang::SourceLocation sourceLocation;
-		std::string nodeType;
-		std::string name;
-		std::string dumpOutput;
-		llvm::raw_string_ostream dumpStream(dumpOutput);
-		clang::DynTypedNode node;
-
-		bool found = false;
-		if (auto p = result.Nodes.getNodeAs<clang::Stmt>("x")) {
-			found = true;
-			if (auto p = result.Nodes.getNodeAs<clang::CallExpr>("x")) {
-				nodeType = "CallExpr";
-				sourceRange = p->getSourceRange();
-				assert(sourceRange.getBegin() == p->getBeginLoc());
-				assert(sourceRange.getEnd() == p->getEndLoc());
-				// name not set
-				p->dump(dumpStream, astContext);
-				//parents = astContext.getParents(*p);
-				node = clang::DynTypedNode::create(*p);
-			} else if (auto p = result.Nodes.getNodeAs<clang::IfStmt>("x")) {
-				nodeType = "IfStmt";
-				sourceRange = p->getSourceRange();
-				// name not set
-				p->dump(dumpStream, astContext);
-				node = clang::DynTypedNode::create(*p);
-			} else if (auto p =
-			  result.Nodes.getNodeAs<clang::CompoundStmt>("x")) {
-				nodeType = "CompoundStmt";
-				sourceRange = p->getSourceRange();
-				// name not set
-				p->dump(dumpStream, astContext);
-				node = clang::DynTypedNode::create(*p);
-			} else if (auto p = result.Nodes.getNodeAs<clang::Expr>("x")) {
-				nodeType = "Expr";
-				sourceRange = p->getSourceRange();
-				// name not set
-				p->dump(dumpStream, astContext);
-				node = clang::DynTypedNode::create(*p);
-			} else if (auto p = result.Nodes.getNodeAs<clang::Stmt>("x")) {
-				nodeType = "Stmt";
-				sourceRange = p->getSourceRange();
-				// name not set
-				p->dump(dumpStream, astContext);
-				node = clang::DynTypedNode::create(*p);
-			} else {
-				found = false;
-			}
-		} else if (result.Nodes.getNodeAs<clang::Decl>("x")) {
-			found = true;
-			if (auto p = result.Nodes.getNodeAs<clang::CXXMethodDecl>("x")) {
-				nodeType = "CXXMethodDecl";
-				sourceRange = p->getSourceRange();
-				assert(sourceRange.getBegin() == p->getBeginLoc());
-				sourceLocation = p->getLocation();
-				name = p->getQualifiedNameAsString();
-				p->dump(dumpStream);
-				node = clang::DynTypedNode::create(*p);
-			} else if (auto p =
-			  result.Nodes.getNodeAs<clang::FunctionDecl>("x")) {
-				nodeType = "FunctionDecl";
-				sourceRange = p->getSourceRange();
-				assert(sourceRange.getBegin() == p->getBeginLoc());
-				sourceLocation = p->getLocation();
-				name = p->getQualifiedNameAsString();
-				p->dump(dumpStream);
-				node = clang::DynTypedNode::create(*p);
-			} else if (auto p =
-			  result.Nodes.getNodeAs<clang::ParmVarDecl>("x")) {
-				nodeType = "ParmVarDecl";
-				sourceRange = p->getSourceRange();
-				assert(sourceRange.getBegin() == p->getBeginLoc());
-				sourceLocation = p->getLocation();
-				name = p->getQualifiedNameAsString();
-				p->dump(dumpStream);
-				node = clang::DynTypedNode::create(*p);
-			} else if (auto p = result.Nodes.getNodeAs<clang::VarDecl>("x")) {
-				nodeType = "VarDecl";
-				sourceRange = p->getSourceRange();
-				assert(sourceRange.getBegin() == p->getBeginLoc());
-				sourceLocation = p->getLocation();
-				name = p->getQualifiedNameAsString();
-				p->dump(dumpStream);
-				node = clang::DynTypedNode::create(*p);
-			} else if (auto p =
-			  result.Nodes.getNodeAs<clang::CXXRecordDecl>("x")) {
-				nodeType = "CXXRecordDecl";
-				sourceRange = p->getSourceRange();
-				// TODO/NOTE: Why can the following assertion fail?
-				// assert(sourceRange.getBegin() == p->getBeginLoc());
-				sourceLocation = p->getLocation();
-				name = p->getQualifiedNameAsString();
-				p->dump(dumpStream);
-				node = clang::DynTypedNode::create(*p);
-			} else if (auto p =
-			  result.Nodes.getNodeAs<clang::RecordDecl>("x")) {
-				nodeType = "RecordDecl";
-				sourceRange = p->getSourceRange();
-				assert(sourceRange.getBegin() == p->getBeginLoc());
-				sourceLocation = p->getLocation();
-				name = p->getQualifiedNameAsString();
-				p->dump(dumpStream);
-				node = clang::DynTypedNode::create(*p);
-			} else if (auto p = result.Nodes.getNodeAs<clang::NamedDecl>("x")) {
-				nodeType = "NamedDecl";
-				sourceRange = p->getSourceRange();
-				assert(sourceRange.getBegin() == p->getBeginLoc());
-				sourceLocation = p->getLocation();
-				name = p->getQualifiedNameAsString();
-				p->dump(dumpStream);
-				node = clang::DynTypedNode::create(*p);
-			} else if (auto p = result.Nodes.getNodeAs<clang::EmptyDecl>("x")) {
-				nodeType = "EmptyDecl";
-				sourceRange = p->getSourceRange();
-				assert(sourceRange.getBegin() == p->getBeginLoc());
-				sourceLocation = p->getLocation();
-				p->dump(dumpStream);
-				node = clang::DynTypedNode::create(*p);
-				// name not set
-			} else if (auto p = result.Nodes.getNodeAs<clang::Decl>("x")) {
-				nodeType = "Decl";
-				sourceRange = p->getSourceRange();
-				assert(sourceRange.getBegin() == p->getBeginLoc());
-				sourceLocation = p->getLocation();
-				// name not set
-				p->dump(dumpStream);
-				node = clang::DynTypedNode::create(*p);
-			} else {
-				found = false;
-			}
+	if (clStmtMatcherId >= 0) {
+		infoOut << std::format("stmt matcher\n",
+		  static_cast<int>(clStmtMatcherId));
+		stmtMatcher = getStmtMatcher(clStmtMatcherId);
+		if (clIgnoreImplicit) {
+			infoOut << "NOTE: IGNORING IMPLICIT NODES\n";
+			stmtMatcher = clang::ast_matchers::traverse(
+			  clang::TK_IgnoreUnlessSpelledInSource, *stmtMatcher);
 		}
-		assert(found);
-		llvm::outs()
-		  << std::format("{}\nMATCH #{}\n", std::string(80, '-'), count_)
-		  << std::format("type: {}\n", nodeType)
-		  << std::format("name: {}\n", name);
-
-		if (clVerbose >= 2) {
-			auto parents = astContext.getParents(node);
-			clang::DynTypedNode farthestAncestor =
-			  getFarAncestor(astContext, &node);
-			llvm::outs() << std::format("depth: {}\n",
-			  getDepth(astContext, &node));
-			llvm::outs() << std::format("number of parents: {}\n",
-			  parents.size());
-			farthestAncestor.dump(llvm::outs(), astContext);
-			node.dump(llvm::outs(), astContext);
-			{
-				clang::DynTypedNode curNode = node;
-				for (;;) {
-					clang::DynTypedNode parentNode =
-					  getParent(astContext, &curNode);
-					llvm::outs()
-					  << std::format("{}\n", std::string(80, '-'), count_);
-					llvm::outs()
-					  << std::format("node kind {}\n",
-					  std::string(parentNode.getNodeKind().asStringRef()));
-					parentNode.dump(llvm::outs(), astContext);
-					curNode = parentNode;
-					if (parentNode.getNodeKind().isNone()) {
-						break;
-					}
-				}
+	}
+	std::vector<cal::MatcherQuery> queries;
+	if (!clQueryFile.empty()) {
+		llvm::Expected<std::vector<cal::MatcherQuery>> fileQueries =
+		  cal::loadMatcherQueries(clQueryFile, "x");
+		if (!fileQueries) {
+			llvm::errs() << llvm::toString(fileQueries.takeError()) << '\n';
+			return 1;
+		}
+		queries = std::move(*fileQueries);
+	}
+	for (std::size_t i = 0; i < clQueries.size(); ++i) {
+		llvm::Expected<cam::internal::DynTypedMatcher> matcher =
+		  cal::parseMatcherExpression(clQueries[i], "x");
+		if (!matcher) {
+			llvm::errs() << std::format("invalid query {}: {}\n",
+			  clQueries[i], llvm::toString(matcher.takeError()));
+			return 1;
+		}
+		queries.push_back(cal::MatcherQuery{std::format("query_{}", i),
+		  std::move(*matcher)});
+	}
+	for (auto& query : queries) {
+		if (clVerbose >= 1) {
+			infoOut << std::format("query {}\n", query.name);
+		}
+		if (clIgnoreImplicit) {
+			query.matcher = query.matcher.withTraversalKind(
+			  clang::TK_IgnoreUnlessSpelledInSource);
+		}
+	}
+	// NOTE: All of the matchers (including the queries) are added to the
+	// same finder, so that they share a single traversal of the AST.
+	// The callbacks for the built-in matchers (which are added to the
+	// specified vector) and the returned callbacks (one per query) must be
+	// kept alive while the finder is used.
+	auto addMatchers = [&](cam::MatchFinder& matchFinder,
+	  MyMatchCallback& matchCallback,
+	  std::vector<std::unique_ptr<BuiltinMatchCallback>>& builtinCallbacks) {
+		if (declMatcher) {
+			builtinCallbacks.push_back(std::make_unique<BuiltinMatchCallback>(
+			  std::format("decl matcher {}",
+			  static_cast<int>(clDeclMatcherId)), matchCallback));
+			matchFinder.addMatcher(*declMatcher,
+			  builtinCallbacks.back().get());
+		}
+		if (stmtMatcher) {
+			builtinCallbacks.push_back(std::make_unique<BuiltinMatchCallback>(
+			  std::format("stmt matcher {}",
+			  static_cast<int>(clStmtMatcherId)), matchCallback));
+			matchFinder.addMatcher(*stmtMatcher,
+			  builtinCallbacks.back().get());
+		}
+		std::vector<std::unique_ptr<QueryMatchCallback>> queryCallbacks;
+		for (const auto& query : queries) {
+			queryCallbacks.push_back(std::make_unique<QueryMatchCallback>(
+			  query.name, matchCallback));
+			if (!matchFinder.addDynamicMatcher(query.matcher,
+			  queryCallbacks.back().get())) {
+				llvm::errs() << std::format("WARNING: query {} matches an "
+				  "unsupported node kind\n", query.name);
 			}
 		}
-
-		bool status = true;
-		if (sourceRange.isValid()) {
-			llvm::outs()
-			  << std::format("begin spelling location {}:{}({})\n",
-			  std::string(sourceManager.getFilename(
-			  sourceManager.getSpellingLoc(sourceRange.getBegin()))),
-			  sourceManager.getSpellingLineNumber(sourceRange.getBegin()),
-			  sourceManager.getSpellingColumnNumber(sourceRange.getBegin()));
-			llvm::outs()
-			  << std::format("end spelling location {}:{}({})\n",
-			  std::string(sourceManager.getFilename(
-			  sourceManager.getSpellingLoc(sourceRange.getEnd()))),
-			  sourceManager.getSpellingLineNumber(sourceRange.getEnd()),
-			  sourceManager.getSpellingColumnNumber(sourceRange.getEnd()));
-			status = printMatch(sourceManager, sourceRange);
-		} else {
-			llvm::outs() << "source range not valid\n";
+		return queryCallbacks;
+	};
+	auto printQueryCounts = [](llvm::raw_ostream& out,
+	  const std::vector<std::unique_ptr<QueryMatchCallback>>&
+	  queryCallbacks) {
+		for (const auto& callback : queryCallbacks) {
+			out << std::format("number of matches for query {}: {}\n",
+			  callback->getName(), callback->getNumMatches());
+		}
+	};
+	auto runTool = [&](const std::vector<std::string>& sourcePaths,
+	  ct::FrontendActionFactory& actionFactory) {
+		ct::ClangTool tool(*compDatabase, sourcePaths,
+		  std::make_shared<clang::PCHContainerOperations>(), fileSys);
+		if (!clClangIncludeDir.empty()) {
+			tool.appendArgumentsAdjuster(cal::traceArgumentsAdjuster(
+			  ct::getInsertArgumentAdjuster(
+			  ("-I"s += clClangIncludeDir).c_str(),
+			  ct::ArgumentInsertPosition::BEGIN)));
 		}
-		if (sourceLocation.isValid()) {
-			llvm::outs()
-			  << std::format("spelling location {}:{}({})\n",
-			  std::string(sourceManager.getFilename(
-			  sourceManager.getSpellingLoc(sourceLocation))),
-			  sourceManager.getSpellingLineNumber(sourceLocation),
-			  sourceManager.getSpellingColumnNumber(sourceLocation));
-		} else {
-			llvm::outs() << "source location not valid\n";
+		std::optional<cal::MainFileScopeActionFactory> scopedActionFactory;
+		ct::FrontendActionFactory* factory = &actionFactory;
+		if (clMainFileOnly) {
+			factory = &scopedActionFactory.emplace(*factory);
 		}
-		if (clDumpAst || !status) {
-			llvm::outs() << dumpOutput;
+		// NOTE: The tracing factory must be the outermost one.
+		cal::TimeTracingActionFactory tracingActionFactory(*factory);
+		return tool.run(&tracingActionFactory);
+	};
+	if (clWatch) {
+		// The output for each source file is kept separately, so that it
+		// can be replaced when the source file is reanalyzed.
+		cal::IncrementalRunner runner(optionsParser.getSourcePathList(),
+		  [&](const std::string& sourcePath) {
+			cal::UnitResult result;
+			llvm::raw_string_ostream out(result.output);
+			cam::MatchFinder matchFinder;
+			MyMatchCallback matchCallback(out, clVerbose, clDumpAst);
+			std::vector<std::unique_ptr<BuiltinMatchCallback>>
+			  builtinCallbacks;
+			std::vector<std::unique_ptr<QueryMatchCallback>> queryCallbacks =
+			  addMatchers(matchFinder, matchCallback, builtinCallbacks);
+			std::unique_ptr<ct::FrontendActionFactory> actionFactory =
+			  ct::newFrontendActionFactory(&matchFinder);
+			cal::DependencyCollectingActionFactory depActionFactory(
+			  *actionFactory, result.dependencies);
+			result.status = runTool({sourcePath}, depActionFactory);
+			printQueryCounts(out, queryCallbacks);
+			out << std::format("number of matches: {}\n",
+			  matchCallback.getNumMatches());
+			return result;
+		});
+		if (llvm::Error error = runner.watch(llvm::outs())) {
+			llvm::errs() << llvm::toString(std::move(error)) << '\n';
+			return 1;
 		}
-		++count_;
+		return 0;
 	}
-	unsigned getNumMatches() const {
-		return count_;
+	std::unique_ptr<cal::MatcherProfiler> profiler;
+	if (clProfileMatchers || !clProfileJson.empty()) {
+		profiler = std::make_unique<cal::MatcherProfiler>();
 	}
-private:
-	unsigned count_;
-};
-
-int main(int argc, const char **argv) {
-	clClangIncludeDir = cal::getClangIncludeDirPath();
-	auto expectedParser = ct::CommonOptionsParser::create(argc, argv,
-	  optionCategory);
-	if (!expectedParser) {
-		llvm::errs() << llvm::toString(expectedParser.takeError());
-		return 1;
-	}
-	ct::CommonOptionsParser& optionsParser = expectedParser.get();
-	ct::ClangTool tool(optionsParser.getCompilations(),
-	  optionsParser.getSourcePathList());
-	if (!clClangIncludeDir.empty()) {
-		if (clVerbose >= 1) {
-			llvm::outs() << std::format("Clang include directory: {}\n",
-			  std::string(clClangIncludeDir));
+	cam::MatchFinder matchFinder(profiler ? profiler->getFinderOptions() :
+	  cam::MatchFinder::MatchFinderOptions());
+	MyMatchCallback matchCallback(llvm::outs(), clVerbose, clDumpAst,
+	  clOutputFormat);
+	std::vector<std::unique_ptr<BuiltinMatchCallback>> builtinCallbacks;
+	std::vector<std::unique_ptr<QueryMatchCallback>> queryCallbacks =
+	  addMatchers(matchFinder, matchCallback, builtinCallbacks);
+	std::unique_ptr<ct::FrontendActionFactory> actionFactory =
+	  ct::newFrontendActionFactory(&matchFinder,
+	  profiler ? profiler->getSourceFileCallbacks() : nullptr);
+	// NOTE: When the matches for a source file are made in another process
+	// (i.e., a worker) or by an earlier run (i.e., a checkpointed one), they
+	// are not seen by the match callbacks, so the number of matches for the
+	// source file (in total and for each query) is passed as data.
+	auto runToolCounted = [&](const std::string& sourcePath,
+	  std::string& data) {
+		unsigned numMatches = matchCallback.getNumMatches();
+		std::vector<unsigned> numQueryMatches;
+		for (const auto& callback : queryCallbacks) {
+			numQueryMatches.push_back(callback->getNumMatches());
+		}
+		int fileStatus = runTool({sourcePath}, *actionFactory);
+		data = std::format("{}", matchCallback.getNumMatches() - numMatches);
+		for (std::size_t i = 0; i < queryCallbacks.size(); ++i) {
+			data += std::format(" {}",
+			  queryCallbacks[i]->getNumMatches() - numQueryMatches[i]);
+		}
+		return fileStatus;
+	};
+	auto addCounts = [&](llvm::StringRef data) {
+		llvm::SmallVector<llvm::StringRef> counts;
+		data.split(counts, ' ', -1, false);
+		for (std::size_t i = 0; i < counts.size(); ++i) {
+			unsigned count;
+			if (!llvm::to_integer(counts[i], count, 10)) {
+				continue;
+			}
+			if (!i) {
+				matchCallback.addNumMatches(count);
+			} else if (i <= queryCallbacks.size()) {
+				queryCallbacks[i - 1]->addNumMatches(count);
+			}
+		}
+	};
+	int status;
+	if (clPreforkWorkers) {
+		cal::WorkerPoolOptions poolOptions;
+		poolOptions.numWorkers = clPreforkWorkers;
+		poolOptions.maxAttempts = clMaxAttempts;
+		auto poolResults = cal::runWorkerPool(
+		  optionsParser.getSourcePathList(), poolOptions, runToolCounted,
+		  llvm::outs());
+		if (!poolResults) {
+			llvm::errs() << llvm::toString(poolResults.takeError()) << '\n';
+			return 1;
+		}
+		status = 0;
+		unsigned numSkipped = 0;
+		for (const auto& result : *poolResults) {
+			status |= result.status;
+			numSkipped += result.skipped;
+			addCounts(result.data);
 		}
-		tool.appendArgumentsAdjuster(ct::getInsertArgumentAdjuster(("-I"s +=
-		  clClangIncludeDir).c_str(), ct::ArgumentInsertPosition::BEGIN));
+		// NOTE: A skipped source file is a failure, even though its
+		// worker never returned a status.
+		if (numSkipped) {
+			infoOut << std::format("number of skipped source files: {}\n",
+			  numSkipped);
+			status |= 1;
+		}
+	} else if (clShard.empty() && clCheckpointDir.empty()) {
+		status = runTool(optionsParser.getSourcePathList(), *actionFactory);
+	} else {
+		status = cal::runShard(shardOptions,
+		  optionsParser.getSourcePathList(), runToolCounted,
+		  [&](const std::string& sourcePath, llvm::StringRef data) {
+			addCounts(data);
+		});
 	}
-	cam::MatchFinder matchFinder;
-	MyMatchCallback matchCallback;
-	if (clDeclMatcherId >= 0) {
-		llvm::outs() << std::format("decl matcher {}\n",
-		  static_cast<int>(clDeclMatcherId));
-		cam::DeclarationMatcher matcher = getDeclMatcher(clDeclMatcherId);
-		if (clIgnoreImplicit) {
-			llvm::outs() << "NOTE: IGNORING IMPLICIT NODES\n";
-			matcher = clang::ast_matchers::traverse(
-			  clang::TK_IgnoreUnlessSpelledInSource, matcher);
+	printQueryCounts(infoOut, queryCallbacks);
+	infoOut << std::format("number of matches: {}\n",
+	  matchCallback.getNumMatches());
+	if (profiler && clProfileMatchers) {
+		profiler->printReport(infoOut);
+	}
+	if (profiler && !clProfileJson.empty()) {
+		if (llvm::Error error = profiler->writeJson(clProfileJson)) {
+			llvm::errs() << llvm::toString(std::move(error)) << '\n';
+			return 1;
 		}
-		matchFinder.addMatcher(matcher, &matchCallback);
 	}
-	if (clStmtMatcherId >= 0) {
-		llvm::outs() << std::format("stmt matcher\n",
-		  static_cast<int>(clStmtMatcherId));
-		cam::StatementMatcher matcher = getStmtMatcher(clStmtMatcherId);
-		if (clIgnoreImplicit) {
-			llvm::outs() << "NOTE: IGNORING IMPLICIT NODES\n";
-			matcher = clang::ast_matchers::traverse(
-			  clang::TK_IgnoreUnlessSpelledInSource, matcher);
+	if (fileSysCache && clVerbose >= 1) {
+		fileSysCache->printStats(infoOut);
+	}
+	if (responseFileCache && clVerbose >= 1) {
+		responseFileCache->printStats(infoOut);
+	}
+	if (!clTimeTrace.empty()) {
+		if (llvm::Error error = cal::finishTimeTrace(clTimeTrace)) {
+			llvm::errs() << llvm::toString(std::move(error)) << '\n';
+			return 1;
 		}
-		matchFinder.addMatcher(matcher, &matchCallback);
 	}
-	int status = tool.run(ct::newFrontendActionFactory(&matchFinder).get());
-	llvm::outs() << std::format("number of matches: {}\n",
-	  matchCallback.getNumMatches());
+	return status;
 }
@@ -0,0 +1,549 @@
+#include <cassert>
+#include <format>
+#include <string>
+#include <clang/AST/ASTContext.h>
+#include <clang/ASTMatchers/ASTMatchers.h>
+#include <clang/ASTMatchers/ASTMatchFinder.h>
+#include <clang/Basic/SourceManager.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cal/main.hpp>
+
+#include "clang_utility.hpp"
+#ifdef ENABLE_EXPERIMENTAL
+#include "clang_experimental.hpp"
+#endif
+#include "matchers.hpp"
+
+namespace cam = clang::ast_matchers;
+namespace json = llvm::json;
+
+unsigned int getDepth(clang::ASTContext& astContext,
+  const clang::DynTypedNode* node) {
+	unsigned int count = 0;
+	const clang::DynTypedNode* curNode = node;
+	for (;;) {
+		auto parents = astContext.getParents(*curNode);
+		if (parents.size() == 0) {
+			break;
+		}
+		if (parents.size() > 1) {
+			llvm::outs() << std::format("multiple parents {}\n",
+			  parents.size());
+		}
+		++count;
+		curNode = &parents[0];
+	}
+	return count;
+}
+
+clang::DynTypedNode getFarAncestor(clang::ASTContext& astContext,
+  const clang::DynTypedNode* node) {
+	const clang::DynTypedNode* curNode = node;
+	clang::DynTypedNode parentNode;
+	for (;;) {
+		auto parents = astContext.getParents(*curNode);
+		if (parents.size() == 0) {
+			break;
+		}
+		if (parents.size() > 1) {
+			llvm::outs() << std::format("multiple parents {}\n",
+			  parents.size());
+		}
+		curNode = &parents[0];
+		parentNode = *curNode;
+	}
+	return parentNode;
+}
+
+clang::DynTypedNode getParent(clang::ASTContext& astContext,
+  const clang::DynTypedNode* node) {
+	auto parents = astContext.getParents(*node);
+	clang::DynTypedNode parentNode;
+	if (parents.size() > 0) {
+		if (parents.size() > 1) {
+			llvm::outs() << std::format("multiple parents {}\n",
+			  parents.size());
+		}
+		parentNode = parents[0];
+	} else {
+		parentNode = clang::DynTypedNode();
+	}
+	return parentNode;
+}
+
+clang::SourceRange charSourceRangeToSourceRange(const clang::SourceManager&
+  sourceManager, clang::CharSourceRange charSourceRange) {
+	return clang::SourceRange(
+	  getBeginningOfToken(sourceManager, charSourceRange.getBegin()),
+	  getBeginningOfToken(sourceManager, charSourceRange.getEnd()));
+}
+
+AST_MATCHER(clang::Decl, hasComment) {
+	if (auto p = Finder->getASTContext().getCommentForDecl(&Node, nullptr)) {
+		return true;
+	} else {
+		return false;
+	}
+}
+
+AST_MATCHER(clang::CXXMethodDecl, isSpecialMember) {
+	bool result;
+	if (auto p = llvm::dyn_cast<clang::CXXConstructorDecl>(&Node)) {
+		result = p->isDefaultConstructor() || p->isCopyConstructor() ||
+		  p->isMoveConstructor();
+	} else if (auto p = llvm::dyn_cast<clang::CXXDestructorDecl>(&Node)) {
+		result = true;
+	} else {
+		result = Node.isCopyAssignmentOperator() ||
+		  Node.isMoveAssignmentOperator();
+	}
+	return result;
+}
+
+AST_MATCHER_P(clang::CXXMethodDecl, paramCountAtLeast, unsigned, Threshold) {
+	return Node.param_size() >= Threshold;
+}
+
+AST_MATCHER_P(clang::CXXMethodDecl, hasNumOverrides, unsigned, N) {
+	const auto& node = Node;
+	return node.size_overridden_methods() >= N;
+}
+
+AST_MATCHER_P(clang::NamedDecl, nameLengthAtLeast, unsigned, Threshold) {
+	return Node.getIdentifier() && Node.getName().size() >= Threshold;
+}
+
+cam::DeclarationMatcher getDeclMatcher(int id) {
+	using namespace cam;
+	switch (id) {
+	default:
+	case 0:
+		return decl().bind("x");
+	case 1:
+		return namedDecl().bind("x");
+	case 2:
+		return varDecl().bind("x");
+	case 3:
+		return functionDecl().bind("x");
+	case 4:
+		return cxxMethodDecl().bind("x");
+	case 5:
+		return recordDecl().bind("x");
+	case 6:
+		return cxxRecordDecl().bind("x");
+	// gap in numbering of cases
+	case 40:
+		return decl(hasComment()).bind("x");
+	// gap in numbering of cases
+	case 50:
+		return cxxMethodDecl(isDefinition(), isSpecialMember(),
+		  unless(isImplicit())).bind("x");
+	case 51:
+		return cxxMethodDecl(paramCountAtLeast(4)).bind("x");
+	case 52:
+		return cxxMethodDecl(hasNumOverrides(1)).bind("x");
+	case 53:
+		return namedDecl(nameLengthAtLeast(6)).bind("x");
+	}
+}
+
+cam::StatementMatcher getStmtMatcher(int id) {
+	using namespace cam;
+	switch (id) {
+	default:
+	case 0:
+		return stmt().bind("x");
+	case 1:
+		return expr().bind("x");
+	case 2:
+		return callExpr().bind("x");
+	case 3:
+		return ifStmt().bind("x");
+	case 4:
+		return switchStmt().bind("x");
+	case 5:
+		return forStmt().bind("x");
+	case 6:
+		return whileStmt().bind("x");
+	case 7:
+		return doStmt().bind("x");
+	case 8:
+		return materializeTemporaryExpr().bind("x");
+	}
+}
+
+bool printMatch(llvm::raw_ostream& out, clang::SourceManager& sourceManager,
+  clang::SourceRange sourceRange) {
+	bool status = true;
+
+	assert(sourceRange.isValid());
+
+	clang::CharSourceRange expRange = sourceManager.getExpansionRange(
+	  sourceRange);
+	clang::SourceRange expTokenRange = charSourceRangeToSourceRange(
+	  sourceManager, expRange);
+	auto expFileName = std::string(sourceManager.getFilename(
+	  sourceManager.getExpansionLoc(expRange.getBegin())));
+	unsigned expBeginLineNum = sourceManager.getExpansionLineNumber(
+	  expRange.getBegin());
+	unsigned expBeginColumnNum = sourceManager.getExpansionColumnNumber(
+	  expRange.getBegin());
+	unsigned expEndLineNum = sourceManager.getExpansionLineNumber(
+	  expRange.getEnd());
+	unsigned expEndColumnNum = sourceManager.getExpansionColumnNumber(
+	  expRange.getEnd());
+	auto expEndFileName = std::string(sourceManager.getFilename(
+	  sourceManager.getExpansionLoc(expRange.getEnd())));
+
+	out
+	  << std::format("expansion range {}:{}({})-{}:{}({})\n", expFileName,
+	  expBeginLineNum, expBeginColumnNum, expEndFileName, expEndLineNum,
+	  expEndColumnNum)
+	  << "\nexpansion range text:\n";
+	// NOTE: The snippet is rendered directly from the source buffer.
+	cal::SnippetOptions snippetOptions;
+	snippetOptions.columnHeader = true;
+	if (!cal::renderSourceSnippet(out, sourceManager, expRange,
+	  snippetOptions)) {
+		out << "[invalid]\n";
+		status = false;
+	}
+	out << '\n';
+
+	out
+	  << std::format("spelling location {}:{}({})\n",
+	  std::string(sourceManager.getFilename(sourceManager.getSpellingLoc(
+	  sourceRange.getBegin()))),
+	  sourceManager.getSpellingLineNumber(sourceRange.getBegin()),
+	  sourceManager.getSpellingColumnNumber(sourceRange.getBegin()));
+
+#if 0
+	clang::SourceLocation spellRangeBegin = sourceManager.getSpellingLoc(
+	  sourceRange.getBegin());
+	clang::SourceLocation spellRangeEnd = sourceManager.getSpellingLoc(
+	  sourceRange.getEnd());
+	unsigned spellBeginLineNum = sourceManager.getSpellingLineNumber(
+      spellRangeBegin);
+	unsigned spellBeginColumnNum = sourceManager.getSpellingColumnNumber(
+      spellRangeBegin);
+	clang::SourceRange spellRange(spellRangeBegin, spellRangeEnd);
+	out
+	  << std::format("\nspelling range text:\n{}\n",
+	  cal::addLineNumbers(sourceRangeToText(sourceManager, spellRange, true).second,
+	  spellBeginLineNum, spellBeginColumnNum, true, true));
+#endif
+
+	if (expTokenRange != sourceRange) {
+		auto [valid, text] = sourceRangeToText(sourceManager, sourceRange);
+		if (valid) {
+			cal::SnippetOptions snippetOptions;
+			snippetOptions.columnHeader = true;
+			out << "\nsource range:\n";
+			cal::renderSnippet(out, text, snippetOptions);
+			out << '\n';
+		} else {
+			out <<
+			  "cannot print range (probably in macro expansion)\n";
+		}
+	} else {
+		out << "source range same as expansion range\n";
+	}
+
+	out
+	  << std::format("expansion is token range: {}\n",
+	  expRange.isTokenRange())
+	  << std::format("sourceRange.getBegin().isMacroID(): {}\n",
+	  sourceRange.getBegin().isMacroID());
+
+#ifdef ENABLE_EXPERIMENTAL
+	examineSourceLocation(out, sourceManager, sourceRange.getBegin());
+	examineSourceLocation(out, sourceManager, sourceRange.getEnd());
+#endif
+	return status;
+}
+
+llvm::StringRef MyMatchCallback::getFileName(
+  const clang::SourceManager& sourceManager, clang::FileID fileId) {
+	auto [i, inserted] = fileNames_.try_emplace(fileId);
+	if (inserted) {
+		if (auto entry = sourceManager.getFileEntryRefForID(fileId)) {
+			i->second = std::string(entry->getName());
+		}
+	}
+	return i->second;
+}
+
+// NOTE: The JSON values are created from string references (to avoid
+// copying) unless the string must be repaired to be valid UTF-8.
+static json::Value toJsonString(llvm::StringRef s) {
+	return json::isUTF8(s) ? json::Value(s) : json::Value(json::fixUTF8(s));
+}
+
+void MyMatchCallback::writeJsonRecord(
+  const cam::MatchFinder::MatchResult& result, llvm::StringRef queryName) {
+	const auto& nodes = result.Nodes.getMap();
+	auto nodeIter = nodes.find("x");
+	assert(nodeIter != nodes.end());
+	const clang::DynTypedNode& node = nodeIter->second;
+	clang::ASTContext& astContext = *result.Context;
+	const clang::SourceManager& sourceManager = astContext.getSourceManager();
+
+	// NOTE: The name is only computed for named declarations.
+	std::string name;
+	if (auto namedDecl = node.get<clang::NamedDecl>()) {
+		name = namedDecl->getQualifiedNameAsString();
+	}
+
+	json::OStream json(out_);
+	auto writeLocation = [&](llvm::StringRef key, clang::SourceLocation loc) {
+		json.attributeBegin(key);
+		if (loc.isValid()) {
+			auto [fileId, offset] =
+			  sourceManager.getDecomposedExpansionLoc(loc);
+			json.object([&] {
+				json.attribute("file",
+				  toJsonString(getFileName(sourceManager, fileId)));
+				json.attribute("line",
+				  sourceManager.getLineNumber(fileId, offset));
+				json.attribute("column",
+				  sourceManager.getColumnNumber(fileId, offset));
+			});
+		} else {
+			json.value(nullptr);
+		}
+		json.attributeEnd();
+	};
+	clang::SourceRange sourceRange = node.getSourceRange();
+	json.object([&] {
+		json.attribute("match", count_);
+		json.attribute("query", queryName.empty() ? json::Value(nullptr) :
+		  toJsonString(queryName));
+		json.attribute("kind", node.getNodeKind().asStringRef());
+		json.attribute("name", toJsonString(name));
+		// NOTE: The end location is the beginning of the last token.
+		writeLocation("begin", sourceRange.getBegin());
+		writeLocation("end", sourceRange.getEnd());
+		if (dumpAst_) {
+			std::string dumpOutput;
+			llvm::raw_string_ostream dumpStream(dumpOutput);
+			node.dump(dumpStream, astContext);
+			json.attribute("ast", toJsonString(dumpOutput));
+		}
+	});
+	out_ << '\n';
+}
+
+void MyMatchCallback::run(const cam::MatchFinder::MatchResult& result,
+  llvm::StringRef queryName) {
+	// NOTE: Most matches are shorter than the trace granularity, but the
+	// total time is still recorded in the trace.
+	llvm::TimeTraceScope traceScope("OutputMatch");
+	if (format_ == OutputFormat::JsonLines) {
+		writeJsonRecord(result, queryName);
+		++count_;
+		return;
+	}
+	clang::ASTContext& astContext = *result.Context;
+	clang::SourceManager& sourceManager = astContext.getSourceManager();
+	clang::SourceRange sourceRange;
+	clang::SourceRange altSourceRange;
+	clang::SourceLocation sourceLocation;
+	std::string nodeType;
+	std::string name;
+	clang::DynTypedNode node;
+
+	bool found = false;
+	if (auto p = result.Nodes.getNodeAs<clang::Stmt>("x")) {
+		found = true;
+		if (auto p = result.Nodes.getNodeAs<clang::CallExpr>("x")) {
+			nodeType = "CallExpr";
+			sourceRange = p->getSourceRange();
+			assert(sourceRange.getBegin() == p->getBeginLoc());
+			assert(sourceRange.getEnd() == p->getEndLoc());
+			// name not set
+			//parents = astContext.getParents(*p);
+			node = clang::DynTypedNode::create(*p);
+		} else if (auto p = result.Nodes.getNodeAs<clang::IfStmt>("x")) {
+			nodeType = "IfStmt";
+			sourceRange = p->getSourceRange();
+			// name not set
+			node = clang::DynTypedNode::create(*p);
+		} else if (auto p =
+		  result.Nodes.getNodeAs<clang::CompoundStmt>("x")) {
+			nodeType = "CompoundStmt";
+			sourceRange = p->getSourceRange();
+			// name not set
+			node = clang::DynTypedNode::create(*p);
+		} else if (auto p = result.Nodes.getNodeAs<clang::Expr>("x")) {
+			nodeType = "Expr";
+			sourceRange = p->getSourceRange();
+			// name not set
+			node = clang::DynTypedNode::create(*p);
+		} else if (auto p = result.Nodes.getNodeAs<clang::Stmt>("x")) {
+			nodeType = "Stmt";
+			sourceRange = p->getSourceRange();
+			// name not set
+			node = clang::DynTypedNode::create(*p);
+		} else {
+			found = false;
+		}
+	} else if (result.Nodes.getNodeAs<clang::Decl>("x")) {
+		found = true;
+		if (auto p = result.Nodes.getNodeAs<clang::CXXMethodDecl>("x")) {
+			nodeType = "CXXMethodDecl";
+			sourceRange = p->getSourceRange();
+			assert(sourceRange.getBegin() == p->getBeginLoc());
+			sourceLocation = p->getLocation();
+			name = p->getQualifiedNameAsString();
+			node = clang::DynTypedNode::create(*p);
+		} else if (auto p =
+		  result.Nodes.getNodeAs<clang::FunctionDecl>("x")) {
+			nodeType = "FunctionDecl";
+			sourceRange = p->getSourceRange();
+			assert(sourceRange.getBegin() == p->getBeginLoc());
+			sourceLocation = p->getLocation();
+			name = p->getQualifiedNameAsString();
+			node = clang::DynTypedNode::create(*p);
+		} else if (auto p =
+		  result.Nodes.getNodeAs<clang::ParmVarDecl>("x")) {
+			nodeType = "ParmVarDecl";
+			sourceRange = p->getSourceRange();
+			assert(sourceRange.getBegin() == p->getBeginLoc());
+			sourceLocation = p->getLocation();
+			name = p->getQualifiedNameAsString();
+			node = clang::DynTypedNode::create(*p);
+		} else if (auto p = result.Nodes.getNodeAs<clang::VarDecl>("x")) {
+			nodeType = "VarDecl";
+			sourceRange = p->getSourceRange();
+			assert(sourceRange.getBegin() == p->getBeginLoc());
+			sourceLocation = p->getLocation();
+			name = p->getQualifiedNameAsString();
+			node = clang::DynTypedNode::create(*p);
+		} else if (auto p =
+		  result.Nodes.getNodeAs<clang::CXXRecordDecl>("x")) {
+			nodeType = "CXXRecordDecl";
+			sourceRange = p->getSourceRange();
+			// TODO/NOTE: Why can the following assertion fail?
+			// assert(sourceRange.getBegin() == p->getBeginLoc());
+			sourceLocation = p->getLocation();
+			name = p->getQualifiedNameAsString();
+			node = clang::DynTypedNode::create(*p);
+		} else if (auto p =
+		  result.Nodes.getNodeAs<clang::RecordDecl>("x")) {
+			nodeType = "RecordDecl";
+			sourceRange = p->getSourceRange();
+			assert(sourceRange.getBegin() == p->getBeginLoc());
+			sourceLocation = p->getLocation();
+			name = p->getQualifiedNameAsString();
+			node = clang::DynTypedNode::create(*p);
+		} else if (auto p = result.Nodes.getNodeAs<clang::NamedDecl>("x")) {
+			nodeType = "NamedDecl";
+			sourceRange = p->getSourceRange();
+			assert(sourceRange.getBegin() == p->getBeginLoc());
+			sourceLocation = p->getLocation();
+			name = p->getQualifiedNameAsString();
+			node = clang::DynTypedNode::create(*p);
+		} else if (auto p = result.Nodes.getNodeAs<clang::EmptyDecl>("x")) {
+			nodeType = "EmptyDecl";
+			sourceRange = p->getSourceRange();
+			assert(sourceRange.getBegin() == p->getBeginLoc());
+			sourceLocation = p->getLocation();
+			node = clang::DynTypedNode::create(*p);
+			// name not set
+		} else if (auto p = result.Nodes.getNodeAs<clang::Decl>("x")) {
+			nodeType = "Decl";
+			sourceRange = p->getSourceRange();
+			assert(sourceRange.getBegin() == p->getBeginLoc());
+			sourceLocation = p->getLocation();
+			// name not set
+			node = clang::DynTypedNode::create(*p);
+		} else {
+			found = false;
+		}
+	}
+	if (!found) {
+		// NOTE: A runtime query can match a node that is neither a
+		// statement nor a declaration (e.g., a type).
+		const auto& nodes = result.Nodes.getMap();
+		if (auto i = nodes.find("x"); i != nodes.end()) {
+			found = true;
+			node = i->second;
+			nodeType = std::string(node.getNodeKind().asStringRef());
+			sourceRange = node.getSourceRange();
+		}
+	}
+	assert(found);
+	out_
+	  << std::format("{}\nMATCH #{}\n", std::string(80, '-'), count_);
+	if (!queryName.empty()) {
+		out_ << std::format("query: {}\n", std::string(queryName));
+	}
+	out_
+	  << std::format("type: {}\n", nodeType)
+	  << std::format("name: {}\n", name);
+
+	if (verbose_ >= 2) {
+		auto parents = astContext.getParents(node);
+		clang::DynTypedNode farthestAncestor =
+		  getFarAncestor(astContext, &node);
+		out_ << std::format("depth: {}\n",
+		  getDepth(astContext, &node));
+		out_ << std::format("number of parents: {}\n",
+		  parents.size());
+		farthestAncestor.dump(out_, astContext);
+		node.dump(out_, astContext);
+		{
+			clang::DynTypedNode curNode = node;
+			for (;;) {
+				clang::DynTypedNode parentNode =
+				  getParent(astContext, &curNode);
+				out_
+				  << std::format("{}\n", std::string(80, '-'), count_);
+				out_
+				  << std::format("node kind {}\n",
+				  std::string(parentNode.getNodeKind().asStringRef()));
+				parentNode.dump(out_, astContext);
+				curNode = parentNode;
+				if (parentNode.getNodeKind().isNone()) {
+					break;
+				}
+			}
+		}
+	}
+
+	bool status = true;
+	if (sourceRange.isValid()) {
+		out_
+		  << std::format("begin spelling location {}:{}({})\n",
+		  std::string(sourceManager.getFilename(
+		  sourceManager.getSpellingLoc(sourceRange.getBegin()))),
+		  sourceManager.getSpellingLineNumber(sourceRange.getBegin()),
+		  sourceManager.getSpellingColumnNumber(sourceRange.getBegin()));
+		out_
+		  << std::format("end spelling location {}:{}({})\n",
+		  std::string(sourceManager.getFilename(
+		  sourceManager.getSpellingLoc(sourceRange.getEnd()))),
+		  sourceManager.getSpellingLineNumber(sourceRange.getEnd()),
+		  sourceManager.getSpellingColumnNumber(sourceRange.getEnd()));
+		status = printMatch(out_, sourceManager, sourceRange);
+	} else {
+		out_ << "source range not valid\n";
+	}
+	if (sourceLocation.isValid()) {
+		out_
+		  << std::format("spelling location {}:{}({})\n",
+		  std::string(sourceManager.getFilename(
+		  sourceManager.getSpellingLoc(sourceLocation))),
+		  sourceManager.getSpellingLineNumber(sourceLocation),
+		  sourceManager.getSpellingColumnNumber(sourceLocation));
+	} else {
+		out_ << "source location not valid\n";
+	}
+	// NOTE: The AST is only dumped when needed, since dumping is expensive.
+	if (dumpAst_ || !status) {
+		node.dump(out_, astContext);
+	}
+	++count_;
+}
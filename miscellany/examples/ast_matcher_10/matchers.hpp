@@ -0,0 +1,139 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <clang/ASTMatchers/ASTMatchers.h>
+#include <clang/ASTMatchers/ASTMatchFinder.h>
+#include <clang/Basic/SourceLocation.h>
+#include <clang/Basic/SourceManager.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Get the declaration matcher with the specified ID.
+clang::ast_matchers::DeclarationMatcher getDeclMatcher(int id);
+
+// Get the statement matcher with the specified ID.
+clang::ast_matchers::StatementMatcher getStmtMatcher(int id);
+
+// The output format of MyMatchCallback.
+enum class OutputFormat {
+	// Human-readable text (with source text and, optionally, AST dumps and
+	// ancestor chains).
+	Text,
+	// One JSON record per line (with a fixed set of members), which is
+	// cheaper to produce than text.
+	JsonLines,
+};
+
+// A match callback that prints information about each matched node
+// (which is bound to the name "x").
+class MyMatchCallback :
+  public clang::ast_matchers::MatchFinder::MatchCallback {
+public:
+	MyMatchCallback(llvm::raw_ostream& out, int verbose = 0,
+	  bool dumpAst = false, OutputFormat format = OutputFormat::Text) :
+	  out_(out), verbose_(verbose), dumpAst_(dumpAst), format_(format),
+	  count_(0) {}
+	void onStartOfTranslationUnit() override {
+		// NOTE: File IDs are only meaningful within a translation unit.
+		fileNames_.clear();
+	}
+	void run(const clang::ast_matchers::MatchFinder::MatchResult& result)
+	  override {
+		run(result, {});
+	}
+	// Print information about a match for the named query (where the
+	// query name is printed if it is not empty).
+	void run(const clang::ast_matchers::MatchFinder::MatchResult& result,
+	  llvm::StringRef queryName);
+	unsigned getNumMatches() const {
+		return count_;
+	}
+	// Account for matches that were made elsewhere (e.g., in a worker
+	// process).
+	void addNumMatches(unsigned count) {
+		count_ += count;
+	}
+private:
+	void writeJsonRecord(
+	  const clang::ast_matchers::MatchFinder::MatchResult& result,
+	  llvm::StringRef queryName);
+	llvm::StringRef getFileName(const clang::SourceManager& sourceManager,
+	  clang::FileID fileId);
+	llvm::raw_ostream& out_;
+	int verbose_;
+	bool dumpAst_;
+	OutputFormat format_;
+	unsigned count_;
+	// The names of the files in the current translation unit (which are
+	// cached, since many matches are typically in the same file).
+	llvm::DenseMap<clang::FileID, std::string> fileNames_;
+};
+
+// A match callback for a built-in matcher that forwards each match to a
+// (shared) MyMatchCallback.
+// A separate callback is registered for each built-in matcher, so that
+// each one is recorded under its own ID by matcher profiling.
+class BuiltinMatchCallback :
+  public clang::ast_matchers::MatchFinder::MatchCallback {
+public:
+	BuiltinMatchCallback(std::string id, MyMatchCallback& callback) :
+	  id_(std::move(id)), callback_(callback) {}
+	void onStartOfTranslationUnit() override {
+		callback_.onStartOfTranslationUnit();
+	}
+	void run(const clang::ast_matchers::MatchFinder::MatchResult& result)
+	  override {
+		callback_.run(result);
+	}
+	// The ID under which matcher profiling records the matcher.
+	llvm::StringRef getID() const override {
+		return id_;
+	}
+private:
+	std::string id_;
+	MyMatchCallback& callback_;
+};
+
+// A match callback for a named query that forwards each match to a
+// (shared) MyMatchCallback.
+// Since a separate callback is registered for each query, all of the
+// queries can be run in a single traversal of the AST while still
+// identifying the query responsible for each match.
+class QueryMatchCallback :
+  public clang::ast_matchers::MatchFinder::MatchCallback {
+public:
+	QueryMatchCallback(std::string name, MyMatchCallback& callback) :
+	  name_(std::move(name)), id_("query " + name_), callback_(callback),
+	  count_(0) {}
+	// NOTE: The shared callback need not be registered with the match
+	// finder itself (e.g., when only queries are run), so the start of a
+	// translation unit must be forwarded to it.
+	void onStartOfTranslationUnit() override {
+		callback_.onStartOfTranslationUnit();
+	}
+	void run(const clang::ast_matchers::MatchFinder::MatchResult& result)
+	  override {
+		++count_;
+		callback_.run(result, name_);
+	}
+	// The ID under which matcher profiling records the query.
+	llvm::StringRef getID() const override {
+		return id_;
+	}
+	const std::string& getName() const {
+		return name_;
+	}
+	unsigned getNumMatches() const {
+		return count_;
+	}
+	void addNumMatches(unsigned count) {
+		count_ += count;
+	}
+private:
+	std::string name_;
+	std::string id_;
+	MyMatchCallback& callback_;
+	unsigned count_;
+};
@@ -0,0 +1,306 @@
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include <clang/Analysis/CFG.h>
+#include <clang/ASTMatchers/ASTMatchers.h>
+#include <clang/ASTMatchers/ASTMatchFinder.h>
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Tooling/ArgumentsAdjusters.h>
+#include <clang/Tooling/CompilationDatabase.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Chrono.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cal/main.hpp>
+
+#include "matchers.hpp"
+
+namespace ct = clang::tooling;
+namespace cam = clang::ast_matchers;
+namespace json = llvm::json;
+using namespace std::literals;
+
+static llvm::cl::OptionCategory optionCategory("Tool options");
+static llvm::cl::opt<std::string> clSocketPath(llvm::cl::Positional,
+  llvm::cl::desc("<socket>"), llvm::cl::Required,
+  llvm::cl::cat(optionCategory));
+static llvm::cl::opt<std::string> clClangIncludeDir(
+  "I", llvm::cl::desc("Clang include directory"),
+  llvm::cl::cat(optionCategory));
+static llvm::cl::opt<unsigned> clMaxUnits(
+  "max-units",
+  llvm::cl::desc("Maximum number of translation units kept in memory"),
+  llvm::cl::cat(optionCategory), llvm::cl::init(16));
+
+// The compilation databases that have been loaded (keyed by build
+// directory).
+// A database is reloaded if its compile_commands.json file changes.
+class CompDatabaseCache {
+public:
+	const ct::CompilationDatabase* get(const std::string& buildDir,
+	  std::string& errString) {
+		llvm::SmallString<256> jsonPath(buildDir);
+		llvm::sys::path::append(jsonPath, "compile_commands.json");
+		llvm::sys::fs::file_status status;
+		llvm::sys::TimePoint<> mtime;
+		if (!llvm::sys::fs::status(jsonPath, status)) {
+			mtime = status.getLastModificationTime();
+		}
+		auto i = entries_.find(buildDir);
+		if (i != entries_.end() && i->second.mtime == mtime) {
+			return i->second.database.get();
+		}
+		std::unique_ptr<ct::CompilationDatabase> database =
+		  ct::CompilationDatabase::loadFromDirectory(buildDir, errString);
+		if (!database) {
+			return nullptr;
+		}
+		Entry& entry = entries_[buildDir];
+		entry.database = std::move(database);
+		entry.mtime = mtime;
+		return entry.database.get();
+	}
+	std::size_t size() const {
+		return entries_.size();
+	}
+private:
+	struct Entry {
+		std::unique_ptr<ct::CompilationDatabase> database;
+		llvm::sys::TimePoint<> mtime;
+	};
+	llvm::StringMap<Entry> entries_;
+};
+
+// A match callback that prints the CFG of each matched function (as
+// done by the dump_cfg example).
+class CfgCallback : public cam::MatchFinder::MatchCallback {
+public:
+	CfgCallback(llvm::raw_ostream& out, bool useColor) : out_(out),
+	  useColor_(useColor) {}
+	void run(const cam::MatchFinder::MatchResult& result) override {
+		const auto* funcDecl =
+		  result.Nodes.getNodeAs<clang::FunctionDecl>("func");
+		if (!funcDecl) {
+			return;
+		}
+		clang::ASTContext* astContext = result.Context;
+		clang::Stmt* funcBody = funcDecl->getBody();
+		if (!funcBody) {
+			return;
+		}
+		out_ << std::format("FUNCTION: {}\n",
+		  funcDecl->getQualifiedNameAsString());
+		std::unique_ptr<clang::CFG> cfg = clang::CFG::buildCFG(funcDecl,
+		  funcBody, astContext, clang::CFG::BuildOptions());
+		if (!cfg) {
+			out_ << "unable to generate CFG\n";
+			return;
+		}
+		cfg->print(out_, astContext->getLangOpts(), useColor_);
+	}
+private:
+	llvm::raw_ostream& out_;
+	bool useColor_;
+};
+
+// The state that is kept across requests.
+struct ServerState {
+	CompDatabaseCache compDatabases;
+	std::unique_ptr<cal::TranslationUnitCache> unitCache;
+};
+
+// Run a match finder on the translation units named by a request.
+// The request has the following members:
+//   - "build_dir": the directory containing the compilation database;
+//   - "files": the (absolute) paths of the source files to process; and
+//   - "main_file_only" (optional): whether to traverse only the top-level
+//     declarations of the main file.
+int runFinder(ServerState& state, const json::Object& request,
+  cam::MatchFinder& matchFinder, llvm::raw_ostream& out) {
+	std::optional<llvm::StringRef> buildDir = request.getString("build_dir");
+	const json::Array* files = request.getArray("files");
+	bool mainFileOnly = request.getBoolean("main_file_only").value_or(false);
+	if (!buildDir || !files) {
+		out << "ERROR: request requires build_dir and files\n";
+		return 1;
+	}
+	std::string errString;
+	const ct::CompilationDatabase* compDatabase =
+	  state.compDatabases.get(std::string(*buildDir), errString);
+	if (!compDatabase) {
+		out << std::format("ERROR: {}\n", errString);
+		return 1;
+	}
+	int status = 0;
+	for (const json::Value& fileValue : *files) {
+		std::optional<llvm::StringRef> file = fileValue.getAsString();
+		if (!file) {
+			out << "ERROR: file is not a string\n";
+			status = 1;
+			continue;
+		}
+		std::vector<ct::CompileCommand> commands =
+		  compDatabase->getCompileCommands(*file);
+		if (commands.empty()) {
+			out << std::format("ERROR: no compile command for {}\n",
+			  std::string(*file));
+			status = 1;
+			continue;
+		}
+		clang::ASTUnit* astUnit = state.unitCache->get(commands.front(),
+		  errString);
+		if (!astUnit) {
+			out << std::format("ERROR: {}\n", errString);
+			status = 1;
+			continue;
+		}
+		clang::ASTContext& astContext = astUnit->getASTContext();
+		if (mainFileOnly) {
+			cal::setMainFileTraversalScope(astContext);
+		}
+		matchFinder.matchAST(astContext);
+		if (mainFileOnly) {
+			// NOTE: The AST is cached, so its traversal scope is restored.
+			astContext.setTraversalScope(
+			  {astContext.getTranslationUnitDecl()});
+		}
+	}
+	return status;
+}
+
+// Handle a request to run a matcher from the matcher table.
+// In addition to the members used by runFinder, the request has the
+// following (optional) members: "decl_matcher", "stmt_matcher", "queries"
+// (the text of a query file), "ignore_implicit", "dump_ast", "verbose", and
+// "format" ("text" or "jsonl").
+int handleMatch(ServerState& state, const json::Object& request,
+  llvm::raw_ostream& out) {
+	std::optional<std::int64_t> declMatcherId =
+	  request.getInteger("decl_matcher");
+	std::optional<std::int64_t> stmtMatcherId =
+	  request.getInteger("stmt_matcher");
+	bool ignoreImplicit =
+	  request.getBoolean("ignore_implicit").value_or(false);
+	bool dumpAst = request.getBoolean("dump_ast").value_or(false);
+	int verbose = static_cast<int>(
+	  request.getInteger("verbose").value_or(0));
+	cam::MatchFinder matchFinder;
+	OutputFormat format = request.getString("format") == "jsonl" ?
+	  OutputFormat::JsonLines : OutputFormat::Text;
+	MyMatchCallback matchCallback(out, verbose, dumpAst, format);
+	// NOTE: With JSON Lines output, the response contains only the match
+	// records.
+	llvm::raw_ostream& infoOut = format == OutputFormat::JsonLines ?
+	  llvm::nulls() : out;
+	if (declMatcherId) {
+		infoOut << std::format("decl matcher {}\n", *declMatcherId);
+		cam::DeclarationMatcher matcher = getDeclMatcher(
+		  static_cast<int>(*declMatcherId));
+		if (ignoreImplicit) {
+			infoOut << "NOTE: IGNORING IMPLICIT NODES\n";
+			matcher = cam::traverse(clang::TK_IgnoreUnlessSpelledInSource,
+			  matcher);
+		}
+		matchFinder.addMatcher(matcher, &matchCallback);
+	}
+	if (stmtMatcherId) {
+		infoOut << std::format("stmt matcher {}\n", *stmtMatcherId);
+		cam::StatementMatcher matcher = getStmtMatcher(
+		  static_cast<int>(*stmtMatcherId));
+		if (ignoreImplicit) {
+			infoOut << "NOTE: IGNORING IMPLICIT NODES\n";
+			matcher = cam::traverse(clang::TK_IgnoreUnlessSpelledInSource,
+			  matcher);
+		}
+		matchFinder.addMatcher(matcher, &matchCallback);
+	}
+	std::vector<std::unique_ptr<QueryMatchCallback>> queryCallbacks;
+	if (std::optional<llvm::StringRef> queryText =
+	  request.getString("queries")) {
+		llvm::Expected<std::vector<cal::MatcherQuery>> queries =
+		  cal::parseMatcherQueries(*queryText, "queries", "x");
+		if (!queries) {
+			out << std::format("ERROR: {}\n",
+			  llvm::toString(queries.takeError()));
+			return 1;
+		}
+		for (auto& query : *queries) {
+			if (ignoreImplicit) {
+				query.matcher = query.matcher.withTraversalKind(
+				  clang::TK_IgnoreUnlessSpelledInSource);
+			}
+			queryCallbacks.push_back(std::make_unique<QueryMatchCallback>(
+			  query.name, matchCallback));
+			if (!matchFinder.addDynamicMatcher(query.matcher,
+			  queryCallbacks.back().get())) {
+				out << std::format("WARNING: query {} matches an "
+				  "unsupported node kind\n", query.name);
+			}
+		}
+	}
+	int status = runFinder(state, request, matchFinder, out);
+	for (const auto& callback : queryCallbacks) {
+		infoOut << std::format("number of matches for query {}: {}\n",
+		  callback->getName(), callback->getNumMatches());
+	}
+	infoOut << std::format("number of matches: {}\n",
+	  matchCallback.getNumMatches());
+	return status;
+}
+
+// Handle a request to dump the CFGs of functions.
+// In addition to the members used by runFinder, the request has the
+// following (optional) members: "function" (a regular expression for the
+// qualified function name) and "color".
+int handleCfg(ServerState& state, const json::Object& request,
+  llvm::raw_ostream& out) {
+	std::string namePattern(request.getString("function").value_or(".*"));
+	bool useColor = request.getBoolean("color").value_or(false);
+	cam::MatchFinder matchFinder;
+	CfgCallback cfgCallback(out, useColor);
+	matchFinder.addMatcher(
+	  cam::functionDecl(cam::matchesName(namePattern)).bind("func"),
+	  &cfgCallback);
+	return runFinder(state, request, matchFinder, out);
+}
+
+int main(int argc, const char **argv) {
+	clClangIncludeDir = cal::getClangIncludeDirPath();
+	llvm::cl::HideUnrelatedOptions(optionCategory);
+	llvm::cl::ParseCommandLineOptions(argc, argv,
+	  "Serve matcher requests over a Unix-domain socket\n");
+	ct::ArgumentsAdjuster adjuster;
+	if (!clClangIncludeDir.empty()) {
+		adjuster = ct::getInsertArgumentAdjuster(("-I"s +=
+		  clClangIncludeDir).c_str(), ct::ArgumentInsertPosition::BEGIN);
+	}
+	ServerState state;
+	state.unitCache = std::make_unique<cal::TranslationUnitCache>(clMaxUnits,
+	  adjuster);
+	cal::AnalysisServer server(clSocketPath);
+	server.addHandler("match", [&](const json::Object& request,
+	  llvm::raw_ostream& out) {return handleMatch(state, request, out);});
+	server.addHandler("cfg", [&](const json::Object& request,
+	  llvm::raw_ostream& out) {return handleCfg(state, request, out);});
+	server.addHandler("stats", [&](const json::Object& request,
+	  llvm::raw_ostream& out) {
+		out << std::format("requests: {}\n", server.getNumRequests())
+		  << std::format("compilation databases: {}\n",
+		  state.compDatabases.size());
+		state.unitCache->printStats(out);
+		return 0;
+	});
+	if (llvm::Error error = server.run()) {
+		llvm::errs() << std::format("ERROR: {}\n",
+		  llvm::toString(std::move(error)));
+		return 1;
+	}
+	return 0;
+}
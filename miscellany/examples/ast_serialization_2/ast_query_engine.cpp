@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <clang/ASTMatchers/ASTMatchFinder.h>
+#include <clang/Frontend/ASTUnit.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cal/main.hpp>
+
+#include "ast_query_engine.hpp"
+#include "utility.hpp"
+
+namespace cam = clang::ast_matchers;
+
+namespace {
+
+// The memory of a loaded AST unit per byte of its AST file, which is used
+// to estimate the memory of an AST unit before it is loaded.
+// NOTE: Declarations are deserialized lazily, so a loaded AST unit is
+// usually not much larger than its AST file.
+constexpr std::uint64_t astMemoryPerByte = 2;
+
+} // namespace
+
+unsigned runAstQuery(const std::vector<std::string>& astFiles,
+  const AstQuery& query, const AstQueryOptions& options,
+  llvm::raw_ostream& out) {
+	// NOTE: Each worker holds at most one AST unit at a time, so limiting
+	// the number of workers limits the number of units in flight.
+	unsigned numWorkers = options.numThreads ? options.numThreads :
+	  cal::getDefaultConcurrency();
+	if (options.maxInFlight) {
+		numWorkers = std::min(numWorkers, options.maxInFlight);
+	}
+	// NOTE: The results for each AST file are buffered and written in the
+	// order of the AST files.
+	cal::OrderedOutput output(astFiles.size(), out);
+	cal::MemoryBudget memoryBudget(options.memoryLimit);
+	std::atomic<unsigned> numFailures(0);
+	cal::parallelFor(astFiles.size(), numWorkers,
+	  [&](std::size_t index, unsigned) {
+		cal::OutputScope outputScope(output, index);
+		llvm::raw_ostream& resultStream = outputScope.outs();
+		resultStream << std::format("AST file: {}\n", astFiles[index]);
+		std::uint64_t fileSize = 0;
+		llvm::sys::fs::file_size(astFiles[index], fileSize);
+		cal::MemoryBudget::Ticket ticket = memoryBudget.admit(
+		  astMemoryPerByte * fileSize);
+		std::unique_ptr<clang::ASTUnit> astUnit = loadAstUnitFromFile(
+		  astFiles[index], options.astOnly ? clang::ASTUnit::LoadASTOnly :
+		  clang::ASTUnit::LoadEverything);
+		// The memory of the AST unit is now part of the resident set size
+		// (which the budget accounts for directly).
+		ticket.settle();
+		if (astUnit) {
+			query(*astUnit, resultStream);
+		} else {
+			resultStream << "cannot load AST file\n";
+			++numFailures;
+		}
+		// Release the AST unit (and its memory reservation) as soon as the
+		// query has finished, before waiting to write the results.
+		astUnit.reset();
+		ticket.release();
+	});
+	return numFailures;
+}
+
+AstQuery makeMatcherQuery(MatcherSetFactory factory) {
+	return [factory = std::move(factory)](clang::ASTUnit& astUnit,
+	  llvm::raw_ostream& out) {
+		cam::MatchFinder matchFinder;
+		std::shared_ptr<void> callbacks = factory(matchFinder, out);
+		matchFinder.matchAST(astUnit.getASTContext());
+	};
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/RecursiveASTVisitor.h>
+#include <clang/ASTMatchers/ASTMatchFinder.h>
+#include <clang/Frontend/ASTUnit.h>
+#include <llvm/Support/raw_ostream.h>
+
+// A query to be run on an AST unit.
+// The query writes its results to the specified stream.
+// A query may be invoked concurrently on different AST units, so it must
+// not modify shared state without synchronization.
+using AstQuery = std::function<void(clang::ASTUnit& astUnit,
+  llvm::raw_ostream& out)>;
+
+struct AstQueryOptions {
+	// The number of worker threads (where zero means the number of CPUs).
+	unsigned numThreads = 0;
+	// The maximum number of AST units that are loaded at any one time
+	// (where zero means no limit other than the number of threads).
+	// This bounds the peak memory usage.
+	unsigned maxInFlight = 0;
+	// The maximum memory of the process (in bytes), where zero means no
+	// limit.  An AST unit is only loaded while the current memory of the
+	// process plus its estimated memory (which is based on the size of its
+	// AST file) fits in this budget.
+	std::uint64_t memoryLimit = 0;
+	// Indicates if the query only needs the AST (and not, for example, the
+	// preprocessor state).
+	bool astOnly = false;
+};
+
+// Run a query on each of the specified AST files.
+// The results for each AST file are written to the output stream in the
+// order in which the AST files are specified (regardless of the order in
+// which the AST files are processed).  The results for an AST file are
+// written as soon as the results for all preceding AST files have been
+// written.
+// The query runs in a CAL output scope, so output written with cal::print
+// and cal::log (or to cal::outs and cal::errs) is also ordered in this way
+// (where the latter goes to the standard error).
+// Returns the number of AST files that could not be loaded.
+unsigned runAstQuery(const std::vector<std::string>& astFiles,
+  const AstQuery& query, const AstQueryOptions& options,
+  llvm::raw_ostream& out);
+
+// Make a query that runs a RecursiveASTVisitor over the whole AST.
+// The visitor type must be constructible from an ASTContext and an output
+// stream.  A new visitor is created for each AST unit.
+template <class Visitor>
+AstQuery makeVisitorQuery() {
+	return [](clang::ASTUnit& astUnit, llvm::raw_ostream& out) {
+		Visitor visitor(astUnit.getASTContext(), out);
+		visitor.TraverseAST(astUnit.getASTContext());
+	};
+}
+
+// Make a query that runs a set of AST matchers over the whole AST.
+// The function is called (once per AST unit) to add the matchers and
+// callbacks to a new MatchFinder.  The callbacks that it creates should
+// be owned by the returned object, which is destroyed after matching.
+using MatcherSetFactory = std::function<std::shared_ptr<void>(
+  clang::ast_matchers::MatchFinder& matchFinder, llvm::raw_ostream& out)>;
+AstQuery makeMatcherQuery(MatcherSetFactory factory);
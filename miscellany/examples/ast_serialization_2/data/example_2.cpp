@@ -0,0 +1,6 @@
+#include "example_2.hpp"
+
+int main()
+{
+	return get_answer();
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+constexpr auto get_answer() {
+	return 42;
+}
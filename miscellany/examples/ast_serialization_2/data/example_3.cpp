@@ -0,0 +1,3 @@
+namespace foo {
+	constexpr int forty_two = 42;
+}
@@ -0,0 +1,80 @@
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <string>
+#include <vector>
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Decl.h>
+#include <clang/Basic/SourceManager.h>
+#include <clang/Frontend/ASTUnit.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cal/main.hpp>
+
+#include "utility.hpp"
+
+namespace lc = llvm::cl;
+
+static lc::opt<std::string> inputPath(lc::Positional,
+  lc::desc("<AST file or (with -cache-dir) source file>"), lc::Required);
+static lc::opt<std::string> clangIncDir("clang-include-dir",
+  lc::desc("Clang include directory"));
+static lc::list<std::string> extraArgs("extra-arg",
+  lc::desc("extra arg"), lc::ZeroOrMore);
+static lc::opt<std::string> cacheDir("cache-dir",
+  lc::desc("AST cache directory"));
+static lc::opt<std::uint64_t> cacheSize("cache-size",
+  lc::desc("Maximum AST cache size in MiB (0 means no limit)"),
+  lc::init(0));
+static lc::opt<bool> verbose("v", lc::desc("Verbose"));
+
+// Print the top-level declarations that are in the main file.
+void printTopLevelDecls(clang::ASTUnit& astUnit) {
+	clang::ASTContext& astContext = astUnit.getASTContext();
+	clang::SourceManager& sourceManager = astUnit.getSourceManager();
+	for (clang::Decl* decl : astContext.getTranslationUnitDecl()->decls()) {
+		if (!sourceManager.isInMainFile(decl->getLocation())) {
+			continue;
+		}
+		auto namedDecl = llvm::dyn_cast<clang::NamedDecl>(decl);
+		llvm::outs() << std::format("{} {}\n",
+		  std::string(decl->getDeclKindName()),
+		  namedDecl ? namedDecl->getQualifiedNameAsString() : "");
+	}
+}
+
+int main(int argc, const char** argv) {
+	clangIncDir = cal::getClangIncludeDirPath();
+	lc::ParseCommandLineOptions(argc, argv, "AST deserializer\n");
+	std::string astPath = inputPath;
+	if (!cacheDir.empty()) {
+		// The input is a source file, which is resolved to an AST file by
+		// way of the cache.
+		cal::AstCache astCache(cacheDir, cacheSize * 1024 * 1024);
+		std::vector<std::string> args = getCompilerArgs(clangIncDir,
+		  {extraArgs.begin(), extraArgs.end()});
+		bool hit = false;
+		llvm::Expected<std::string> cachedAstPath = astCache.getOrBuild(
+		  inputPath, args, &hit);
+		if (!cachedAstPath) {
+			llvm::errs() << std::format("cannot get AST: {}\n",
+			  llvm::toString(cachedAstPath.takeError()));
+			return 1;
+		}
+		if (verbose) {
+			llvm::outs() << std::format("AST cache {}: {}\n",
+			  hit ? "hit" : "miss", *cachedAstPath);
+		}
+		astPath = *cachedAstPath;
+	}
+	std::unique_ptr<clang::ASTUnit> astUnit = loadAstUnitFromFile(astPath);
+	if (!astUnit) {
+		llvm::errs() << "cannot load AST file\n";
+		return 1;
+	}
+	llvm::outs() << std::format("main file name: {}\n",
+	  std::string_view(astUnit->getMainFileName()));
+	printTopLevelDecls(*astUnit);
+	return 0;
+}
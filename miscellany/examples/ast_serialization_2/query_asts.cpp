@@ -0,0 +1,189 @@
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Decl.h>
+#include <clang/AST/Expr.h>
+#include <clang/AST/RecursiveASTVisitor.h>
+#include <clang/ASTMatchers/ASTMatchers.h>
+#include <clang/ASTMatchers/ASTMatchFinder.h>
+#include <clang/Basic/SourceManager.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cal/main.hpp>
+
+#include "ast_query_engine.hpp"
+
+namespace lc = llvm::cl;
+namespace cam = clang::ast_matchers;
+namespace json = llvm::json;
+
+enum class QueryKind {functions, calls};
+
+static lc::list<std::string> astPaths(lc::Positional,
+  lc::desc("<AST file>..."), lc::ZeroOrMore);
+static lc::opt<std::string> manifestPath("manifest",
+  lc::desc("Query all of the AST files listed in a manifest "
+  "(as written by save_ast -p)"));
+static lc::opt<QueryKind> queryKind("query", lc::desc("Query to run"),
+  lc::values(
+  clEnumValN(QueryKind::functions, "functions",
+  "List function definitions (using a visitor)"),
+  clEnumValN(QueryKind::calls, "calls",
+  "List function calls (using a matcher)")),
+  lc::init(QueryKind::functions));
+static lc::opt<unsigned> numThreads("j",
+  lc::desc("Number of worker threads (0 means the number of CPUs)"),
+  lc::init(0));
+static lc::opt<unsigned> maxInFlight("max-in-flight",
+  lc::desc("Maximum number of AST units loaded at once (0 means no limit)"),
+  lc::init(0));
+static lc::opt<std::string> memoryLimit("memory-limit",
+  lc::desc("Maximum memory of the process, such as 32G (AST units are only "
+  "loaded while their estimated memory fits)"));
+
+std::string getLocationString(const clang::SourceManager& sourceManager,
+  clang::SourceLocation loc) {
+	clang::PresumedLoc presumedLoc = sourceManager.getPresumedLoc(loc);
+	if (presumedLoc.isInvalid()) {
+		return "<invalid>";
+	}
+	return std::format("{}:{}:{}", presumedLoc.getFilename(),
+	  presumedLoc.getLine(), presumedLoc.getColumn());
+}
+
+// A visitor that lists the function definitions in the main file.
+class FunctionLister : public clang::RecursiveASTVisitor<FunctionLister> {
+public:
+	FunctionLister(clang::ASTContext& astContext, llvm::raw_ostream& out) :
+	  astContext_(astContext), out_(out) {}
+	bool VisitFunctionDecl(clang::FunctionDecl* funcDecl) {
+		const clang::SourceManager& sourceManager =
+		  astContext_.getSourceManager();
+		if (funcDecl->isThisDeclarationADefinition() &&
+		  sourceManager.isInMainFile(funcDecl->getLocation())) {
+			out_ << std::format("function {} at {}\n",
+			  funcDecl->getQualifiedNameAsString(),
+			  getLocationString(sourceManager, funcDecl->getLocation()));
+		}
+		return true;
+	}
+private:
+	clang::ASTContext& astContext_;
+	llvm::raw_ostream& out_;
+};
+
+// A match callback that lists function calls.
+class CallLister : public cam::MatchFinder::MatchCallback {
+public:
+	explicit CallLister(llvm::raw_ostream& out) : out_(out) {}
+	void run(const cam::MatchFinder::MatchResult& result) override {
+		const auto* callExpr = result.Nodes.getNodeAs<clang::CallExpr>("call");
+		const auto* callee = result.Nodes.getNodeAs<clang::FunctionDecl>(
+		  "callee");
+		if (!callExpr || !callee) {
+			return;
+		}
+		out_ << std::format("call to {} at {}\n",
+		  callee->getQualifiedNameAsString(),
+		  getLocationString(*result.SourceManager, callExpr->getBeginLoc()));
+	}
+private:
+	llvm::raw_ostream& out_;
+};
+
+// Get the paths of the AST files listed in a manifest.
+std::optional<std::vector<std::string>> readManifest(const std::string& path) {
+	auto buffer = llvm::MemoryBuffer::getFile(path);
+	if (!buffer) {
+		return std::nullopt;
+	}
+	llvm::Expected<json::Value> manifest = json::parse(
+	  (*buffer)->getBuffer());
+	if (!manifest) {
+		llvm::consumeError(manifest.takeError());
+		return std::nullopt;
+	}
+	const json::Object* object = manifest->getAsObject();
+	const json::Array* units = object ? object->getArray("units") : nullptr;
+	if (!units) {
+		return std::nullopt;
+	}
+	// NOTE: The AST paths in the manifest are relative to the directory
+	// containing the manifest.
+	llvm::StringRef dir = llvm::sys::path::parent_path(path);
+	std::vector<std::string> paths;
+	for (const json::Value& unit : *units) {
+		const json::Object* unitObject = unit.getAsObject();
+		std::optional<llvm::StringRef> ast = unitObject ?
+		  unitObject->getString("ast") : std::nullopt;
+		if (!ast) {
+			continue;
+		}
+		llvm::SmallString<256> astPath(dir);
+		llvm::sys::path::append(astPath, *ast);
+		paths.emplace_back(astPath);
+	}
+	return paths;
+}
+
+int main(int argc, const char** argv) {
+	lc::ParseCommandLineOptions(argc, argv, "Query serialized ASTs\n");
+	std::vector<std::string> astFiles(astPaths.begin(), astPaths.end());
+	if (!manifestPath.empty()) {
+		std::optional<std::vector<std::string>> manifestFiles =
+		  readManifest(manifestPath);
+		if (!manifestFiles) {
+			llvm::errs() << std::format("cannot read manifest {}\n",
+			  std::string(manifestPath));
+			return 1;
+		}
+		astFiles.insert(astFiles.end(), manifestFiles->begin(),
+		  manifestFiles->end());
+	}
+	if (astFiles.empty()) {
+		llvm::errs() << "no AST files specified\n";
+		return 1;
+	}
+
+	AstQuery query;
+	switch (queryKind) {
+	case QueryKind::functions:
+		query = makeVisitorQuery<FunctionLister>();
+		break;
+	case QueryKind::calls:
+		query = makeMatcherQuery([](cam::MatchFinder& matchFinder,
+		  llvm::raw_ostream& out) {
+			auto callLister = std::make_shared<CallLister>(out);
+			matchFinder.addMatcher(cam::callExpr(cam::isExpansionInMainFile(),
+			  cam::callee(cam::functionDecl().bind("callee"))).bind("call"),
+			  callLister.get());
+			return std::shared_ptr<void>(callLister);
+		});
+		break;
+	}
+
+	AstQueryOptions options;
+	options.numThreads = numThreads;
+	options.maxInFlight = maxInFlight;
+	if (!memoryLimit.empty()) {
+		std::optional<std::uint64_t> limit = cal::parseMemorySize(
+		  memoryLimit);
+		if (!limit) {
+			llvm::errs() << std::format("invalid memory limit {}\n",
+			  memoryLimit.getValue());
+			return 1;
+		}
+		options.memoryLimit = *limit;
+	}
+	options.astOnly = true;
+	unsigned numFailures = runAstQuery(astFiles, query, options, llvm::outs());
+	return numFailures ? 1 : 0;
+}
@@ -0,0 +1,465 @@
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include <clang/Basic/Diagnostic.h>
+#include <clang/Basic/DiagnosticOptions.h>
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Frontend/TextDiagnosticPrinter.h>
+#include <clang/Serialization/PCHContainerOperations.h>
+#include <clang/Tooling/ArgumentsAdjusters.h>
+#include <clang/Tooling/CompilationDatabase.h>
+#include <clang/Tooling/Tooling.h>
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/ErrorOr.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cal/main.hpp>
+
+#include "utility.hpp"
+
+namespace lc = llvm::cl;
+namespace ct = clang::tooling;
+namespace json = llvm::json;
+
+static lc::list<std::string> sourcePaths(lc::Positional,
+  lc::desc("<source file>..."), lc::ZeroOrMore);
+static lc::opt<std::string> outPath("o",
+  lc::desc("Output AST file (or output directory with -p)"));
+static lc::opt<std::string> buildPath("p",
+  lc::desc("Build directory containing the compilation database "
+  "(serialize the AST for every translation unit)"));
+static lc::opt<unsigned> numThreads("j",
+  lc::desc("Number of worker threads (0 means the number of CPUs)"),
+  lc::init(0));
+static lc::opt<std::string> clangIncDir("clang-include-dir",
+  lc::desc("Clang include directory"));
+static lc::list<std::string> extraArgs("extra-arg",
+  lc::desc("extra arg"), lc::ZeroOrMore);
+static lc::opt<std::string> cacheDir("cache-dir",
+  lc::desc("AST cache directory"));
+static lc::opt<std::uint64_t> cacheSize("cache-size",
+  lc::desc("Maximum AST cache size in MiB (0 means no limit)"),
+  lc::init(0));
+static lc::opt<std::string> timeTracePath("time-trace",
+  lc::desc("Write a Chrome trace of the workers to the specified file "
+  "(with -p)"));
+static lc::opt<unsigned> timeTraceGranularity("time-trace-granularity",
+  lc::desc("Minimum duration of a traced span (in microseconds)"),
+  lc::init(500));
+static lc::opt<std::string> scheduleStatePath("schedule-state",
+  lc::desc("File in which the cost of each translation unit is kept across "
+  "runs in order to start the costliest ones first (with -p)"));
+static lc::opt<std::string> memoryLimit("memory-limit",
+  lc::desc("Maximum memory of the process, such as 32G (with -p); "
+  "translation units are only started while their estimated memory fits"));
+static lc::opt<bool> verbose("v", lc::desc("Verbose"));
+
+std::unique_ptr<llvm::MemoryBuffer> loadFile(const std::string& path) {
+	llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> bufferOrError{
+	  llvm::MemoryBuffer::getFile(path)};
+	if (!bufferOrError) {return nullptr;}
+	return std::move(*bufferOrError);
+}
+
+int saveWithoutCache(const std::string& sourcePath,
+  const std::vector<std::string>& args) {
+	std::unique_ptr<llvm::MemoryBuffer> sourceCode = loadFile(sourcePath);
+	if (!sourceCode) {
+		llvm::errs() << "cannot load source file\n";
+		return 1;
+	}
+	std::unique_ptr<clang::ASTUnit> astUnit = ct::buildASTFromCodeWithArgs(
+	  sourceCode->getBuffer(), args, sourcePath, "save_ast");
+	if (!astUnit) {
+		llvm::errs() << "failed to build AST\n";
+		return 1;
+	}
+	if (astUnit->Save(outPath)) {
+		llvm::errs() << "cannot save AST file\n";
+		return 1;
+	}
+	return 0;
+}
+
+int saveWithCache(const std::string& sourcePath,
+  const std::vector<std::string>& args) {
+	cal::AstCache astCache(cacheDir, cacheSize * 1024 * 1024);
+	bool hit = false;
+	llvm::Expected<std::string> cachedAstPath = astCache.getOrBuild(
+	  sourcePath, args, &hit);
+	if (!cachedAstPath) {
+		llvm::errs() << std::format("cannot get AST: {}\n",
+		  llvm::toString(cachedAstPath.takeError()));
+		return 1;
+	}
+	if (verbose) {
+		llvm::outs() << std::format("AST cache {}: {}\n",
+		  hit ? "hit" : "miss", *cachedAstPath);
+	}
+	if (!outPath.empty()) {
+		if (std::error_code ec = llvm::sys::fs::copy_file(*cachedAstPath,
+		  outPath)) {
+			llvm::errs() << std::format("cannot copy AST file: {}\n",
+			  ec.message());
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/****************************************************************************\
+Compilation-Database Mode
+\****************************************************************************/
+
+// A compilation database consisting of a single compile command.
+// This allows a ClangTool to process exactly one entry of another database
+// (which may have several entries for the same file).
+class SingleCommandDatabase : public ct::CompilationDatabase {
+public:
+	explicit SingleCommandDatabase(ct::CompileCommand command) :
+	  command_(std::move(command)) {}
+	std::vector<ct::CompileCommand> getCompileCommands(llvm::StringRef)
+	  const override {return {command_};}
+	std::vector<std::string> getAllFiles() const override
+	  {return {command_.Filename};}
+	std::vector<ct::CompileCommand> getAllCompileCommands() const override
+	  {return {command_};}
+private:
+	ct::CompileCommand command_;
+};
+
+// The result of serializing the AST for one translation unit.
+struct UnitResult {
+	// The path of the AST file relative to the output directory.
+	std::string astPath;
+	// The time taken to build and save the AST (in milliseconds).
+	double time;
+	// The growth in the resident set size due to building the AST (in
+	// bytes), if it was measured (i.e., if no other translation units were
+	// processed concurrently).
+	std::optional<std::uint64_t> memory;
+	// The size of the AST file (in bytes).
+	std::uint64_t size;
+	// Indicates if the AST was built and saved.
+	bool saved;
+	// Indicates if errors occurred while building the AST.
+	bool errors;
+};
+
+// Get the path (relative to the output directory) of the AST file for a
+// compile command.
+// The AST files are sharded across subdirectories by the leading digits of
+// a hash of the compile command, in order to avoid huge directories.
+std::string getShardedAstPath(const ct::CompileCommand& command) {
+	std::string key = cal::Hasher()
+	  .add(command.Directory)
+	  .add(command.Filename)
+	  .add(command.CommandLine)
+	  .finalize();
+	llvm::SmallString<256> path(key.substr(0, 2));
+	llvm::sys::path::append(path, key + ".ast");
+	return std::string(path);
+}
+
+UnitResult saveCommand(const ct::CompileCommand& command,
+  const std::vector<std::string>& args,
+  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fileSys,
+  cal::MemoryBudget::Ticket& ticket, bool measureMemory) {
+	llvm::TimeTraceScope traceScope("TranslationUnit", command.Filename);
+	auto startTime = std::chrono::steady_clock::now();
+	UnitResult result{getShardedAstPath(command), 0, std::nullopt, 0, false,
+	  false};
+	llvm::SmallString<256> astPath(outPath.getValue());
+	llvm::sys::path::append(astPath, result.astPath);
+	llvm::sys::fs::create_directories(llvm::sys::path::parent_path(astPath));
+
+	// NOTE: Relative paths in the compile command are relative to the
+	// directory of the command.  Since the file system is private to this
+	// worker, changing its working directory does not affect other workers.
+	fileSys->setCurrentWorkingDirectory(command.Directory);
+	SingleCommandDatabase compDatabase(command);
+	ct::ClangTool tool(compDatabase, {command.Filename},
+	  std::make_shared<clang::PCHContainerOperations>(), fileSys);
+	tool.setRestoreWorkingDir(false);
+	tool.appendArgumentsAdjuster(cal::traceArgumentsAdjuster(
+	  ct::getInsertArgumentAdjuster(args, ct::ArgumentInsertPosition::END)));
+	clang::IgnoringDiagConsumer diagConsumer;
+	// NOTE: In verbose mode, the diagnostics are written to the output of
+	// the translation unit (so that they are not interleaved with those of
+	// other translation units).
+#if LLVM_MAJOR_VERSION >= 21
+	clang::DiagnosticOptions diagOpts;
+	clang::TextDiagnosticPrinter diagPrinter(cal::errs(), diagOpts);
+#else
+	llvm::IntrusiveRefCntPtr<clang::DiagnosticOptions> diagOpts(
+	  new clang::DiagnosticOptions());
+	clang::TextDiagnosticPrinter diagPrinter(cal::errs(), &*diagOpts);
+#endif
+	tool.setDiagnosticConsumer(verbose ?
+	  static_cast<clang::DiagnosticConsumer*>(&diagPrinter) : &diagConsumer);
+	std::vector<std::unique_ptr<clang::ASTUnit>> astUnits;
+	std::uint64_t startMemory = measureMemory ?
+	  cal::getResidentSetSize() : 0;
+	{
+		llvm::TimeTraceScope buildScope("BuildAST");
+		tool.buildASTs(astUnits);
+	}
+	// NOTE: The memory is measured while the AST is still alive.
+	if (measureMemory) {
+		std::uint64_t endMemory = cal::getResidentSetSize();
+		result.memory = endMemory > startMemory ? endMemory - startMemory : 0;
+	}
+	// The memory of the AST is now part of the resident set size (which
+	// the budget accounts for directly).
+	ticket.settle();
+	if (astUnits.size() == 1 && astUnits.front()) {
+		clang::ASTUnit& astUnit = *astUnits.front();
+		result.errors = astUnit.getDiagnostics().hasErrorOccurred();
+		llvm::TimeTraceScope saveScope("SaveAST");
+		result.saved = !astUnit.Save(astPath);
+		if (result.saved) {
+			llvm::sys::fs::file_size(astPath, result.size);
+		}
+	}
+	// Release the AST as soon as it has been saved (so that its memory can
+	// be used by the next translation unit).
+	astUnits.clear();
+
+	result.time = std::chrono::duration<double, std::milli>(
+	  std::chrono::steady_clock::now() - startTime).count();
+	return result;
+}
+
+bool writeManifest(llvm::StringRef path,
+  const std::vector<ct::CompileCommand>& commands,
+  const std::vector<UnitResult>& results, double totalTime) {
+	json::Array units;
+	for (std::size_t i = 0; i < commands.size(); ++i) {
+		const ct::CompileCommand& command = commands[i];
+		const UnitResult& result = results[i];
+		units.push_back(json::Object{
+			{"file", command.Filename},
+			{"directory", command.Directory},
+			{"ast", result.saved ? json::Value(result.astPath) : nullptr},
+			{"time_ms", result.time},
+			{"memory", result.memory ?
+			  json::Value(static_cast<std::int64_t>(*result.memory)) :
+			  nullptr},
+			{"size", static_cast<std::int64_t>(result.size)},
+			{"errors", result.errors},
+		});
+	}
+	json::Value manifest(json::Object{
+		{"version", 1},
+		{"time_ms", totalTime},
+		{"units", std::move(units)},
+	});
+	std::error_code ec;
+	llvm::raw_fd_ostream out(path, ec);
+	if (ec) {
+		return false;
+	}
+	out << llvm::formatv("{0:2}", manifest) << '\n';
+	out.close();
+	return !out.has_error();
+}
+
+int saveCompilationDatabase(const std::vector<std::string>& args) {
+	std::string errorMessage;
+	std::unique_ptr<ct::CompilationDatabase> compDatabase =
+	  ct::CompilationDatabase::autoDetectFromDirectory(buildPath,
+	  errorMessage);
+	if (!compDatabase) {
+		llvm::errs() << std::format("cannot load compilation database: {}\n",
+		  errorMessage);
+		return 1;
+	}
+
+	// Select the commands to process (i.e., all commands or only those for
+	// the specified source files).
+	std::vector<ct::CompileCommand> commands;
+	if (sourcePaths.empty()) {
+		commands = compDatabase->getAllCompileCommands();
+	} else {
+		for (const auto& sourcePath : sourcePaths) {
+			std::vector<ct::CompileCommand> fileCommands =
+			  compDatabase->getCompileCommands(sourcePath);
+			commands.insert(commands.end(), fileCommands.begin(),
+			  fileCommands.end());
+		}
+	}
+
+	if (llvm::sys::fs::create_directories(outPath.getValue())) {
+		llvm::errs() << std::format("cannot make directory {}\n",
+		  outPath.getValue());
+		return 1;
+	}
+
+	// NOTE: The real file system shares the working directory of the
+	// process, so each worker gets its own physical file system.
+	unsigned numWorkers = numThreads ? numThreads.getValue() :
+	  cal::getDefaultConcurrency();
+	std::vector<llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem>> fileSyss;
+	for (unsigned i = 0; i < numWorkers; ++i) {
+		fileSyss.push_back(llvm::vfs::createPhysicalFileSystem());
+	}
+
+	std::optional<std::uint64_t> memoryLimitValue = 0;
+	if (!memoryLimit.empty()) {
+		memoryLimitValue = cal::parseMemorySize(memoryLimit);
+		if (!memoryLimitValue) {
+			llvm::errs() << std::format("invalid memory limit {}\n",
+			  memoryLimit.getValue());
+			return 1;
+		}
+	}
+
+	// Estimate the cost of each command from the previous runs (if any) or
+	// from its source file, so that the costliest commands can be started
+	// first (and admitted only while their memory fits in the budget).
+	cal::CostHistory history;
+	if (!scheduleStatePath.empty()) {
+		// NOTE: A state file that cannot be loaded leaves the history empty.
+		if (llvm::Error error = history.load(scheduleStatePath)) {
+			llvm::errs() << std::format(
+			  "warning: ignoring schedule state: {}\n",
+			  llvm::toString(std::move(error)));
+		}
+	}
+	std::vector<std::string> unitKeys;
+	std::vector<cal::SourceFeatures> unitFeatures;
+	std::vector<double> costs;
+	std::vector<std::uint64_t> memories;
+	for (const ct::CompileCommand& command : commands) {
+		unitKeys.push_back(cal::getNormalizedPath(command.Filename,
+		  command.Directory));
+		unitFeatures.push_back(cal::getSourceFeatures(unitKeys.back()));
+		costs.push_back(history.estimateTime(unitKeys.back(),
+		  unitFeatures.back()));
+		memories.push_back(history.estimateMemory(unitKeys.back(),
+		  unitFeatures.back()));
+	}
+	cal::MemoryBudget memoryBudget(*memoryLimitValue);
+	// NOTE: The growth in the resident set size only measures the memory of
+	// a translation unit if no others are processed concurrently, so the
+	// memory is only measured (and recorded) with a single worker.
+	bool measureMemory = numWorkers == 1;
+
+	auto startTime = std::chrono::steady_clock::now();
+	std::vector<UnitResult> results(commands.size());
+	// NOTE: The output for each command is buffered and written in the
+	// order of the commands (as soon as the preceding commands are done).
+	cal::OrderedOutput output(commands.size());
+	cal::parallelForByCost(costs, numWorkers,
+	  [&](std::size_t index, unsigned worker) {
+		cal::OutputScope outputScope(output, index);
+		cal::MemoryBudget::Ticket ticket = memoryBudget.admit(
+		  memories[index]);
+		results[index] = saveCommand(commands[index], args, fileSyss[worker],
+		  ticket, measureMemory);
+		const UnitResult& result = results[index];
+		if (!result.saved) {
+			cal::log("cannot save AST for {}\n", commands[index].Filename);
+		} else if (verbose) {
+			cal::print("{} -> {} ({} bytes, {:.1f} ms)\n",
+			  commands[index].Filename, result.astPath, result.size,
+			  result.time);
+		}
+	});
+	output.finish();
+	double totalTime = std::chrono::duration<double, std::milli>(
+	  std::chrono::steady_clock::now() - startTime).count();
+
+	if (!scheduleStatePath.empty()) {
+		for (std::size_t i = 0; i < commands.size(); ++i) {
+			history.record(unitKeys[i], {results[i].time, results[i].memory},
+			  unitFeatures[i]);
+		}
+		if (llvm::Error error = history.save(scheduleStatePath)) {
+			llvm::errs() << std::format("warning: {}\n",
+			  llvm::toString(std::move(error)));
+		}
+	}
+
+	llvm::SmallString<256> manifestPath(outPath.getValue());
+	llvm::sys::path::append(manifestPath, "manifest.json");
+	llvm::TimeTraceScope outputScope("WriteOutput");
+	if (!writeManifest(manifestPath, commands, results, totalTime)) {
+		llvm::errs() << std::format("cannot write manifest {}\n",
+		  std::string(manifestPath));
+		return 1;
+	}
+
+	int status = 0;
+	std::uint64_t totalSize = 0;
+	for (const UnitResult& result : results) {
+		totalSize += result.size;
+		if (!result.saved) {
+			status = 1;
+		}
+	}
+	if (verbose) {
+		llvm::outs() << std::format(
+		  "saved {} ASTs ({} bytes) in {:.1f} ms using {} threads\n",
+		  commands.size(), totalSize, totalTime, numWorkers);
+		if (memoryBudget.getLimit()) {
+			llvm::outs() << std::format(
+			  "memory budget: {} MiB limit, {} MiB peak RSS, {} waits\n",
+			  memoryBudget.getLimit() >> 20,
+			  cal::getPeakResidentSetSize() >> 20,
+			  memoryBudget.getNumWaits());
+		}
+	}
+	return status;
+}
+
+int main(int argc, const char** argv) {
+	clangIncDir = cal::getClangIncludeDirPath();
+	lc::ParseCommandLineOptions(argc, argv, "AST serializer\n");
+	std::vector<std::string> args = getCompilerArgs(clangIncDir,
+	  {extraArgs.begin(), extraArgs.end()});
+	if (!buildPath.empty()) {
+		if (outPath.empty()) {
+			llvm::errs() << "no output directory specified\n";
+			return 1;
+		}
+		if (!cacheDir.empty()) {
+			llvm::errs() << "-cache-dir cannot be used with -p\n";
+			return 1;
+		}
+		if (!timeTracePath.empty()) {
+			cal::startTimeTrace("save_ast", timeTraceGranularity);
+		}
+		int status = saveCompilationDatabase(args);
+		if (!timeTracePath.empty()) {
+			if (llvm::Error error = cal::finishTimeTrace(timeTracePath)) {
+				llvm::errs() << llvm::toString(std::move(error)) << '\n';
+				return 1;
+			}
+		}
+		return status;
+	}
+	if (sourcePaths.size() != 1) {
+		llvm::errs() << "exactly one source file must be specified\n";
+		return 1;
+	}
+	if (outPath.empty() && cacheDir.empty()) {
+		llvm::errs() << "no output AST file or cache directory specified\n";
+		return 1;
+	}
+	return cacheDir.empty() ? saveWithoutCache(sourcePaths.front(), args) :
+	  saveWithCache(sourcePaths.front(), args);
+}
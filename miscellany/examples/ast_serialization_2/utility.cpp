@@ -0,0 +1,64 @@
+#include <format>
+#include <memory>
+#include <string>
+#include <vector>
+#include <clang/Basic/Diagnostic.h>
+#include <clang/Basic/DiagnosticOptions.h>
+#include <clang/Basic/FileSystemOptions.h>
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Frontend/TextDiagnosticPrinter.h>
+#include <clang/Lex/HeaderSearchOptions.h>
+#include <clang/Serialization/PCHContainerOperations.h>
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "utility.hpp"
+
+std::unique_ptr<clang::ASTUnit> loadAstUnitFromFile(const std::string& astFile,
+  clang::ASTUnit::WhatToLoad whatToLoad) {
+#if LLVM_MAJOR_VERSION >= 21
+	auto diagOpts = std::make_shared<clang::DiagnosticOptions>();
+	llvm::IntrusiveRefCntPtr<clang::DiagnosticIDs> diagIDs(
+	  new clang::DiagnosticIDs());
+	llvm::IntrusiveRefCntPtr<clang::DiagnosticsEngine> diagEngine(
+	  new clang::DiagnosticsEngine(diagIDs, *diagOpts,
+	  new clang::TextDiagnosticPrinter(llvm::errs(), *diagOpts), true));
+#else
+	llvm::IntrusiveRefCntPtr<clang::DiagnosticOptions> diagOpts(
+	  new clang::DiagnosticOptions());
+	llvm::IntrusiveRefCntPtr<clang::DiagnosticIDs> diagIDs(
+	  new clang::DiagnosticIDs());
+	llvm::IntrusiveRefCntPtr<clang::DiagnosticsEngine> diagEngine(
+	  new clang::DiagnosticsEngine(diagIDs, diagOpts,
+	  new clang::TextDiagnosticPrinter(llvm::errs(), &*diagOpts), true));
+#endif
+	clang::PCHContainerOperations pchContainerOps;
+	clang::FileSystemOptions fileSysOpts;
+#if LLVM_MAJOR_VERSION >= 22
+	clang::HeaderSearchOptions headerSearchOpts;
+	return clang::ASTUnit::LoadFromASTFile(astFile,
+	  pchContainerOps.getRawReader(), whatToLoad,
+	  llvm::vfs::getRealFileSystem(), diagOpts, diagEngine, fileSysOpts,
+	  headerSearchOpts, nullptr);
+#elif LLVM_MAJOR_VERSION >= 21
+	clang::HeaderSearchOptions headerSearchOpts;
+	return clang::ASTUnit::LoadFromASTFile(astFile,
+	  pchContainerOps.getRawReader(), whatToLoad, diagOpts, diagEngine,
+	  fileSysOpts, headerSearchOpts, nullptr);
+#else
+	return clang::ASTUnit::LoadFromASTFile(astFile,
+	  pchContainerOps.getRawReader(), whatToLoad, diagEngine, fileSysOpts,
+	  nullptr);
+#endif
+}
+
+std::vector<std::string> getCompilerArgs(const std::string& clangIncDir,
+  const std::vector<std::string>& extraArgs) {
+	std::vector<std::string> args;
+	if (!clangIncDir.empty()) {
+		args.push_back(std::format("-I{}", clangIncDir));
+	}
+	args.insert(args.end(), extraArgs.begin(), extraArgs.end());
+	return args;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <clang/Frontend/ASTUnit.h>
+
+// Load an AST unit from an AST file.
+std::unique_ptr<clang::ASTUnit> loadAstUnitFromFile(const std::string& astFile,
+  clang::ASTUnit::WhatToLoad whatToLoad = clang::ASTUnit::LoadEverything);
+
+// Get the compiler arguments used to build an AST.
+std::vector<std::string> getCompilerArgs(const std::string& clangIncDir,
+  const std::vector<std::string>& extraArgs);
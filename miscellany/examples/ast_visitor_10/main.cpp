@@ -1,4 +1,6 @@
 #include <format>
+#include <memory>
+#include <string>
 #include <clang/AST/ASTConsumer.h>
 #include <clang/AST/Decl.h>
 #include <clang/AST/RecursiveASTVisitor.h>
@@ -8,6 +10,9 @@
 #include <clang/Tooling/Tooling.h>
 #include <llvm/Config/llvm-config.h>
 #include <llvm/Support/CommandLine.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <cal/main.hpp>
 #include "utilities.hpp"
 
 namespace ct = clang::tooling;
@@ -20,6 +25,17 @@ static lc::opt<bool> clVisitVarDecl("varDecl", lc::cat(toolOptions),
   lc::init(false));
 static lc::opt<bool> clVisitFunctionDecl("functionDecl", lc::cat(toolOptions),
   lc::init(false));
+static lc::opt<bool> clCacheFileSystem("cache-fs",
+  lc::desc("Cache file status and contents across TUs"),
+  lc::cat(toolOptions), lc::init(false));
+static lc::opt<bool> clPrintStats("stats",
+  lc::desc("Print statistics"), lc::cat(toolOptions), lc::init(false));
+static lc::opt<std::string> clTimeTrace("time-trace",
+  lc::desc("Write a Chrome trace of the tool phases to the specified file"),
+  lc::value_desc("path"), lc::cat(toolOptions));
+static lc::opt<unsigned> clTimeTraceGranularity("time-trace-granularity",
+  lc::desc("Minimum duration of a traced span (in microseconds)"),
+  lc::cat(toolOptions), lc::init(500));
 
 void printVarDecl(clang::ASTContext* astContext, clang::VarDecl* varDecl) {
 	auto& sourceManager = astContext->getSourceManager();
@@ -86,14 +102,9 @@ void printFunctionDecl(clang::ASTContext* astContext,
 	if (returnTypeSourceRange.isValid()) {
 		llvm::outs() << std::format(
 		  "getReturnTypeSourceRange() [return type]: {}\n{}",
-		  rangeToString(sourceManager, funcDecl->getReturnTypeSourceRange(),
-		  false),
-		  addLineNumbers(getSourceText(sourceManager,
-		  funcDecl->getReturnTypeSourceRange()),
-		  sourceManager.getSpellingLineNumber(
-		  funcDecl->getReturnTypeSourceRange().getBegin()),
-		  sourceManager.getSpellingColumnNumber(
-		  funcDecl->getReturnTypeSourceRange().getBegin())));
+		  rangeToString(sourceManager, returnTypeSourceRange, false),
+		  getSourceTextWithLineNumbers(sourceManager,
+		  returnTypeSourceRange));
 	} else {
 		llvm::outs() << "no return type\n";
 	}
@@ -193,6 +204,7 @@ public:
 		auto& sourceManager = astContext_->getSourceManager();
 		const auto& fileId = sourceManager.getFileID(varDecl->getLocation());
 		if (clProcessHeaders || fileId == sourceManager.getMainFileID()) {
+			llvm::TimeTraceScope traceScope("PrintVarDecl");
 			printVarDecl(astContext_, varDecl);
 		}
 		return true;
@@ -204,6 +216,7 @@ public:
 		auto& sourceManager = astContext_->getSourceManager();
 		const auto& fileId = sourceManager.getFileID(funcDecl->getLocation());
 		if (clProcessHeaders || fileId == sourceManager.getMainFileID()) {
+			llvm::TimeTraceScope traceScope("PrintFunctionDecl");
 			printFunctionDecl(astContext_, funcDecl);
 		}
 		return true;
@@ -242,10 +255,32 @@ int main(int argc, char** argv) {
 		return 1;
 	}
 	ct::CommonOptionsParser& optionsParser = *expectedOptionsParser;
+	if (!clTimeTrace.empty()) {
+		cal::startTimeTrace("ast_visitor_10", clTimeTraceGranularity);
+	}
+	std::shared_ptr<cal::FileSystemCache> fileSysCache;
+	llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fileSys =
+	  llvm::vfs::getRealFileSystem();
+	if (clCacheFileSystem) {
+		fileSysCache = std::make_shared<cal::FileSystemCache>();
+		fileSys = cal::createCachingFileSystem(fileSysCache, fileSys);
+	}
 	ct::ClangTool tool(optionsParser.getCompilations(),
-	  optionsParser.getSourcePathList());
-	int status = tool.run(
-	  ct::newFrontendActionFactory<MyFrontendAction>().get());
+	  optionsParser.getSourcePathList(),
+	  std::make_shared<clang::PCHContainerOperations>(), fileSys);
+	std::unique_ptr<ct::FrontendActionFactory> actionFactory =
+	  ct::newFrontendActionFactory<MyFrontendAction>();
+	cal::TimeTracingActionFactory tracingActionFactory(*actionFactory);
+	int status = tool.run(&tracingActionFactory);
 	if (status) {llvm::errs() << "error detected\n";}
+	if (fileSysCache && clPrintStats) {
+		fileSysCache->printStats(llvm::errs());
+	}
+	if (!clTimeTrace.empty()) {
+		if (llvm::Error error = cal::finishTimeTrace(clTimeTrace)) {
+			llvm::errs() << llvm::toString(std::move(error)) << '\n';
+			return 1;
+		}
+	}
 	return !status ? 0 : 1;
 }
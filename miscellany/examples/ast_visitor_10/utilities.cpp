@@ -3,7 +3,8 @@
 
 #include <clang/Basic/SourceManager.h>
 #include <clang/Basic/SourceLocation.h>
-#include <clang/Lex/Lexer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cal/main.hpp>
 
 #include "utilities.hpp"
 
@@ -40,67 +41,39 @@ std::string rangeToString(const clang::SourceManager& sourceManager,
 	return result;
 }
 
-std::string getSourceTextRaw(const clang::SourceManager& sourceManager,
+llvm::StringRef getSourceTextRaw(const clang::SourceManager& sourceManager,
   clang::SourceRange sourceRange) {
 	assert(sourceRange.isValid());
-	return std::string(clang::Lexer::getSourceText(
-	  clang::CharSourceRange::getCharRange(sourceRange), sourceManager,
-	  clang::LangOptions()));
+	return cal::getSourceText(sourceManager,
+	  clang::CharSourceRange::getCharRange(sourceRange), nullptr,
+	  cal::MacroRangePolicy::expansion).text;
 }
 
-std::string getSourceText(const clang::SourceManager& sourceManager,
+llvm::StringRef getSourceText(const clang::SourceManager& sourceManager,
   clang::SourceRange sourceRange) {
 	assert(sourceRange.isValid());
-	clang::LangOptions lo;
-	auto startLoc = sourceManager.getSpellingLoc(sourceRange.getBegin());
-	auto lastTokenLoc = sourceManager.getSpellingLoc(sourceRange.getEnd());
-	auto endLoc = clang::Lexer::getLocForEndOfToken(lastTokenLoc, 0,
-	  sourceManager, lo);
-	auto printableRange = clang::SourceRange{startLoc, endLoc};
-	return getSourceTextRaw(sourceManager, printableRange);
-}
-
-std::string addLineNumbers(const std::string& source, unsigned int startLine,
-  unsigned int startCol, bool includeHeader) {
-	std::string result;
-	bool needPrefix = true;
-	for (auto c : source) {
-		if (needPrefix) {
-			if (includeHeader) {
-				result += "      ";
-				result += "0000000001111111111222222222233333333334444444444";
-				result += "555555555566666666667";
-				result += "\n";
-				result += "      ";
-				result += "12345678901234567890123456789012345678901234567890";
-				result += "12345678901234567890";
-				result += "\n";
-				includeHeader = false;
-			}
-			result += std::format("{:4d}: {}", startLine, std::string(
-			  startCol - 1, ' '));
-			needPrefix = false;
-		}
-		result += c;
-		++startCol;
-		if (c == '\n') {
-			++startLine;
-			startCol = 1;
-			needPrefix = true;
-		}
-	}
-	if (startCol > 1) {result += '\n';}
-	return result;
+	return cal::getSourceText(sourceManager, sourceRange, nullptr,
+	  cal::MacroRangePolicy::spelling).text;
 }
 
 std::string getSourceTextWithLineNumbers(clang::SourceManager& sourceManager,
   clang::SourceRange sourceRange, bool includeHeader) {
-	assert(sourceRange.isValid());
-	std::string s = getSourceText(sourceManager, sourceRange);
-	return addLineNumbers(s,
-	  sourceManager.getSpellingLineNumber(sourceRange.getBegin()),
-	  sourceManager.getSpellingColumnNumber(sourceRange.getBegin()),
-	  includeHeader);
+	// NOTE: The snippet is rendered directly from the source buffer (rather
+	// than from a copy of the text).
+	cal::SourceText sourceText = cal::getSourceText(sourceManager, sourceRange,
+	  nullptr, cal::MacroRangePolicy::spelling);
+	if (!sourceText) {
+		return std::string(cal::getSourceTextPlaceholder(sourceText.status)) +
+		  '\n';
+	}
+	auto [fileId, offset] = sourceManager.getDecomposedLoc(
+	  sourceManager.getSpellingLoc(sourceRange.getBegin()));
+	cal::SnippetOptions options;
+	options.startLine = sourceManager.getLineNumber(fileId, offset);
+	options.startColumn = sourceManager.getColumnNumber(fileId, offset);
+	options.lineNumberWidth = 4;
+	options.columnHeader = includeHeader;
+	return cal::renderSnippet(sourceText.text, options);
 }
 
 std::string functionDeclTemplatedKindToString(
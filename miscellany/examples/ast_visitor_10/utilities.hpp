@@ -2,6 +2,7 @@
 #include <clang/AST/Decl.h>
 #include <clang/Basic/SourceManager.h>
 #include <clang/Basic/SourceLocation.h>
+#include <llvm/ADT/StringRef.h>
 
 std::string locationToString(const clang::SourceManager& sourceManager,
   clang::SourceLocation sourceLoc, bool includeFileName = true);
@@ -9,15 +10,14 @@ std::string locationToString(const clang::SourceManager& sourceManager,
 std::string rangeToString(const clang::SourceManager& sourceManager,
   clang::SourceRange sourceRange, bool includeFileName = true);
 
-std::string getSourceTextRaw(const clang::SourceManager& sm,
+// NOTE: The text returned refers to the buffer of the source manager (i.e.,
+// it is not copied).
+llvm::StringRef getSourceTextRaw(const clang::SourceManager& sm,
   clang::SourceRange range);
 
-std::string getSourceText(const clang::SourceManager& sm,
+llvm::StringRef getSourceText(const clang::SourceManager& sm,
   clang::SourceRange range);
 
-std::string addLineNumbers(const std::string& source, unsigned int startLine,
-  unsigned int startCol = 1, bool includeHeader = true);
-
 std::string getSourceTextWithLineNumbers(clang::SourceManager& sourceManager,
   clang::SourceRange sourceRange, bool includeHeader = true);
 
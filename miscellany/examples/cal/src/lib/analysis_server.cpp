@@ -0,0 +1,397 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <utility>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "cal/analysis_server.hpp"
+
+namespace json = llvm::json;
+
+namespace cal {
+
+/****************************************************************************\
+Helper Functions
+\****************************************************************************/
+
+// The protocol is as follows.
+// The client sends a request (i.e., a JSON object) and then shuts down the
+// sending side of its connection.
+// The server replies with a sequence of frames, each of which consists of
+// a header line of the form "<type> <size>" followed by a payload of the
+// specified size.  The frame types are:
+//   - 'o', whose payload is output from the handler;
+//   - 's', whose payload is the exit status of the handler (in decimal),
+//     which ends the reply; and
+//   - 'e', whose payload is an error message, which ends the reply.
+// Since the output is framed (rather than being encoded as JSON), it can
+// contain arbitrary bytes (e.g., text that is not valid UTF-8).
+
+namespace {
+
+// The maximum size of a request.
+constexpr std::size_t maxRequestSize = 1024 * 1024;
+
+std::error_code getErrnoCode()
+{
+	return std::error_code(errno, std::generic_category());
+}
+
+bool makeAddress(llvm::StringRef path, sockaddr_un& addr)
+{
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path)) {
+		return false;
+	}
+	std::memcpy(addr.sun_path, path.data(), path.size());
+	return true;
+}
+
+bool writeAll(int fd, llvm::StringRef data)
+{
+	while (!data.empty()) {
+		// NOTE: MSG_NOSIGNAL prevents a SIGPIPE if the peer has gone away.
+		ssize_t count = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		data = data.drop_front(count);
+	}
+	return true;
+}
+
+bool writeFrame(int fd, char type, llvm::StringRef payload)
+{
+	return writeAll(fd, std::format("{} {}\n", type, payload.size())) &&
+	  writeAll(fd, payload);
+}
+
+// A stream that sends its output to a client as a sequence of frames.
+class ResponseStream : public llvm::raw_ostream {
+public:
+	explicit ResponseStream(int fd) : fd_(fd), pos_(0), failed_(false)
+	  {SetBufferSize(64 * 1024);}
+	~ResponseStream() override {flush();}
+	// Indicates if the client could not be written (e.g., because it has
+	// disconnected).
+	bool hasFailed() const {return failed_;}
+private:
+	void write_impl(const char* ptr, size_t size) override
+	{
+		pos_ += size;
+		if (!failed_ && !writeFrame(fd_, 'o', llvm::StringRef(ptr, size))) {
+			failed_ = true;
+		}
+	}
+	std::uint64_t current_pos() const override {return pos_;}
+	int fd_;
+	std::uint64_t pos_;
+	bool failed_;
+};
+
+// A reader that buffers the data received from a socket.
+class SocketReader {
+public:
+	explicit SocketReader(int fd) : fd_(fd) {}
+	// Read a line (excluding the newline).
+	bool readLine(std::string& line)
+	{
+		for (;;) {
+			auto i = buffer_.find('\n');
+			if (i != std::string::npos) {
+				line = buffer_.substr(0, i);
+				buffer_.erase(0, i + 1);
+				return true;
+			}
+			if (!fill()) {
+				return false;
+			}
+		}
+	}
+	// Read the specified number of bytes.
+	bool read(std::size_t size, std::string& data)
+	{
+		while (buffer_.size() < size) {
+			if (!fill()) {
+				return false;
+			}
+		}
+		data = buffer_.substr(0, size);
+		buffer_.erase(0, size);
+		return true;
+	}
+private:
+	bool fill()
+	{
+		char chunk[64 * 1024];
+		for (;;) {
+			ssize_t count = ::read(fd_, chunk, sizeof(chunk));
+			if (count < 0 && errno == EINTR) {
+				continue;
+			}
+			if (count <= 0) {
+				return false;
+			}
+			buffer_.append(chunk, count);
+			return true;
+		}
+	}
+	int fd_;
+	std::string buffer_;
+};
+
+// Read everything until the peer shuts down its sending side.
+bool readToEnd(int fd, std::string& data, std::size_t maxSize)
+{
+	char chunk[4096];
+	for (;;) {
+		ssize_t count = ::read(fd, chunk, sizeof(chunk));
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		if (!count) {
+			return true;
+		}
+		if (data.size() + count > maxSize) {
+			return false;
+		}
+		data.append(chunk, count);
+	}
+}
+
+int connectToSocket(llvm::StringRef socketPath)
+{
+	sockaddr_un addr;
+	if (!makeAddress(socketPath, addr)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) {
+		int savedErrno = errno;
+		::close(fd);
+		errno = savedErrno;
+		return -1;
+	}
+	return fd;
+}
+
+} // namespace
+
+/****************************************************************************\
+Analysis Server
+\****************************************************************************/
+
+AnalysisServer::AnalysisServer(std::string socketPath) :
+  socketPath_(std::move(socketPath)), listenFd_(-1), stopping_(false),
+  numRequests_(0) {}
+
+AnalysisServer::~AnalysisServer()
+{
+	if (listenFd_ >= 0) {
+		::close(listenFd_);
+		::unlink(socketPath_.c_str());
+	}
+}
+
+void AnalysisServer::addHandler(std::string command, Handler handler)
+{
+	handlers_[command] = std::move(handler);
+}
+
+llvm::Error AnalysisServer::run()
+{
+	sockaddr_un addr;
+	if (!makeAddress(socketPath_, addr)) {
+		return llvm::createStringError(
+		  std::make_error_code(std::errc::filename_too_long),
+		  "socket path too long: %s", socketPath_.c_str());
+	}
+
+	// Replace a stale socket (but not a live one or a non-socket).
+	struct stat status;
+	if (!::lstat(socketPath_.c_str(), &status)) {
+		if (!S_ISSOCK(status.st_mode)) {
+			return llvm::createStringError(
+			  std::make_error_code(std::errc::file_exists),
+			  "%s exists and is not a socket", socketPath_.c_str());
+		}
+		if (int fd = connectToSocket(socketPath_); fd >= 0) {
+			::close(fd);
+			return llvm::createStringError(
+			  std::make_error_code(std::errc::address_in_use),
+			  "server already running on %s", socketPath_.c_str());
+		}
+		::unlink(socketPath_.c_str());
+	}
+
+	listenFd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenFd_ < 0) {
+		return llvm::createStringError(getErrnoCode(),
+		  "cannot create socket");
+	}
+	if (::bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) ||
+	  ::listen(listenFd_, 16)) {
+		std::error_code ec = getErrnoCode();
+		::close(listenFd_);
+		listenFd_ = -1;
+		return llvm::createStringError(ec, "cannot listen on %s",
+		  socketPath_.c_str());
+	}
+
+	stopping_ = false;
+	while (!stopping_) {
+		int fd = ::accept(listenFd_, nullptr, nullptr);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			return llvm::createStringError(getErrnoCode(),
+			  "cannot accept connection");
+		}
+		serve(fd);
+		::close(fd);
+	}
+
+	::close(listenFd_);
+	listenFd_ = -1;
+	::unlink(socketPath_.c_str());
+	return llvm::Error::success();
+}
+
+void AnalysisServer::serve(int fd)
+{
+	++numRequests_;
+	std::string data;
+	if (!readToEnd(fd, data, maxRequestSize)) {
+		writeFrame(fd, 'e', "cannot read request");
+		return;
+	}
+	llvm::Expected<json::Value> value = json::parse(data);
+	if (!value) {
+		writeFrame(fd, 'e', std::format("invalid request: {}",
+		  llvm::toString(value.takeError())));
+		return;
+	}
+	const json::Object* request = value->getAsObject();
+	std::optional<llvm::StringRef> command = request ?
+	  request->getString("command") : std::nullopt;
+	if (!command) {
+		writeFrame(fd, 'e', "request has no command");
+		return;
+	}
+
+	int status;
+	if (*command == "ping") {
+		status = 0;
+	} else if (*command == "shutdown") {
+		stopping_ = true;
+		status = 0;
+	} else {
+		auto i = handlers_.find(*command);
+		if (i == handlers_.end()) {
+			writeFrame(fd, 'e', std::format("unknown command {}",
+			  std::string(*command)));
+			return;
+		}
+		ResponseStream out(fd);
+		status = i->second(*request, out);
+		out.flush();
+		if (out.hasFailed()) {
+			// The client has gone away, so there is no one to tell.
+			return;
+		}
+	}
+	writeFrame(fd, 's', std::to_string(status));
+}
+
+/****************************************************************************\
+Client
+\****************************************************************************/
+
+llvm::Expected<int> sendServerRequest(llvm::StringRef socketPath,
+  const json::Value& request, llvm::raw_ostream& out)
+{
+	int fd = connectToSocket(socketPath);
+	if (fd < 0) {
+		return llvm::createStringError(getErrnoCode(),
+		  "cannot connect to %s", socketPath.str().c_str());
+	}
+	std::string data;
+	llvm::raw_string_ostream(data) << request;
+	if (!writeAll(fd, data) || ::shutdown(fd, SHUT_WR)) {
+		std::error_code ec = getErrnoCode();
+		::close(fd);
+		return llvm::createStringError(ec, "cannot send request");
+	}
+
+	SocketReader reader(fd);
+	std::string header;
+	std::string payload;
+	for (;;) {
+		llvm::StringRef type;
+		llvm::StringRef sizeString;
+		std::size_t size;
+		if (!reader.readLine(header)) {
+			break;
+		}
+		std::tie(type, sizeString) = llvm::StringRef(header).split(' ');
+		if (type.size() != 1 || !llvm::to_integer(sizeString, size, 10) ||
+		  !reader.read(size, payload)) {
+			break;
+		}
+		switch (type[0]) {
+		case 'o':
+			out << payload;
+			break;
+		case 's':
+			{
+				int status;
+				::close(fd);
+				if (!llvm::to_integer(payload, status, 10)) {
+					return llvm::createStringError(
+					  std::make_error_code(std::errc::protocol_error),
+					  "invalid status from server");
+				}
+				return status;
+			}
+		case 'e':
+			::close(fd);
+			return llvm::createStringError(
+			  std::make_error_code(std::errc::protocol_error),
+			  "server error: %s", payload.c_str());
+		default:
+			break;
+		}
+	}
+	::close(fd);
+	return llvm::createStringError(
+	  std::make_error_code(std::errc::protocol_error),
+	  "connection to server lost");
+}
+
+} // namespace cal
@@ -0,0 +1,382 @@
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <clang/Basic/SourceManager.h>
+#include <clang/Basic/Version.h>
+#include <clang/Tooling/Tooling.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "cal/ast_cache.hpp"
+#include "cal/hash.hpp"
+
+namespace bf = boost::filesystem;
+namespace ct = clang::tooling;
+namespace json = llvm::json;
+
+namespace cal {
+
+/****************************************************************************\
+Helper Functions
+\****************************************************************************/
+
+namespace {
+
+// The maximum number of entries kept in a manifest.
+constexpr std::size_t maxManifestEntries = 8;
+
+// A file that was read in order to build an AST.
+struct Dependency {
+	std::string path;
+	std::string hash;
+};
+
+std::string makeAbsolutePath(llvm::StringRef path)
+{
+	llvm::SmallString<256> buffer(path);
+	llvm::sys::fs::make_absolute(buffer);
+	llvm::sys::path::remove_dots(buffer, true);
+	return std::string(buffer);
+}
+
+// Write a file atomically (by writing a temporary file and renaming it).
+template <class Writer>
+llvm::Error writeFileAtomically(const std::string& path, Writer writer)
+{
+	llvm::SmallString<256> tempPath;
+	llvm::sys::fs::createUniquePath(path + ".tmp-%%%%%%%%", tempPath, false);
+	if (!writer(std::string(tempPath))) {
+		llvm::sys::fs::remove(tempPath);
+		return llvm::createStringError(std::errc::io_error,
+		  "cannot write %s", path.c_str());
+	}
+	if (std::error_code ec = llvm::sys::fs::rename(tempPath, path)) {
+		llvm::sys::fs::remove(tempPath);
+		return llvm::createStringError(ec, "cannot rename %s to %s",
+		  tempPath.c_str(), path.c_str());
+	}
+	return llvm::Error::success();
+}
+
+std::optional<json::Value> readJsonFile(const std::string& path)
+{
+	auto buffer = llvm::MemoryBuffer::getFile(path);
+	if (!buffer) {
+		return std::nullopt;
+	}
+	llvm::Expected<json::Value> value = json::parse((*buffer)->getBuffer());
+	if (!value) {
+		llvm::consumeError(value.takeError());
+		return std::nullopt;
+	}
+	return std::move(*value);
+}
+
+// Get the files that were read in order to build an AST.
+std::vector<Dependency> getDependencies(clang::ASTUnit& astUnit)
+{
+	const clang::SourceManager& sourceManager = astUnit.getSourceManager();
+	std::vector<Dependency> deps;
+	for (auto i = sourceManager.fileinfo_begin();
+	  i != sourceManager.fileinfo_end(); ++i) {
+		const clang::FileEntryRef& fileEntry = i->first;
+		const clang::SrcMgr::ContentCache* contentCache = i->second;
+		std::string path = makeAbsolutePath(fileEntry.getName());
+		// NOTE: Prefer the contents that were actually used to build the
+		// AST to the current contents of the file.
+		std::optional<llvm::StringRef> data =
+		  contentCache->getBufferDataIfLoaded();
+		std::string hash = data ? hashString(*data) : hashFile(path);
+		if (hash.empty()) {
+			continue;
+		}
+		deps.push_back({std::move(path), std::move(hash)});
+	}
+	std::sort(deps.begin(), deps.end(), [](const auto& a, const auto& b)
+	  {return a.path < b.path;});
+	deps.erase(std::unique(deps.begin(), deps.end(),
+	  [](const auto& a, const auto& b) {return a.path == b.path;}),
+	  deps.end());
+	return deps;
+}
+
+} // namespace
+
+/****************************************************************************\
+AST Cache
+\****************************************************************************/
+
+AstCache::AstCache(const std::string& directory, std::uint64_t maxSize) :
+  directory_(makeAbsolutePath(directory)), maxSize_(maxSize), hits_(0),
+  misses_(0), evictions_(0) {}
+
+AstCache::Stats AstCache::getStats() const
+{
+	return {
+		.hits = hits_.load(),
+		.misses = misses_.load(),
+		.evictions = evictions_.load(),
+	};
+}
+
+std::string AstCache::getManifestKey(const std::string& sourcePath,
+  const std::vector<std::string>& args) const
+{
+	auto buffer = llvm::MemoryBuffer::getFile(sourcePath, false, false);
+	if (!buffer) {
+		return "";
+	}
+	return Hasher()
+	  .add("ast-cache-v1")
+	  .add(clang::getClangFullVersion())
+	  .add(makeAbsolutePath(sourcePath))
+	  .add((*buffer)->getBuffer())
+	  .add(args)
+	  .finalize();
+}
+
+std::string AstCache::getManifestPath(const std::string& manifestKey) const
+{
+	return (bf::path(directory_) / "manifests" / manifestKey.substr(0, 2) /
+	  (manifestKey + ".json")).string();
+}
+
+std::string AstCache::getAstPath(const std::string& astKey) const
+{
+	return (bf::path(directory_) / "asts" / astKey.substr(0, 2) /
+	  (astKey + ".ast")).string();
+}
+
+std::string AstCache::lookup(const std::string& sourcePath,
+  const std::vector<std::string>& args)
+{
+	std::string manifestKey = getManifestKey(sourcePath, args);
+	std::optional<json::Value> manifest;
+	if (!manifestKey.empty()) {
+		manifest = readJsonFile(getManifestPath(manifestKey));
+	}
+	const json::Array* entries = nullptr;
+	if (manifest && manifest->getAsObject()) {
+		entries = manifest->getAsObject()->getArray("entries");
+	}
+	if (!entries) {
+		++misses_;
+		return "";
+	}
+
+	// Memoize the file hashes, since many entries typically share most of
+	// their dependencies.
+	llvm::StringMap<std::string> fileHashes;
+	for (const json::Value& entryValue : *entries) {
+		const json::Object* entry = entryValue.getAsObject();
+		if (!entry) {
+			continue;
+		}
+		std::optional<llvm::StringRef> astKey = entry->getString("ast");
+		const json::Array* deps = entry->getArray("dependencies");
+		if (!astKey || !deps) {
+			continue;
+		}
+		bool valid = true;
+		for (const json::Value& depValue : *deps) {
+			const json::Object* dep = depValue.getAsObject();
+			std::optional<llvm::StringRef> path = dep ?
+			  dep->getString("path") : std::nullopt;
+			std::optional<llvm::StringRef> hash = dep ?
+			  dep->getString("hash") : std::nullopt;
+			if (!path || !hash) {
+				valid = false;
+				break;
+			}
+			auto [i, inserted] = fileHashes.try_emplace(*path);
+			if (inserted) {
+				i->second = hashFile(std::string(*path));
+			}
+			if (i->second != *hash) {
+				valid = false;
+				break;
+			}
+		}
+		if (!valid) {
+			continue;
+		}
+		std::string astPath = getAstPath(std::string(*astKey));
+		boost::system::error_code ec;
+		if (!bf::exists(astPath, ec)) {
+			continue;
+		}
+		// Record the use of the AST file for the purposes of LRU eviction.
+		bf::last_write_time(astPath, std::time(nullptr), ec);
+		++hits_;
+		return astPath;
+	}
+	++misses_;
+	return "";
+}
+
+llvm::Expected<std::string> AstCache::store(clang::ASTUnit& astUnit,
+  const std::string& sourcePath, const std::vector<std::string>& args)
+{
+	std::string manifestKey = getManifestKey(sourcePath, args);
+	if (manifestKey.empty()) {
+		return llvm::createStringError(std::errc::no_such_file_or_directory,
+		  "cannot read %s", sourcePath.c_str());
+	}
+	std::vector<Dependency> deps = getDependencies(astUnit);
+	Hasher astHasher;
+	astHasher.add(manifestKey);
+	for (const auto& dep : deps) {
+		astHasher.add(dep.path).add(dep.hash);
+	}
+	std::string astKey = astHasher.finalize();
+
+	std::string manifestPath = getManifestPath(manifestKey);
+	std::string astPath = getAstPath(astKey);
+	boost::system::error_code ec;
+	bf::create_directories(bf::path(manifestPath).parent_path(), ec);
+	bf::create_directories(bf::path(astPath).parent_path(), ec);
+
+	if (!bf::exists(astPath, ec)) {
+		if (llvm::Error error = writeFileAtomically(astPath,
+		  [&astUnit](const std::string& path) {
+			return !astUnit.Save(path);
+		})) {
+			return std::move(error);
+		}
+	}
+
+	json::Array depsArray;
+	for (const auto& dep : deps) {
+		depsArray.push_back(json::Object{{"path", dep.path},
+		  {"hash", dep.hash}});
+	}
+	json::Array entries;
+	entries.push_back(json::Object{{"ast", astKey},
+	  {"dependencies", std::move(depsArray)}});
+	// Keep the most recent entries from the existing manifest (if any).
+	if (std::optional<json::Value> manifest = readJsonFile(manifestPath)) {
+		const json::Object* object = manifest->getAsObject();
+		const json::Array* oldEntries = object ?
+		  object->getArray("entries") : nullptr;
+		if (oldEntries) {
+			for (const json::Value& entryValue : *oldEntries) {
+				if (entries.size() >= maxManifestEntries) {
+					break;
+				}
+				const json::Object* entry = entryValue.getAsObject();
+				if (!entry || entry->getString("ast") == astKey) {
+					continue;
+				}
+				entries.push_back(entryValue);
+			}
+		}
+	}
+	json::Value newManifest(json::Object{{"entries", std::move(entries)}});
+	if (llvm::Error error = writeFileAtomically(manifestPath,
+	  [&newManifest](const std::string& path) {
+		std::error_code ec;
+		llvm::raw_fd_ostream out(path, ec);
+		if (ec) {
+			return false;
+		}
+		out << newManifest;
+		out.close();
+		return !out.has_error();
+	})) {
+		return std::move(error);
+	}
+
+	evict();
+	return astPath;
+}
+
+llvm::Expected<std::string> AstCache::getOrBuild(const std::string& sourcePath,
+  const std::vector<std::string>& args, bool* hit)
+{
+	std::string astPath = lookup(sourcePath, args);
+	if (hit) {
+		*hit = !astPath.empty();
+	}
+	if (!astPath.empty()) {
+		return astPath;
+	}
+	auto buffer = llvm::MemoryBuffer::getFile(sourcePath);
+	if (!buffer) {
+		return llvm::createStringError(buffer.getError(), "cannot read %s",
+		  sourcePath.c_str());
+	}
+	std::unique_ptr<clang::ASTUnit> astUnit = ct::buildASTFromCodeWithArgs(
+	  (*buffer)->getBuffer(), args, sourcePath, "ast_cache");
+	if (!astUnit) {
+		return llvm::createStringError(std::errc::invalid_argument,
+		  "cannot build AST for %s", sourcePath.c_str());
+	}
+	// NOTE: An AST that was built with errors is not cached.
+	if (astUnit->getDiagnostics().hasErrorOccurred()) {
+		return llvm::createStringError(std::errc::invalid_argument,
+		  "errors occurred building AST for %s", sourcePath.c_str());
+	}
+	return store(*astUnit, sourcePath, args);
+}
+
+void AstCache::evict()
+{
+	if (!maxSize_) {
+		return;
+	}
+	struct File {
+		bf::path path;
+		std::uintmax_t size;
+		std::time_t time;
+	};
+	std::vector<File> files;
+	std::uintmax_t totalSize = 0;
+	boost::system::error_code ec;
+	for (bf::recursive_directory_iterator i(bf::path(directory_) / "asts",
+	  ec), end; !ec && i != end; i.increment(ec)) {
+		if (!bf::is_regular_file(i->path(), ec) ||
+		  i->path().extension() != ".ast") {
+			continue;
+		}
+		File file{i->path(), bf::file_size(i->path(), ec),
+		  bf::last_write_time(i->path(), ec)};
+		if (ec) {
+			ec.clear();
+			continue;
+		}
+		totalSize += file.size;
+		files.push_back(std::move(file));
+	}
+	if (totalSize <= maxSize_) {
+		return;
+	}
+	std::sort(files.begin(), files.end(), [](const auto& a, const auto& b)
+	  {return a.time < b.time;});
+	for (const auto& file : files) {
+		if (totalSize <= maxSize_) {
+			break;
+		}
+		// NOTE: The manifest entries that refer to an evicted AST file are
+		// left in place.  They are ignored by lookups.
+		if (bf::remove(file.path, ec)) {
+			totalSize -= file.size;
+			++evictions_;
+		}
+	}
+}
+
+} // namespace cal
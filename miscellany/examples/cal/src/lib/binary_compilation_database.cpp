@@ -0,0 +1,536 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <map>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <clang/Tooling/CompilationDatabase.h>
+#include <clang/Tooling/CompilationDatabasePluginRegistry.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Endian.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "cal/binary_compilation_database.hpp"
+#include "cal/hash.hpp"
+#include "cal/utility.hpp"
+
+namespace ct = clang::tooling;
+namespace ls = llvm::support;
+
+namespace cal {
+
+/****************************************************************************\
+File Format
+\****************************************************************************/
+
+namespace {
+
+constexpr char magic[8] = {'C', 'A', 'L', 'B', 'C', 'D', 'B', '\0'};
+constexpr std::uint32_t formatVersion = 1;
+
+// The string index used to indicate the absence of a string.
+constexpr std::uint32_t noString = 0xffffffffU;
+// The placeholders for the file name and output in an argument vector.
+constexpr std::uint32_t filePlaceholder = 0xfffffffeU;
+constexpr std::uint32_t outputPlaceholder = 0xfffffffdU;
+
+struct Header {
+	char magic[8];
+	ls::ulittle32_t version;
+	ls::ulittle32_t numStrings;
+	ls::ulittle32_t numArgVectors;
+	ls::ulittle32_t numArgs;
+	ls::ulittle32_t numCommands;
+	ls::ulittle32_t numBuckets;
+	ls::ulittle64_t stringsOffset;
+	ls::ulittle64_t stringDataOffset;
+	ls::ulittle64_t stringDataSize;
+	ls::ulittle64_t argVectorsOffset;
+	ls::ulittle64_t argsOffset;
+	ls::ulittle64_t commandsOffset;
+	ls::ulittle64_t bucketsOffset;
+	ls::ulittle64_t commandIndicesOffset;
+};
+
+struct StringRecord {
+	ls::ulittle64_t offset;
+	ls::ulittle32_t size;
+	ls::ulittle32_t reserved;
+};
+
+struct ArgVectorRecord {
+	ls::ulittle32_t first;
+	ls::ulittle32_t count;
+};
+
+struct CommandRecord {
+	ls::ulittle32_t directory;
+	ls::ulittle32_t file;
+	ls::ulittle32_t output;
+	ls::ulittle32_t argVector;
+};
+
+// An entry in the hash table that maps a source file to its commands.
+// The commands for the file are given by a range of the command-index
+// array.  An empty bucket has a path of noString.
+// NOTE: The hash is stored in the file, so it must be stable across
+// processes and platforms (hence FNV-1a on the normalized path).
+struct BucketRecord {
+	ls::ulittle64_t hash;
+	ls::ulittle32_t path;
+	ls::ulittle32_t first;
+	ls::ulittle32_t count;
+	ls::ulittle32_t reserved;
+};
+
+template <class T>
+const T* getRecords(const llvm::MemoryBuffer& buffer, std::uint64_t offset)
+{
+	return reinterpret_cast<const T*>(buffer.getBufferStart() + offset);
+}
+
+const Header& getHeader(const llvm::MemoryBuffer& buffer)
+{
+	return *getRecords<Header>(buffer, 0);
+}
+
+} // namespace
+
+/****************************************************************************\
+Binary Compilation Database
+\****************************************************************************/
+
+BinaryCompilationDatabase::BinaryCompilationDatabase(
+  std::unique_ptr<llvm::MemoryBuffer> buffer) : buffer_(std::move(buffer)) {}
+
+std::unique_ptr<BinaryCompilationDatabase>
+  BinaryCompilationDatabase::loadFromFile(llvm::StringRef path,
+  std::string& errorMessage)
+{
+	// NOTE: The file is not required to be null terminated, which allows
+	// large files to be memory mapped.
+	auto buffer = llvm::MemoryBuffer::getFile(path, false, false);
+	if (!buffer) {
+		errorMessage = std::format("cannot read {}: {}", std::string(path),
+		  buffer.getError().message());
+		return nullptr;
+	}
+	return loadFromBuffer(std::move(*buffer), errorMessage);
+}
+
+std::unique_ptr<BinaryCompilationDatabase>
+  BinaryCompilationDatabase::loadFromBuffer(
+  std::unique_ptr<llvm::MemoryBuffer> buffer, std::string& errorMessage)
+{
+	std::unique_ptr<BinaryCompilationDatabase> database(
+	  new BinaryCompilationDatabase(std::move(buffer)));
+	if (!database->validate(errorMessage)) {
+		return nullptr;
+	}
+	return database;
+}
+
+bool BinaryCompilationDatabase::validate(std::string& errorMessage) const
+{
+	std::uint64_t size = buffer_->getBufferSize();
+	if (size < sizeof(Header) ||
+	  std::memcmp(getHeader(*buffer_).magic, magic, sizeof(magic))) {
+		errorMessage = "not a binary compilation database";
+		return false;
+	}
+	const Header& header = getHeader(*buffer_);
+	if (header.version != formatVersion) {
+		errorMessage = std::format(
+		  "unsupported binary compilation database version {}",
+		  static_cast<std::uint32_t>(header.version));
+		return false;
+	}
+	// Check that each section lies within the file.
+	// Only the bounds of the sections are checked here (so that loading
+	// takes constant time).  The individual records are checked as they
+	// are used.
+	auto inBounds = [size](std::uint64_t offset, std::uint64_t count,
+	  std::uint64_t recordSize) {
+		return offset <= size && count <= (size - offset) / recordSize;
+	};
+	if (!inBounds(header.stringsOffset, header.numStrings,
+	  sizeof(StringRecord)) ||
+	  !inBounds(header.stringDataOffset, header.stringDataSize, 1) ||
+	  !inBounds(header.argVectorsOffset, header.numArgVectors,
+	  sizeof(ArgVectorRecord)) ||
+	  !inBounds(header.argsOffset, header.numArgs, sizeof(ls::ulittle32_t)) ||
+	  !inBounds(header.commandsOffset, header.numCommands,
+	  sizeof(CommandRecord)) ||
+	  !inBounds(header.bucketsOffset, header.numBuckets,
+	  sizeof(BucketRecord)) ||
+	  !inBounds(header.commandIndicesOffset, header.numCommands,
+	  sizeof(ls::ulittle32_t))) {
+		errorMessage = "truncated or corrupt binary compilation database";
+		return false;
+	}
+	// The number of buckets must be a power of two.
+	if (!header.numBuckets || (header.numBuckets & (header.numBuckets - 1))) {
+		errorMessage = "corrupt binary compilation database index";
+		return false;
+	}
+	return true;
+}
+
+unsigned BinaryCompilationDatabase::getNumCommands() const
+{
+	return getHeader(*buffer_).numCommands;
+}
+
+unsigned BinaryCompilationDatabase::getNumStrings() const
+{
+	return getHeader(*buffer_).numStrings;
+}
+
+unsigned BinaryCompilationDatabase::getNumArgVectors() const
+{
+	return getHeader(*buffer_).numArgVectors;
+}
+
+llvm::StringRef BinaryCompilationDatabase::getString(unsigned index) const
+{
+	const Header& header = getHeader(*buffer_);
+	if (index >= header.numStrings) {
+		return {};
+	}
+	const StringRecord& record = getRecords<StringRecord>(*buffer_,
+	  header.stringsOffset)[index];
+	if (record.offset > header.stringDataSize ||
+	  record.size > header.stringDataSize - record.offset) {
+		return {};
+	}
+	return llvm::StringRef(buffer_->getBufferStart() +
+	  header.stringDataOffset + record.offset, record.size);
+}
+
+ct::CompileCommand BinaryCompilationDatabase::getCommand(unsigned index) const
+{
+	const Header& header = getHeader(*buffer_);
+	const CommandRecord& record = getRecords<CommandRecord>(*buffer_,
+	  header.commandsOffset)[index];
+	llvm::StringRef file = getString(record.file);
+	llvm::StringRef output = getString(record.output);
+	std::vector<std::string> commandLine;
+	if (record.argVector < header.numArgVectors) {
+		const ArgVectorRecord& argVector = getRecords<ArgVectorRecord>(
+		  *buffer_, header.argVectorsOffset)[record.argVector];
+		if (argVector.first <= header.numArgs &&
+		  argVector.count <= header.numArgs - argVector.first) {
+			const ls::ulittle32_t* args = getRecords<ls::ulittle32_t>(
+			  *buffer_, header.argsOffset) + argVector.first;
+			commandLine.reserve(argVector.count);
+			for (unsigned i = 0; i < argVector.count; ++i) {
+				std::uint32_t arg = args[i];
+				commandLine.emplace_back(arg == filePlaceholder ? file :
+				  arg == outputPlaceholder ? output : getString(arg));
+			}
+		}
+	}
+	return ct::CompileCommand(getString(record.directory), file,
+	  std::move(commandLine), output);
+}
+
+std::vector<ct::CompileCommand> BinaryCompilationDatabase::getCompileCommands(
+  llvm::StringRef filePath) const
+{
+	const Header& header = getHeader(*buffer_);
+	std::string key = getNormalizedPath(filePath);
+	std::uint64_t hash = fnv1aHash(key);
+	const BucketRecord* buckets = getRecords<BucketRecord>(*buffer_,
+	  header.bucketsOffset);
+	const ls::ulittle32_t* commandIndices = getRecords<ls::ulittle32_t>(
+	  *buffer_, header.commandIndicesOffset);
+	std::uint32_t mask = header.numBuckets - 1;
+	// Probe linearly from the home bucket until the key or an empty bucket
+	// is found.
+	for (std::uint32_t i = hash & mask, n = 0; n < header.numBuckets;
+	  i = (i + 1) & mask, ++n) {
+		const BucketRecord& bucket = buckets[i];
+		if (bucket.path == noString) {
+			break;
+		}
+		if (bucket.hash != hash || getString(bucket.path) != key) {
+			continue;
+		}
+		std::vector<ct::CompileCommand> commands;
+		if (bucket.first > header.numCommands ||
+		  bucket.count > header.numCommands - bucket.first) {
+			break;
+		}
+		commands.reserve(bucket.count);
+		for (std::uint32_t j = 0; j < bucket.count; ++j) {
+			std::uint32_t commandIndex = commandIndices[bucket.first + j];
+			if (commandIndex < header.numCommands) {
+				commands.push_back(getCommand(commandIndex));
+			}
+		}
+		return commands;
+	}
+	return {};
+}
+
+std::vector<std::string> BinaryCompilationDatabase::getAllFiles() const
+{
+	const Header& header = getHeader(*buffer_);
+	const BucketRecord* buckets = getRecords<BucketRecord>(*buffer_,
+	  header.bucketsOffset);
+	std::vector<std::string> files;
+	for (std::uint32_t i = 0; i < header.numBuckets; ++i) {
+		if (buckets[i].path != noString) {
+			files.emplace_back(getString(buckets[i].path));
+		}
+	}
+	// NOTE: The order of the buckets is an artifact of hashing, so sort
+	// the files (as the JSON compilation database does).
+	std::sort(files.begin(), files.end());
+	return files;
+}
+
+std::vector<ct::CompileCommand>
+  BinaryCompilationDatabase::getAllCompileCommands() const
+{
+	std::vector<ct::CompileCommand> commands;
+	unsigned numCommands = getNumCommands();
+	commands.reserve(numCommands);
+	for (unsigned i = 0; i < numCommands; ++i) {
+		commands.push_back(getCommand(i));
+	}
+	return commands;
+}
+
+/****************************************************************************\
+Writer
+\****************************************************************************/
+
+namespace {
+
+// A builder for the tables of a binary compilation database.
+class Builder {
+public:
+	void addCommand(const ct::CompileCommand& command);
+	llvm::Error write(llvm::StringRef path);
+private:
+	std::uint32_t internString(llvm::StringRef s);
+	std::uint32_t internArgVector(const std::vector<std::uint32_t>& args);
+
+	llvm::StringMap<std::uint32_t> stringIndices_;
+	std::vector<StringRecord> strings_;
+	std::string stringData_;
+	std::map<std::vector<std::uint32_t>, std::uint32_t> argVectorIndices_;
+	std::vector<ArgVectorRecord> argVectors_;
+	std::vector<ls::ulittle32_t> args_;
+	std::vector<CommandRecord> commands_;
+	// The commands for each file (in order of first appearance).
+	llvm::StringMap<std::uint32_t> fileIndices_;
+	std::vector<std::pair<std::string, std::vector<std::uint32_t>>> files_;
+};
+
+std::uint32_t Builder::internString(llvm::StringRef s)
+{
+	auto [i, inserted] = stringIndices_.try_emplace(s, strings_.size());
+	if (inserted) {
+		StringRecord record;
+		record.offset = stringData_.size();
+		record.size = s.size();
+		record.reserved = 0;
+		strings_.push_back(record);
+		stringData_.append(s.data(), s.size());
+	}
+	return i->second;
+}
+
+std::uint32_t Builder::internArgVector(const std::vector<std::uint32_t>& args)
+{
+	auto [i, inserted] = argVectorIndices_.try_emplace(args,
+	  argVectors_.size());
+	if (inserted) {
+		ArgVectorRecord record;
+		record.first = args_.size();
+		record.count = args.size();
+		argVectors_.push_back(record);
+		args_.insert(args_.end(), args.begin(), args.end());
+	}
+	return i->second;
+}
+
+void Builder::addCommand(const ct::CompileCommand& command)
+{
+	std::vector<std::uint32_t> args;
+	args.reserve(command.CommandLine.size());
+	for (const auto& arg : command.CommandLine) {
+		if (arg == command.Filename) {
+			args.push_back(filePlaceholder);
+		} else if (!command.Output.empty() && arg == command.Output) {
+			args.push_back(outputPlaceholder);
+		} else {
+			args.push_back(internString(arg));
+		}
+	}
+	CommandRecord record;
+	record.directory = internString(command.Directory);
+	record.file = internString(command.Filename);
+	record.output = command.Output.empty() ? noString :
+	  internString(command.Output);
+	record.argVector = internArgVector(args);
+	std::uint32_t commandIndex = commands_.size();
+	commands_.push_back(record);
+
+	std::string key = getNormalizedPath(command.Filename, command.Directory);
+	auto [i, inserted] = fileIndices_.try_emplace(key, files_.size());
+	if (inserted) {
+		files_.emplace_back(key, std::vector<std::uint32_t>());
+	}
+	files_[i->second].second.push_back(commandIndex);
+}
+
+llvm::Error Builder::write(llvm::StringRef path)
+{
+	// Build the hash table, with a load factor of at most one half.
+	std::uint32_t numBuckets = 1;
+	while (numBuckets < 2 * files_.size()) {
+		numBuckets *= 2;
+	}
+	std::vector<BucketRecord> buckets(numBuckets);
+	for (auto& bucket : buckets) {
+		bucket.hash = 0;
+		bucket.path = noString;
+		bucket.first = 0;
+		bucket.count = 0;
+		bucket.reserved = 0;
+	}
+	std::vector<ls::ulittle32_t> commandIndices;
+	commandIndices.reserve(commands_.size());
+	for (const auto& [key, fileCommands] : files_) {
+		std::uint64_t hash = fnv1aHash(key);
+		std::uint32_t i = hash & (numBuckets - 1);
+		while (buckets[i].path != noString) {
+			i = (i + 1) & (numBuckets - 1);
+		}
+		buckets[i].hash = hash;
+		buckets[i].path = internString(key);
+		buckets[i].first = commandIndices.size();
+		buckets[i].count = fileCommands.size();
+		commandIndices.insert(commandIndices.end(), fileCommands.begin(),
+		  fileCommands.end());
+	}
+
+	// Lay out the sections, each aligned on an 8-byte boundary.
+	std::uint64_t offset = 0;
+	auto allocate = [&offset](std::uint64_t size) {
+		std::uint64_t result = (offset + 7) & ~std::uint64_t(7);
+		offset = result + size;
+		return result;
+	};
+	Header header;
+	std::memcpy(header.magic, magic, sizeof(magic));
+	header.version = formatVersion;
+	header.numStrings = strings_.size();
+	header.numArgVectors = argVectors_.size();
+	header.numArgs = args_.size();
+	header.numCommands = commands_.size();
+	header.numBuckets = numBuckets;
+	allocate(sizeof(Header));
+	header.stringsOffset = allocate(strings_.size() * sizeof(StringRecord));
+	header.stringDataOffset = allocate(stringData_.size());
+	header.stringDataSize = stringData_.size();
+	header.argVectorsOffset = allocate(argVectors_.size() *
+	  sizeof(ArgVectorRecord));
+	header.argsOffset = allocate(args_.size() * sizeof(ls::ulittle32_t));
+	header.commandsOffset = allocate(commands_.size() * sizeof(CommandRecord));
+	header.bucketsOffset = allocate(buckets.size() * sizeof(BucketRecord));
+	header.commandIndicesOffset = allocate(commandIndices.size() *
+	  sizeof(ls::ulittle32_t));
+
+	std::error_code ec;
+	llvm::raw_fd_ostream out(path, ec);
+	if (ec) {
+		return llvm::createStringError(ec, "cannot open %s",
+		  path.str().c_str());
+	}
+	auto writeSection = [&out](std::uint64_t offset, const void* data,
+	  std::uint64_t size) {
+		out.write_zeros(offset - out.tell());
+		out.write(static_cast<const char*>(data), size);
+	};
+	writeSection(0, &header, sizeof(header));
+	writeSection(header.stringsOffset, strings_.data(),
+	  strings_.size() * sizeof(StringRecord));
+	writeSection(header.stringDataOffset, stringData_.data(),
+	  stringData_.size());
+	writeSection(header.argVectorsOffset, argVectors_.data(),
+	  argVectors_.size() * sizeof(ArgVectorRecord));
+	writeSection(header.argsOffset, args_.data(),
+	  args_.size() * sizeof(ls::ulittle32_t));
+	writeSection(header.commandsOffset, commands_.data(),
+	  commands_.size() * sizeof(CommandRecord));
+	writeSection(header.bucketsOffset, buckets.data(),
+	  buckets.size() * sizeof(BucketRecord));
+	writeSection(header.commandIndicesOffset, commandIndices.data(),
+	  commandIndices.size() * sizeof(ls::ulittle32_t));
+	out.close();
+	if (out.has_error()) {
+		out.clear_error();
+		return llvm::createStringError(std::errc::io_error,
+		  "cannot write %s", path.str().c_str());
+	}
+	return llvm::Error::success();
+}
+
+} // namespace
+
+llvm::Error writeBinaryCompilationDatabase(llvm::StringRef path,
+  const std::vector<ct::CompileCommand>& commands)
+{
+	Builder builder;
+	for (const auto& command : commands) {
+		builder.addCommand(command);
+	}
+	return builder.write(path);
+}
+
+/****************************************************************************\
+Plugin
+\****************************************************************************/
+
+namespace {
+
+class BinaryCompilationDatabasePlugin : public ct::CompilationDatabasePlugin {
+	std::unique_ptr<ct::CompilationDatabase> loadFromDirectory(
+	  llvm::StringRef directory, std::string& errorMessage) override
+	{
+		llvm::SmallString<256> path(directory);
+		llvm::sys::path::append(path,
+		  BinaryCompilationDatabase::defaultFileName);
+		std::unique_ptr<ct::CompilationDatabase> database =
+		  BinaryCompilationDatabase::loadFromFile(path, errorMessage);
+		if (!database) {
+			return nullptr;
+		}
+		// NOTE: As for the JSON compilation database plugin, infer the
+		// target and driver mode from the compiler name.
+		return ct::inferTargetAndDriverMode(std::move(database));
+	}
+};
+
+} // namespace
+
+static ct::CompilationDatabasePluginRegistry::Add<
+  BinaryCompilationDatabasePlugin> binaryCompilationDatabasePlugin(
+  "binary-compilation-database",
+  "Reads binary compilation databases (compile_commands.bcdb)");
+
+volatile int binaryCompilationDatabaseAnchorSource = 0;
+
+} // namespace cal
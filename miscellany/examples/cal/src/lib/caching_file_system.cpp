@@ -0,0 +1,243 @@
+#include <format>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/Path.h>
+
+#include "cal/caching_file_system.hpp"
+
+namespace vfs = llvm::vfs;
+
+namespace cal {
+
+/****************************************************************************\
+File-System Cache
+\****************************************************************************/
+
+const llvm::ErrorOr<vfs::Status>* FileSystemCache::findStatus(
+  llvm::StringRef path) const
+{
+	std::shared_lock lock(mutex_);
+	auto i = statuses_.find(path);
+	return i != statuses_.end() ? &i->second : nullptr;
+}
+
+const llvm::ErrorOr<vfs::Status>& FileSystemCache::insertStatus(
+  llvm::StringRef path, llvm::ErrorOr<vfs::Status> status)
+{
+	std::unique_lock lock(mutex_);
+	// Note: Entries in a StringMap are not moved by later insertions, so
+	// the returned reference remains valid.
+	return statuses_.try_emplace(path, std::move(status)).first->second;
+}
+
+const FileSystemCache::Contents* FileSystemCache::findContents(
+  llvm::StringRef path) const
+{
+	std::shared_lock lock(mutex_);
+	auto i = contents_.find(path);
+	return i != contents_.end() ? i->second.get() : nullptr;
+}
+
+const FileSystemCache::Contents& FileSystemCache::insertContents(
+  llvm::StringRef path, std::unique_ptr<Contents> contents)
+{
+	std::unique_lock lock(mutex_);
+	return *contents_.try_emplace(path, std::move(contents)).first->second;
+}
+
+FileSystemCache::Stats FileSystemCache::getStats() const
+{
+	return {
+		.statusHits = statusHits_.load(),
+		.statusMisses = statusMisses_.load(),
+		.negativeHits = negativeHits_.load(),
+		.openHits = openHits_.load(),
+		.openMisses = openMisses_.load(),
+		.bytesServed = bytesServed_.load(),
+		.bytesRead = bytesRead_.load(),
+	};
+}
+
+void FileSystemCache::printStats(llvm::raw_ostream& out) const
+{
+	Stats stats = getStats();
+	out << std::format("file system cache status hits: {}\n",
+	  stats.statusHits)
+	  << std::format("file system cache status misses: {}\n",
+	  stats.statusMisses)
+	  << std::format("file system cache negative hits: {}\n",
+	  stats.negativeHits)
+	  << std::format("file system cache open hits: {}\n", stats.openHits)
+	  << std::format("file system cache open misses: {}\n", stats.openMisses)
+	  << std::format("file system cache bytes served: {}\n",
+	  stats.bytesServed)
+	  << std::format("file system cache bytes read: {}\n", stats.bytesRead);
+}
+
+void FileSystemCache::clear()
+{
+	std::unique_lock lock(mutex_);
+	statuses_.clear();
+	contents_.clear();
+}
+
+/****************************************************************************\
+Caching File System
+\****************************************************************************/
+
+namespace {
+
+// A file whose contents are owned by a FileSystemCache.
+class CachedFile : public vfs::File {
+public:
+	CachedFile(const FileSystemCache::Contents& contents,
+	  const llvm::Twine& path, std::shared_ptr<FileSystemCache> cache) :
+	  contents_(&contents), cache_(std::move(cache)),
+	  status_(vfs::Status::copyWithNewName(contents.status, path)) {}
+	llvm::ErrorOr<vfs::Status> status() override {return status_;}
+	llvm::ErrorOr<std::string> getName() override
+	  {return std::string(status_.getName());}
+	llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> getBuffer(
+	  const llvm::Twine& name, int64_t, bool requiresNullTerminator, bool)
+	  override {
+		// NOTE: The buffer returned does not own its data.  The data is
+		// owned by the cache.
+		return llvm::MemoryBuffer::getMemBuffer(
+		  contents_->buffer->getBuffer(), name.str(), requiresNullTerminator);
+	}
+	std::error_code close() override {return {};}
+	void setPath(const llvm::Twine& path) override {
+		status_ = vfs::Status::copyWithNewName(status_, path);
+	}
+private:
+	const FileSystemCache::Contents* contents_;
+	std::shared_ptr<FileSystemCache> cache_;
+	vfs::Status status_;
+};
+
+} // namespace
+
+CachingFileSystem::CachingFileSystem(
+  llvm::IntrusiveRefCntPtr<vfs::FileSystem> fileSys,
+  std::shared_ptr<FileSystemCache> cache) :
+  ProxyFileSystem(std::move(fileSys)), cache_(std::move(cache))
+{
+	if (!cache_) {
+		cache_ = std::make_shared<FileSystemCache>();
+	}
+}
+
+bool CachingFileSystem::getCacheKey(const llvm::Twine& path,
+  llvm::SmallVectorImpl<char>& key) const
+{
+	path.toVector(key);
+	if (makeAbsolute(key)) {
+		return false;
+	}
+	// NOTE: Only "." components are removed, since removing ".." components
+	// lexically is wrong in the presence of symbolic links (e.g., if "link"
+	// is a symbolic link, "a/link/../b" need not be "a/b").
+	llvm::sys::path::remove_dots(key, false);
+	return true;
+}
+
+llvm::ErrorOr<vfs::Status> CachingFileSystem::status(const llvm::Twine& path)
+{
+	llvm::SmallString<256> key;
+	if (!getCacheKey(path, key)) {
+		return ProxyFileSystem::status(path);
+	}
+	const llvm::ErrorOr<vfs::Status>* status = cache_->findStatus(key);
+	if (status) {
+		++cache_->statusHits_;
+		if (!*status) {
+			++cache_->negativeHits_;
+		}
+	} else {
+		++cache_->statusMisses_;
+		status = &cache_->insertStatus(key, ProxyFileSystem::status(key));
+	}
+	if (!*status) {
+		return status->getError();
+	}
+	return vfs::Status::copyWithNewName(**status, path);
+}
+
+llvm::ErrorOr<std::unique_ptr<vfs::File>> CachingFileSystem::openFileForRead(
+  const llvm::Twine& path)
+{
+	llvm::SmallString<256> key;
+	if (!getCacheKey(path, key)) {
+		return ProxyFileSystem::openFileForRead(path);
+	}
+
+	// If the path is already known not to refer to a regular file, fail
+	// without consulting the underlying file system.
+	if (const auto* status = cache_->findStatus(key)) {
+		if (!*status) {
+			++cache_->statusHits_;
+			++cache_->negativeHits_;
+			return status->getError();
+		}
+		if ((*status)->isDirectory()) {
+			++cache_->statusHits_;
+			return std::make_error_code(std::errc::is_a_directory);
+		}
+	}
+
+	const FileSystemCache::Contents* contents = cache_->findContents(key);
+	if (contents) {
+		++cache_->openHits_;
+		cache_->bytesServed_ += contents->buffer->getBufferSize();
+	} else {
+		++cache_->openMisses_;
+		auto file = ProxyFileSystem::openFileForRead(key);
+		if (!file) {
+			cache_->insertStatus(key, file.getError());
+			return file.getError();
+		}
+		auto status = (*file)->status();
+		if (!status) {
+			return status.getError();
+		}
+		cache_->insertStatus(key, *status);
+		// NOTE: The file size is not passed to getBuffer, since the status
+		// may have been obtained before the file was (last) modified.
+		auto buffer = (*file)->getBuffer(key);
+		if (!buffer) {
+			return buffer.getError();
+		}
+		cache_->bytesRead_ += (*buffer)->getBufferSize();
+		contents = &cache_->insertContents(key,
+		  std::make_unique<FileSystemCache::Contents>(
+		  FileSystemCache::Contents{*status, std::move(*buffer)}));
+	}
+	return std::unique_ptr<vfs::File>(new CachedFile(*contents, path,
+	  cache_));
+}
+
+#if LLVM_VERSION_MAJOR >= 17
+bool CachingFileSystem::exists(const llvm::Twine& path)
+{
+	return static_cast<bool>(status(path));
+}
+#endif
+
+llvm::IntrusiveRefCntPtr<CachingFileSystem> createCachingFileSystem(
+  std::shared_ptr<FileSystemCache> cache,
+  llvm::IntrusiveRefCntPtr<vfs::FileSystem> fileSys)
+{
+	if (!fileSys) {
+		fileSys = vfs::createPhysicalFileSystem();
+	}
+	return llvm::makeIntrusiveRefCnt<CachingFileSystem>(std::move(fileSys),
+	  std::move(cache));
+}
+
+} // namespace cal
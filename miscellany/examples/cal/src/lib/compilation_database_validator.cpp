@@ -0,0 +1,753 @@
+#include <cstdint>
+#include <cstdio>
+#include <format>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+
+#include "cal/compilation_database_validator.hpp"
+
+namespace cal {
+
+/****************************************************************************\
+JSON Lexer
+\****************************************************************************/
+
+namespace {
+
+// The maximum number of bytes of a string value that are kept.
+// Longer strings are truncated (which bounds the memory used).
+constexpr std::size_t maxStringSize = 64 * 1024;
+
+// A lexer for JSON that reads its input incrementally.
+class JsonLexer {
+public:
+
+	enum class Kind {
+		beginObject, endObject, beginArray, endArray, colon, comma, string,
+		number, literal, end, error
+	};
+
+	struct Token {
+		Kind kind;
+		// The offset of the first byte of the token.
+		std::uint64_t offset;
+		// The (decoded) value of a string token (if kept).
+		std::string value;
+		// Indicates if the kept value was truncated.
+		bool truncated;
+	};
+
+	explicit JsonLexer(std::FILE* file) : file_(file), buffer_(64 * 1024),
+	  begin_(0), end_(0), offset_(0), errorOffset_(0) {}
+
+	// Get the next token.
+	// The value of a string token is kept only if requested.
+	void next(Token& token, bool keepString);
+
+	const std::string& getError() const {return error_;}
+	std::uint64_t getErrorOffset() const {return errorOffset_;}
+
+private:
+
+	int peek() {
+		if (begin_ == end_ && !fill()) {
+			return EOF;
+		}
+		return static_cast<unsigned char>(buffer_[begin_]);
+	}
+	int get() {
+		int c = peek();
+		if (c != EOF) {
+			++begin_;
+			++offset_;
+		}
+		return c;
+	}
+	bool fill() {
+		begin_ = 0;
+		end_ = std::fread(buffer_.data(), 1, buffer_.size(), file_);
+		return end_ != 0;
+	}
+	void setError(Token& token, std::uint64_t offset, std::string message) {
+		token.kind = Kind::error;
+		errorOffset_ = offset;
+		error_ = std::move(message);
+	}
+	void lexString(Token& token, bool keepString);
+	void lexNumber(Token& token);
+	void lexLiteral(Token& token);
+	bool readHexQuad(unsigned& value);
+	static void appendUtf8(std::string& s, unsigned codePoint);
+
+	std::FILE* file_;
+	std::vector<char> buffer_;
+	std::size_t begin_;
+	std::size_t end_;
+	std::uint64_t offset_;
+	std::string error_;
+	std::uint64_t errorOffset_;
+};
+
+void JsonLexer::next(Token& token, bool keepString)
+{
+	token.value.clear();
+	token.truncated = false;
+	int c;
+	while ((c = peek()) == ' ' || c == '\t' || c == '\n' || c == '\r') {
+		get();
+	}
+	token.offset = offset_;
+	switch (c) {
+	case EOF:
+		token.kind = Kind::end;
+		if (std::ferror(file_)) {
+			setError(token, offset_, "read error");
+		}
+		return;
+	case '{':
+		get();
+		token.kind = Kind::beginObject;
+		return;
+	case '}':
+		get();
+		token.kind = Kind::endObject;
+		return;
+	case '[':
+		get();
+		token.kind = Kind::beginArray;
+		return;
+	case ']':
+		get();
+		token.kind = Kind::endArray;
+		return;
+	case ':':
+		get();
+		token.kind = Kind::colon;
+		return;
+	case ',':
+		get();
+		token.kind = Kind::comma;
+		return;
+	case '"':
+		lexString(token, keepString);
+		return;
+	case 't':
+	case 'f':
+	case 'n':
+		lexLiteral(token);
+		return;
+	default:
+		if (c == '-' || (c >= '0' && c <= '9')) {
+			lexNumber(token);
+			return;
+		}
+		setError(token, offset_, std::format("unexpected character 0x{:02x}",
+		  c));
+		return;
+	}
+}
+
+bool JsonLexer::readHexQuad(unsigned& value)
+{
+	value = 0;
+	for (int i = 0; i < 4; ++i) {
+		int c = get();
+		unsigned digit;
+		if (c >= '0' && c <= '9') {
+			digit = c - '0';
+		} else if (c >= 'a' && c <= 'f') {
+			digit = c - 'a' + 10;
+		} else if (c >= 'A' && c <= 'F') {
+			digit = c - 'A' + 10;
+		} else {
+			return false;
+		}
+		value = 16 * value + digit;
+	}
+	return true;
+}
+
+void JsonLexer::appendUtf8(std::string& s, unsigned codePoint)
+{
+	if (codePoint < 0x80) {
+		s += static_cast<char>(codePoint);
+	} else if (codePoint < 0x800) {
+		s += static_cast<char>(0xc0 | (codePoint >> 6));
+		s += static_cast<char>(0x80 | (codePoint & 0x3f));
+	} else if (codePoint < 0x10000) {
+		s += static_cast<char>(0xe0 | (codePoint >> 12));
+		s += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+		s += static_cast<char>(0x80 | (codePoint & 0x3f));
+	} else {
+		s += static_cast<char>(0xf0 | (codePoint >> 18));
+		s += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+		s += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+		s += static_cast<char>(0x80 | (codePoint & 0x3f));
+	}
+}
+
+void JsonLexer::lexString(Token& token, bool keepString)
+{
+	token.kind = Kind::string;
+	get();
+	std::string& value = token.value;
+	auto append = [&](llvm::StringRef s) {
+		if (!keepString) {
+			return;
+		}
+		if (value.size() + s.size() > maxStringSize) {
+			token.truncated = true;
+			return;
+		}
+		value.append(s.data(), s.size());
+	};
+	for (;;) {
+		std::uint64_t charOffset = offset_;
+		int c = get();
+		if (c == EOF) {
+			setError(token, token.offset, "unterminated string");
+			return;
+		}
+		if (c == '"') {
+			return;
+		}
+		if (c < 0x20) {
+			setError(token, charOffset, "control character in string");
+			return;
+		}
+		if (c != '\\') {
+			char ch = static_cast<char>(c);
+			append(llvm::StringRef(&ch, 1));
+			continue;
+		}
+		c = get();
+		switch (c) {
+		case '"': append("\""); break;
+		case '\\': append("\\"); break;
+		case '/': append("/"); break;
+		case 'b': append("\b"); break;
+		case 'f': append("\f"); break;
+		case 'n': append("\n"); break;
+		case 'r': append("\r"); break;
+		case 't': append("\t"); break;
+		case 'u':
+			{
+				unsigned codePoint;
+				if (!readHexQuad(codePoint)) {
+					setError(token, charOffset, "invalid \\u escape");
+					return;
+				}
+				// Combine a surrogate pair.
+				if (codePoint >= 0xd800 && codePoint < 0xdc00) {
+					unsigned low;
+					if (get() != '\\' || get() != 'u' || !readHexQuad(low) ||
+					  low < 0xdc00 || low >= 0xe000) {
+						setError(token, charOffset, "invalid surrogate pair");
+						return;
+					}
+					codePoint = 0x10000 + ((codePoint - 0xd800) << 10) +
+					  (low - 0xdc00);
+				}
+				std::string encoded;
+				appendUtf8(encoded, codePoint);
+				append(encoded);
+			}
+			break;
+		default:
+			setError(token, charOffset, "invalid escape sequence");
+			return;
+		}
+	}
+}
+
+void JsonLexer::lexNumber(Token& token)
+{
+	token.kind = Kind::number;
+	auto isDigit = [](int c) {return c >= '0' && c <= '9';};
+	auto skipDigits = [&]() {
+		if (!isDigit(peek())) {
+			return false;
+		}
+		while (isDigit(peek())) {
+			get();
+		}
+		return true;
+	};
+	if (peek() == '-') {
+		get();
+	}
+	if (peek() == '0') {
+		get();
+	} else if (!skipDigits()) {
+		setError(token, token.offset, "invalid number");
+		return;
+	}
+	if (peek() == '.') {
+		get();
+		if (!skipDigits()) {
+			setError(token, token.offset, "invalid number");
+			return;
+		}
+	}
+	if (peek() == 'e' || peek() == 'E') {
+		get();
+		if (peek() == '+' || peek() == '-') {
+			get();
+		}
+		if (!skipDigits()) {
+			setError(token, token.offset, "invalid number");
+			return;
+		}
+	}
+}
+
+void JsonLexer::lexLiteral(Token& token)
+{
+	token.kind = Kind::literal;
+	llvm::StringRef expected = peek() == 't' ? "true" : peek() == 'f' ?
+	  "false" : "null";
+	for (char c : expected) {
+		if (get() != c) {
+			setError(token, token.offset, "invalid literal");
+			return;
+		}
+	}
+}
+
+/****************************************************************************\
+Validator
+\****************************************************************************/
+
+class Validator {
+public:
+	Validator(std::FILE* file, const CdbValidationOptions& options,
+	  const std::function<void(const CdbDiagnostic&)>& callback) :
+	  lexer_(file), options_(options), callback_(callback),
+	  result_{0, 0, false}, entry_(-1) {}
+	CdbValidationResult run();
+
+private:
+	// The state of the entry being validated.
+	struct Entry {
+		std::uint64_t offset;
+		bool hasDirectory;
+		bool hasFile;
+		bool hasArguments;
+		bool hasCommand;
+		std::string directory;
+		std::string file;
+		std::uint64_t fileOffset;
+		std::uint64_t directoryOffset;
+	};
+
+	// Get the next token (stopping on a syntax error).
+	bool next(bool keepString = false);
+	// Report a problem.  Returns false if validation should stop.
+	bool report(std::uint64_t offset, std::string message);
+	// Report a syntax error (which stops validation).  Returns false.
+	bool syntaxError(std::string message);
+	// Skip a member name and the following colon (in a skipped object).
+	bool skipKey();
+	// Skip (and check the syntax of) the value that starts with the current
+	// token.
+	bool skipValue();
+	// Report a value of the wrong type and skip it.
+	bool skipMismatchedValue(std::string message);
+	bool validateEntry();
+	bool validateMember(Entry& entry, const std::string& key,
+	  std::uint64_t keyOffset);
+	bool validateStringMember(const std::string& key, bool keep,
+	  std::string* value);
+	bool validateArguments();
+	bool checkEntry(const Entry& entry);
+
+	JsonLexer lexer_;
+	JsonLexer::Token token_;
+	const CdbValidationOptions& options_;
+	const std::function<void(const CdbDiagnostic&)>& callback_;
+	CdbValidationResult result_;
+	std::int64_t entry_;
+};
+
+bool Validator::next(bool keepString)
+{
+	lexer_.next(token_, keepString);
+	if (token_.kind == JsonLexer::Kind::error) {
+		report(lexer_.getErrorOffset(),
+		  std::format("syntax error: {}", lexer_.getError()));
+		result_.stopped = true;
+		return false;
+	}
+	return true;
+}
+
+bool Validator::report(std::uint64_t offset, std::string message)
+{
+	++result_.numProblems;
+	callback_({offset, entry_, std::move(message)});
+	if (options_.maxProblems && result_.numProblems >= options_.maxProblems) {
+		result_.stopped = true;
+		return false;
+	}
+	return true;
+}
+
+bool Validator::syntaxError(std::string message)
+{
+	report(token_.offset, std::format("syntax error: {}", message));
+	result_.stopped = true;
+	return false;
+}
+
+bool Validator::skipKey()
+{
+	if (token_.kind != JsonLexer::Kind::string) {
+		return syntaxError("expected member name");
+	}
+	if (!next()) {
+		return false;
+	}
+	if (token_.kind != JsonLexer::Kind::colon) {
+		return syntaxError("expected ':'");
+	}
+	return next();
+}
+
+bool Validator::skipValue()
+{
+	// NOTE: An explicit stack (rather than recursion) is used, so that deeply
+	// nested values do not exhaust the stack.
+	// Each element indicates if the enclosing value is an object.
+	std::vector<bool> inObject;
+	for (;;) {
+		// Skip the start of a value.
+		switch (token_.kind) {
+		case JsonLexer::Kind::beginObject:
+		case JsonLexer::Kind::beginArray:
+			{
+				bool isObject = token_.kind == JsonLexer::Kind::beginObject;
+				if (!next()) {
+					return false;
+				}
+				if (token_.kind == (isObject ? JsonLexer::Kind::endObject :
+				  JsonLexer::Kind::endArray)) {
+					break;
+				}
+				inObject.push_back(isObject);
+				if (isObject && !skipKey()) {
+					return false;
+				}
+			}
+			continue;
+		case JsonLexer::Kind::string:
+		case JsonLexer::Kind::number:
+		case JsonLexer::Kind::literal:
+			break;
+		case JsonLexer::Kind::end:
+			return syntaxError("unexpected end of file");
+		default:
+			return syntaxError("expected value");
+		}
+		// A value is complete, so close the enclosing values that end here.
+		for (;;) {
+			if (inObject.empty()) {
+				return true;
+			}
+			if (!next()) {
+				return false;
+			}
+			if (token_.kind == JsonLexer::Kind::comma) {
+				if (!next() || (inObject.back() && !skipKey())) {
+					return false;
+				}
+				break;
+			}
+			if (token_.kind != (inObject.back() ? JsonLexer::Kind::endObject :
+			  JsonLexer::Kind::endArray)) {
+				return syntaxError(inObject.back() ? "expected ',' or '}'" :
+				  "expected ',' or ']'");
+			}
+			inObject.pop_back();
+		}
+	}
+}
+
+bool Validator::skipMismatchedValue(std::string message)
+{
+	switch (token_.kind) {
+	case JsonLexer::Kind::beginObject:
+	case JsonLexer::Kind::beginArray:
+	case JsonLexer::Kind::string:
+	case JsonLexer::Kind::number:
+	case JsonLexer::Kind::literal:
+		if (!report(token_.offset, std::move(message))) {
+			return false;
+		}
+		break;
+	default:
+		// There is no value (so this is a syntax error that is reported when
+		// skipping the value).
+		break;
+	}
+	return skipValue();
+}
+
+bool Validator::validateStringMember(const std::string& key, bool keep,
+  std::string* value)
+{
+	if (!next(keep)) {
+		return false;
+	}
+	if (token_.kind != JsonLexer::Kind::string) {
+		return skipMismatchedValue(std::format("\"{}\" is not a string",
+		  key));
+	}
+	if (token_.truncated) {
+		return report(token_.offset, std::format("\"{}\" is too long", key));
+	}
+	if (value) {
+		*value = std::move(token_.value);
+	}
+	return true;
+}
+
+bool Validator::validateArguments()
+{
+	if (!next()) {
+		return false;
+	}
+	if (token_.kind != JsonLexer::Kind::beginArray) {
+		return skipMismatchedValue("\"arguments\" is not an array");
+	}
+	std::uint64_t arrayOffset = token_.offset;
+	std::uint64_t count = 0;
+	if (!next()) {
+		return false;
+	}
+	if (token_.kind != JsonLexer::Kind::endArray) {
+		for (;;) {
+			++count;
+			if (token_.kind != JsonLexer::Kind::string &&
+			  !skipMismatchedValue(std::format("argument {} is not a string",
+			  count - 1))) {
+				return false;
+			}
+			if (!next()) {
+				return false;
+			}
+			if (token_.kind == JsonLexer::Kind::endArray) {
+				break;
+			}
+			if (token_.kind != JsonLexer::Kind::comma) {
+				return syntaxError("expected ',' or ']'");
+			}
+			if (!next()) {
+				return false;
+			}
+		}
+	}
+	if (!count) {
+		return report(arrayOffset, "\"arguments\" is empty");
+	}
+	return true;
+}
+
+bool Validator::validateMember(Entry& entry, const std::string& key,
+  std::uint64_t keyOffset)
+{
+	auto checkDuplicate = [&](bool& seen) {
+		if (seen) {
+			if (!report(keyOffset, std::format("duplicate \"{}\"", key))) {
+				return false;
+			}
+		}
+		seen = true;
+		return true;
+	};
+	if (key == "directory") {
+		if (!checkDuplicate(entry.hasDirectory)) {
+			return false;
+		}
+		entry.directoryOffset = keyOffset;
+		return validateStringMember(key, true, &entry.directory);
+	}
+	if (key == "file") {
+		if (!checkDuplicate(entry.hasFile)) {
+			return false;
+		}
+		entry.fileOffset = keyOffset;
+		return validateStringMember(key, true, &entry.file);
+	}
+	if (key == "arguments") {
+		if (!checkDuplicate(entry.hasArguments)) {
+			return false;
+		}
+		return validateArguments();
+	}
+	if (key == "command") {
+		if (!checkDuplicate(entry.hasCommand)) {
+			return false;
+		}
+		return validateStringMember(key, false, nullptr);
+	}
+	if (key == "output") {
+		return validateStringMember(key, false, nullptr);
+	}
+	// Other members are permitted by the schema.
+	return next() && skipValue();
+}
+
+bool Validator::checkEntry(const Entry& entry)
+{
+	if (!entry.hasDirectory &&
+	  !report(entry.offset, "missing \"directory\"")) {
+		return false;
+	}
+	if (!entry.hasFile && !report(entry.offset, "missing \"file\"")) {
+		return false;
+	}
+	if (!entry.hasArguments && !entry.hasCommand &&
+	  !report(entry.offset, "missing \"arguments\" or \"command\"")) {
+		return false;
+	}
+	if (entry.hasDirectory) {
+		if (entry.directory.empty()) {
+			if (!report(entry.directoryOffset, "\"directory\" is empty")) {
+				return false;
+			}
+		} else if (!llvm::sys::path::is_absolute(entry.directory)) {
+			if (!report(entry.directoryOffset, std::format(
+			  "\"directory\" is not an absolute path: {}", entry.directory))) {
+				return false;
+			}
+		}
+	}
+	if (entry.hasFile) {
+		if (entry.file.empty()) {
+			if (!report(entry.fileOffset, "\"file\" is empty")) {
+				return false;
+			}
+		} else if (options_.checkFilesExist) {
+			llvm::SmallString<256> path(entry.file);
+			if (llvm::sys::path::is_relative(path)) {
+				llvm::sys::fs::make_absolute(entry.directory, path);
+			}
+			if (!llvm::sys::fs::exists(path) && !report(entry.fileOffset,
+			  std::format("file does not exist: {}", std::string(path)))) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool Validator::validateEntry()
+{
+	if (token_.kind != JsonLexer::Kind::beginObject) {
+		return skipMismatchedValue("entry is not an object");
+	}
+	Entry entry{token_.offset, false, false, false, false, {}, {}, 0, 0};
+	if (!next(true)) {
+		return false;
+	}
+	if (token_.kind != JsonLexer::Kind::endObject) {
+		for (;;) {
+			if (token_.kind != JsonLexer::Kind::string) {
+				return syntaxError("expected member name");
+			}
+			std::string key = std::move(token_.value);
+			std::uint64_t keyOffset = token_.offset;
+			if (!next()) {
+				return false;
+			}
+			if (token_.kind != JsonLexer::Kind::colon) {
+				return syntaxError("expected ':'");
+			}
+			if (!validateMember(entry, key, keyOffset) || !next(true)) {
+				return false;
+			}
+			if (token_.kind == JsonLexer::Kind::endObject) {
+				break;
+			}
+			if (token_.kind != JsonLexer::Kind::comma) {
+				return syntaxError("expected ',' or '}'");
+			}
+			if (!next(true)) {
+				return false;
+			}
+		}
+	}
+	return checkEntry(entry);
+}
+
+CdbValidationResult Validator::run()
+{
+	if (!next()) {
+		return result_;
+	}
+	if (token_.kind != JsonLexer::Kind::beginArray) {
+		report(token_.offset, "compilation database is not an array");
+		result_.stopped = true;
+		return result_;
+	}
+	if (!next()) {
+		return result_;
+	}
+	if (token_.kind != JsonLexer::Kind::endArray) {
+		for (;;) {
+			++entry_;
+			++result_.numEntries;
+			if (!validateEntry() || !next()) {
+				return result_;
+			}
+			if (token_.kind == JsonLexer::Kind::endArray) {
+				break;
+			}
+			if (token_.kind != JsonLexer::Kind::comma) {
+				syntaxError("expected ',' or ']'");
+				return result_;
+			}
+			if (!next()) {
+				return result_;
+			}
+		}
+	}
+	entry_ = -1;
+	if (!next()) {
+		return result_;
+	}
+	if (token_.kind != JsonLexer::Kind::end) {
+		report(token_.offset, "trailing data after compilation database");
+	}
+	return result_;
+}
+
+} // namespace
+
+/****************************************************************************\
+Compilation-Database Validator
+\****************************************************************************/
+
+llvm::Expected<CdbValidationResult> validateCompilationDatabase(
+  llvm::StringRef path, const CdbValidationOptions& options,
+  const std::function<void(const CdbDiagnostic&)>& callback)
+{
+	std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(
+	  std::fopen(path.str().c_str(), "rb"), &std::fclose);
+	if (!file) {
+		return llvm::createStringError(
+		  std::make_error_code(std::errc::no_such_file_or_directory),
+		  "cannot open %s", path.str().c_str());
+	}
+	Validator validator(file.get(), options, callback);
+	return validator.run();
+}
+
+} // namespace cal
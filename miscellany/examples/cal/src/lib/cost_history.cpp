@@ -0,0 +1,285 @@
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "cal/cost_history.hpp"
+
+namespace json = llvm::json;
+
+namespace cal {
+
+/****************************************************************************\
+Helper Functions
+\****************************************************************************/
+
+namespace {
+
+// The version of the state-file format.
+constexpr std::int64_t stateVersion = 1;
+
+// The number of bytes of source that an include directive is taken to be
+// worth when estimating the cost of a translation unit (since the cost is
+// usually dominated by the included headers).
+constexpr double includeWeight = 32 * 1024;
+
+// The time per (weighted) byte of source (in milliseconds) that is used
+// when there is no history from which to fit it.
+constexpr double defaultTimePerByte = 1.0e-3;
+
+// The memory per (weighted) byte of source that is used when there is no
+// history from which to fit it.
+constexpr double defaultMemoryPerByte = 256;
+
+// Check if a line (with leading whitespace removed) is an include
+// directive.
+bool isIncludeDirective(llvm::StringRef line)
+{
+	if (!line.consume_front("#")) {
+		return false;
+	}
+	line = line.ltrim(" \t");
+	return line.starts_with("include") || line.starts_with("import");
+}
+
+} // namespace
+
+/****************************************************************************\
+Cost History
+\****************************************************************************/
+
+std::uint64_t getResidentSetSize()
+{
+	// NOTE: The second field of statm is the resident set size in pages.
+	std::ifstream in("/proc/self/statm");
+	std::uint64_t size = 0;
+	std::uint64_t resident = 0;
+	if (!(in >> size >> resident)) {
+		return 0;
+	}
+	long pageSize = sysconf(_SC_PAGESIZE);
+	return pageSize > 0 ? resident * static_cast<std::uint64_t>(pageSize) :
+	  0;
+}
+
+std::uint64_t getPeakResidentSetSize()
+{
+	// NOTE: On Linux, the maximum resident set size is in kilobytes.
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage)) {
+		return 0;
+	}
+	return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+}
+
+SourceFeatures getSourceFeatures(llvm::StringRef path)
+{
+	SourceFeatures features;
+	auto buffer = llvm::MemoryBuffer::getFile(path, false, false);
+	if (!buffer) {
+		return features;
+	}
+	llvm::StringRef data = (*buffer)->getBuffer();
+	features.size = data.size();
+	const char* begin = data.data();
+	const char* end = begin + data.size();
+	while (begin != end) {
+		const char* newline = static_cast<const char*>(std::memchr(begin,
+		  '\n', end - begin));
+		const char* lineEnd = newline ? newline : end;
+		if (isIncludeDirective(llvm::StringRef(begin, lineEnd - begin).ltrim(
+		  " \t"))) {
+			++features.numIncludes;
+		}
+		begin = newline ? newline + 1 : end;
+	}
+	return features;
+}
+
+llvm::Error CostHistory::load(llvm::StringRef path)
+{
+	auto buffer = llvm::MemoryBuffer::getFile(path);
+	if (!buffer) {
+		if (buffer.getError() == std::errc::no_such_file_or_directory) {
+			return llvm::Error::success();
+		}
+		return llvm::createStringError(buffer.getError(), "cannot read %s",
+		  path.str().c_str());
+	}
+	llvm::Expected<json::Value> value = json::parse((*buffer)->getBuffer());
+	if (!value) {
+		return value.takeError();
+	}
+	const json::Object* object = value->getAsObject();
+	const json::Object* units = object ? object->getObject("units") :
+	  nullptr;
+	if (!units || object->getInteger("version") != stateVersion) {
+		return llvm::createStringError(std::errc::invalid_argument,
+		  "invalid state file %s", path.str().c_str());
+	}
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (const auto& keyValue : *units) {
+		const json::Object* unit = keyValue.second.getAsObject();
+		if (!unit) {
+			continue;
+		}
+		Entry entry;
+		entry.cost.time = unit->getNumber("time_ms").value_or(0);
+		if (std::optional<std::int64_t> memory = unit->getInteger("memory")) {
+			entry.cost.memory = *memory;
+		}
+		entry.features.size = unit->getInteger("size").value_or(0);
+		entry.features.numIncludes = unit->getInteger("includes").value_or(0);
+		entries_[keyValue.first.str()] = entry;
+	}
+	timePerByte_.reset();
+	memoryPerByte_.reset();
+	return llvm::Error::success();
+}
+
+llvm::Error CostHistory::save(llvm::StringRef path) const
+{
+	json::Object units;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (const auto& entry : entries_) {
+			const Entry& value = entry.getValue();
+			json::Object unit{
+			  {"time_ms", value.cost.time},
+			  {"size", static_cast<std::int64_t>(value.features.size)},
+			  {"includes", static_cast<std::int64_t>(
+			  value.features.numIncludes)}};
+			if (value.cost.memory) {
+				unit["memory"] = static_cast<std::int64_t>(*value.cost.memory);
+			}
+			units[entry.getKey()] = std::move(unit);
+		}
+	}
+	json::Value state(json::Object{{"version", stateVersion},
+	  {"units", std::move(units)}});
+
+	// Write the file atomically (by writing a temporary file and renaming
+	// it), since several runs may share a state file.
+	llvm::SmallString<256> tempPath;
+	llvm::sys::fs::createUniquePath(path + ".tmp-%%%%%%%%", tempPath, false);
+	std::error_code ec;
+	{
+		llvm::raw_fd_ostream out(tempPath, ec);
+		if (!ec) {
+			out << state;
+			out.close();
+			if (out.has_error()) {
+				ec = out.error();
+				out.clear_error();
+			}
+		}
+	}
+	if (!ec) {
+		ec = llvm::sys::fs::rename(tempPath, path);
+	}
+	if (ec) {
+		llvm::sys::fs::remove(tempPath);
+		return llvm::createStringError(ec, "cannot write %s",
+		  path.str().c_str());
+	}
+	return llvm::Error::success();
+}
+
+void CostHistory::record(llvm::StringRef key, const UnitCost& cost,
+  const SourceFeatures& features)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	Entry& entry = entries_[key];
+	std::optional<std::uint64_t> memory = cost.memory ? cost.memory :
+	  entry.cost.memory;
+	entry = Entry{cost, features};
+	entry.cost.memory = memory;
+	timePerByte_.reset();
+	memoryPerByte_.reset();
+}
+
+bool CostHistory::lookup(llvm::StringRef key, UnitCost& cost) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto i = entries_.find(key);
+	if (i == entries_.end()) {
+		return false;
+	}
+	cost = i->getValue().cost;
+	return true;
+}
+
+double CostHistory::getWeightedSize(const SourceFeatures& features)
+{
+	return static_cast<double>(features.size) +
+	  includeWeight * features.numIncludes;
+}
+
+template <class Cost>
+double CostHistory::fitCostPerByte(Cost getCost,
+  double defaultCostPerByte) const
+{
+	// Fit by least squares through the origin.
+	double sumCostSize = 0;
+	double sumSizeSquared = 0;
+	for (const auto& entry : entries_) {
+		const Entry& value = entry.getValue();
+		std::optional<double> cost = getCost(value.cost);
+		if (!cost) {
+			continue;
+		}
+		double size = getWeightedSize(value.features);
+		sumCostSize += *cost * size;
+		sumSizeSquared += size * size;
+	}
+	return sumSizeSquared > 0 ? sumCostSize / sumSizeSquared :
+	  defaultCostPerByte;
+}
+
+double CostHistory::estimateTime(llvm::StringRef key,
+  const SourceFeatures& features) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (auto i = entries_.find(key); i != entries_.end()) {
+		return i->getValue().cost.time;
+	}
+	if (!timePerByte_) {
+		timePerByte_ = fitCostPerByte([](const UnitCost& cost) {
+			return std::optional<double>(cost.time);
+		}, defaultTimePerByte);
+	}
+	return *timePerByte_ * getWeightedSize(features);
+}
+
+std::uint64_t CostHistory::estimateMemory(llvm::StringRef key,
+  const SourceFeatures& features) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (auto i = entries_.find(key); i != entries_.end() &&
+	  i->getValue().cost.memory) {
+		return *i->getValue().cost.memory;
+	}
+	if (!memoryPerByte_) {
+		memoryPerByte_ = fitCostPerByte([](const UnitCost& cost) {
+			return cost.memory ? std::optional<double>(*cost.memory) :
+			  std::nullopt;
+		}, defaultMemoryPerByte);
+	}
+	return static_cast<std::uint64_t>(*memoryPerByte_ *
+	  getWeightedSize(features));
+}
+
+} // namespace cal
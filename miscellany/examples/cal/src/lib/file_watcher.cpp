@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/Path.h>
+
+#include "cal/file_watcher.hpp"
+
+namespace cal {
+
+/****************************************************************************\
+File Watcher
+\****************************************************************************/
+
+namespace {
+
+// The events that indicate that a file in a watched directory may have
+// changed.
+constexpr std::uint32_t watchMask = IN_CLOSE_WRITE | IN_MOVED_TO |
+  IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ATTRIB | IN_ONLYDIR;
+
+std::error_code getErrnoCode()
+{
+	return std::error_code(errno, std::generic_category());
+}
+
+} // namespace
+
+FileWatcher::FileWatcher(int fd) : fd_(fd) {}
+
+FileWatcher::~FileWatcher()
+{
+	::close(fd_);
+}
+
+llvm::Expected<std::unique_ptr<FileWatcher>> FileWatcher::create()
+{
+	int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0) {
+		return llvm::createStringError(getErrnoCode(),
+		  "cannot initialize inotify");
+	}
+	return std::unique_ptr<FileWatcher>(new FileWatcher(fd));
+}
+
+llvm::Error FileWatcher::setFiles(const std::vector<std::string>& files)
+{
+	files_.clear();
+	llvm::StringSet<> directories;
+	for (const auto& file : files) {
+		files_.insert(file);
+		directories.insert(llvm::sys::path::parent_path(file));
+	}
+
+	// Stop watching the directories that are no longer needed.
+	for (auto i = watches_.begin(); i != watches_.end();) {
+		auto current = i++;
+		if (!directories.contains(current->first())) {
+			::inotify_rm_watch(fd_, current->second);
+			directories_.erase(current->second);
+			watches_.erase(current);
+		}
+	}
+
+	// Start watching the new directories.
+	for (const auto& entry : directories) {
+		llvm::StringRef directory = entry.first();
+		if (watches_.count(directory)) {
+			continue;
+		}
+		int wd = ::inotify_add_watch(fd_, directory.str().c_str(),
+		  watchMask);
+		if (wd < 0) {
+			// NOTE: A directory that does not exist (e.g., one that has
+			// been removed) cannot be watched, which is not an error.
+			if (errno == ENOENT || errno == ENOTDIR) {
+				continue;
+			}
+			return llvm::createStringError(getErrnoCode(), "cannot watch %s",
+			  directory.str().c_str());
+		}
+		watches_[directory] = wd;
+		directories_[wd] = std::string(directory);
+	}
+	return llvm::Error::success();
+}
+
+llvm::Expected<bool> FileWatcher::readEvents(llvm::StringSet<>& changed)
+{
+	bool complete = true;
+	alignas(inotify_event) char buffer[64 * 1024];
+	for (;;) {
+		ssize_t count = ::read(fd_, buffer, sizeof(buffer));
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN) {
+				return complete;
+			}
+			return llvm::createStringError(getErrnoCode(),
+			  "cannot read inotify events");
+		}
+		for (char* p = buffer; p < buffer + count;) {
+			const auto* event = reinterpret_cast<const inotify_event*>(p);
+			p += sizeof(inotify_event) + event->len;
+			if (event->mask & IN_Q_OVERFLOW) {
+				complete = false;
+				continue;
+			}
+			if (!event->len) {
+				continue;
+			}
+			auto i = directories_.find(event->wd);
+			if (i == directories_.end()) {
+				continue;
+			}
+			llvm::SmallString<256> path(i->second);
+			llvm::sys::path::append(path, event->name);
+			if (files_.contains(path)) {
+				changed.insert(path);
+			}
+		}
+	}
+}
+
+llvm::Expected<std::vector<std::string>> FileWatcher::waitForChanges(
+  std::chrono::milliseconds settleTime)
+{
+	llvm::StringSet<> changed;
+	bool complete = true;
+	int timeout = -1;
+	for (;;) {
+		pollfd pollFd{fd_, POLLIN, 0};
+		int ready = ::poll(&pollFd, 1, timeout);
+		if (ready < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return llvm::createStringError(getErrnoCode(),
+			  "cannot poll inotify descriptor");
+		}
+		if (!ready) {
+			// The files have settled.
+			break;
+		}
+		llvm::Expected<bool> result = readEvents(changed);
+		if (!result) {
+			return result.takeError();
+		}
+		complete = complete && *result;
+		if (!changed.empty() || !complete) {
+			timeout = static_cast<int>(settleTime.count());
+		}
+	}
+
+	std::vector<std::string> paths;
+	if (complete) {
+		for (const auto& entry : changed) {
+			paths.push_back(std::string(entry.first()));
+		}
+	} else {
+		for (const auto& entry : files_) {
+			paths.push_back(std::string(entry.first()));
+		}
+	}
+	std::sort(paths.begin(), paths.end());
+	return paths;
+}
+
+} // namespace cal
@@ -0,0 +1,73 @@
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/Endian.h>
+#include <llvm/Support/ErrorOr.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include "cal/hash.hpp"
+
+namespace cal {
+
+/****************************************************************************\
+Content Hashing
+\****************************************************************************/
+
+Hasher& Hasher::add(std::uint64_t value)
+{
+	std::array<std::uint8_t, sizeof(value)> bytes;
+	llvm::support::endian::write64le(bytes.data(), value);
+	blake3_.update(bytes);
+	return *this;
+}
+
+Hasher& Hasher::add(llvm::StringRef data)
+{
+	add(static_cast<std::uint64_t>(data.size()));
+	blake3_.update(data);
+	return *this;
+}
+
+Hasher& Hasher::add(const std::vector<std::string>& strings)
+{
+	add(static_cast<std::uint64_t>(strings.size()));
+	for (const auto& s : strings) {
+		add(llvm::StringRef(s));
+	}
+	return *this;
+}
+
+std::string Hasher::finalize()
+{
+	return llvm::toHex(blake3_.final(), true);
+}
+
+std::uint64_t fnv1aHash(llvm::StringRef data, std::uint64_t hash)
+{
+	for (unsigned char c : data) {
+		hash ^= c;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+std::string hashString(llvm::StringRef data)
+{
+	return Hasher().add(data).finalize();
+}
+
+std::string hashFile(const std::string& path)
+{
+	llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+	  llvm::MemoryBuffer::getFile(path, false, false);
+	if (!buffer) {
+		return "";
+	}
+	return hashString((*buffer)->getBuffer());
+}
+
+} // namespace cal
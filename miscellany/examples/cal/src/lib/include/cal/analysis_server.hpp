@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace cal {
+
+/****************************************************************************\
+Analysis Server
+\****************************************************************************/
+
+// A server that accepts analysis requests over a Unix-domain socket, so
+// that the state built up by a tool (e.g., loaded compilation databases
+// and parsed headers) can be kept in memory across many invocations.
+//
+// Each connection carries a single request, which is a JSON object with a
+// "command" member naming the handler to run.  The output written by the
+// handler is streamed back to the client as it is produced, followed by
+// the exit status of the handler.
+// The following commands are built in:
+//   - "ping", which does nothing; and
+//   - "shutdown", which stops the server.
+//
+// Requests are handled one at a time (in the thread that calls run), so
+// handlers can share state without locking.
+class AnalysisServer {
+public:
+
+	// A handler for a command.
+	// The handler writes its output to the specified stream and returns
+	// an exit status (where zero indicates success).
+	using Handler = std::function<int(const llvm::json::Object& request,
+	  llvm::raw_ostream& out)>;
+
+	explicit AnalysisServer(std::string socketPath);
+	~AnalysisServer();
+	AnalysisServer(const AnalysisServer&) = delete;
+	AnalysisServer& operator=(const AnalysisServer&) = delete;
+
+	// Add (or replace) the handler for a command.
+	void addHandler(std::string command, Handler handler);
+
+	// Serve requests until a shutdown request is received.
+	// A stale socket (i.e., one left behind by a server that is no longer
+	// running) is replaced, but it is an error for another server to be
+	// listening on the socket.
+	llvm::Error run();
+
+	std::uint64_t getNumRequests() const {return numRequests_;}
+
+private:
+
+	void serve(int fd);
+
+	std::string socketPath_;
+	llvm::StringMap<Handler> handlers_;
+	int listenFd_;
+	bool stopping_;
+	std::uint64_t numRequests_;
+};
+
+// Send a request to an analysis server, copying the output of the request
+// to the specified stream as it arrives.
+// Returns the exit status of the request.
+llvm::Expected<int> sendServerRequest(llvm::StringRef socketPath,
+  const llvm::json::Value& request, llvm::raw_ostream& out);
+
+} // namespace cal
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <clang/Frontend/ASTUnit.h>
+#include <llvm/Support/Error.h>
+
+namespace cal {
+
+/****************************************************************************\
+AST Cache
+\****************************************************************************/
+
+// A content-addressed on-disk cache of serialized ASTs.
+//
+// An AST is keyed by the hash of:
+//   - the Clang version;
+//   - the (absolute) path and contents of the main source file;
+//   - the compiler arguments; and
+//   - the contents of every file that was read while building the AST
+//     (i.e., the transitive closure of the included headers).
+// Since the headers are not known until the source file has been parsed,
+// the cache keeps (for each combination of version, source file, and
+// arguments) a manifest that lists the headers used by each cached AST
+// along with the hashes of their contents.
+// A lookup succeeds if the current contents of all of the headers listed
+// for some manifest entry match.
+//
+// The total size of the cached AST files can be bounded, in which case
+// the least-recently used AST files are evicted when the bound is
+// exceeded.
+//
+// The cache may be used concurrently by multiple threads and processes.
+//
+// Note: Like most compiler caches, the cache cannot detect that a newly
+// created header would shadow a header that was found on the include path
+// when the AST was built.
+class AstCache {
+public:
+
+	struct Stats {
+		std::uint64_t hits;
+		std::uint64_t misses;
+		std::uint64_t evictions;
+	};
+
+	// Create a cache that lives in the specified directory.
+	// A maximum size of zero indicates no limit on the size of the cache.
+	explicit AstCache(const std::string& directory,
+	  std::uint64_t maxSize = 0);
+
+	// Look up the AST for a source file and compiler arguments.
+	// Returns the path of the cached AST file, or an empty string if there
+	// is no such file in the cache.
+	std::string lookup(const std::string& sourcePath,
+	  const std::vector<std::string>& args);
+
+	// Store the AST for a source file and compiler arguments in the cache.
+	// Returns the path of the cached AST file.
+	llvm::Expected<std::string> store(clang::ASTUnit& astUnit,
+	  const std::string& sourcePath, const std::vector<std::string>& args);
+
+	// Look up the AST for a source file and compiler arguments, building
+	// the AST and storing it in the cache if it is not found.
+	// Returns the path of the cached AST file.
+	llvm::Expected<std::string> getOrBuild(const std::string& sourcePath,
+	  const std::vector<std::string>& args, bool* hit = nullptr);
+
+	// Evict least-recently used AST files until the cache size is within
+	// the maximum size.
+	void evict();
+
+	const std::string& getDirectory() const {return directory_;}
+	Stats getStats() const;
+
+private:
+
+	// Compute the key under which the manifest for a source file and
+	// compiler arguments is stored.
+	// An empty string is returned if the source file cannot be read.
+	std::string getManifestKey(const std::string& sourcePath,
+	  const std::vector<std::string>& args) const;
+
+	std::string getManifestPath(const std::string& manifestKey) const;
+	std::string getAstPath(const std::string& astKey) const;
+
+	std::string directory_;
+	std::uint64_t maxSize_;
+	std::atomic<std::uint64_t> hits_;
+	std::atomic<std::uint64_t> misses_;
+	std::atomic<std::uint64_t> evictions_;
+};
+
+} // namespace cal
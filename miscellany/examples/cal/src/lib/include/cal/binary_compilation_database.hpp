@@ -0,0 +1,88 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <clang/Tooling/CompilationDatabase.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+namespace cal {
+
+/****************************************************************************\
+Binary Compilation Database
+\****************************************************************************/
+
+// A compilation database that is stored in a compact binary format that
+// can be used directly from a memory-mapped file (i.e., without parsing
+// the whole database up front).
+//
+// The file consists of a header followed by these sections:
+//   - a string table, in which every distinct string (e.g., directory,
+//     file name, or argument) is stored once;
+//   - an argument-vector table, in which every distinct argument vector is
+//     stored once (as a sequence of string indices);
+//   - a command table, in which each command refers to its directory,
+//     file, output, and argument vector; and
+//   - a hash table that maps each (absolute) source file path to the
+//     commands for that file.
+// Within an argument vector, the arguments that are the file name or
+// output of the command are replaced by placeholders.  This allows the
+// commands that differ only in their file name and output to share an
+// argument vector.
+// All integers are stored in little-endian byte order.
+//
+// Only the commands for the files that are queried are materialized.
+class BinaryCompilationDatabase : public clang::tooling::CompilationDatabase {
+public:
+
+	// The conventional name of a binary compilation database file in a
+	// build directory.
+	static constexpr const char* defaultFileName = "compile_commands.bcdb";
+
+	// Load a binary compilation database from a file.
+	// Returns null (and sets the error message) upon failure.
+	static std::unique_ptr<BinaryCompilationDatabase> loadFromFile(
+	  llvm::StringRef path, std::string& errorMessage);
+
+	// Load a binary compilation database from a buffer.
+	// Returns null (and sets the error message) upon failure.
+	static std::unique_ptr<BinaryCompilationDatabase> loadFromBuffer(
+	  std::unique_ptr<llvm::MemoryBuffer> buffer, std::string& errorMessage);
+
+	std::vector<clang::tooling::CompileCommand> getCompileCommands(
+	  llvm::StringRef filePath) const override;
+	std::vector<std::string> getAllFiles() const override;
+	std::vector<clang::tooling::CompileCommand> getAllCompileCommands()
+	  const override;
+
+	// Get the number of commands, distinct strings, and distinct argument
+	// vectors in the database.
+	unsigned getNumCommands() const;
+	unsigned getNumStrings() const;
+	unsigned getNumArgVectors() const;
+
+private:
+
+	explicit BinaryCompilationDatabase(
+	  std::unique_ptr<llvm::MemoryBuffer> buffer);
+	bool validate(std::string& errorMessage) const;
+	llvm::StringRef getString(unsigned index) const;
+	clang::tooling::CompileCommand getCommand(unsigned index) const;
+
+	std::unique_ptr<llvm::MemoryBuffer> buffer_;
+};
+
+// Write a binary compilation database containing the specified commands.
+llvm::Error writeBinaryCompilationDatabase(llvm::StringRef path,
+  const std::vector<clang::tooling::CompileCommand>& commands);
+
+// Force the linking of the binary compilation database plugin, which
+// allows the database to be found by CompilationDatabase::loadFromDirectory
+// and autoDetectFromDirectory (e.g., as used by CommonOptionsParser).
+extern volatile int binaryCompilationDatabaseAnchorSource;
+[[maybe_unused]] static int binaryCompilationDatabaseAnchorDest =
+  binaryCompilationDatabaseAnchorSource;
+
+} // namespace cal
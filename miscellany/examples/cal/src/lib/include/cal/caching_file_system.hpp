@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/Twine.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/ErrorOr.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace cal {
+
+/****************************************************************************\
+File-System Cache
+\****************************************************************************/
+
+// A thread-safe cache of file-system state that can be shared by any number
+// of CachingFileSystem objects (e.g., one per worker thread).
+// The cache assumes that the files it sees do not change for the lifetime
+// of the cache.  In particular, the status of a path (including the
+// nonexistence of a path) and the contents of a file are looked up at most
+// once.
+// The buffers handed out by the cache refer to memory owned by the cache.
+// So, the cache must outlive any SourceManager that uses these buffers.
+class FileSystemCache {
+public:
+
+	// Counters describing the effectiveness of the cache.
+	struct Stats {
+		// The number of status queries answered from the cache.
+		std::uint64_t statusHits;
+		// The number of status queries forwarded to the underlying file
+		// system.
+		std::uint64_t statusMisses;
+		// The number of status queries answered from the cache with an
+		// error (e.g., a nonexistent file).
+		std::uint64_t negativeHits;
+		// The number of file opens answered from the cache.
+		std::uint64_t openHits;
+		// The number of file opens forwarded to the underlying file system.
+		std::uint64_t openMisses;
+		// The number of bytes of file contents served from the cache.
+		std::uint64_t bytesServed;
+		// The number of bytes of file contents read from the underlying
+		// file system.
+		std::uint64_t bytesRead;
+	};
+
+	// The cached contents of a file.
+	struct Contents {
+		llvm::vfs::Status status;
+		std::unique_ptr<llvm::MemoryBuffer> buffer;
+	};
+
+	FileSystemCache() = default;
+	FileSystemCache(const FileSystemCache&) = delete;
+	FileSystemCache& operator=(const FileSystemCache&) = delete;
+
+	// Look up the status of an absolute path.
+	// Returns nullptr if the status is not in the cache.
+	const llvm::ErrorOr<llvm::vfs::Status>* findStatus(llvm::StringRef path)
+	  const;
+
+	// Insert the status of an absolute path.
+	// If the path is already in the cache, the existing entry is kept.
+	const llvm::ErrorOr<llvm::vfs::Status>& insertStatus(llvm::StringRef path,
+	  llvm::ErrorOr<llvm::vfs::Status> status);
+
+	// Look up the contents of the file with an absolute path.
+	// Returns nullptr if the contents are not in the cache.
+	const Contents* findContents(llvm::StringRef path) const;
+
+	// Insert the contents of the file with an absolute path.
+	// If the path is already in the cache, the existing entry is kept.
+	const Contents& insertContents(llvm::StringRef path,
+	  std::unique_ptr<Contents> contents);
+
+	Stats getStats() const;
+	void printStats(llvm::raw_ostream& out) const;
+
+	// Discard all cached state.
+	// This must not be called while buffers from the cache are in use.
+	void clear();
+
+private:
+
+	friend class CachingFileSystem;
+
+	mutable std::shared_mutex mutex_;
+	llvm::StringMap<llvm::ErrorOr<llvm::vfs::Status>> statuses_;
+	llvm::StringMap<std::unique_ptr<Contents>> contents_;
+
+	std::atomic<std::uint64_t> statusHits_{0};
+	std::atomic<std::uint64_t> statusMisses_{0};
+	std::atomic<std::uint64_t> negativeHits_{0};
+	std::atomic<std::uint64_t> openHits_{0};
+	std::atomic<std::uint64_t> openMisses_{0};
+	std::atomic<std::uint64_t> bytesServed_{0};
+	std::atomic<std::uint64_t> bytesRead_{0};
+};
+
+/****************************************************************************\
+Caching File System
+\****************************************************************************/
+
+// A file system that memoizes the status and contents queries made of an
+// underlying file system in a (possibly shared) FileSystemCache.
+// Each CachingFileSystem has its own current working directory (by way of
+// the underlying file system), so a distinct CachingFileSystem (wrapping a
+// distinct underlying file system) should be used by each thread.
+class CachingFileSystem : public llvm::vfs::ProxyFileSystem {
+public:
+
+	CachingFileSystem(llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fileSys,
+	  std::shared_ptr<FileSystemCache> cache);
+
+	llvm::ErrorOr<llvm::vfs::Status> status(const llvm::Twine& path) override;
+	llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>> openFileForRead(
+	  const llvm::Twine& path) override;
+#if LLVM_VERSION_MAJOR >= 17
+	bool exists(const llvm::Twine& path) override;
+#endif
+
+	FileSystemCache& getCache() const {return *cache_;}
+
+private:
+
+	// Convert a path to the key used for the cache (i.e., the absolute path
+	// with "." components removed).
+	bool getCacheKey(const llvm::Twine& path,
+	  llvm::SmallVectorImpl<char>& key) const;
+
+	std::shared_ptr<FileSystemCache> cache_;
+};
+
+// Create a caching file system layered on top of the specified file system.
+// If no file system is specified, a new physical file system (with its own
+// working directory) is used.
+// If no cache is specified, a new (unshared) cache is created.
+llvm::IntrusiveRefCntPtr<CachingFileSystem> createCachingFileSystem(
+  std::shared_ptr<FileSystemCache> cache = nullptr,
+  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fileSys = nullptr);
+
+} // namespace cal
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+
+namespace cal {
+
+/****************************************************************************\
+Compilation-Database Validator
+\****************************************************************************/
+
+// A problem found in a compilation database.
+struct CdbDiagnostic {
+	// The byte offset in the file at which the problem was found.
+	std::uint64_t offset;
+	// The index of the entry (i.e., command object) containing the problem
+	// (or -1 if the problem is not associated with an entry).
+	std::int64_t entry;
+	std::string message;
+};
+
+struct CdbValidationOptions {
+	// Indicates if the files named by the entries must exist.
+	bool checkFilesExist = false;
+	// The maximum number of problems to report before stopping (where
+	// zero means no limit).
+	std::uint64_t maxProblems = 0;
+};
+
+struct CdbValidationResult {
+	// The number of entries examined.
+	std::uint64_t numEntries;
+	// The number of problems found.
+	std::uint64_t numProblems;
+	// Indicates if validation stopped early (e.g., due to a syntax error).
+	bool stopped;
+};
+
+// Validate a JSON compilation database against the compilation-database
+// schema (i.e., documents/json_schema/compilation_database_schema.json).
+//
+// The following is checked:
+//   - the file is well-formed JSON consisting of an array of objects;
+//   - each object has "directory" and "file" strings;
+//   - each object has an "arguments" array of one or more strings and/or
+//     a "command" string;
+//   - the "output" member (if any) is a string;
+//   - the directory is an absolute path (so that the paths that are
+//     relative to it are meaningful); and
+//   - optionally, that the file (relative to the directory) exists.
+//
+// The file is processed as a stream (without building a DOM), so the
+// memory used does not depend on the size of the file.
+// The callback is invoked for each problem found.
+llvm::Expected<CdbValidationResult> validateCompilationDatabase(
+  llvm::StringRef path, const CdbValidationOptions& options,
+  const std::function<void(const CdbDiagnostic&)>& callback);
+
+} // namespace cal
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+
+namespace cal {
+
+/****************************************************************************\
+Cost History
+\****************************************************************************/
+
+// Get the current resident set size of the process (in bytes), or zero if
+// it cannot be determined.
+std::uint64_t getResidentSetSize();
+
+// Get the peak resident set size of the process so far (in bytes), or zero
+// if it cannot be determined.
+std::uint64_t getPeakResidentSetSize();
+
+// The features of a source file that are used to estimate the cost of a
+// translation unit for which there is no history.
+struct SourceFeatures {
+	// The size of the source file (in bytes).
+	std::uint64_t size = 0;
+	// The number of include directives in the source file.
+	unsigned numIncludes = 0;
+};
+
+// Get the features of a source file (where a file that cannot be read has
+// a size and number of includes of zero).
+SourceFeatures getSourceFeatures(llvm::StringRef path);
+
+// The measured cost of processing a translation unit.
+struct UnitCost {
+	// The wall time (in milliseconds).
+	double time = 0;
+	// The memory used (in bytes), as given by the growth in the resident
+	// set size of the process while the translation unit was processed.
+	// This is only meaningful if the translation unit was processed in
+	// isolation (since the growth would otherwise include that due to the
+	// translation units processed concurrently), so it is absent if not.
+	std::optional<std::uint64_t> memory;
+};
+
+// The costs of processing translation units in previous runs, which are
+// kept in a (JSON) state file.
+// The translation units are identified by arbitrary keys (e.g., the
+// absolute path of the source file).
+// The costs may be recorded concurrently.
+class CostHistory {
+public:
+
+	// Load the history from a state file (where a file that does not exist
+	// yields an empty history).
+	llvm::Error load(llvm::StringRef path);
+
+	// Save the history to a state file (atomically).
+	llvm::Error save(llvm::StringRef path) const;
+
+	// Record the cost of a translation unit (replacing any previous cost).
+	// If the cost has no memory, any previously recorded memory is kept.
+	void record(llvm::StringRef key, const UnitCost& cost,
+	  const SourceFeatures& features);
+
+	// Get the recorded cost of a translation unit (if any).
+	bool lookup(llvm::StringRef key, UnitCost& cost) const;
+
+	// Estimate the wall time (in milliseconds) of a translation unit.
+	// The recorded time is used if available.  Otherwise, the time is
+	// estimated from the source-file features, with a time per byte of
+	// source (where each include directive counts as a fixed number of
+	// bytes) that is fitted to the recorded translation units.
+	double estimateTime(llvm::StringRef key,
+	  const SourceFeatures& features) const;
+
+	// Estimate the memory (in bytes) of a translation unit (in the same way
+	// as the wall time, but using only the translation units with recorded
+	// memory).
+	std::uint64_t estimateMemory(llvm::StringRef key,
+	  const SourceFeatures& features) const;
+
+private:
+
+	struct Entry {
+		UnitCost cost;
+		SourceFeatures features;
+	};
+
+	// Get the (weighted) size of a source file for estimation purposes.
+	static double getWeightedSize(const SourceFeatures& features);
+
+	// Fit a cost per weighted byte to the recorded translation units (where
+	// the default is used if there are none).
+	// The cost function returns no value for a translation unit without the
+	// cost (which is then excluded from the fit).
+	template <class Cost>
+	double fitCostPerByte(Cost getCost, double defaultCostPerByte) const;
+
+	mutable std::mutex mutex_;
+	llvm::StringMap<Entry> entries_;
+	// The fitted time and memory per weighted byte (which are computed on
+	// demand).
+	mutable std::optional<double> timePerByte_;
+	mutable std::optional<double> memoryPerByte_;
+};
+
+} // namespace cal
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Support/Error.h>
+
+namespace cal {
+
+/****************************************************************************\
+File Watcher
+\****************************************************************************/
+
+// A watcher that reports changes to a set of files (using inotify).
+//
+// The directories containing the files are watched (rather than the files
+// themselves), so that a file that is replaced (e.g., by an editor that
+// saves by writing a new file and renaming it over the old one) continues
+// to be watched.
+class FileWatcher {
+public:
+
+	static llvm::Expected<std::unique_ptr<FileWatcher>> create();
+	~FileWatcher();
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	// Set the files to be watched (replacing any previous set).
+	// The paths must be absolute and normalized (e.g., by
+	// getNormalizedPath).
+	llvm::Error setFiles(const std::vector<std::string>& files);
+
+	// Wait until at least one watched file changes.
+	// Since a single save often generates several events (and several
+	// files are often saved together), changes continue to be collected
+	// until no event has occurred for the settle time.
+	// Returns the (sorted) paths of the changed files.
+	// If events were lost (i.e., the event queue overflowed), all of the
+	// watched files are reported as changed.
+	llvm::Expected<std::vector<std::string>> waitForChanges(
+	  std::chrono::milliseconds settleTime);
+
+private:
+
+	explicit FileWatcher(int fd);
+
+	// Read the pending events, recording the changed files.
+	// Returns false if events were lost.
+	llvm::Expected<bool> readEvents(llvm::StringSet<>& changed);
+
+	int fd_;
+	llvm::StringSet<> files_;
+	// The watched directories (keyed by watch descriptor) and vice versa.
+	llvm::DenseMap<int, std::string> directories_;
+	llvm::StringMap<int> watches_;
+};
+
+} // namespace cal
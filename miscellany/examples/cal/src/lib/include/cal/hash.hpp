@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/BLAKE3.h>
+
+namespace cal {
+
+/****************************************************************************\
+Content Hashing
+\****************************************************************************/
+
+// A hasher for computing content-based keys (e.g., for caches).
+// Each value added is prefixed by its length, so that (for example)
+// adding "ab" then "c" yields a different hash than adding "a" then "bc".
+class Hasher {
+public:
+	Hasher& add(llvm::StringRef data);
+	Hasher& add(std::uint64_t value);
+	Hasher& add(const std::vector<std::string>& strings);
+	// Return the hash as a lowercase hexadecimal string.
+	// The hasher should not be used after this function is called.
+	std::string finalize();
+private:
+	llvm::BLAKE3 blake3_;
+};
+
+// Compute the (64-bit) FNV-1a hash of a string.
+// Unlike the hashes used by LLVM containers, this hash is stable across
+// processes and platforms, so it may be stored in files.
+// Passing a previous hash as the initial value allows a sequence of
+// strings to be hashed incrementally.
+std::uint64_t fnv1aHash(llvm::StringRef data,
+  std::uint64_t hash = 0xcbf29ce484222325ULL);
+
+// Compute the hash of a string.
+std::string hashString(llvm::StringRef data);
+
+// Compute the hash of the contents of a file.
+// An empty string is returned if the file cannot be read.
+std::string hashFile(const std::string& path);
+
+} // namespace cal
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <clang/Frontend/FrontendAction.h>
+#include <clang/Tooling/Tooling.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace cal {
+
+/****************************************************************************\
+Dependency Collection
+\****************************************************************************/
+
+// A frontend-action factory that wraps the actions created by another
+// factory so that the files read while processing a translation unit
+// (excluding system headers) are recorded.
+// The recorded paths are absolute and normalized.
+class DependencyCollectingActionFactory :
+  public clang::tooling::FrontendActionFactory {
+public:
+	DependencyCollectingActionFactory(
+	  clang::tooling::FrontendActionFactory& factory,
+	  std::vector<std::string>& dependencies) : factory_(factory),
+	  dependencies_(dependencies) {}
+	std::unique_ptr<clang::FrontendAction> create() override;
+private:
+	clang::tooling::FrontendActionFactory& factory_;
+	std::vector<std::string>& dependencies_;
+};
+
+/****************************************************************************\
+Incremental Runner
+\****************************************************************************/
+
+// The result of analyzing a single translation unit.
+struct UnitResult {
+	// The exit status of the analysis (where zero indicates success).
+	int status = 0;
+	// The output of the analysis.
+	std::string output;
+	// The files that the translation unit depends on (typically collected
+	// with a DependencyCollectingActionFactory).
+	std::vector<std::string> dependencies;
+};
+
+// A runner that analyzes a set of translation units and then, as files
+// change, reanalyzes only the translation units that depend on the changed
+// files.
+// The result of each translation unit is kept in memory, so that an
+// aggregate report (in which the results appear in the order of the source
+// files) can be produced after each update.
+//
+// Note: A change that would add a dependency without modifying an existing
+// one (e.g., the creation of a header that shadows a header found later on
+// the include path) is not detected.
+class IncrementalRunner {
+public:
+
+	// Analyze a single translation unit.
+	using Analyzer = std::function<UnitResult(const std::string& sourcePath)>;
+
+	IncrementalRunner(std::vector<std::string> sourcePaths, Analyzer analyzer);
+
+	// Analyze all of the translation units.
+	void runAll();
+
+	// Reanalyze the translation units that depend on any of the specified
+	// (absolute and normalized) files.
+	// Returns the number of translation units reanalyzed.
+	std::size_t rerun(const std::vector<std::string>& changedFiles);
+
+	// Get the (sorted) files on which any translation unit depends.
+	std::vector<std::string> getDependencies() const;
+
+	// Print the results of all of the translation units.
+	// If the output is a terminal, the screen is cleared first (so that
+	// the report is updated in place).
+	void printReport(llvm::raw_ostream& out) const;
+
+	// Get the status of the analysis as a whole (i.e., zero if every
+	// translation unit was analyzed successfully).
+	int getStatus() const;
+
+	// Analyze all of the translation units and then repeatedly wait for
+	// files to change and reanalyze the affected translation units,
+	// printing the report after each update.
+	// This only returns if an error occurs.
+	llvm::Error watch(llvm::raw_ostream& out,
+	  std::chrono::milliseconds settleTime = std::chrono::milliseconds(100));
+
+private:
+
+	void analyze(std::size_t index);
+	void rebuildIndex();
+
+	std::vector<std::string> sourcePaths_;
+	Analyzer analyzer_;
+	std::vector<UnitResult> results_;
+	// The translation units that depend on each file.
+	llvm::StringMap<std::vector<std::size_t>> dependents_;
+	// A description of the last update.
+	std::string lastUpdate_;
+};
+
+} // namespace cal
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <clang/Tooling/CompilationDatabase.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/StringSet.h>
+
+namespace cal {
+
+/****************************************************************************\
+Interning Compilation Database
+\****************************************************************************/
+
+// A compilation database that holds the commands of another database in a
+// compact form.
+//
+// All strings are interned.  The argument vectors are stored in a trie
+// so that a common prefix of arguments is stored only once.  Within an
+// argument vector, the arguments that are the file name or output of the
+// command are replaced by placeholders, so that the commands that differ
+// only in their file name and output share the same argument vector
+// (i.e., the same flag set).
+//
+// The commands are grouped by flag set, which allows tools to batch work
+// that depends only on the flags (e.g., header search setup).
+//
+// The underlying database is read once (at construction time) and is not
+// retained.
+class InterningCompilationDatabase :
+  public clang::tooling::CompilationDatabase {
+public:
+
+	// A group of commands that share a flag set.
+	struct FlagSet {
+		// A hash of the arguments (with the file name and output replaced
+		// by placeholders).  The hash is stable across processes.
+		std::uint64_t hash;
+		// The indices of the commands that have this flag set.
+		std::vector<unsigned> commands;
+	};
+
+	explicit InterningCompilationDatabase(
+	  const clang::tooling::CompilationDatabase& base);
+
+	std::vector<clang::tooling::CompileCommand> getCompileCommands(
+	  llvm::StringRef filePath) const override;
+	std::vector<std::string> getAllFiles() const override;
+	std::vector<clang::tooling::CompileCommand> getAllCompileCommands()
+	  const override;
+
+	unsigned getNumCommands() const {return commands_.size();}
+	clang::tooling::CompileCommand getCommand(unsigned index) const;
+
+	// Get the flag sets, in order of first appearance.
+	const std::vector<FlagSet>& getFlagSets() const {return flagSets_;}
+
+	// Get the number of distinct strings and the number of argument-trie
+	// nodes (i.e., the number of stored arguments).
+	unsigned getNumStrings() const {return strings_.size();}
+	unsigned getNumArgNodes() const {return argNodes_.size();}
+
+private:
+
+	// A node in the argument trie.  The argument vector for a node consists
+	// of the argument vector for its parent followed by its argument.
+	// Node zero is the root (which represents the empty argument vector).
+	struct ArgNode {
+		llvm::StringRef arg;
+		// The index of the parent node (or noParent for the root).
+		unsigned parent;
+		// The index of the flag set for the argument vector ending at this
+		// node (or noFlagSet if there is none).
+		unsigned flagSet;
+		// A hash of the argument vector ending at this node.
+		std::uint64_t hash;
+	};
+
+	struct Command {
+		llvm::StringRef directory;
+		llvm::StringRef file;
+		llvm::StringRef output;
+		// The index of the last node of the argument vector.
+		unsigned argNode;
+		unsigned flagSet;
+	};
+
+	static constexpr unsigned noParent = ~0U;
+	static constexpr unsigned noFlagSet = ~0U;
+
+	llvm::StringRef intern(llvm::StringRef s);
+	void addCommand(const clang::tooling::CompileCommand& command);
+
+	// NOTE: The entries of a StringSet are not moved by later insertions,
+	// so the interned strings can be referenced by StringRef.
+	llvm::StringSet<> strings_;
+	std::vector<ArgNode> argNodes_;
+	// The children of each node, keyed by (parent, argument data).
+	// NOTE: Since the strings are interned, the data pointer of an
+	// argument identifies the argument.
+	llvm::DenseMap<std::pair<unsigned, const char*>, unsigned> argChildren_;
+	std::vector<Command> commands_;
+	std::vector<FlagSet> flagSets_;
+	// The commands for each file, keyed by normalized path.
+	llvm::StringMap<std::vector<unsigned>> fileCommands_;
+};
+
+} // namespace cal
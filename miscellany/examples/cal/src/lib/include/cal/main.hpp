@@ -1,3 +1,26 @@
 #pragma once
 
+#include <cal/analysis_server.hpp>
+#include <cal/ast_cache.hpp>
+#include <cal/binary_compilation_database.hpp>
+#include <cal/caching_file_system.hpp>
+#include <cal/compilation_database_validator.hpp>
+#include <cal/cost_history.hpp>
+#include <cal/file_watcher.hpp>
+#include <cal/hash.hpp>
+#include <cal/incremental_runner.hpp>
+#include <cal/interning_compilation_database.hpp>
+#include <cal/matcher_profiler.hpp>
+#include <cal/matcher_query.hpp>
+#include <cal/memory_budget.hpp>
+#include <cal/output.hpp>
+#include <cal/parallel.hpp>
+#include <cal/response_file_cache.hpp>
+#include <cal/sharded_execution.hpp>
+#include <cal/snippet.hpp>
+#include <cal/source_text.hpp>
+#include <cal/time_trace.hpp>
+#include <cal/translation_unit_cache.hpp>
+#include <cal/traversal_scope.hpp>
 #include <cal/utility.hpp>
+#include <cal/worker_pool.hpp>
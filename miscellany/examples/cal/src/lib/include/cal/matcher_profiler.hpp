@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <clang/ASTMatchers/ASTMatchFinder.h>
+#include <clang/Tooling/Tooling.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/Timer.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace cal {
+
+/****************************************************************************\
+Matcher Profiler
+\****************************************************************************/
+
+// A profiler that aggregates the matcher timings collected by a MatchFinder
+// (with CheckProfiling enabled) across translation units.
+//
+// A MatchFinder attributes the time spent matching (and running the
+// callback) to the ID of the callback (i.e., MatchCallback::getID).
+// So, for matchers to be profiled separately, each matcher must have a
+// callback with a distinct ID.
+//
+// A MatchFinder replaces (rather than adds to) the timings after each
+// translation unit, so the timings must be collected at the end of each
+// translation unit.
+// This is done automatically by the source-file callbacks of the profiler
+// (when they are passed to newFrontendActionFactory).
+// Otherwise (e.g., when MatchFinder::matchAST is called directly), collect
+// must be called after each translation unit.
+class MatcherProfiler {
+public:
+
+	struct Entry {
+		// The total time.
+		llvm::TimeRecord time;
+		// The number of translation units in which the callback ran.
+		std::uint64_t numUnits;
+	};
+
+	MatcherProfiler();
+	MatcherProfiler(const MatcherProfiler&) = delete;
+	MatcherProfiler& operator=(const MatcherProfiler&) = delete;
+
+	// Get the options for a MatchFinder that reports its timings to this
+	// profiler.
+	clang::ast_matchers::MatchFinder::MatchFinderOptions getFinderOptions();
+
+	// Get source-file callbacks that collect the timings at the end of each
+	// translation unit.
+	clang::tooling::SourceFileCallbacks* getSourceFileCallbacks() {
+		return &callbacks_;
+	}
+
+	// Add the timings of the last translation unit to the totals.
+	void collect();
+
+	// Get the number of translation units for which timings were collected.
+	std::uint64_t getNumUnits() const {
+		return numUnits_;
+	}
+
+	// Get the total timings (in decreasing order of wall time).
+	std::vector<std::pair<std::string, Entry>> getEntries() const;
+
+	// Print a report of the total timings (in decreasing order of wall
+	// time).
+	void printReport(llvm::raw_ostream& out) const;
+
+	// Get the total timings as JSON.
+	llvm::json::Value toJson() const;
+
+	// Write the total timings as JSON to a file.
+	llvm::Error writeJson(llvm::StringRef path) const;
+
+private:
+
+	class Callbacks : public clang::tooling::SourceFileCallbacks {
+	public:
+		explicit Callbacks(MatcherProfiler& profiler) : profiler_(profiler) {}
+		void handleEndSource() override {
+			profiler_.collect();
+		}
+	private:
+		MatcherProfiler& profiler_;
+	};
+
+	// The timings of the current translation unit (which are written by the
+	// MatchFinder).
+	llvm::StringMap<llvm::TimeRecord> records_;
+	llvm::StringMap<Entry> totals_;
+	std::uint64_t numUnits_;
+	Callbacks callbacks_;
+};
+
+} // namespace cal
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <clang/ASTMatchers/ASTMatchersInternal.h>
+#include <clang/ASTMatchers/Dynamic/Parser.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+
+namespace cal {
+
+/****************************************************************************\
+Matcher Queries
+\****************************************************************************/
+
+// A named matcher that was parsed at run time.
+struct MatcherQuery {
+	std::string name;
+	clang::ast_matchers::internal::DynTypedMatcher matcher;
+};
+
+// Parse a matcher expression (using the same language as clang-query).
+// If the bind ID is not empty, the matcher is bound to it (in which case
+// the matcher must be bindable).
+// The named values (which may be null) are the values that can be
+// referenced by name in the expression.
+llvm::Expected<clang::ast_matchers::internal::DynTypedMatcher>
+  parseMatcherExpression(llvm::StringRef code, llvm::StringRef bindId = {},
+  const clang::ast_matchers::dynamic::Parser::NamedValueMap* namedValues =
+  nullptr);
+
+// Parse a list of named matcher queries.
+// Each (nonblank) line of the text is one of the following:
+//   query <name> <matcher expression>
+//   let <name> <expression>
+//   # <comment>
+// A line that starts with whitespace continues the previous query or
+// value (so that a long expression can be split across lines).
+// A value defined with let can be referenced by name in any later
+// expression.
+// The bind ID (if not empty) is applied to every query.
+// The buffer name is used to identify the text in error messages.
+llvm::Expected<std::vector<MatcherQuery>> parseMatcherQueries(
+  llvm::StringRef text, llvm::StringRef bufferName,
+  llvm::StringRef bindId = {});
+
+// Load a list of named matcher queries from a file (in the format used by
+// parseMatcherQueries).
+llvm::Expected<std::vector<MatcherQuery>> loadMatcherQueries(
+  llvm::StringRef path, llvm::StringRef bindId = {});
+
+} // namespace cal
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <llvm/ADT/StringRef.h>
+
+namespace cal {
+
+/****************************************************************************\
+Memory Budget
+\****************************************************************************/
+
+// Parse a memory size (in bytes), which is a nonnegative integer that is
+// optionally followed by one of the (binary) suffixes K, M, G, or T
+// (optionally followed by B or iB), such as "512M" or "32GiB".
+std::optional<std::uint64_t> parseMemorySize(llvm::StringRef text);
+
+// An admission controller that bounds the memory used by work items (e.g.,
+// translation units) that are processed concurrently.
+// Before an item is processed, it is admitted with an estimate of its
+// memory, which is reserved until the item has allocated its memory (i.e.,
+// until its ticket is settled or released).  An item is admitted when the
+// current resident set size of the process plus the outstanding
+// reservations (of the items that have not yet allocated their memory)
+// plus its estimate fits in the limit.  Otherwise, admission blocks until
+// another item settles or finishes.
+// Since admission is driven by the resident set size, the memory in use by
+// the items in progress (and by anything else in the process) is accounted
+// for as it is, rather than as estimated or as measured per item (which
+// cannot be done reliably while other items are allocating concurrently).
+// An item is always admitted if no other item is in progress (even if its
+// estimate exceeds the budget), so that every item is eventually
+// processed.
+class MemoryBudget {
+public:
+
+	// The reservation for an admitted item, which is released when the
+	// ticket is destroyed.
+	class Ticket {
+	public:
+		Ticket() = default;
+		Ticket(Ticket&& other);
+		Ticket& operator=(Ticket&& other);
+		~Ticket();
+		// Indicate that the item has allocated its memory (so that the
+		// memory is reflected in the resident set size of the process),
+		// which ends its reservation (but not its admission).
+		void settle();
+		// Release the reservation (which allows other items to be
+		// admitted).
+		void release();
+		// Get the memory (in bytes) that is currently reserved.
+		std::uint64_t getReservation() const {return reservation_;}
+	private:
+		friend class MemoryBudget;
+		Ticket(MemoryBudget* budget, std::uint64_t reservation) :
+		  budget_(budget), reservation_(reservation) {}
+		MemoryBudget* budget_ = nullptr;
+		std::uint64_t reservation_ = 0;
+	};
+
+	// Create a budget with the specified limit (in bytes) on the memory of
+	// the process, where a limit of zero means no limit.
+	explicit MemoryBudget(std::uint64_t limit);
+
+	MemoryBudget(const MemoryBudget&) = delete;
+	MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+	// Admit an item with the specified estimate of its memory (in bytes),
+	// waiting until the estimate fits in the budget.
+	Ticket admit(std::uint64_t estimate);
+
+	// Get the limit (in bytes).
+	std::uint64_t getLimit() const {return limit_;}
+
+	// Get the number of admissions that had to wait.
+	unsigned getNumWaits() const;
+
+private:
+	void settle(Ticket& ticket);
+	void release(Ticket& ticket);
+
+	std::uint64_t limit_;
+	mutable std::mutex mutex_;
+	std::condition_variable released_;
+	// The total reservation of the items that have not yet settled.
+	std::uint64_t reserved_ = 0;
+	unsigned numInProgress_ = 0;
+	unsigned numWaits_ = 0;
+};
+
+} // namespace cal
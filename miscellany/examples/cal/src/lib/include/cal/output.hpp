@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstddef>
+#include <format>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <llvm/Support/raw_ostream.h>
+
+namespace cal {
+
+/****************************************************************************\
+Ordered Output
+\****************************************************************************/
+
+// A sink that writes the output of a sequence of units (e.g., translation
+// units) in the order of the units, even though the units are processed
+// concurrently (and so finish out of order).
+// The output of each unit is buffered (by an OutputScope) and handed to the
+// sink when the unit finishes.  Output is written as soon as the output of
+// all preceding units has been written.  A thread that finishes a unit only
+// holds the lock of the sink long enough to hand over its output: the
+// output is written by one thread at a time (namely, the thread that finds
+// the sink idle), without holding the lock, and the output of consecutive
+// units is coalesced into large writes.
+// So, the output of a run is the same regardless of the number of threads
+// and of the order in which the units finish.
+class OrderedOutput {
+public:
+	// The default size (in bytes) up to which the output of consecutive
+	// units is coalesced into a single write.
+	static constexpr std::size_t defaultBatchSize = 64 * 1024;
+
+	OrderedOutput(std::size_t numUnits, llvm::raw_ostream& out = llvm::outs(),
+	  llvm::raw_ostream& err = llvm::errs(),
+	  std::size_t batchSize = defaultBatchSize);
+	OrderedOutput(const OrderedOutput&) = delete;
+	OrderedOutput& operator=(const OrderedOutput&) = delete;
+	// Write the output of any units that were committed but are still
+	// waiting on a unit that was never committed (as by finish).
+	~OrderedOutput();
+
+	// Hand over the output of a unit (i.e., its standard output and error
+	// text).
+	// Each unit must be committed at most once.  This may be called
+	// concurrently from multiple threads.
+	void commit(std::size_t index, std::string out, std::string err);
+
+	// Write the output of all units that were committed (in order, skipping
+	// any units that were not committed).
+	// This must not be called concurrently with commit.
+	void finish();
+
+	// Get the number of writes (to either stream) so far.
+	std::size_t getNumWrites() const;
+
+private:
+	struct UnitOutput {
+		std::string out;
+		std::string err;
+	};
+	// Write the output of the units that are ready (i.e., that are not
+	// preceded by a unit that is not committed), if no other thread is
+	// doing so.
+	// The lock must be held on entry (and is held on exit).
+	void writeReady(std::unique_lock<std::mutex>& lock, bool skipMissing);
+
+	mutable std::mutex mutex_;
+	llvm::raw_ostream& out_;
+	llvm::raw_ostream& err_;
+	std::size_t batchSize_;
+	std::vector<std::optional<UnitOutput>> units_;
+	// The index of the next unit to be written.
+	std::size_t next_;
+	// Indicates if a thread is writing output.
+	bool writing_;
+	std::size_t numWrites_;
+};
+
+// The buffered output of one unit of an ordered output.
+// While a scope is alive, it is the current output scope of the thread
+// that created it, so that print, log, outs and errs (below) write to its
+// buffers rather than directly to the standard streams.  The output is
+// committed to the ordered output when the scope is destroyed.
+// Scopes may be nested (where the innermost one is current).
+class OutputScope {
+public:
+	OutputScope(OrderedOutput& output, std::size_t index);
+	OutputScope(const OutputScope&) = delete;
+	OutputScope& operator=(const OutputScope&) = delete;
+	~OutputScope();
+
+	// Get the streams that write to the buffers of the scope.
+	// NOTE: The streams are unbuffered (i.e., they write directly to the
+	// buffers), so they can be freely mixed with print and log.
+	llvm::raw_ostream& outs() {return outStream_;}
+	llvm::raw_ostream& errs() {return errStream_;}
+
+	// Get the buffers of the scope.
+	std::string& getOutBuffer() {return out_;}
+	std::string& getErrBuffer() {return err_;}
+
+	// Get the current output scope of the calling thread (or null if there
+	// is none).
+	static OutputScope* getCurrent();
+
+private:
+	OrderedOutput& output_;
+	std::size_t index_;
+	std::string out_;
+	std::string err_;
+	llvm::raw_string_ostream outStream_;
+	llvm::raw_string_ostream errStream_;
+	OutputScope* previous_;
+};
+
+/****************************************************************************\
+Formatted Output
+\****************************************************************************/
+
+// Get the stream for the standard output (or error) of the calling thread,
+// which is the corresponding buffer of the current output scope (if any)
+// and llvm::outs() (or llvm::errs()) otherwise.
+llvm::raw_ostream& outs();
+llvm::raw_ostream& errs();
+
+// Print to the standard output of the calling thread.
+// The format string is checked at compile time.  In an output scope, the
+// text is formatted directly into the buffer of the scope.
+template <class... Args>
+void print(std::format_string<Args...> fmt, Args&&... args)
+{
+	if (OutputScope* scope = OutputScope::getCurrent()) {
+		std::format_to(std::back_inserter(scope->getOutBuffer()), fmt,
+		  std::forward<Args>(args)...);
+	} else {
+		llvm::outs() << std::format(fmt, std::forward<Args>(args)...);
+	}
+}
+
+// Print to the standard error of the calling thread (as with print).
+template <class... Args>
+void log(std::format_string<Args...> fmt, Args&&... args)
+{
+	if (OutputScope* scope = OutputScope::getCurrent()) {
+		std::format_to(std::back_inserter(scope->getErrBuffer()), fmt,
+		  std::forward<Args>(args)...);
+	} else {
+		llvm::errs() << std::format(fmt, std::forward<Args>(args)...);
+	}
+}
+
+} // namespace cal
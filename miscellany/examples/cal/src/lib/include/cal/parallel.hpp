@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace cal {
+
+/****************************************************************************\
+Parallel Execution
+\****************************************************************************/
+
+// Get the default number of worker threads to use (i.e., the number of
+// hardware threads, or one if this cannot be determined).
+unsigned getDefaultConcurrency();
+
+// Invoke a function for each index in [0, count) using the specified
+// number of worker threads.
+// The function is passed the index and the number of the worker thread
+// (in [0, numThreads)) on which it is invoked.  The worker number can be
+// used to select per-thread state (e.g., a file system object).
+// Indices are handed out to workers in increasing order.
+// If a time trace was started, each worker thread other than the calling
+// thread is traced (as by TimeTraceThreadScope).
+// A number of threads of zero indicates the default concurrency.
+// The function must not throw.
+void parallelFor(std::size_t count, unsigned numThreads,
+  const std::function<void(std::size_t index, unsigned worker)>& func);
+
+// Invoke a function for each index in [0, costs.size()) using the
+// specified number of worker threads, where costs[i] is the estimated cost
+// (e.g., wall time) of index i.
+// This is like parallelFor except that the indices are scheduled so as to
+// minimize the overall time: the indices are dealt out to per-worker queues
+// costliest first (each to the least loaded worker), and a worker whose
+// queue runs dry steals the costliest remaining index from the queue of the
+// most loaded other worker.  So, long-running indices start early instead
+// of delaying the end of the run.
+void parallelForByCost(const std::vector<double>& costs, unsigned numThreads,
+  const std::function<void(std::size_t index, unsigned worker)>& func);
+
+} // namespace cal
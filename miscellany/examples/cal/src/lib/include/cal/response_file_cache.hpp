@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <clang/Tooling/CompilationDatabase.h>
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Chrono.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace cal {
+
+/****************************************************************************\
+Response-File Cache
+\****************************************************************************/
+
+// A thread-safe cache of tokenized response files.
+//
+// The tokens of a response file are keyed by the hash of its contents.
+// So, a response file that is referenced by many commands is tokenized
+// only once, and a response file is never served stale contents.
+// Within a process, the contents hash of a response file is also
+// remembered by path (and validated against the size and the
+// full-resolution modification time of the file), so that a response file
+// is read only once.
+// If a cache directory is specified, the tokens are also stored on disk,
+// so that they can be shared across runs.
+class ResponseFileCache {
+public:
+
+	struct Stats {
+		// The number of response-file references that were resolved.
+		std::uint64_t references;
+		// The number of times that a response file was read.
+		std::uint64_t reads;
+		// The number of times that a response file was tokenized.
+		std::uint64_t tokenizations;
+		// The number of times that tokens were loaded from disk.
+		std::uint64_t diskHits;
+	};
+
+	// Create a cache (that is persisted in the specified directory if the
+	// directory is not empty).
+	explicit ResponseFileCache(std::string directory = {});
+
+	// Get the tokens of a response file.
+	// Returns null if the file cannot be read.
+	std::shared_ptr<const std::vector<std::string>> getTokens(
+	  llvm::vfs::FileSystem& fileSys, llvm::StringRef path);
+
+	Stats getStats() const;
+	void printStats(llvm::raw_ostream& out) const;
+
+private:
+
+	struct PathEntry {
+		std::uint64_t size;
+		llvm::sys::TimePoint<> mtime;
+		std::string hash;
+	};
+
+	std::shared_ptr<const std::vector<std::string>> tokenize(
+	  llvm::StringRef hash, llvm::StringRef contents);
+
+	std::string directory_;
+	mutable std::mutex mutex_;
+	llvm::StringMap<PathEntry> paths_;
+	llvm::StringMap<std::shared_ptr<const std::vector<std::string>>> tokens_;
+	std::atomic<std::uint64_t> references_;
+	std::atomic<std::uint64_t> reads_;
+	std::atomic<std::uint64_t> tokenizations_;
+	std::atomic<std::uint64_t> diskHits_;
+};
+
+/****************************************************************************\
+Response-File-Expanding Compilation Database
+\****************************************************************************/
+
+// A compilation database that expands the response files (i.e., the
+// "@file" arguments) in the commands of another database using a
+// ResponseFileCache.
+// This is a drop-in replacement for clang::tooling::expandResponseFiles.
+// As with that function, a relative response-file path is resolved
+// relative to the directory of the command (or, for a nested reference,
+// the directory of the referencing response file), and an argument that
+// does not name a readable file is left unchanged.
+class ResponseFileExpandingDatabase :
+  public clang::tooling::CompilationDatabase {
+public:
+
+	// Create a database that owns the underlying database.
+	ResponseFileExpandingDatabase(
+	  std::unique_ptr<clang::tooling::CompilationDatabase> base,
+	  std::shared_ptr<ResponseFileCache> cache,
+	  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fileSys = nullptr);
+
+	// Create a database that refers to (but does not own) the underlying
+	// database.
+	ResponseFileExpandingDatabase(
+	  const clang::tooling::CompilationDatabase& base,
+	  std::shared_ptr<ResponseFileCache> cache,
+	  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fileSys = nullptr);
+
+	std::vector<clang::tooling::CompileCommand> getCompileCommands(
+	  llvm::StringRef filePath) const override;
+	std::vector<std::string> getAllFiles() const override;
+	std::vector<clang::tooling::CompileCommand> getAllCompileCommands()
+	  const override;
+
+private:
+
+	std::vector<clang::tooling::CompileCommand> expand(
+	  std::vector<clang::tooling::CompileCommand> commands) const;
+	void expandArgs(const std::vector<std::string>& args,
+	  llvm::StringRef directory, unsigned depth,
+	  std::vector<std::string>& result) const;
+
+	std::unique_ptr<clang::tooling::CompilationDatabase> owned_;
+	const clang::tooling::CompilationDatabase& base_;
+	std::shared_ptr<ResponseFileCache> cache_;
+	llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fileSys_;
+};
+
+} // namespace cal
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace cal {
+
+/****************************************************************************\
+Sharded Execution
+\****************************************************************************/
+
+// The options controlling the sharded execution of a tool.
+struct ShardOptions {
+	// The index of the shard to process (in [0, numShards)).
+	unsigned shardIndex = 0;
+	// The total number of shards.
+	unsigned numShards = 1;
+	// The directory in which the checkpoint journal and the per-file
+	// outputs are kept.  If empty, no checkpointing is performed and
+	// output is not captured.
+	std::string checkpointDir;
+	// A key identifying the configuration of the tool (e.g., a hash of the
+	// options that affect its output).  Files that were completed by an
+	// earlier run with a different configuration are processed again.
+	std::string configKey;
+};
+
+// Parse a shard specification of the form "i/n" (where 0 <= i < n).
+// Returns false if the specification is invalid.
+bool parseShardSpec(llvm::StringRef spec, unsigned& shardIndex,
+  unsigned& numShards);
+
+// Select the files that belong to the specified shard.
+// The assignment of a file to a shard depends only on the (normalized)
+// path of the file, so it does not change when other files are added to
+// or removed from the list.  The order of the files is preserved.
+std::vector<std::string> selectShardFiles(
+  const std::vector<std::string>& files, unsigned shardIndex,
+  unsigned numShards);
+
+// A journal that records the files that have been completely processed,
+// so that an interrupted run can be resumed.
+// Each record is tagged with the configuration key of the run that wrote
+// it, and records with a different key are ignored when loading.
+// The journal is an append-only file with one JSON object per line.
+// Each record is flushed to disk as soon as it is written, so at most the
+// file being processed is lost when a run is interrupted.  A partially
+// written (i.e., truncated) last record is ignored.
+class CheckpointJournal {
+public:
+
+	struct Entry {
+		// The status returned by the processing of the file.
+		int status;
+		// The path of the captured output (relative to the checkpoint
+		// directory).
+		std::string output;
+		// The data produced by the processing of the file (e.g.,
+		// serialized counters).
+		std::string data;
+	};
+
+	CheckpointJournal(std::string path, std::string configKey);
+	~CheckpointJournal();
+	CheckpointJournal(const CheckpointJournal&) = delete;
+	CheckpointJournal& operator=(const CheckpointJournal&) = delete;
+
+	// Read the records in the journal (if the journal exists).
+	llvm::Error load();
+
+	// Get the entry for a file (or null if the file has not been
+	// completed).
+	const Entry* find(llvm::StringRef file) const;
+
+	// Record the completion of a file.
+	llvm::Error add(llvm::StringRef file, Entry entry);
+
+	const llvm::StringMap<Entry>& getEntries() const {return entries_;}
+
+private:
+	std::string path_;
+	std::string configKey_;
+	llvm::StringMap<Entry> entries_;
+	int fd_;
+};
+
+// A task that processes a file of a shard.
+// The task may store data in its second argument, which is recorded in the
+// checkpoint journal with the file.  The return value is the
+// (nonzero-means-failure) status.
+using ShardTask = std::function<int(const std::string& file,
+  std::string& data)>;
+
+// A function that is invoked with the data recorded for a file that was
+// completed by an earlier run (so that the state that the task would have
+// updated, such as counters, can be restored).
+using ShardResumeCallback = std::function<void(const std::string& file,
+  llvm::StringRef data)>;
+
+// Process the files in a shard.
+// The task is invoked for each file in the shard that is not recorded as
+// complete in the checkpoint journal of the shard (if checkpointing is
+// enabled), and the resume callback (if any) is invoked for each file that
+// is.  While the task runs, the standard output of the process is captured
+// in a per-file output file, which is recorded in the journal once the
+// task returns.  Upon completion, the outputs of all files in the shard are
+// written to the standard output in order of (normalized) file path, as
+// by mergeShardOutputs.
+// Returns the logical OR of the (nonzero-means-failure) statuses for all
+// files in the shard (including those completed by earlier runs).
+int runShard(const ShardOptions& options,
+  const std::vector<std::string>& files, const ShardTask& task,
+  const ShardResumeCallback& onResume = nullptr);
+
+// Merge the outputs of all shards in a checkpoint directory (that were
+// produced with the specified configuration key).
+// The outputs are written in order of (normalized) file path, so the
+// result does not depend on the number of shards.
+llvm::Error mergeShardOutputs(const std::string& checkpointDir,
+  llvm::StringRef configKey, llvm::raw_ostream& out);
+
+} // namespace cal
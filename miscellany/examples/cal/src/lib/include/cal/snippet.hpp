@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <clang/Basic/SourceLocation.h>
+#include <clang/Basic/SourceManager.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace cal {
+
+/****************************************************************************\
+Source Snippets
+\****************************************************************************/
+
+// The options for rendering a source snippet.
+struct SnippetOptions {
+	// The line and column numbers of the first character of the text.
+	unsigned startLine = 1;
+	unsigned startColumn = 1;
+	// Indicates if each line is prefixed by its line number.
+	bool lineNumbers = true;
+	// The minimum width of the line numbers (which are otherwise just wide
+	// enough for the largest line number).
+	unsigned lineNumberWidth = 0;
+	// Indicates if the snippet is preceded by a header with the column
+	// numbers.
+	bool columnHeader = false;
+};
+
+// Get the offsets of the starts of the lines in a text (where the first
+// offset is always zero and a text ending in a newline has an empty last
+// line).
+std::vector<std::size_t> getLineOffsets(llvm::StringRef text);
+
+// Render a snippet of source text with line (and optionally column)
+// numbers, appending it to a string.
+// The first line is indented so that the columns of all lines line up
+// (relative to the smallest column of any character), and every line
+// (including the last one) is terminated by a newline.  An empty text is
+// rendered as "[empty text]".
+// The text is scanned for newlines once (with memchr) and the result is
+// reserved once, so this is suitable for rendering a snippet per match.
+void renderSnippet(std::string& result, llvm::StringRef text,
+  const SnippetOptions& options);
+std::string renderSnippet(llvm::StringRef text,
+  const SnippetOptions& options);
+void renderSnippet(llvm::raw_ostream& out, llvm::StringRef text,
+  const SnippetOptions& options);
+
+// Render the text of a (file) source range as a snippet, where the text is
+// taken directly from the buffer of the source manager (without copying)
+// and the starting line and column are those of the beginning of the
+// range (so the corresponding options are ignored).
+// Returns false (and renders nothing) if the text of the range is not
+// available (e.g., the range is in a macro expansion or spans files).
+bool renderSourceSnippet(llvm::raw_ostream& out,
+  const clang::SourceManager& sourceManager, clang::CharSourceRange range,
+  SnippetOptions options = {});
+
+// Render a snippet with optional line and column headers (which is the
+// same as renderSnippet).
+std::string addLineNumbers(llvm::StringRef source, unsigned int startLineNo,
+  unsigned int startColNo, bool lineHeader, bool columnHeader);
+
+} // namespace cal
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <clang/Basic/LangOptions.h>
+#include <clang/Basic/SourceLocation.h>
+#include <clang/Basic/SourceManager.h>
+#include <llvm/ADT/StringRef.h>
+
+namespace cal {
+
+/****************************************************************************\
+Source Text
+\****************************************************************************/
+
+// The outcome of getting the source text of a range.
+enum class SourceTextStatus {
+	// The text is valid.
+	ok,
+	// The range is invalid (or its buffer is unavailable).
+	invalid,
+	// The range involves a macro expansion (and macro ranges are rejected
+	// or cannot be mapped to a file range).
+	macro,
+	// The range begins and ends in different files.
+	spansFiles,
+};
+
+// How a range that involves a macro expansion is handled.
+enum class MacroRangePolicy {
+	// Reject the range.
+	reject,
+	// Use the text of the expansion (i.e., the macro invocation), if the
+	// range corresponds to a contiguous file range.
+	expansion,
+	// Use the spelling locations of the beginning and end of the range.
+	spelling,
+};
+
+// The source text of a range.
+struct SourceText {
+	// The text, which refers to a buffer of the source manager (and so is
+	// only valid as long as the source manager).
+	llvm::StringRef text;
+	SourceTextStatus status = SourceTextStatus::invalid;
+	explicit operator bool() const {return status == SourceTextStatus::ok;}
+};
+
+// Get the language options that are used when none are specified.
+// The options are constructed only once (rather than on every call).
+const clang::LangOptions& getDefaultLangOptions();
+
+// Get the source text of a range without copying it (i.e., as a view into
+// the buffer of the source manager).
+// For a token range, the text extends to the end of the last token (which
+// is found by lexing with the specified language options, or the default
+// ones if none are specified).
+SourceText getSourceText(const clang::SourceManager& sourceManager,
+  clang::CharSourceRange range, const clang::LangOptions* langOpts = nullptr,
+  MacroRangePolicy macroPolicy = MacroRangePolicy::reject);
+
+// Get the source text of a token range.
+inline SourceText getSourceText(const clang::SourceManager& sourceManager,
+  clang::SourceRange range, const clang::LangOptions* langOpts = nullptr,
+  MacroRangePolicy macroPolicy = MacroRangePolicy::reject)
+{
+	return getSourceText(sourceManager,
+	  clang::CharSourceRange::getTokenRange(range), langOpts, macroPolicy);
+}
+
+// Get a placeholder that describes why the source text of a range is not
+// available (such as "@@SOURCE::MACRO@@"), or the empty string for a valid
+// text.
+llvm::StringRef getSourceTextPlaceholder(SourceTextStatus status);
+
+// Get the source text of a range, or a placeholder if it is not available.
+inline llvm::StringRef getSourceTextOrPlaceholder(
+  const clang::SourceManager& sourceManager, clang::SourceRange range,
+  const clang::LangOptions* langOpts = nullptr,
+  MacroRangePolicy macroPolicy = MacroRangePolicy::reject)
+{
+	SourceText sourceText = getSourceText(sourceManager, range, langOpts,
+	  macroPolicy);
+	return sourceText ? sourceText.text :
+	  getSourceTextPlaceholder(sourceText.status);
+}
+
+} // namespace cal
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <clang/Frontend/CompilerInvocation.h>
+#include <clang/Frontend/FrontendAction.h>
+#include <clang/Tooling/ArgumentsAdjusters.h>
+#include <clang/Tooling/Tooling.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+
+namespace cal {
+
+/****************************************************************************\
+Time Tracing
+\****************************************************************************/
+
+// Time tracing records spans (e.g., llvm::TimeTraceScope objects, including
+// those created by Clang itself for parsing, template instantiation, and
+// so on) and writes them as a Chrome trace_event JSON file (which can be
+// viewed with chrome://tracing or Perfetto).
+// Each traced thread has its own track in the trace.
+
+// Start tracing on the calling thread (which should be the main thread).
+// Spans shorter than the granularity (in microseconds) are not recorded.
+void startTimeTrace(llvm::StringRef processName, unsigned granularity = 500);
+
+// Check if tracing was started (and has not yet been finished).
+bool isTimeTraceStarted();
+
+// Write the trace (i.e., the spans from the calling thread and from every
+// thread whose TimeTraceThreadScope has ended) to a file and stop tracing.
+// This must be called on the thread that started tracing after all other
+// traced threads have finished.
+llvm::Error finishTimeTrace(llvm::StringRef path);
+
+// An object that (if tracing was started) traces the calling thread, which
+// is given the specified name, for the lifetime of the object.
+// This is intended for worker threads (e.g., those of parallelFor).
+class TimeTraceThreadScope {
+public:
+	explicit TimeTraceThreadScope(llvm::StringRef threadName);
+	~TimeTraceThreadScope();
+	TimeTraceThreadScope(const TimeTraceThreadScope&) = delete;
+	TimeTraceThreadScope& operator=(const TimeTraceThreadScope&) = delete;
+private:
+	bool active_;
+};
+
+// Wrap an arguments adjuster so that each invocation is traced.
+clang::tooling::ArgumentsAdjuster traceArgumentsAdjuster(
+  clang::tooling::ArgumentsAdjuster adjuster);
+
+// A frontend-action factory that wraps the actions created by another
+// factory so that (while tracing) the phases of each translation unit are
+// traced.
+// The spans are:
+//   TranslationUnit: the whole invocation (with the main file as detail)
+//   ExecuteAction: parsing and semantic analysis (including the consumer)
+//   HandleTranslationUnit: the AST consumer (e.g., matching or visiting)
+// Since ClangTool calls runInvocation on the outermost factory only, this
+// factory must not itself be wrapped by another factory.
+class TimeTracingActionFactory :
+  public clang::tooling::FrontendActionFactory {
+public:
+	explicit TimeTracingActionFactory(
+	  clang::tooling::FrontendActionFactory& factory) : factory_(factory) {}
+	std::unique_ptr<clang::FrontendAction> create() override;
+	bool runInvocation(std::shared_ptr<clang::CompilerInvocation> invocation,
+	  clang::FileManager* fileManager,
+	  std::shared_ptr<clang::PCHContainerOperations> pchContainerOps,
+	  clang::DiagnosticConsumer* diagConsumer) override;
+private:
+	clang::tooling::FrontendActionFactory& factory_;
+};
+
+} // namespace cal
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Tooling/ArgumentsAdjusters.h>
+#include <clang/Tooling/CompilationDatabase.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace cal {
+
+/****************************************************************************\
+Translation-Unit Cache
+\****************************************************************************/
+
+// An in-memory cache of parsed translation units (i.e., ASTUnit objects)
+// for use by long-running processes (such as an analysis server).
+//
+// The first time that a translation unit is requested, it is parsed with
+// a precompiled preamble (i.e., the headers included at the start of the
+// main file are parsed once and saved).
+// Each subsequent request reparses the translation unit (so that any
+// changes to the source files are seen), which reuses the preamble as long
+// as the headers that it covers have not changed.
+// So, the cost of a repeated request is typically dominated by the parsing
+// of the main file (rather than its headers).
+//
+// A translation unit is keyed by its compile command.  At most the
+// specified number of translation units are kept, with the least-recently
+// used ones being discarded first.
+//
+// The cache is not thread safe.
+class TranslationUnitCache {
+public:
+
+	struct Stats {
+		// The number of translation units that were parsed from scratch.
+		std::uint64_t builds;
+		// The number of translation units that were reparsed.
+		std::uint64_t reparses;
+		// The number of translation units that were discarded.
+		std::uint64_t evictions;
+	};
+
+	// Create a cache holding at most maxUnits translation units.
+	// The arguments adjuster (if any) is applied to each compile command
+	// (after those that make the command suitable for parsing).
+	explicit TranslationUnitCache(std::size_t maxUnits = 16,
+	  clang::tooling::ArgumentsAdjuster adjuster = nullptr);
+	~TranslationUnitCache();
+	TranslationUnitCache(const TranslationUnitCache&) = delete;
+	TranslationUnitCache& operator=(const TranslationUnitCache&) = delete;
+
+	// Get an up-to-date AST for the specified compile command.
+	// The AST remains valid until the next call to get or clear.
+	// Returns null (and sets the error string) if the AST cannot be built.
+	clang::ASTUnit* get(const clang::tooling::CompileCommand& command,
+	  std::string& errString);
+
+	// Discard all cached translation units.
+	void clear();
+
+	std::size_t getNumUnits() const {return units_.size();}
+	Stats getStats() const;
+	void printStats(llvm::raw_ostream& out) const;
+
+private:
+
+	struct Unit {
+		std::string key;
+		std::unique_ptr<clang::ASTUnit> astUnit;
+	};
+
+	std::unique_ptr<clang::ASTUnit> build(
+	  const clang::tooling::CompileCommand& command, std::string& errString);
+
+	std::size_t maxUnits_;
+	clang::tooling::ArgumentsAdjuster adjuster_;
+	// The translation units in order of most-recent use.
+	std::list<Unit> units_;
+	llvm::StringMap<std::list<Unit>::iterator> index_;
+	std::uint64_t builds_;
+	std::uint64_t reparses_;
+	std::uint64_t evictions_;
+};
+
+} // namespace cal
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Decl.h>
+#include <clang/Frontend/FrontendAction.h>
+#include <clang/Tooling/Tooling.h>
+
+namespace cal {
+
+/****************************************************************************\
+Traversal Scope
+\****************************************************************************/
+
+// Get the top-level declarations of a translation unit that are in the
+// main file.
+// A declaration is considered to be in the main file if its location
+// (after macro expansion) is in the main file.
+std::vector<clang::Decl*> getMainFileTopLevelDecls(
+  clang::ASTContext& astContext);
+
+// Restrict the traversal scope of an AST context to the top-level
+// declarations in the main file.
+// The traversal scope is respected by MatchFinder::matchAST and
+// RecursiveASTVisitor::TraverseAST (but not by TraverseDecl on the
+// translation-unit declaration).
+// So, matches in (and visits of) headers are avoided without the headers
+// being walked at all.  For a tool that ignores what is in the headers
+// anyway (e.g., one that only reports the functions of the main file),
+// this saves the traversal of what is typically most of the translation
+// unit.
+// Note: Since the parent map of the AST context only covers the traversal
+// scope, a node in a header no longer has parents.
+void setMainFileTraversalScope(clang::ASTContext& astContext);
+
+// A frontend-action factory that wraps the actions created by another
+// factory so that the traversal scope is restricted to the main file (as
+// by setMainFileTraversalScope) before the AST consumer of the action
+// handles the translation unit.
+class MainFileScopeActionFactory :
+  public clang::tooling::FrontendActionFactory {
+public:
+	explicit MainFileScopeActionFactory(
+	  clang::tooling::FrontendActionFactory& factory) : factory_(factory) {}
+	std::unique_ptr<clang::FrontendAction> create() override;
+private:
+	clang::tooling::FrontendActionFactory& factory_;
+};
+
+} // namespace cal
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace cal {
+
+/****************************************************************************\
+Prefork Worker Pool
+\****************************************************************************/
+
+// The options controlling a prefork worker pool.
+struct WorkerPoolOptions {
+	// The number of worker processes (where zero means the default
+	// concurrency).
+	unsigned numWorkers = 0;
+	// The maximum number of times that an item is attempted.  An item whose
+	// worker crashes on every attempt is skipped.
+	unsigned maxAttempts = 2;
+};
+
+// The result of processing an item in a prefork worker pool.
+struct WorkerPoolResult {
+	// The status returned by the task (or one if the item was skipped).
+	int status = 0;
+	// The number of times that the item was attempted.
+	unsigned attempts = 0;
+	// Indicates if the item was skipped (because its worker crashed on
+	// every attempt).
+	bool skipped = false;
+	// A description of the last crash (if any), such as "signal 6
+	// (Aborted)".
+	std::string crash;
+	// The data produced by the task (e.g., serialized counters).
+	std::string data;
+};
+
+// A task that processes an item (e.g., a source file) in a worker process.
+// The task may store data to be returned to the parent in its second
+// argument.  The return value is the (nonzero-means-failure) status.
+using WorkerPoolTask = std::function<int(const std::string& item,
+  std::string& data)>;
+
+// Process items in a pool of worker processes that are forked from the
+// calling process (so that they share its state, such as parsed options,
+// a loaded compilation database, or warm caches, copy-on-write).
+// Each item is dispatched to an idle worker.  If a worker crashes (e.g.,
+// due to an assertion failure), the item that it was processing is
+// recorded and retried in a new worker (or skipped once the maximum number
+// of attempts is reached), and processing of the other items continues.
+// The standard output of the task for each item is captured and written
+// to the specified stream in the order of the items (as soon as all of the
+// preceding items are done).  The output of a crashed attempt is
+// discarded.  The standard error of the workers is not captured.
+// Since state changes made by a task are confined to its worker, anything
+// that the parent needs must be returned as data.
+// The calling process must not have other threads when this is called
+// (since only the calling thread is forked).
+llvm::Expected<std::vector<WorkerPoolResult>> runWorkerPool(
+  const std::vector<std::string>& items, const WorkerPoolOptions& options,
+  const WorkerPoolTask& task, llvm::raw_ostream& out);
+
+} // namespace cal
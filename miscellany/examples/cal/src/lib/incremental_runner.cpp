@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <clang/Basic/FileManager.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/FrontendAction.h>
+#include <clang/Frontend/Utils.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "cal/file_watcher.hpp"
+#include "cal/incremental_runner.hpp"
+#include "cal/utility.hpp"
+
+namespace cal {
+
+/****************************************************************************\
+Dependency Collection
+\****************************************************************************/
+
+namespace {
+
+class DependencyCollectingAction : public clang::WrapperFrontendAction {
+public:
+	DependencyCollectingAction(std::unique_ptr<clang::FrontendAction> action,
+	  std::vector<std::string>& dependencies) :
+	  clang::WrapperFrontendAction(std::move(action)),
+	  dependencies_(dependencies) {}
+protected:
+	bool BeginSourceFileAction(clang::CompilerInstance& compInstance)
+	  override
+	{
+		collector_ = std::make_shared<clang::DependencyCollector>();
+		collector_->attachToPreprocessor(compInstance.getPreprocessor());
+		return clang::WrapperFrontendAction::BeginSourceFileAction(
+		  compInstance);
+	}
+	void EndSourceFileAction() override
+	{
+		clang::WrapperFrontendAction::EndSourceFileAction();
+		// NOTE: The paths may be relative to the working directory of the
+		// compile command.
+		const clang::FileManager& fileManager =
+		  getCompilerInstance().getFileManager();
+		for (const auto& dependency : collector_->getDependencies()) {
+			llvm::SmallString<256> path(dependency);
+			fileManager.makeAbsolutePath(path);
+			dependencies_.push_back(getNormalizedPath(path));
+		}
+	}
+private:
+	std::vector<std::string>& dependencies_;
+	std::shared_ptr<clang::DependencyCollector> collector_;
+};
+
+} // namespace
+
+std::unique_ptr<clang::FrontendAction>
+  DependencyCollectingActionFactory::create()
+{
+	return std::make_unique<DependencyCollectingAction>(factory_.create(),
+	  dependencies_);
+}
+
+/****************************************************************************\
+Incremental Runner
+\****************************************************************************/
+
+IncrementalRunner::IncrementalRunner(std::vector<std::string> sourcePaths,
+  Analyzer analyzer) : sourcePaths_(std::move(sourcePaths)),
+  analyzer_(std::move(analyzer)), results_(sourcePaths_.size()) {}
+
+void IncrementalRunner::analyze(std::size_t index)
+{
+	UnitResult result = analyzer_(sourcePaths_[index]);
+	// NOTE: The source file is always a dependency (even if the analysis
+	// failed before it was read).
+	std::vector<std::string>& deps = result.dependencies;
+	deps.push_back(getNormalizedPath(sourcePaths_[index]));
+	std::sort(deps.begin(), deps.end());
+	deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+	results_[index] = std::move(result);
+}
+
+void IncrementalRunner::rebuildIndex()
+{
+	dependents_.clear();
+	for (std::size_t i = 0; i < results_.size(); ++i) {
+		for (const auto& dep : results_[i].dependencies) {
+			dependents_[dep].push_back(i);
+		}
+	}
+}
+
+void IncrementalRunner::runAll()
+{
+	auto startTime = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < sourcePaths_.size(); ++i) {
+		analyze(i);
+	}
+	rebuildIndex();
+	double time = std::chrono::duration<double>(
+	  std::chrono::steady_clock::now() - startTime).count();
+	lastUpdate_ = std::format("analyzed {} translation units in {:.3f} s",
+	  sourcePaths_.size(), time);
+}
+
+std::size_t IncrementalRunner::rerun(
+  const std::vector<std::string>& changedFiles)
+{
+	std::set<std::size_t> affected;
+	for (const auto& file : changedFiles) {
+		auto i = dependents_.find(file);
+		if (i != dependents_.end()) {
+			affected.insert(i->second.begin(), i->second.end());
+		}
+	}
+	if (affected.empty()) {
+		return 0;
+	}
+	auto startTime = std::chrono::steady_clock::now();
+	for (std::size_t index : affected) {
+		analyze(index);
+	}
+	rebuildIndex();
+	double time = std::chrono::duration<double>(
+	  std::chrono::steady_clock::now() - startTime).count();
+	lastUpdate_ = std::format("reanalyzed {} of {} translation units in "
+	  "{:.3f} s after changes to {} files", affected.size(),
+	  sourcePaths_.size(), time, changedFiles.size());
+	return affected.size();
+}
+
+std::vector<std::string> IncrementalRunner::getDependencies() const
+{
+	std::vector<std::string> files;
+	files.reserve(dependents_.size());
+	for (const auto& entry : dependents_) {
+		files.push_back(std::string(entry.first()));
+	}
+	std::sort(files.begin(), files.end());
+	return files;
+}
+
+int IncrementalRunner::getStatus() const
+{
+	for (const auto& result : results_) {
+		if (result.status) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void IncrementalRunner::printReport(llvm::raw_ostream& out) const
+{
+	if (out.is_displayed()) {
+		// Clear the screen and move the cursor to the top left.
+		out << "\033[H\033[2J";
+	}
+	std::size_t numFailed = 0;
+	for (std::size_t i = 0; i < sourcePaths_.size(); ++i) {
+		const UnitResult& result = results_[i];
+		out << std::format("{}\n==> {} <==\n", std::string(80, '='),
+		  sourcePaths_[i]) << result.output;
+		if (result.status) {
+			out << std::format("STATUS: {}\n", result.status);
+			++numFailed;
+		}
+	}
+	out << std::format("{}\n{}\n", std::string(80, '='), lastUpdate_)
+	  << std::format("failed translation units: {}\n", numFailed);
+	out.flush();
+}
+
+llvm::Error IncrementalRunner::watch(llvm::raw_ostream& out,
+  std::chrono::milliseconds settleTime)
+{
+	llvm::Expected<std::unique_ptr<FileWatcher>> watcher =
+	  FileWatcher::create();
+	if (!watcher) {
+		return watcher.takeError();
+	}
+	runAll();
+	printReport(out);
+	for (;;) {
+		if (llvm::Error error = (*watcher)->setFiles(getDependencies())) {
+			return error;
+		}
+		llvm::Expected<std::vector<std::string>> changedFiles =
+		  (*watcher)->waitForChanges(settleTime);
+		if (!changedFiles) {
+			return changedFiles.takeError();
+		}
+		if (rerun(*changedFiles)) {
+			printReport(out);
+		}
+	}
+}
+
+} // namespace cal
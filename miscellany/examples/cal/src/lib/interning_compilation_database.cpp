@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <clang/Tooling/CompilationDatabase.h>
+
+#include "cal/hash.hpp"
+#include "cal/interning_compilation_database.hpp"
+#include "cal/utility.hpp"
+
+namespace ct = clang::tooling;
+
+namespace cal {
+
+/****************************************************************************\
+Interning Compilation Database
+\****************************************************************************/
+
+namespace {
+
+// The placeholders for the file name and output in an argument vector.
+// NOTE: A command-line argument cannot contain a null character, so these
+// cannot be confused with a real argument.
+const llvm::StringRef filePlaceholder("\0file", 5);
+const llvm::StringRef outputPlaceholder("\0output", 7);
+
+// Hash an argument vector consisting of the argument vector with the
+// specified hash followed by the specified argument.
+std::uint64_t hashArg(std::uint64_t hash, llvm::StringRef arg)
+{
+	return fnv1aHash(llvm::StringRef("\0", 1), fnv1aHash(arg, hash));
+}
+
+} // namespace
+
+InterningCompilationDatabase::InterningCompilationDatabase(
+  const ct::CompilationDatabase& base)
+{
+	argNodes_.push_back({{}, noParent, noFlagSet, fnv1aHash({})});
+	for (const auto& command : base.getAllCompileCommands()) {
+		addCommand(command);
+	}
+}
+
+llvm::StringRef InterningCompilationDatabase::intern(llvm::StringRef s)
+{
+	return strings_.insert(s).first->getKey();
+}
+
+void InterningCompilationDatabase::addCommand(const ct::CompileCommand& command)
+{
+	Command record;
+	record.directory = intern(command.Directory);
+	record.file = intern(command.Filename);
+	record.output = intern(command.Output);
+
+	// Find (or add) the path through the argument trie for the arguments.
+	unsigned node = 0;
+	for (const auto& arg : command.CommandLine) {
+		llvm::StringRef internedArg =
+		  arg == command.Filename ? filePlaceholder :
+		  !command.Output.empty() && arg == command.Output ? outputPlaceholder :
+		  intern(arg);
+		auto [i, inserted] = argChildren_.try_emplace(
+		  std::make_pair(node, internedArg.data()), argNodes_.size());
+		if (inserted) {
+			argNodes_.push_back({internedArg, node, noFlagSet,
+			  hashArg(argNodes_[node].hash, internedArg)});
+		}
+		node = i->second;
+	}
+	record.argNode = node;
+
+	if (argNodes_[node].flagSet == noFlagSet) {
+		argNodes_[node].flagSet = flagSets_.size();
+		flagSets_.push_back({argNodes_[node].hash, {}});
+	}
+	record.flagSet = argNodes_[node].flagSet;
+	flagSets_[record.flagSet].commands.push_back(commands_.size());
+	fileCommands_[getNormalizedPath(command.Filename, command.Directory)]
+	  .push_back(commands_.size());
+	commands_.push_back(record);
+}
+
+ct::CompileCommand InterningCompilationDatabase::getCommand(unsigned index)
+  const
+{
+	const Command& record = commands_[index];
+	// Collect the arguments by walking from the last node to the root.
+	std::vector<std::string> commandLine;
+	for (unsigned node = record.argNode; node; node = argNodes_[node].parent) {
+		llvm::StringRef arg = argNodes_[node].arg;
+		if (arg.data() == filePlaceholder.data()) {
+			arg = record.file;
+		} else if (arg.data() == outputPlaceholder.data()) {
+			arg = record.output;
+		}
+		commandLine.emplace_back(arg);
+	}
+	std::reverse(commandLine.begin(), commandLine.end());
+	return ct::CompileCommand(record.directory, record.file,
+	  std::move(commandLine), record.output);
+}
+
+std::vector<ct::CompileCommand>
+  InterningCompilationDatabase::getCompileCommands(llvm::StringRef filePath)
+  const
+{
+	auto i = fileCommands_.find(getNormalizedPath(filePath));
+	if (i == fileCommands_.end()) {
+		return {};
+	}
+	std::vector<ct::CompileCommand> commands;
+	commands.reserve(i->second.size());
+	for (unsigned index : i->second) {
+		commands.push_back(getCommand(index));
+	}
+	return commands;
+}
+
+std::vector<std::string> InterningCompilationDatabase::getAllFiles() const
+{
+	std::vector<std::string> files;
+	files.reserve(fileCommands_.size());
+	for (const auto& entry : fileCommands_) {
+		files.emplace_back(entry.getKey());
+	}
+	std::sort(files.begin(), files.end());
+	return files;
+}
+
+std::vector<ct::CompileCommand>
+  InterningCompilationDatabase::getAllCompileCommands() const
+{
+	std::vector<ct::CompileCommand> commands;
+	commands.reserve(commands_.size());
+	for (unsigned i = 0; i < commands_.size(); ++i) {
+		commands.push_back(getCommand(i));
+	}
+	return commands;
+}
+
+} // namespace cal
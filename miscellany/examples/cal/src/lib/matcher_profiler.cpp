@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <clang/ASTMatchers/ASTMatchFinder.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/Timer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "cal/matcher_profiler.hpp"
+
+namespace cam = clang::ast_matchers;
+namespace json = llvm::json;
+
+namespace cal {
+
+/****************************************************************************\
+Matcher Profiler
+\****************************************************************************/
+
+MatcherProfiler::MatcherProfiler() : numUnits_(0), callbacks_(*this) {}
+
+cam::MatchFinder::MatchFinderOptions MatcherProfiler::getFinderOptions()
+{
+	cam::MatchFinder::MatchFinderOptions options;
+	options.CheckProfiling.emplace(records_);
+	return options;
+}
+
+void MatcherProfiler::collect()
+{
+	for (const auto& record : records_) {
+		Entry& entry = totals_[record.first()];
+		entry.time += record.second;
+		++entry.numUnits;
+	}
+	records_.clear();
+	++numUnits_;
+}
+
+std::vector<std::pair<std::string, MatcherProfiler::Entry>>
+  MatcherProfiler::getEntries() const
+{
+	std::vector<std::pair<std::string, Entry>> entries;
+	entries.reserve(totals_.size());
+	for (const auto& total : totals_) {
+		entries.emplace_back(std::string(total.first()), total.second);
+	}
+	std::sort(entries.begin(), entries.end(), [](const auto& a,
+	  const auto& b) {
+		if (a.second.time.getWallTime() != b.second.time.getWallTime()) {
+			return a.second.time.getWallTime() > b.second.time.getWallTime();
+		}
+		return a.first < b.first;
+	});
+	return entries;
+}
+
+void MatcherProfiler::printReport(llvm::raw_ostream& out) const
+{
+	std::vector<std::pair<std::string, Entry>> entries = getEntries();
+	double totalWallTime = 0.0;
+	for (const auto& [id, entry] : entries) {
+		totalWallTime += entry.time.getWallTime();
+	}
+	out << std::format("matcher profile ({} translation units):\n",
+	  numUnits_)
+	  << std::format("{:>10} {:>6} {:>10} {:>10} {:>6} {}\n", "wall (s)",
+	  "%", "user (s)", "sys (s)", "units", "callback");
+	for (const auto& [id, entry] : entries) {
+		double wallTime = entry.time.getWallTime();
+		out << std::format("{:10.6f} {:6.2f} {:10.6f} {:10.6f} {:6} {}\n",
+		  wallTime, totalWallTime > 0.0 ? 100.0 * wallTime / totalWallTime :
+		  0.0, entry.time.getUserTime(), entry.time.getSystemTime(),
+		  entry.numUnits, id);
+	}
+	out << std::format("{:10.6f} {:6.2f} {:>10} {:>10} {:>6} {}\n",
+	  totalWallTime, 100.0, "", "", "", "total");
+}
+
+json::Value MatcherProfiler::toJson() const
+{
+	json::Array callbacks;
+	for (const auto& [id, entry] : getEntries()) {
+		callbacks.push_back(json::Object{
+		  {"id", id},
+		  {"wall_time", entry.time.getWallTime()},
+		  {"user_time", entry.time.getUserTime()},
+		  {"system_time", entry.time.getSystemTime()},
+		  {"units", static_cast<std::int64_t>(entry.numUnits)},
+		});
+	}
+	return json::Object{
+	  {"units", static_cast<std::int64_t>(numUnits_)},
+	  {"callbacks", std::move(callbacks)},
+	};
+}
+
+llvm::Error MatcherProfiler::writeJson(llvm::StringRef path) const
+{
+	std::error_code ec;
+	llvm::raw_fd_ostream out(path, ec);
+	if (ec) {
+		return llvm::createStringError(ec, "cannot open %s",
+		  path.str().c_str());
+	}
+	out << llvm::formatv("{0:2}", toJson()) << '\n';
+	out.close();
+	if (out.has_error()) {
+		ec = out.error();
+		out.clear_error();
+		return llvm::createStringError(ec, "cannot write %s",
+		  path.str().c_str());
+	}
+	return llvm::Error::success();
+}
+
+} // namespace cal
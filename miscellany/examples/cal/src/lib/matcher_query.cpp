@@ -0,0 +1,205 @@
+#include <format>
+#include <memory>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <clang/ASTMatchers/ASTMatchersInternal.h>
+#include <clang/ASTMatchers/Dynamic/Diagnostics.h>
+#include <clang/ASTMatchers/Dynamic/Parser.h>
+#include <clang/ASTMatchers/Dynamic/VariantValue.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include "cal/matcher_query.hpp"
+
+namespace cam = clang::ast_matchers;
+namespace camd = clang::ast_matchers::dynamic;
+
+namespace cal {
+
+/****************************************************************************\
+Matcher Queries
+\****************************************************************************/
+
+namespace {
+
+llvm::Error makeQueryError(llvm::StringRef bufferName, unsigned lineNum,
+  const std::string& message)
+{
+	return llvm::createStringError(
+	  std::make_error_code(std::errc::invalid_argument), "%s",
+	  std::format("{}:{}: {}", std::string(bufferName), lineNum,
+	  message).c_str());
+}
+
+// Check that nothing other than whitespace (and comments) follows a parsed
+// expression.
+bool isTrailingTextEmpty(llvm::StringRef text)
+{
+	while (!(text = text.ltrim()).empty()) {
+		if (!text.starts_with("#")) {
+			return false;
+		}
+		text = text.drop_until([](char c) {return c == '\n';});
+	}
+	return true;
+}
+
+// Split off the first word of the text (where words are separated by
+// whitespace, including newlines).
+std::pair<llvm::StringRef, llvm::StringRef> splitWord(llvm::StringRef text)
+{
+	text = text.ltrim();
+	std::size_t pos = text.find_first_of(" \t\n");
+	return {text.substr(0, pos),
+	  pos != llvm::StringRef::npos ? text.substr(pos) : llvm::StringRef()};
+}
+
+} // namespace
+
+llvm::Expected<cam::internal::DynTypedMatcher> parseMatcherExpression(
+  llvm::StringRef code, llvm::StringRef bindId,
+  const camd::Parser::NamedValueMap* namedValues)
+{
+	// NOTE: The parser advances the code past the parsed expression.
+	llvm::StringRef remaining = code;
+	camd::Diagnostics diag;
+	std::optional<cam::internal::DynTypedMatcher> matcher =
+	  camd::Parser::parseMatcherExpression(remaining, nullptr, namedValues,
+	  &diag);
+	if (!matcher) {
+		return llvm::createStringError(
+		  std::make_error_code(std::errc::invalid_argument), "%s",
+		  diag.toStringFull().c_str());
+	}
+	if (!isTrailingTextEmpty(remaining)) {
+		return llvm::createStringError(
+		  std::make_error_code(std::errc::invalid_argument),
+		  "unexpected text after matcher: %s",
+		  remaining.trim().str().c_str());
+	}
+	if (!bindId.empty()) {
+		std::optional<cam::internal::DynTypedMatcher> boundMatcher =
+		  matcher->tryBind(bindId);
+		if (!boundMatcher) {
+			return llvm::createStringError(
+			  std::make_error_code(std::errc::invalid_argument),
+			  "matcher cannot be bound");
+		}
+		return *boundMatcher;
+	}
+	return *matcher;
+}
+
+llvm::Expected<std::vector<MatcherQuery>> parseMatcherQueries(
+  llvm::StringRef text, llvm::StringRef bufferName, llvm::StringRef bindId)
+{
+	std::vector<MatcherQuery> queries;
+	llvm::StringSet<> queryNames;
+	camd::Parser::NamedValueMap namedValues;
+
+	// The statement currently being accumulated (which may span several
+	// lines).
+	unsigned stmtLineNum = 0;
+	std::string stmt;
+
+	auto processStmt = [&]() -> llvm::Error {
+		if (stmt.empty()) {
+			return llvm::Error::success();
+		}
+		llvm::StringRef rest(stmt);
+		llvm::StringRef keyword;
+		llvm::StringRef name;
+		std::tie(keyword, rest) = splitWord(rest);
+		std::tie(name, rest) = splitWord(rest);
+		if (keyword != "query" && keyword != "let") {
+			return makeQueryError(bufferName, stmtLineNum,
+			  std::format("unknown statement {}", std::string(keyword)));
+		}
+		if (name.empty() || rest.trim().empty()) {
+			return makeQueryError(bufferName, stmtLineNum,
+			  std::format("expected {} <name> <expression>",
+			  std::string(keyword)));
+		}
+		if (keyword == "let") {
+			llvm::StringRef code = rest;
+			camd::Diagnostics diag;
+			camd::VariantValue value;
+			if (!camd::Parser::parseExpression(code, nullptr, &namedValues,
+			  &value, &diag)) {
+				return makeQueryError(bufferName, stmtLineNum,
+				  std::format("in value {}: {}", std::string(name),
+				  diag.toStringFull()));
+			}
+			if (!isTrailingTextEmpty(code)) {
+				return makeQueryError(bufferName, stmtLineNum,
+				  std::format("in value {}: unexpected text after "
+				  "expression", std::string(name)));
+			}
+			namedValues[name] = value;
+			return llvm::Error::success();
+		}
+		if (!queryNames.insert(name).second) {
+			return makeQueryError(bufferName, stmtLineNum,
+			  std::format("duplicate query {}", std::string(name)));
+		}
+		llvm::Expected<cam::internal::DynTypedMatcher> matcher =
+		  parseMatcherExpression(rest, bindId, &namedValues);
+		if (!matcher) {
+			return makeQueryError(bufferName, stmtLineNum,
+			  std::format("in query {}: {}", std::string(name),
+			  llvm::toString(matcher.takeError())));
+		}
+		queries.push_back(MatcherQuery{std::string(name),
+		  std::move(*matcher)});
+		return llvm::Error::success();
+	};
+
+	unsigned lineNum = 0;
+	while (!text.empty()) {
+		llvm::StringRef line;
+		std::tie(line, text) = text.split('\n');
+		++lineNum;
+		llvm::StringRef trimmedLine = line.trim();
+		if (trimmedLine.empty() || trimmedLine.starts_with("#")) {
+			continue;
+		}
+		if (line.front() == ' ' || line.front() == '\t') {
+			if (stmt.empty()) {
+				return makeQueryError(bufferName, lineNum,
+				  "continuation line without statement");
+			}
+			(stmt += '\n') += trimmedLine;
+			continue;
+		}
+		if (llvm::Error error = processStmt()) {
+			return std::move(error);
+		}
+		stmtLineNum = lineNum;
+		stmt = std::string(trimmedLine);
+	}
+	if (llvm::Error error = processStmt()) {
+		return std::move(error);
+	}
+	return queries;
+}
+
+llvm::Expected<std::vector<MatcherQuery>> loadMatcherQueries(
+  llvm::StringRef path, llvm::StringRef bindId)
+{
+	llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+	  llvm::MemoryBuffer::getFile(path);
+	if (!buffer) {
+		return llvm::createStringError(buffer.getError(), "cannot read %s",
+		  path.str().c_str());
+	}
+	return parseMatcherQueries((*buffer)->getBuffer(), path, bindId);
+}
+
+} // namespace cal
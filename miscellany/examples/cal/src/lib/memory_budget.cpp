@@ -0,0 +1,127 @@
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+#include <llvm/ADT/StringRef.h>
+
+#include "cal/cost_history.hpp"
+#include "cal/memory_budget.hpp"
+
+namespace cal {
+
+/****************************************************************************\
+Memory Budget
+\****************************************************************************/
+
+std::optional<std::uint64_t> parseMemorySize(llvm::StringRef text)
+{
+	text = text.trim();
+	std::uint64_t value = 0;
+	if (text.consumeInteger(10, value)) {
+		return std::nullopt;
+	}
+	if (!text.consume_back_insensitive("ib")) {
+		text.consume_back_insensitive("b");
+	}
+	unsigned shift = 0;
+	if (text.size() == 1) {
+		switch (text.front()) {
+		case 'K': case 'k': shift = 10; break;
+		case 'M': case 'm': shift = 20; break;
+		case 'G': case 'g': shift = 30; break;
+		case 'T': case 't': shift = 40; break;
+		default: return std::nullopt;
+		}
+	} else if (!text.empty()) {
+		return std::nullopt;
+	}
+	if (value > (std::numeric_limits<std::uint64_t>::max() >> shift)) {
+		return std::nullopt;
+	}
+	return value << shift;
+}
+
+MemoryBudget::Ticket::Ticket(Ticket&& other) :
+  budget_(std::exchange(other.budget_, nullptr)),
+  reservation_(std::exchange(other.reservation_, 0)) {}
+
+MemoryBudget::Ticket& MemoryBudget::Ticket::operator=(Ticket&& other)
+{
+	if (this != &other) {
+		release();
+		budget_ = std::exchange(other.budget_, nullptr);
+		reservation_ = std::exchange(other.reservation_, 0);
+	}
+	return *this;
+}
+
+MemoryBudget::Ticket::~Ticket()
+{
+	release();
+}
+
+void MemoryBudget::Ticket::settle()
+{
+	if (budget_) {
+		budget_->settle(*this);
+	}
+}
+
+void MemoryBudget::Ticket::release()
+{
+	if (budget_) {
+		budget_->release(*this);
+		budget_ = nullptr;
+		reservation_ = 0;
+	}
+}
+
+MemoryBudget::MemoryBudget(std::uint64_t limit) : limit_(limit) {}
+
+MemoryBudget::Ticket MemoryBudget::admit(std::uint64_t estimate)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	// NOTE: The resident set size is sampled each time admission is
+	// checked, so that memory freed by finished items is accounted for.
+	auto fits = [&]() {
+		return !limit_ || !numInProgress_ ||
+		  getResidentSetSize() + reserved_ + estimate <= limit_;
+	};
+	if (!fits()) {
+		++numWaits_;
+		released_.wait(lock, fits);
+	}
+	++numInProgress_;
+	reserved_ += estimate;
+	return Ticket(this, estimate);
+}
+
+unsigned MemoryBudget::getNumWaits() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return numWaits_;
+}
+
+void MemoryBudget::settle(Ticket& ticket)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		reserved_ -= ticket.reservation_;
+		ticket.reservation_ = 0;
+	}
+	released_.notify_all();
+}
+
+void MemoryBudget::release(Ticket& ticket)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		reserved_ -= ticket.reservation_;
+		--numInProgress_;
+	}
+	released_.notify_all();
+}
+
+} // namespace cal
@@ -0,0 +1,149 @@
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <llvm/Support/raw_ostream.h>
+
+#include "cal/output.hpp"
+
+namespace cal {
+
+/****************************************************************************\
+Helper Functions
+\****************************************************************************/
+
+namespace {
+
+// The current output scope of each thread.
+thread_local OutputScope* currentScope = nullptr;
+
+// Append text to a batch (moving rather than copying it into an empty
+// batch).
+void appendToBatch(std::string& batch, std::string& text)
+{
+	if (batch.empty()) {
+		batch = std::move(text);
+	} else {
+		batch += text;
+	}
+}
+
+} // namespace
+
+/****************************************************************************\
+Ordered Output
+\****************************************************************************/
+
+OrderedOutput::OrderedOutput(std::size_t numUnits, llvm::raw_ostream& out,
+  llvm::raw_ostream& err, std::size_t batchSize) :
+  out_(out), err_(err), batchSize_(batchSize), units_(numUnits), next_(0),
+  writing_(false), numWrites_(0)
+{
+}
+
+OrderedOutput::~OrderedOutput()
+{
+	finish();
+}
+
+void OrderedOutput::commit(std::size_t index, std::string out,
+  std::string err)
+{
+	std::unique_lock lock(mutex_);
+	units_[index] = UnitOutput{std::move(out), std::move(err)};
+	writeReady(lock, false);
+}
+
+void OrderedOutput::finish()
+{
+	std::unique_lock lock(mutex_);
+	writeReady(lock, true);
+}
+
+std::size_t OrderedOutput::getNumWrites() const
+{
+	std::scoped_lock lock(mutex_);
+	return numWrites_;
+}
+
+void OrderedOutput::writeReady(std::unique_lock<std::mutex>& lock,
+  bool skipMissing)
+{
+	// NOTE: The thread that is writing also writes any units that become
+	// ready while it is doing so.
+	if (writing_) {
+		return;
+	}
+	writing_ = true;
+	auto isReady = [&]() {
+		return next_ < units_.size() && (units_[next_] || skipMissing);
+	};
+	while (isReady()) {
+		// Coalesce the output of consecutive ready units into batches.
+		std::string outBatch;
+		std::string errBatch;
+		while (isReady() && outBatch.size() < batchSize_ &&
+		  errBatch.size() < batchSize_) {
+			if (std::optional<UnitOutput>& unit = units_[next_]) {
+				appendToBatch(outBatch, unit->out);
+				appendToBatch(errBatch, unit->err);
+				// NOTE: The output is released as soon as it is batched,
+				// so only the output waiting on a predecessor is held.
+				unit.reset();
+			}
+			++next_;
+		}
+		lock.unlock();
+		if (!errBatch.empty()) {
+			err_.write(errBatch.data(), errBatch.size());
+			err_.flush();
+		}
+		if (!outBatch.empty()) {
+			out_.write(outBatch.data(), outBatch.size());
+			out_.flush();
+		}
+		lock.lock();
+		numWrites_ += !errBatch.empty() + !outBatch.empty();
+	}
+	writing_ = false;
+}
+
+/****************************************************************************\
+Output Scopes
+\****************************************************************************/
+
+OutputScope::OutputScope(OrderedOutput& output, std::size_t index) :
+  output_(output), index_(index), outStream_(out_), errStream_(err_),
+  previous_(currentScope)
+{
+	currentScope = this;
+}
+
+OutputScope::~OutputScope()
+{
+	currentScope = previous_;
+	output_.commit(index_, std::move(out_), std::move(err_));
+}
+
+OutputScope* OutputScope::getCurrent()
+{
+	return currentScope;
+}
+
+/****************************************************************************\
+Formatted Output
+\****************************************************************************/
+
+llvm::raw_ostream& outs()
+{
+	return currentScope ? currentScope->outs() : llvm::outs();
+}
+
+llvm::raw_ostream& errs()
+{
+	return currentScope ? currentScope->errs() : llvm::errs();
+}
+
+} // namespace cal
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <format>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "cal/parallel.hpp"
+#include "cal/time_trace.hpp"
+
+namespace cal {
+
+/****************************************************************************\
+Helper Functions
+\****************************************************************************/
+
+namespace {
+
+// Invoke a function on the specified number of worker threads (where the
+// calling thread acts as worker zero) and wait for all of them to finish.
+void runWorkers(unsigned numThreads,
+  const std::function<void(unsigned worker)>& work)
+{
+	std::vector<std::thread> threads;
+	threads.reserve(numThreads - 1);
+	for (unsigned worker = 1; worker < numThreads; ++worker) {
+		threads.emplace_back([&work, worker]() {
+			// Give each worker its own track in the time trace (if any).
+			TimeTraceThreadScope traceScope(std::format("worker {}",
+			  worker));
+			work(worker);
+		});
+	}
+	work(0);
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+// The queue of indices of a worker (for cost-based scheduling).
+struct WorkQueue {
+	std::mutex mutex;
+	// The indices in order of decreasing cost.
+	std::deque<std::size_t> indices;
+	// The total cost of the indices.
+	double load = 0;
+};
+
+} // namespace
+
+/****************************************************************************\
+Parallel Execution
+\****************************************************************************/
+
+unsigned getDefaultConcurrency()
+{
+	return std::max(std::thread::hardware_concurrency(), 1U);
+}
+
+void parallelFor(std::size_t count, unsigned numThreads,
+  const std::function<void(std::size_t index, unsigned worker)>& func)
+{
+	if (!numThreads) {
+		numThreads = getDefaultConcurrency();
+	}
+	numThreads = static_cast<unsigned>(std::min<std::size_t>(numThreads,
+	  count));
+	if (numThreads <= 1) {
+		for (std::size_t i = 0; i < count; ++i) {
+			func(i, 0);
+		}
+		return;
+	}
+	std::atomic<std::size_t> next(0);
+	auto work = [&](unsigned worker) {
+		for (;;) {
+			std::size_t i = next++;
+			if (i >= count) {
+				break;
+			}
+			func(i, worker);
+		}
+	};
+	runWorkers(numThreads, work);
+}
+
+void parallelForByCost(const std::vector<double>& costs, unsigned numThreads,
+  const std::function<void(std::size_t index, unsigned worker)>& func)
+{
+	std::size_t count = costs.size();
+	if (!numThreads) {
+		numThreads = getDefaultConcurrency();
+	}
+	numThreads = static_cast<unsigned>(std::min<std::size_t>(numThreads,
+	  count));
+	std::vector<std::size_t> order(count);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(),
+	  [&costs](std::size_t i, std::size_t j) {
+		return costs[i] > costs[j];
+	});
+	if (numThreads <= 1) {
+		for (std::size_t i : order) {
+			func(i, 0);
+		}
+		return;
+	}
+
+	// Deal out the indices costliest first, each to the least loaded worker
+	// (i.e., the longest-processing-time-first rule).
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	queues.reserve(numThreads);
+	for (unsigned worker = 0; worker < numThreads; ++worker) {
+		queues.push_back(std::make_unique<WorkQueue>());
+	}
+	for (std::size_t i : order) {
+		WorkQueue& queue = **std::min_element(queues.begin(), queues.end(),
+		  [](const auto& a, const auto& b) {
+			return a->load < b->load;
+		});
+		queue.indices.push_back(i);
+		queue.load += costs[i];
+	}
+
+	// Take the costliest index from a queue (if any).
+	auto take = [&costs](WorkQueue& queue, std::size_t& index) {
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.indices.empty()) {
+			return false;
+		}
+		index = queue.indices.front();
+		queue.indices.pop_front();
+		queue.load -= costs[index];
+		return true;
+	};
+	// Steal the costliest index from the most loaded queue of another worker
+	// (if any).
+	auto steal = [&](unsigned worker, std::size_t& index) {
+		for (;;) {
+			WorkQueue* victim = nullptr;
+			double maxLoad = -1;
+			bool found = false;
+			for (unsigned other = 0; other < numThreads; ++other) {
+				if (other == worker) {
+					continue;
+				}
+				std::lock_guard<std::mutex> lock(queues[other]->mutex);
+				if (queues[other]->indices.empty()) {
+					continue;
+				}
+				found = true;
+				if (queues[other]->load > maxLoad) {
+					maxLoad = queues[other]->load;
+					victim = queues[other].get();
+				}
+			}
+			if (!found) {
+				return false;
+			}
+			// NOTE: The victim may have been emptied in the meantime, in
+			// which case another victim is chosen.
+			if (take(*victim, index)) {
+				return true;
+			}
+		}
+	};
+	auto work = [&](unsigned worker) {
+		std::size_t i;
+		while (take(*queues[worker], i) || steal(worker, i)) {
+			func(i, worker);
+		}
+	};
+	runWorkers(numThreads, work);
+}
+
+} // namespace cal
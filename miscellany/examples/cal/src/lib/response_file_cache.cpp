@@ -0,0 +1,288 @@
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <clang/Tooling/CompilationDatabase.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Support/Allocator.h>
+#include <llvm/Support/Chrono.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/StringSaver.h>
+#include <llvm/TargetParser/Host.h>
+#include <llvm/TargetParser/Triple.h>
+
+#include "cal/hash.hpp"
+#include "cal/response_file_cache.hpp"
+
+namespace ct = clang::tooling;
+namespace vfs = llvm::vfs;
+
+namespace cal {
+
+/****************************************************************************\
+Response-File Cache
+\****************************************************************************/
+
+namespace {
+
+// The maximum nesting depth of response files (which guards against
+// cycles).
+constexpr unsigned maxResponseFileDepth = 32;
+
+std::string getTokensPath(llvm::StringRef directory, llvm::StringRef hash)
+{
+	llvm::SmallString<256> path(directory);
+	llvm::sys::path::append(path, hash.substr(0, 2), hash + ".tokens");
+	return std::string(path);
+}
+
+// NOTE: The tokens are stored on disk separated by null characters, which
+// cannot occur in a command-line argument.
+std::shared_ptr<std::vector<std::string>> readTokensFile(
+  const std::string& path)
+{
+	auto buffer = llvm::MemoryBuffer::getFile(path, false, false);
+	if (!buffer) {
+		return nullptr;
+	}
+	auto tokens = std::make_shared<std::vector<std::string>>();
+	llvm::SmallVector<llvm::StringRef> parts;
+	(*buffer)->getBuffer().split(parts, '\0', -1, true);
+	// The file ends with a separator, so the last part is empty.
+	if (parts.empty() || !parts.back().empty()) {
+		return nullptr;
+	}
+	parts.pop_back();
+	tokens->assign(parts.begin(), parts.end());
+	return tokens;
+}
+
+void writeTokensFile(const std::string& path,
+  const std::vector<std::string>& tokens)
+{
+	llvm::sys::fs::create_directories(llvm::sys::path::parent_path(path));
+	llvm::SmallString<256> tempPath;
+	llvm::sys::fs::createUniquePath(path + ".tmp-%%%%%%%%", tempPath, false);
+	{
+		std::error_code ec;
+		llvm::raw_fd_ostream out(tempPath, ec);
+		if (ec) {
+			return;
+		}
+		for (const auto& token : tokens) {
+			out << token << '\0';
+		}
+		out.close();
+		if (out.has_error()) {
+			out.clear_error();
+			llvm::sys::fs::remove(tempPath);
+			return;
+		}
+	}
+	// NOTE: The file is renamed into place, so that a concurrent reader
+	// never sees a partially written file.
+	if (llvm::sys::fs::rename(tempPath, path)) {
+		llvm::sys::fs::remove(tempPath);
+	}
+}
+
+} // namespace
+
+ResponseFileCache::ResponseFileCache(std::string directory) :
+  directory_(std::move(directory)), references_(0), reads_(0),
+  tokenizations_(0), diskHits_(0) {}
+
+std::shared_ptr<const std::vector<std::string>> ResponseFileCache::getTokens(
+  vfs::FileSystem& fileSys, llvm::StringRef path)
+{
+	++references_;
+	llvm::ErrorOr<vfs::Status> status = fileSys.status(path);
+	if (!status || !status->isRegularFile()) {
+		return nullptr;
+	}
+	std::uint64_t size = status->getSize();
+	// NOTE: The modification time is compared at full resolution (rather
+	// than in seconds), so that a file rewritten with the same size within
+	// the same second is not served stale tokens.
+	llvm::sys::TimePoint<> mtime = status->getLastModificationTime();
+	{
+		std::scoped_lock lock(mutex_);
+		auto i = paths_.find(path);
+		if (i != paths_.end() && i->second.size == size &&
+		  i->second.mtime == mtime) {
+			auto j = tokens_.find(i->second.hash);
+			if (j != tokens_.end()) {
+				return j->second;
+			}
+		}
+	}
+
+	auto buffer = fileSys.getBufferForFile(path, -1, false);
+	if (!buffer) {
+		return nullptr;
+	}
+	++reads_;
+	llvm::StringRef contents = (*buffer)->getBuffer();
+	std::string hash = hashString(contents);
+	std::shared_ptr<const std::vector<std::string>> tokens =
+	  tokenize(hash, contents);
+	std::scoped_lock lock(mutex_);
+	paths_[path] = {size, mtime, hash};
+	return tokens;
+}
+
+std::shared_ptr<const std::vector<std::string>> ResponseFileCache::tokenize(
+  llvm::StringRef hash, llvm::StringRef contents)
+{
+	{
+		std::scoped_lock lock(mutex_);
+		auto i = tokens_.find(hash);
+		if (i != tokens_.end()) {
+			return i->second;
+		}
+	}
+
+	std::shared_ptr<std::vector<std::string>> tokens;
+	std::string tokensPath;
+	if (!directory_.empty()) {
+		tokensPath = getTokensPath(directory_, hash);
+		tokens = readTokensFile(tokensPath);
+		if (tokens) {
+			++diskHits_;
+		}
+	}
+	if (!tokens) {
+		++tokenizations_;
+		// NOTE: As for clang::tooling::expandResponseFiles, the syntax of a
+		// response file depends on the host.
+		llvm::BumpPtrAllocator allocator;
+		llvm::StringSaver saver(allocator);
+		llvm::SmallVector<const char*> argv;
+		if (llvm::Triple(llvm::sys::getProcessTriple()).isOSWindows()) {
+			llvm::cl::TokenizeWindowsCommandLine(contents, saver, argv);
+		} else {
+			llvm::cl::TokenizeGNUCommandLine(contents, saver, argv);
+		}
+		tokens = std::make_shared<std::vector<std::string>>(argv.begin(),
+		  argv.end());
+		if (!tokensPath.empty()) {
+			writeTokensFile(tokensPath, *tokens);
+		}
+	}
+
+	std::scoped_lock lock(mutex_);
+	// NOTE: If another thread tokenized the same contents in the meantime,
+	// its tokens are used (so that all users share one copy).
+	return tokens_.try_emplace(hash, std::move(tokens)).first->second;
+}
+
+ResponseFileCache::Stats ResponseFileCache::getStats() const
+{
+	return {
+		.references = references_.load(),
+		.reads = reads_.load(),
+		.tokenizations = tokenizations_.load(),
+		.diskHits = diskHits_.load(),
+	};
+}
+
+void ResponseFileCache::printStats(llvm::raw_ostream& out) const
+{
+	Stats stats = getStats();
+	out << std::format("response file references: {}\n", stats.references)
+	  << std::format("response file reads: {}\n", stats.reads)
+	  << std::format("response file tokenizations: {}\n",
+	  stats.tokenizations)
+	  << std::format("response file disk cache hits: {}\n", stats.diskHits);
+}
+
+/****************************************************************************\
+Response-File-Expanding Compilation Database
+\****************************************************************************/
+
+ResponseFileExpandingDatabase::ResponseFileExpandingDatabase(
+  std::unique_ptr<ct::CompilationDatabase> base,
+  std::shared_ptr<ResponseFileCache> cache,
+  llvm::IntrusiveRefCntPtr<vfs::FileSystem> fileSys) :
+  ResponseFileExpandingDatabase(*base, std::move(cache), std::move(fileSys))
+{
+	owned_ = std::move(base);
+}
+
+ResponseFileExpandingDatabase::ResponseFileExpandingDatabase(
+  const ct::CompilationDatabase& base,
+  std::shared_ptr<ResponseFileCache> cache,
+  llvm::IntrusiveRefCntPtr<vfs::FileSystem> fileSys) :
+  base_(base), cache_(std::move(cache)), fileSys_(std::move(fileSys))
+{
+	if (!cache_) {
+		cache_ = std::make_shared<ResponseFileCache>();
+	}
+	if (!fileSys_) {
+		fileSys_ = vfs::createPhysicalFileSystem();
+	}
+}
+
+void ResponseFileExpandingDatabase::expandArgs(
+  const std::vector<std::string>& args, llvm::StringRef directory,
+  unsigned depth, std::vector<std::string>& result) const
+{
+	for (const auto& arg : args) {
+		if (arg.size() < 2 || arg[0] != '@' || depth >= maxResponseFileDepth) {
+			result.push_back(arg);
+			continue;
+		}
+		llvm::SmallString<256> path(llvm::StringRef(arg).drop_front());
+		if (llvm::sys::path::is_relative(path)) {
+			llvm::sys::fs::make_absolute(directory, path);
+		}
+		std::shared_ptr<const std::vector<std::string>> tokens =
+		  cache_->getTokens(*fileSys_, path);
+		if (!tokens) {
+			result.push_back(arg);
+			continue;
+		}
+		expandArgs(*tokens, llvm::sys::path::parent_path(path), depth + 1,
+		  result);
+	}
+}
+
+std::vector<ct::CompileCommand> ResponseFileExpandingDatabase::expand(
+  std::vector<ct::CompileCommand> commands) const
+{
+	for (auto& command : commands) {
+		std::vector<std::string> commandLine;
+		commandLine.reserve(command.CommandLine.size());
+		expandArgs(command.CommandLine, command.Directory, 0, commandLine);
+		command.CommandLine = std::move(commandLine);
+	}
+	return commands;
+}
+
+std::vector<ct::CompileCommand>
+  ResponseFileExpandingDatabase::getCompileCommands(llvm::StringRef filePath)
+  const
+{
+	return expand(base_.getCompileCommands(filePath));
+}
+
+std::vector<std::string> ResponseFileExpandingDatabase::getAllFiles() const
+{
+	return base_.getAllFiles();
+}
+
+std::vector<ct::CompileCommand>
+  ResponseFileExpandingDatabase::getAllCompileCommands() const
+{
+	return expand(base_.getAllCompileCommands());
+}
+
+} // namespace cal
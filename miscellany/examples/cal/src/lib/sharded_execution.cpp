@@ -0,0 +1,392 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+
+#include "cal/hash.hpp"
+#include "cal/sharded_execution.hpp"
+#include "cal/utility.hpp"
+
+namespace json = llvm::json;
+
+namespace cal {
+
+/****************************************************************************\
+Helper Functions
+\****************************************************************************/
+
+namespace {
+
+std::error_code getErrnoCode()
+{
+	return std::error_code(errno, std::generic_category());
+}
+
+std::string getJournalPath(const ShardOptions& options)
+{
+	llvm::SmallString<256> path(options.checkpointDir);
+	llvm::sys::path::append(path, std::format("shard-{}-of-{}.journal",
+	  options.shardIndex, options.numShards));
+	return std::string(path);
+}
+
+// Get the path (relative to the checkpoint directory) of the captured
+// output for a file.
+// NOTE: The path depends on the configuration key, so that the output of
+// a run with one configuration does not replace that of another.
+std::string getOutputPath(llvm::StringRef file, llvm::StringRef configKey)
+{
+	std::string key = Hasher().add(file).add(configKey).finalize();
+	llvm::SmallString<256> path("outputs");
+	llvm::sys::path::append(path, key.substr(0, 2), key + ".out");
+	return std::string(path);
+}
+
+void flushStdout()
+{
+	llvm::outs().flush();
+	std::cout.flush();
+	std::fflush(stdout);
+}
+
+// Redirect the standard output of the process to a file for the lifetime
+// of the object.
+// NOTE: This operates at the level of file descriptors, so it captures
+// output written by any means (e.g., llvm::outs() or std::cout).
+class StdoutRedirector {
+public:
+	explicit StdoutRedirector(const std::string& path) : savedFd_(-1)
+	{
+		flushStdout();
+		int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		if (fd < 0) {
+			return;
+		}
+		savedFd_ = ::dup(STDOUT_FILENO);
+		if (savedFd_ >= 0) {
+			::dup2(fd, STDOUT_FILENO);
+		}
+		::close(fd);
+	}
+	~StdoutRedirector()
+	{
+		if (savedFd_ >= 0) {
+			flushStdout();
+			::dup2(savedFd_, STDOUT_FILENO);
+			::close(savedFd_);
+		}
+	}
+	StdoutRedirector(const StdoutRedirector&) = delete;
+	StdoutRedirector& operator=(const StdoutRedirector&) = delete;
+	bool isActive() const {return savedFd_ >= 0;}
+private:
+	int savedFd_;
+};
+
+llvm::Error copyFileTo(const std::string& path, llvm::raw_ostream& out)
+{
+	auto buffer = llvm::MemoryBuffer::getFile(path, false, false);
+	if (!buffer) {
+		return llvm::createStringError(buffer.getError(), "cannot read %s",
+		  path.c_str());
+	}
+	out << (*buffer)->getBuffer();
+	return llvm::Error::success();
+}
+
+// Get the journal keys (i.e., normalized paths) of a list of files, in the
+// order in which their outputs are written.
+std::vector<std::string> getSortedKeys(const std::vector<std::string>& files)
+{
+	std::vector<std::string> keys;
+	for (const auto& file : files) {
+		keys.push_back(getNormalizedPath(file));
+	}
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	return keys;
+}
+
+} // namespace
+
+/****************************************************************************\
+Shard Selection
+\****************************************************************************/
+
+bool parseShardSpec(llvm::StringRef spec, unsigned& shardIndex,
+  unsigned& numShards)
+{
+	auto [indexString, countString] = spec.split('/');
+	unsigned index;
+	unsigned count;
+	if (!llvm::to_integer(indexString, index, 10) ||
+	  !llvm::to_integer(countString, count, 10) || !count || index >= count) {
+		return false;
+	}
+	shardIndex = index;
+	numShards = count;
+	return true;
+}
+
+std::vector<std::string> selectShardFiles(
+  const std::vector<std::string>& files, unsigned shardIndex,
+  unsigned numShards)
+{
+	std::vector<std::string> result;
+	for (const auto& file : files) {
+		if (fnv1aHash(getNormalizedPath(file)) % numShards == shardIndex) {
+			result.push_back(file);
+		}
+	}
+	return result;
+}
+
+/****************************************************************************\
+Checkpoint Journal
+\****************************************************************************/
+
+CheckpointJournal::CheckpointJournal(std::string path,
+  std::string configKey) :
+  path_(std::move(path)), configKey_(std::move(configKey)), fd_(-1) {}
+
+CheckpointJournal::~CheckpointJournal()
+{
+	if (fd_ >= 0) {
+		::close(fd_);
+	}
+}
+
+llvm::Error CheckpointJournal::load()
+{
+	auto buffer = llvm::MemoryBuffer::getFile(path_, false, false);
+	if (!buffer) {
+		if (buffer.getError() == std::errc::no_such_file_or_directory) {
+			return llvm::Error::success();
+		}
+		return llvm::createStringError(buffer.getError(), "cannot read %s",
+		  path_.c_str());
+	}
+	llvm::SmallVector<llvm::StringRef> lines;
+	(*buffer)->getBuffer().split(lines, '\n', -1, false);
+	for (llvm::StringRef line : lines) {
+		llvm::Expected<json::Value> value = json::parse(line);
+		if (!value) {
+			// NOTE: The last record may have been truncated by an
+			// interruption.
+			llvm::consumeError(value.takeError());
+			continue;
+		}
+		const json::Object* object = value->getAsObject();
+		std::optional<llvm::StringRef> file = object ?
+		  object->getString("file") : std::nullopt;
+		std::optional<std::int64_t> status = object ?
+		  object->getInteger("status") : std::nullopt;
+		std::optional<llvm::StringRef> output = object ?
+		  object->getString("output") : std::nullopt;
+		std::optional<llvm::StringRef> config = object ?
+		  object->getString("config") : std::nullopt;
+		std::optional<llvm::StringRef> data = object ?
+		  object->getString("data") : std::nullopt;
+		if (!file || !status || !output || !config || !data) {
+			continue;
+		}
+		// NOTE: A record written with a different configuration does not
+		// describe the output of this run (so the file must be processed
+		// again).
+		if (*config != configKey_) {
+			continue;
+		}
+		entries_[*file] = {static_cast<int>(*status), std::string(*output),
+		  std::string(*data)};
+	}
+	return llvm::Error::success();
+}
+
+const CheckpointJournal::Entry* CheckpointJournal::find(llvm::StringRef file)
+  const
+{
+	auto i = entries_.find(file);
+	return i != entries_.end() ? &i->second : nullptr;
+}
+
+llvm::Error CheckpointJournal::add(llvm::StringRef file, Entry entry)
+{
+	if (fd_ < 0) {
+		fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0666);
+		if (fd_ < 0) {
+			return llvm::createStringError(getErrnoCode(),
+			  "cannot open %s", path_.c_str());
+		}
+	}
+	std::string record;
+	llvm::raw_string_ostream recordStream(record);
+	recordStream << json::Value(json::Object{
+		{"file", file},
+		{"status", entry.status},
+		{"output", entry.output},
+		{"config", configKey_},
+		{"data", entry.data},
+	}) << '\n';
+	recordStream.flush();
+	// NOTE: The record is written with a single write (so that it cannot
+	// be interleaved with another record) and is synced to disk before the
+	// file is considered complete.
+	if (::write(fd_, record.data(), record.size()) !=
+	  static_cast<ssize_t>(record.size()) || ::fsync(fd_)) {
+		return llvm::createStringError(getErrnoCode(),
+		  "cannot write %s", path_.c_str());
+	}
+	entries_[file] = std::move(entry);
+	return llvm::Error::success();
+}
+
+/****************************************************************************\
+Sharded Execution
+\****************************************************************************/
+
+int runShard(const ShardOptions& options,
+  const std::vector<std::string>& files, const ShardTask& task,
+  const ShardResumeCallback& onResume)
+{
+	std::vector<std::string> shardFiles = selectShardFiles(files,
+	  options.shardIndex, options.numShards);
+	if (options.checkpointDir.empty()) {
+		int status = 0;
+		for (const auto& file : shardFiles) {
+			std::string data;
+			status |= task(file, data);
+		}
+		return status;
+	}
+
+	if (std::error_code ec = llvm::sys::fs::create_directories(
+	  options.checkpointDir)) {
+		llvm::errs() << std::format("cannot make directory {}: {}\n",
+		  options.checkpointDir, ec.message());
+		return 1;
+	}
+	CheckpointJournal journal(getJournalPath(options), options.configKey);
+	if (llvm::Error error = journal.load()) {
+		llvm::errs() << std::format("{}\n", llvm::toString(std::move(error)));
+		return 1;
+	}
+
+	// NOTE: The journal is keyed by normalized path, so that the same file
+	// is recognized regardless of how its path is specified.
+	int status = 0;
+	for (const auto& file : shardFiles) {
+		std::string key = getNormalizedPath(file);
+		if (const CheckpointJournal::Entry* entry = journal.find(key)) {
+			if (onResume) {
+				onResume(file, entry->data);
+			}
+			continue;
+		}
+		std::string output = getOutputPath(key, options.configKey);
+		llvm::SmallString<256> outputPath(options.checkpointDir);
+		llvm::sys::path::append(outputPath, output);
+		llvm::sys::fs::create_directories(
+		  llvm::sys::path::parent_path(outputPath));
+		// The output is written to a temporary file, which is only renamed
+		// once the file has been completely processed.
+		std::string tempPath = std::string(outputPath) + ".tmp";
+		int fileStatus;
+		std::string data;
+		{
+			StdoutRedirector redirector(tempPath);
+			if (!redirector.isActive()) {
+				llvm::errs() << std::format("cannot capture output in {}\n",
+				  tempPath);
+				return 1;
+			}
+			fileStatus = task(file, data);
+		}
+		if (std::error_code ec = llvm::sys::fs::rename(tempPath,
+		  outputPath)) {
+			llvm::errs() << std::format("cannot rename {}: {}\n", tempPath,
+			  ec.message());
+			return 1;
+		}
+		if (llvm::Error error = journal.add(key, {fileStatus, output,
+		  std::move(data)})) {
+			llvm::errs() << std::format("{}\n",
+			  llvm::toString(std::move(error)));
+			return 1;
+		}
+	}
+
+	// Emit the output for the whole shard (including the files completed
+	// by earlier runs).
+	// NOTE: The output is in the same order as that of mergeShardOutputs,
+	// so that merging the output of a single shard yields the same result.
+	for (const auto& key : getSortedKeys(shardFiles)) {
+		const CheckpointJournal::Entry* entry = journal.find(key);
+		if (!entry) {
+			continue;
+		}
+		status |= entry->status;
+		llvm::SmallString<256> outputPath(options.checkpointDir);
+		llvm::sys::path::append(outputPath, entry->output);
+		if (llvm::Error error = copyFileTo(std::string(outputPath),
+		  llvm::outs())) {
+			llvm::errs() << std::format("{}\n",
+			  llvm::toString(std::move(error)));
+			status = 1;
+		}
+	}
+	return status;
+}
+
+llvm::Error mergeShardOutputs(const std::string& checkpointDir,
+  llvm::StringRef configKey, llvm::raw_ostream& out)
+{
+	// Collect the entries from the journals of all shards.
+	std::vector<std::pair<std::string, std::string>> outputs;
+	std::error_code ec;
+	for (llvm::sys::fs::directory_iterator i(checkpointDir, ec), end;
+	  !ec && i != end; i.increment(ec)) {
+		if (llvm::sys::path::extension(i->path()) != ".journal") {
+			continue;
+		}
+		CheckpointJournal journal(i->path(), std::string(configKey));
+		if (llvm::Error error = journal.load()) {
+			return error;
+		}
+		for (const auto& entry : journal.getEntries()) {
+			outputs.emplace_back(entry.getKey(), entry.getValue().output);
+		}
+	}
+	if (ec) {
+		return llvm::createStringError(ec, "cannot read directory %s",
+		  checkpointDir.c_str());
+	}
+	std::sort(outputs.begin(), outputs.end());
+	for (const auto& [file, output] : outputs) {
+		llvm::SmallString<256> outputPath(checkpointDir);
+		llvm::sys::path::append(outputPath, output);
+		if (llvm::Error error = copyFileTo(std::string(outputPath), out)) {
+			return error;
+		}
+	}
+	return llvm::Error::success();
+}
+
+} // namespace cal
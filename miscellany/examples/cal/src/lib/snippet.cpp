@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <clang/Basic/SourceLocation.h>
+#include <clang/Basic/SourceManager.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "cal/snippet.hpp"
+#include "cal/source_text.hpp"
+
+namespace cal {
+
+/****************************************************************************\
+Helper Functions
+\****************************************************************************/
+
+namespace {
+
+unsigned getNumDigits(unsigned value)
+{
+	unsigned count = 1;
+	while (value >= 10) {
+		value /= 10;
+		++count;
+	}
+	return count;
+}
+
+// Append a number that is right-aligned in a field of the specified width.
+void appendNumber(std::string& result, unsigned value, unsigned width)
+{
+	char buffer[16];
+	char* end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+	std::size_t size = end - buffer;
+	if (size < width) {
+		result.append(width - size, ' ');
+	}
+	result.append(buffer, size);
+}
+
+} // namespace
+
+/****************************************************************************\
+Source Snippets
+\****************************************************************************/
+
+std::vector<std::size_t> getLineOffsets(llvm::StringRef text)
+{
+	std::vector<std::size_t> offsets{0};
+	const char* begin = text.data();
+	const char* end = begin + text.size();
+	for (const char* p = begin; p != end;) {
+		const char* newline = static_cast<const char*>(std::memchr(p, '\n',
+		  end - p));
+		if (!newline) {
+			break;
+		}
+		p = newline + 1;
+		offsets.push_back(p - begin);
+	}
+	return offsets;
+}
+
+void renderSnippet(std::string& result, llvm::StringRef text,
+  const SnippetOptions& options)
+{
+	if (text.empty()) {
+		result += "[empty text]\n";
+		return;
+	}
+
+	// Find the lines and the range of columns that they occupy.
+	std::vector<std::size_t> offsets = getLineOffsets(text);
+	std::size_t numLines = offsets.size();
+	offsets.push_back(text.size() + 1);
+	auto getLineLength = [&offsets](std::size_t i) {
+		return offsets[i + 1] - offsets[i] - 1;
+	};
+	unsigned minColumn = options.startColumn;
+	unsigned maxColumn = options.startColumn;
+	if (std::size_t length = getLineLength(0)) {
+		maxColumn = options.startColumn + length - 1;
+	}
+	for (std::size_t i = 1; i < numLines; ++i) {
+		if (std::size_t length = getLineLength(i)) {
+			minColumn = 1;
+			maxColumn = std::max<std::size_t>(maxColumn, length);
+		}
+	}
+	unsigned maxLine = options.startLine + numLines - 1;
+	unsigned lineNumberWidth = std::max(getNumDigits(maxLine),
+	  options.lineNumberWidth);
+	// The width of a line-number prefix (i.e., the number, a colon, and a
+	// space).
+	std::size_t prefixSize = options.lineNumbers ? lineNumberWidth + 2 : 0;
+	unsigned numColumns = maxColumn - minColumn + 1;
+	unsigned numHeaderRows = !options.columnHeader ? 0 :
+	  getNumDigits(maxColumn) >= 2 ? 3 : 2;
+	std::size_t indent = options.startColumn - minColumn;
+
+	// NOTE: Each line is rendered as its prefix, its text, and a newline
+	// (where the newline of the text itself is not copied).
+	result.reserve(result.size() + numHeaderRows * (prefixSize +
+	  numColumns + 1) + numLines * (prefixSize + 1) + indent + text.size() +
+	  1 - numLines);
+
+	if (options.columnHeader) {
+		constexpr char digits[] = "0123456789";
+		if (numHeaderRows == 3) {
+			result.append(prefixSize, ' ');
+			for (unsigned i = minColumn; i <= maxColumn; ++i) {
+				result += digits[(i / 10) % 10];
+			}
+			result += '\n';
+		}
+		result.append(prefixSize, ' ');
+		for (unsigned i = minColumn; i <= maxColumn; ++i) {
+			result += digits[i % 10];
+		}
+		result += '\n';
+		result.append(prefixSize, ' ');
+		result.append(numColumns, '-');
+		result += '\n';
+	}
+
+	for (std::size_t i = 0; i < numLines; ++i) {
+		if (options.lineNumbers) {
+			appendNumber(result, options.startLine + i, lineNumberWidth);
+			result += ": ";
+		}
+		if (!i) {
+			result.append(indent, ' ');
+		}
+		result.append(text.data() + offsets[i], getLineLength(i));
+		result += '\n';
+	}
+}
+
+std::string renderSnippet(llvm::StringRef text,
+  const SnippetOptions& options)
+{
+	std::string result;
+	renderSnippet(result, text, options);
+	return result;
+}
+
+void renderSnippet(llvm::raw_ostream& out, llvm::StringRef text,
+  const SnippetOptions& options)
+{
+	std::string result;
+	renderSnippet(result, text, options);
+	out << result;
+}
+
+bool renderSourceSnippet(llvm::raw_ostream& out,
+  const clang::SourceManager& sourceManager, clang::CharSourceRange range,
+  SnippetOptions options)
+{
+	// NOTE: The text refers to the buffer of the source manager.
+	SourceText sourceText = getSourceText(sourceManager, range);
+	if (!sourceText) {
+		return false;
+	}
+	auto [fileId, offset] = sourceManager.getDecomposedLoc(
+	  range.getBegin());
+	options.startLine = sourceManager.getLineNumber(fileId, offset);
+	options.startColumn = sourceManager.getColumnNumber(fileId, offset);
+	renderSnippet(out, sourceText.text, options);
+	return true;
+}
+
+std::string addLineNumbers(llvm::StringRef source, unsigned int startLineNo,
+  unsigned int startColNo, bool lineHeader, bool columnHeader)
+{
+	SnippetOptions options;
+	options.startLine = startLineNo;
+	options.startColumn = startColNo;
+	options.lineNumbers = lineHeader;
+	options.columnHeader = columnHeader;
+	return renderSnippet(source, options);
+}
+
+} // namespace cal
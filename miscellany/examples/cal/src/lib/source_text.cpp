@@ -0,0 +1,90 @@
+#include <clang/Basic/LangOptions.h>
+#include <clang/Basic/SourceLocation.h>
+#include <clang/Basic/SourceManager.h>
+#include <clang/Lex/Lexer.h>
+#include <llvm/ADT/StringRef.h>
+
+#include "cal/source_text.hpp"
+
+namespace cal {
+
+/****************************************************************************\
+Source Text
+\****************************************************************************/
+
+const clang::LangOptions& getDefaultLangOptions()
+{
+	static const clang::LangOptions langOpts;
+	return langOpts;
+}
+
+SourceText getSourceText(const clang::SourceManager& sourceManager,
+  clang::CharSourceRange range, const clang::LangOptions* langOpts,
+  MacroRangePolicy macroPolicy)
+{
+	if (range.isInvalid()) {
+		return {{}, SourceTextStatus::invalid};
+	}
+	const clang::LangOptions& lo = langOpts ? *langOpts :
+	  getDefaultLangOptions();
+
+	if (range.getBegin().isMacroID() || range.getEnd().isMacroID()) {
+		switch (macroPolicy) {
+		case MacroRangePolicy::reject:
+			return {{}, SourceTextStatus::macro};
+		case MacroRangePolicy::expansion:
+			// NOTE: The resulting range is a character range, which is
+			// invalid if the range does not map to a contiguous file range.
+			range = clang::Lexer::makeFileCharRange(range, sourceManager, lo);
+			if (range.isInvalid()) {
+				return {{}, SourceTextStatus::macro};
+			}
+			break;
+		case MacroRangePolicy::spelling:
+			range = clang::CharSourceRange(clang::SourceRange(
+			  sourceManager.getSpellingLoc(range.getBegin()),
+			  sourceManager.getSpellingLoc(range.getEnd())),
+			  range.isTokenRange());
+			break;
+		}
+	}
+
+	clang::SourceLocation endLoc = range.getEnd();
+	if (range.isTokenRange()) {
+		endLoc = clang::Lexer::getLocForEndOfToken(endLoc, 0, sourceManager,
+		  lo);
+		if (endLoc.isInvalid()) {
+			return {{}, SourceTextStatus::invalid};
+		}
+	}
+	auto [beginFileId, beginOffset] = sourceManager.getDecomposedLoc(
+	  range.getBegin());
+	auto [endFileId, endOffset] = sourceManager.getDecomposedLoc(endLoc);
+	if (beginFileId != endFileId) {
+		return {{}, SourceTextStatus::spansFiles};
+	}
+	bool invalid = false;
+	llvm::StringRef buffer = sourceManager.getBufferData(beginFileId,
+	  &invalid);
+	if (invalid || beginOffset > endOffset || endOffset > buffer.size()) {
+		return {{}, SourceTextStatus::invalid};
+	}
+	return {buffer.slice(beginOffset, endOffset), SourceTextStatus::ok};
+}
+
+llvm::StringRef getSourceTextPlaceholder(SourceTextStatus status)
+{
+	switch (status) {
+	case SourceTextStatus::ok:
+		return "";
+	case SourceTextStatus::invalid:
+		return "@@SOURCE::INVALID@@";
+	case SourceTextStatus::macro:
+		return "@@SOURCE::MACRO@@";
+	case SourceTextStatus::spansFiles:
+		return "@@SOURCE::SPANS_FILES@@";
+	}
+	return "";
+}
+
+} // namespace cal
@@ -0,0 +1,165 @@
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <clang/AST/ASTConsumer.h>
+#include <clang/AST/ASTContext.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/CompilerInvocation.h>
+#include <clang/Frontend/FrontendAction.h>
+#include <clang/Frontend/MultiplexConsumer.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/Threading.h>
+#include <llvm/Support/TimeProfiler.h>
+
+#include "cal/time_trace.hpp"
+
+namespace ct = clang::tooling;
+
+namespace cal {
+
+/****************************************************************************\
+Time Tracing
+\****************************************************************************/
+
+namespace {
+
+// The settings for tracing worker threads (which are only valid while
+// tracing is started).
+std::atomic<bool> traceStarted(false);
+unsigned traceGranularity = 0;
+std::string traceProcessName;
+
+} // namespace
+
+void startTimeTrace(llvm::StringRef processName, unsigned granularity)
+{
+	traceGranularity = granularity;
+	traceProcessName = std::string(processName);
+	llvm::timeTraceProfilerInitialize(granularity, processName);
+	traceStarted = true;
+}
+
+bool isTimeTraceStarted()
+{
+	return traceStarted;
+}
+
+llvm::Error finishTimeTrace(llvm::StringRef path)
+{
+	if (!traceStarted) {
+		return llvm::Error::success();
+	}
+	traceStarted = false;
+	llvm::Error error = llvm::timeTraceProfilerWrite(path, path);
+	llvm::timeTraceProfilerCleanup();
+	return error;
+}
+
+TimeTraceThreadScope::TimeTraceThreadScope(llvm::StringRef threadName) :
+  active_(traceStarted && !llvm::timeTraceProfilerEnabled())
+{
+	if (active_) {
+		// NOTE: The profiler takes the name of its track from the name of
+		// the thread when it is initialized.
+		llvm::set_thread_name(threadName);
+		llvm::timeTraceProfilerInitialize(traceGranularity, traceProcessName);
+	}
+}
+
+TimeTraceThreadScope::~TimeTraceThreadScope()
+{
+	if (active_) {
+		llvm::timeTraceProfilerFinishThread();
+	}
+}
+
+ct::ArgumentsAdjuster traceArgumentsAdjuster(ct::ArgumentsAdjuster adjuster)
+{
+	return [adjuster = std::move(adjuster)](
+	  const ct::CommandLineArguments& args, llvm::StringRef file) {
+		llvm::TimeTraceScope scope("AdjustArguments", file);
+		return adjuster(args, file);
+	};
+}
+
+namespace {
+
+std::vector<std::unique_ptr<clang::ASTConsumer>> makeConsumerList(
+  std::unique_ptr<clang::ASTConsumer> consumer)
+{
+	std::vector<std::unique_ptr<clang::ASTConsumer>> consumers;
+	consumers.push_back(std::move(consumer));
+	return consumers;
+}
+
+// An AST consumer that traces the handling of the translation unit by
+// another consumer.
+// NOTE: A multiplexing consumer (with a single consumer) is used, so that
+// all of the other callbacks are forwarded.
+class TimeTracingConsumer : public clang::MultiplexConsumer {
+public:
+	explicit TimeTracingConsumer(std::unique_ptr<clang::ASTConsumer>
+	  consumer) : clang::MultiplexConsumer(makeConsumerList(
+	  std::move(consumer))) {}
+	void HandleTranslationUnit(clang::ASTContext& astContext) override
+	{
+		llvm::TimeTraceScope scope("HandleTranslationUnit");
+		clang::MultiplexConsumer::HandleTranslationUnit(astContext);
+	}
+};
+
+class TimeTracingAction : public clang::WrapperFrontendAction {
+public:
+	explicit TimeTracingAction(std::unique_ptr<clang::FrontendAction>
+	  action) : clang::WrapperFrontendAction(std::move(action)) {}
+protected:
+	std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(
+	  clang::CompilerInstance& compInstance, llvm::StringRef inFile)
+	  override
+	{
+		std::unique_ptr<clang::ASTConsumer> consumer =
+		  clang::WrapperFrontendAction::CreateASTConsumer(compInstance,
+		  inFile);
+		if (!consumer) {
+			return nullptr;
+		}
+		return std::make_unique<TimeTracingConsumer>(std::move(consumer));
+	}
+	void ExecuteAction() override
+	{
+		llvm::TimeTraceScope scope("ExecuteAction");
+		clang::WrapperFrontendAction::ExecuteAction();
+	}
+};
+
+} // namespace
+
+std::unique_ptr<clang::FrontendAction> TimeTracingActionFactory::create()
+{
+	std::unique_ptr<clang::FrontendAction> action = factory_.create();
+	if (!llvm::timeTraceProfilerEnabled()) {
+		return action;
+	}
+	return std::make_unique<TimeTracingAction>(std::move(action));
+}
+
+bool TimeTracingActionFactory::runInvocation(
+  std::shared_ptr<clang::CompilerInvocation> invocation,
+  clang::FileManager* fileManager,
+  std::shared_ptr<clang::PCHContainerOperations> pchContainerOps,
+  clang::DiagnosticConsumer* diagConsumer)
+{
+	const auto& inputs = invocation->getFrontendOpts().Inputs;
+	llvm::TimeTraceScope scope("TranslationUnit", [&]() {
+		return !inputs.empty() && inputs.front().isFile() ?
+		  std::string(inputs.front().getFile()) : std::string();
+	});
+	return ct::FrontendActionFactory::runInvocation(std::move(invocation),
+	  fileManager, std::move(pchContainerOps), diagConsumer);
+}
+
+} // namespace cal
@@ -0,0 +1,173 @@
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <clang/Basic/Diagnostic.h>
+#include <clang/Basic/DiagnosticOptions.h>
+#include <clang/Basic/FileManager.h>
+#include <clang/Basic/FileSystemOptions.h>
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Frontend/CompilerInvocation.h>
+#include <clang/Frontend/Utils.h>
+#include <clang/Serialization/PCHContainerOperations.h>
+#include <clang/Tooling/ArgumentsAdjusters.h>
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "cal/hash.hpp"
+#include "cal/translation_unit_cache.hpp"
+
+namespace ct = clang::tooling;
+namespace vfs = llvm::vfs;
+
+namespace cal {
+
+/****************************************************************************\
+Translation-Unit Cache
+\****************************************************************************/
+
+namespace {
+
+std::string getUnitKey(const ct::CompileCommand& command)
+{
+	return Hasher()
+	  .add(command.Directory)
+	  .add(command.Filename)
+	  .add(command.CommandLine)
+	  .finalize();
+}
+
+} // namespace
+
+TranslationUnitCache::TranslationUnitCache(std::size_t maxUnits,
+  ct::ArgumentsAdjuster adjuster) : maxUnits_(maxUnits ? maxUnits : 1),
+  adjuster_(std::move(adjuster)), builds_(0), reparses_(0), evictions_(0) {}
+
+TranslationUnitCache::~TranslationUnitCache() = default;
+
+std::unique_ptr<clang::ASTUnit> TranslationUnitCache::build(
+  const ct::CompileCommand& command, std::string& errString)
+{
+	std::vector<std::string> args = ct::getClangSyntaxOnlyAdjuster()(
+	  command.CommandLine, command.Filename);
+	args = ct::getClangStripOutputAdjuster()(args, command.Filename);
+	if (adjuster_) {
+		args = adjuster_(args, command.Filename);
+	}
+	std::vector<const char*> argv;
+	for (const auto& arg : args) {
+		argv.push_back(arg.c_str());
+	}
+
+	// NOTE: Each translation unit has its own file system, since the
+	// working directory depends on the compile command.
+	llvm::IntrusiveRefCntPtr<vfs::FileSystem> fileSys =
+	  vfs::createPhysicalFileSystem();
+	fileSys->setCurrentWorkingDirectory(command.Directory);
+
+#if LLVM_VERSION_MAJOR >= 21
+	auto diagOpts = std::make_shared<clang::DiagnosticOptions>();
+	llvm::IntrusiveRefCntPtr<clang::DiagnosticsEngine> diagEngine(
+	  new clang::DiagnosticsEngine(new clang::DiagnosticIDs(), *diagOpts,
+	  new clang::IgnoringDiagConsumer(), true));
+#else
+	llvm::IntrusiveRefCntPtr<clang::DiagnosticsEngine> diagEngine(
+	  new clang::DiagnosticsEngine(new clang::DiagnosticIDs(),
+	  new clang::DiagnosticOptions(), new clang::IgnoringDiagConsumer(),
+	  true));
+#endif
+
+	clang::CreateInvocationOptions invocationOpts;
+	invocationOpts.Diags = diagEngine;
+	invocationOpts.VFS = fileSys;
+	std::shared_ptr<clang::CompilerInvocation> invocation =
+	  clang::createInvocation(argv, std::move(invocationOpts));
+	if (!invocation) {
+		errString = std::format("cannot create compiler invocation for {}",
+		  command.Filename);
+		return nullptr;
+	}
+
+	clang::FileSystemOptions fileSysOpts;
+	fileSysOpts.WorkingDir = command.Directory;
+	// NOTE: The preamble is built on the first parse (so that it can be
+	// reused by every reparse).
+	constexpr unsigned precompilePreambleAfterNParses = 1;
+	std::unique_ptr<clang::ASTUnit> astUnit =
+	  clang::ASTUnit::LoadFromCompilerInvocation(std::move(invocation),
+	  std::make_shared<clang::PCHContainerOperations>(),
+#if LLVM_VERSION_MAJOR >= 21
+	  diagOpts,
+#endif
+	  diagEngine, new clang::FileManager(fileSysOpts, fileSys), false,
+	  clang::CaptureDiagsKind::None, precompilePreambleAfterNParses);
+	if (!astUnit) {
+		errString = std::format("cannot parse {}", command.Filename);
+		return nullptr;
+	}
+	return astUnit;
+}
+
+clang::ASTUnit* TranslationUnitCache::get(const ct::CompileCommand& command,
+  std::string& errString)
+{
+	std::string key = getUnitKey(command);
+	auto i = index_.find(key);
+	if (i != index_.end()) {
+		units_.splice(units_.begin(), units_, i->second);
+		clang::ASTUnit& astUnit = *units_.front().astUnit;
+		++reparses_;
+		if (astUnit.Reparse(std::make_shared<clang::PCHContainerOperations>())) {
+			index_.erase(i);
+			units_.pop_front();
+			errString = std::format("cannot reparse {}", command.Filename);
+			return nullptr;
+		}
+		return &astUnit;
+	}
+
+	std::unique_ptr<clang::ASTUnit> astUnit = build(command, errString);
+	if (!astUnit) {
+		return nullptr;
+	}
+	++builds_;
+	units_.push_front({key, std::move(astUnit)});
+	index_[key] = units_.begin();
+	while (units_.size() > maxUnits_) {
+		index_.erase(units_.back().key);
+		units_.pop_back();
+		++evictions_;
+	}
+	return units_.front().astUnit.get();
+}
+
+void TranslationUnitCache::clear()
+{
+	index_.clear();
+	units_.clear();
+}
+
+TranslationUnitCache::Stats TranslationUnitCache::getStats() const
+{
+	return {
+		.builds = builds_,
+		.reparses = reparses_,
+		.evictions = evictions_,
+	};
+}
+
+void TranslationUnitCache::printStats(llvm::raw_ostream& out) const
+{
+	Stats stats = getStats();
+	out << std::format("translation units cached: {}\n", units_.size())
+	  << std::format("translation unit builds: {}\n", stats.builds)
+	  << std::format("translation unit reparses: {}\n", stats.reparses)
+	  << std::format("translation unit evictions: {}\n", stats.evictions);
+}
+
+} // namespace cal
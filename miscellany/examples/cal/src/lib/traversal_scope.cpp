@@ -0,0 +1,93 @@
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <clang/AST/ASTConsumer.h>
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Decl.h>
+#include <clang/Basic/SourceManager.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/FrontendAction.h>
+#include <clang/Frontend/MultiplexConsumer.h>
+#include <llvm/ADT/StringRef.h>
+
+#include "cal/traversal_scope.hpp"
+
+namespace cal {
+
+/****************************************************************************\
+Traversal Scope
+\****************************************************************************/
+
+std::vector<clang::Decl*> getMainFileTopLevelDecls(
+  clang::ASTContext& astContext)
+{
+	const clang::SourceManager& sourceManager =
+	  astContext.getSourceManager();
+	std::vector<clang::Decl*> decls;
+	for (clang::Decl* decl : astContext.getTranslationUnitDecl()->decls()) {
+		if (sourceManager.isInMainFile(decl->getLocation())) {
+			decls.push_back(decl);
+		}
+	}
+	return decls;
+}
+
+void setMainFileTraversalScope(clang::ASTContext& astContext)
+{
+	astContext.setTraversalScope(getMainFileTopLevelDecls(astContext));
+}
+
+namespace {
+
+std::vector<std::unique_ptr<clang::ASTConsumer>> makeConsumerList(
+  std::unique_ptr<clang::ASTConsumer> consumer)
+{
+	std::vector<std::unique_ptr<clang::ASTConsumer>> consumers;
+	consumers.push_back(std::move(consumer));
+	return consumers;
+}
+
+// An AST consumer that restricts the traversal scope to the main file
+// before forwarding the translation unit to another consumer.
+// NOTE: A multiplexing consumer (with a single consumer) is used, so that
+// all of the other callbacks are forwarded.
+class MainFileScopeConsumer : public clang::MultiplexConsumer {
+public:
+	explicit MainFileScopeConsumer(
+	  std::unique_ptr<clang::ASTConsumer> consumer) :
+	  clang::MultiplexConsumer(makeConsumerList(std::move(consumer))) {}
+	void HandleTranslationUnit(clang::ASTContext& astContext) override
+	{
+		setMainFileTraversalScope(astContext);
+		clang::MultiplexConsumer::HandleTranslationUnit(astContext);
+	}
+};
+
+class MainFileScopeAction : public clang::WrapperFrontendAction {
+public:
+	explicit MainFileScopeAction(std::unique_ptr<clang::FrontendAction>
+	  action) : clang::WrapperFrontendAction(std::move(action)) {}
+protected:
+	std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(
+	  clang::CompilerInstance& compInstance, llvm::StringRef inFile)
+	  override
+	{
+		std::unique_ptr<clang::ASTConsumer> consumer =
+		  clang::WrapperFrontendAction::CreateASTConsumer(compInstance,
+		  inFile);
+		if (!consumer) {
+			return nullptr;
+		}
+		return std::make_unique<MainFileScopeConsumer>(std::move(consumer));
+	}
+};
+
+} // namespace
+
+std::unique_ptr<clang::FrontendAction> MainFileScopeActionFactory::create()
+{
+	return std::make_unique<MainFileScopeAction>(factory_.create());
+}
+
+} // namespace cal
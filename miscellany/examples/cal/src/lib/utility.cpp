@@ -23,6 +23,10 @@
 #	define BOOST_PROCESS_V1_NAMESPACE boost::process
 #endif
 
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+
 #include "cal/main.hpp"
 
 namespace bf = boost::filesystem;
@@ -66,97 +70,6 @@ bool parseVersion(const std::string& versionString, Version& version)
 	return true;
 }
 
-/****************************************************************************\
-Code Pretty Printing
-\****************************************************************************/
-
-unsigned int getLineNumSize(unsigned int maxLineNo)
-{
-	unsigned int count = 1;
-	while (maxLineNo >= 10) {
-		maxLineNo /= 10;
-		++count;
-	}
-	return count;
-}
-
-std::string addLineNumbers(const std::string& text, unsigned int startLineNo,
-  unsigned int startColumnNo, bool lineHeader, bool columnHeader)
-{
-	std::string result;
-
-	if (text.empty()) {
-		return "[empty text]\n";
-	}
-
-	unsigned int maxLineNo = startLineNo;
-	unsigned int columnNo = startColumnNo;
-	unsigned int minColumnNo = startColumnNo;
-	unsigned int maxColumnNo = startColumnNo;
-
-	for (auto i = text.begin(); i != text.end(); ++i) {
-		if (*i == '\n') {
-			++maxLineNo;
-			columnNo = 1;
-		} else {
-		minColumnNo = std::min(minColumnNo, columnNo);
-		maxColumnNo = std::max(maxColumnNo, columnNo);
-			++columnNo;
-		}
-	}
-	unsigned int lineNumSize = getLineNumSize(maxLineNo);
-	unsigned int columnNumSize = getLineNumSize(maxColumnNo);
-
-	if (columnHeader) {
-		constexpr char digits[] = "0123456789";
-		if (columnNumSize >= 2) {
-			if (lineHeader) {
-				result += std::string(lineNumSize + 2, ' ');
-			}
-			for (unsigned int i = minColumnNo; i <= maxColumnNo; ++i) {
-				result += digits[(i / 10) % 10];
-			}
-			result += '\n';
-		}
-		if (lineHeader) {
-			result += std::string(lineNumSize + 2, ' ');
-		}
-		for (unsigned int i = minColumnNo; i <= maxColumnNo; ++i) {
-			result += digits[i % 10];
-		}
-		result += '\n';
-		if (lineHeader) {
-			result += std::string(lineNumSize + 2, ' ');
-		}
-		result += std::string(maxColumnNo - minColumnNo + 1, '-');
-		result += '\n';
-	}
-
-	columnNo = minColumnNo;
-	auto i = text.begin();
-	for (unsigned int lineNo = startLineNo; lineNo <= maxLineNo; ++lineNo) {
-		if (lineHeader) {
-			result += std::format("{:{}d}: ", lineNo, lineNumSize);
-		}
-		if (lineNo == startLineNo) {
-			result += std::string(startColumnNo - minColumnNo, ' ');
-		}
-		while (i != text.end()) {
-			char c = *i++;
-			if (c == '\n') {
-				columnNo = minColumnNo;
-				//result += '$';
-				break;
-			}
-			result += c;
-			++columnNo;
-		}
-		result += '\n';
-	}
-
-	return result;
-}
-
 /****************************************************************************\
 Clang Include Directory
 \****************************************************************************/
@@ -278,4 +191,17 @@ std::string getClangIncludeDirPath(const std::string& clangProgramPath)
 	return (bf::path{resourceDir} / "include").string();
 }
 
+std::string getNormalizedPath(llvm::StringRef path, llvm::StringRef directory)
+{
+	llvm::SmallString<256> buffer(path);
+	if (directory.empty()) {
+		llvm::sys::fs::make_absolute(buffer);
+	} else {
+		llvm::sys::fs::make_absolute(directory, buffer);
+	}
+	llvm::sys::path::remove_dots(buffer, true);
+	llvm::sys::path::native(buffer);
+	return std::string(buffer);
+}
+
 } // namespace cal
@@ -0,0 +1,400 @@
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <format>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "cal/parallel.hpp"
+#include "cal/worker_pool.hpp"
+
+namespace cal {
+
+/****************************************************************************\
+Helper Functions
+\****************************************************************************/
+
+namespace {
+
+// The message sent by a worker when it has processed an item (which is
+// followed by the data produced by the task).
+struct ResultHeader {
+	std::uint32_t index;
+	std::int32_t status;
+	std::uint32_t dataSize;
+};
+
+// A worker process and the pipes used to communicate with it.
+struct Worker {
+	pid_t pid = -1;
+	// The pipe on which items (i.e., their indices) are sent to the worker.
+	int taskFd = -1;
+	// The pipe on which the worker sends its results.
+	int resultFd = -1;
+	// The index of the item being processed (if any).
+	std::optional<std::size_t> current;
+};
+
+std::error_code getErrnoCode()
+{
+	return std::error_code(errno, std::generic_category());
+}
+
+bool writeFull(int fd, const void* data, std::size_t size)
+{
+	const char* p = static_cast<const char*>(data);
+	while (size) {
+		ssize_t count = ::write(fd, p, size);
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		p += count;
+		size -= count;
+	}
+	return true;
+}
+
+// Read exactly the specified number of bytes (where end of file is treated
+// as an error).
+bool readFull(int fd, void* data, std::size_t size)
+{
+	char* p = static_cast<char*>(data);
+	while (size) {
+		ssize_t count = ::read(fd, p, size);
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		if (!count) {
+			return false;
+		}
+		p += count;
+		size -= count;
+	}
+	return true;
+}
+
+void flushStdout()
+{
+	llvm::outs().flush();
+	std::cout.flush();
+	std::fflush(stdout);
+}
+
+std::string getOutputPath(llvm::StringRef outputDir, std::size_t index)
+{
+	llvm::SmallString<256> path(outputDir);
+	llvm::sys::path::append(path, std::format("item-{}.out", index));
+	return std::string(path);
+}
+
+// Describe how a worker process terminated.
+std::string describeWaitStatus(int waitStatus)
+{
+	if (WIFSIGNALED(waitStatus)) {
+		int signal = WTERMSIG(waitStatus);
+		return std::format("signal {} ({})", signal, ::strsignal(signal));
+	}
+	if (WIFEXITED(waitStatus)) {
+		return std::format("exit status {}", WEXITSTATUS(waitStatus));
+	}
+	return "unknown termination";
+}
+
+void closeWorker(Worker& worker)
+{
+	if (worker.taskFd >= 0) {
+		::close(worker.taskFd);
+		worker.taskFd = -1;
+	}
+	if (worker.resultFd >= 0) {
+		::close(worker.resultFd);
+		worker.resultFd = -1;
+	}
+}
+
+// Run the loop of a worker process, which processes the items that it is
+// sent until its task pipe is closed.
+[[noreturn]] void runWorker(int taskFd, int resultFd,
+  const std::vector<std::string>& items, const WorkerPoolTask& task,
+  llvm::StringRef outputDir)
+{
+	std::uint32_t index;
+	while (readFull(taskFd, &index, sizeof(index))) {
+		// Capture the standard output of the task (at the level of file
+		// descriptors, so that output written by any means is captured).
+		std::string outputPath = getOutputPath(outputDir, index);
+		int fd = ::open(outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+		  0666);
+		if (fd >= 0) {
+			::dup2(fd, STDOUT_FILENO);
+			::close(fd);
+		}
+		std::string data;
+		int status = task(items[index], data);
+		flushStdout();
+		ResultHeader header{index, status,
+		  static_cast<std::uint32_t>(data.size())};
+		if (!writeFull(resultFd, &header, sizeof(header)) ||
+		  !writeFull(resultFd, data.data(), data.size())) {
+			break;
+		}
+	}
+	flushStdout();
+	// NOTE: The static destructors and exit handlers belong to the parent,
+	// so they must not be run by the worker.
+	::_exit(0);
+}
+
+} // namespace
+
+/****************************************************************************\
+Prefork Worker Pool
+\****************************************************************************/
+
+llvm::Expected<std::vector<WorkerPoolResult>> runWorkerPool(
+  const std::vector<std::string>& items, const WorkerPoolOptions& options,
+  const WorkerPoolTask& task, llvm::raw_ostream& out)
+{
+	std::vector<WorkerPoolResult> results(items.size());
+	if (items.empty()) {
+		return results;
+	}
+	unsigned numWorkers = options.numWorkers ? options.numWorkers :
+	  getDefaultConcurrency();
+	numWorkers = static_cast<unsigned>(std::min<std::size_t>(numWorkers,
+	  items.size()));
+	unsigned maxAttempts = std::max(options.maxAttempts, 1U);
+
+	llvm::SmallString<256> outputDir;
+	if (std::error_code ec = llvm::sys::fs::createUniqueDirectory(
+	  "cal-worker-pool", outputDir)) {
+		return llvm::createStringError(ec,
+		  "cannot make temporary directory");
+	}
+
+	// NOTE: A worker that crashes closes its pipes, and writing to a pipe
+	// without a reader must not terminate the parent.
+	struct sigaction ignoreAction{};
+	struct sigaction savedAction{};
+	ignoreAction.sa_handler = SIG_IGN;
+	::sigaction(SIGPIPE, &ignoreAction, &savedAction);
+
+	std::vector<Worker> workers(numWorkers);
+	auto startWorker = [&](Worker& worker) -> llvm::Error {
+		int taskPipe[2];
+		int resultPipe[2];
+		if (::pipe(taskPipe)) {
+			return llvm::createStringError(getErrnoCode(),
+			  "cannot create pipe");
+		}
+		if (::pipe(resultPipe)) {
+			std::error_code ec = getErrnoCode();
+			::close(taskPipe[0]);
+			::close(taskPipe[1]);
+			return llvm::createStringError(ec, "cannot create pipe");
+		}
+		// NOTE: Buffered output would otherwise be written by both the
+		// parent and the worker.
+		flushStdout();
+		out.flush();
+		pid_t pid = ::fork();
+		if (!pid) {
+			// NOTE: The worker must not hold the pipes of the other
+			// workers (or they would never see the end of their task
+			// pipes).
+			for (Worker& other : workers) {
+				closeWorker(other);
+			}
+			::close(taskPipe[1]);
+			::close(resultPipe[0]);
+			::signal(SIGPIPE, SIG_DFL);
+			runWorker(taskPipe[0], resultPipe[1], items, task, outputDir);
+		}
+		std::error_code ec = getErrnoCode();
+		::close(taskPipe[0]);
+		::close(resultPipe[1]);
+		if (pid < 0) {
+			::close(taskPipe[1]);
+			::close(resultPipe[0]);
+			return llvm::createStringError(ec, "cannot fork worker");
+		}
+		worker.pid = pid;
+		worker.taskFd = taskPipe[1];
+		worker.resultFd = resultPipe[0];
+		worker.current.reset();
+		return llvm::Error::success();
+	};
+
+	std::deque<std::size_t> pending;
+	for (std::size_t i = 0; i < items.size(); ++i) {
+		pending.push_back(i);
+	}
+	std::vector<bool> done(items.size(), false);
+	std::size_t nextOutput = 0;
+	// Write the outputs of the items that are done and are not preceded
+	// by an item that is not done.
+	auto writeOutputs = [&]() {
+		for (; nextOutput < items.size() && done[nextOutput]; ++nextOutput) {
+			std::string outputPath = getOutputPath(outputDir, nextOutput);
+			if (!results[nextOutput].skipped) {
+				auto buffer = llvm::MemoryBuffer::getFile(outputPath, false,
+				  false);
+				if (buffer) {
+					out << (*buffer)->getBuffer();
+				}
+			}
+			llvm::sys::fs::remove(outputPath);
+		}
+		out.flush();
+	};
+	// Handle the termination of a worker (while it was processing an
+	// item).
+	auto handleCrash = [&](Worker& worker) {
+		int waitStatus = 0;
+		while (::waitpid(worker.pid, &waitStatus, 0) < 0 && errno == EINTR) {
+		}
+		closeWorker(worker);
+		worker.pid = -1;
+		std::size_t index = *worker.current;
+		worker.current.reset();
+		WorkerPoolResult& result = results[index];
+		result.crash = describeWaitStatus(waitStatus);
+		if (result.attempts < maxAttempts) {
+			llvm::errs() << std::format("warning: worker crashed while "
+			  "processing {} ({}); retrying\n", items[index], result.crash);
+			pending.push_front(index);
+		} else {
+			llvm::errs() << std::format("error: worker crashed while "
+			  "processing {} ({}); skipping\n", items[index], result.crash);
+			result.status = 1;
+			result.skipped = true;
+			done[index] = true;
+		}
+	};
+
+	std::optional<llvm::Error> error;
+	for (;;) {
+		// Dispatch the pending items to the idle workers (starting new
+		// workers as needed).
+		for (Worker& worker : workers) {
+			if (pending.empty()) {
+				break;
+			}
+			if (worker.current) {
+				continue;
+			}
+			if (worker.pid < 0) {
+				if (llvm::Error startError = startWorker(worker)) {
+					error = std::move(startError);
+					break;
+				}
+			}
+			std::size_t index = pending.front();
+			pending.pop_front();
+			worker.current = index;
+			++results[index].attempts;
+			std::uint32_t message = static_cast<std::uint32_t>(index);
+			if (!writeFull(worker.taskFd, &message, sizeof(message))) {
+				// NOTE: The worker has died, which is detected below.
+				continue;
+			}
+		}
+		if (error) {
+			break;
+		}
+
+		// Wait for a busy worker to finish its item (or to crash).
+		std::vector<pollfd> pollFds;
+		std::vector<Worker*> busyWorkers;
+		for (Worker& worker : workers) {
+			if (worker.current) {
+				pollFds.push_back({worker.resultFd, POLLIN, 0});
+				busyWorkers.push_back(&worker);
+			}
+		}
+		if (pollFds.empty()) {
+			break;
+		}
+		if (::poll(pollFds.data(), pollFds.size(), -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			error = llvm::createStringError(getErrnoCode(), "cannot poll");
+			break;
+		}
+		for (std::size_t i = 0; i < pollFds.size(); ++i) {
+			if (!pollFds[i].revents) {
+				continue;
+			}
+			Worker& worker = *busyWorkers[i];
+			ResultHeader header;
+			std::string data;
+			bool received = readFull(worker.resultFd, &header,
+			  sizeof(header)) && header.index == *worker.current;
+			if (received) {
+				data.resize(header.dataSize);
+				received = readFull(worker.resultFd, data.data(),
+				  data.size());
+			}
+			if (!received) {
+				handleCrash(worker);
+				continue;
+			}
+			WorkerPoolResult& result = results[header.index];
+			result.status = header.status;
+			result.data = std::move(data);
+			done[header.index] = true;
+			worker.current.reset();
+		}
+		writeOutputs();
+	}
+
+	// Shut down the workers (which exit when their task pipes are closed).
+	for (Worker& worker : workers) {
+		if (worker.pid < 0) {
+			continue;
+		}
+		if (worker.current) {
+			::kill(worker.pid, SIGKILL);
+		}
+		closeWorker(worker);
+		while (::waitpid(worker.pid, nullptr, 0) < 0 && errno == EINTR) {
+		}
+		worker.pid = -1;
+	}
+	::sigaction(SIGPIPE, &savedAction, nullptr);
+	llvm::sys::fs::remove_directories(outputDir);
+	if (error) {
+		return std::move(*error);
+	}
+	return results;
+}
+
+} // namespace cal
@@ -0,0 +1,59 @@
+#include <chrono>
+#include <format>
+#include <memory>
+#include <string>
+#include <vector>
+#include <clang/Tooling/CompilationDatabase.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cal/main.hpp>
+#include "utility.hpp"
+
+namespace lc = llvm::cl;
+namespace ct = clang::tooling;
+
+static lc::opt<std::string> inPath(lc::Positional,
+  lc::desc("<input compilation database>"), lc::Required);
+static lc::opt<std::string> outPath("o",
+  lc::desc("Output binary compilation database"), lc::Required);
+static lc::opt<bool> verbose("v", lc::desc("Verbose"));
+
+int main(int argc, char** argv) {
+	lc::ParseCommandLineOptions(argc, argv,
+	  "Convert a compilation database to the binary format\n");
+	auto startTime = std::chrono::steady_clock::now();
+	std::string errString;
+	std::unique_ptr<ct::CompilationDatabase> compDatabase =
+	  loadCompDatabase(inPath, errString);
+	if (!compDatabase) {
+		llvm::errs() << std::format("ERROR: {}\n", errString);
+		return 1;
+	}
+	std::vector<ct::CompileCommand> compCommands =
+	  compDatabase->getAllCompileCommands();
+	if (llvm::Error error = cal::writeBinaryCompilationDatabase(outPath,
+	  compCommands)) {
+		llvm::errs() << std::format("ERROR: {}\n",
+		  llvm::toString(std::move(error)));
+		return 1;
+	}
+	if (verbose) {
+		std::unique_ptr<cal::BinaryCompilationDatabase> binDatabase =
+		  cal::BinaryCompilationDatabase::loadFromFile(outPath, errString);
+		if (!binDatabase) {
+			llvm::errs() << std::format("ERROR: {}\n", errString);
+			return 1;
+		}
+		double time = std::chrono::duration<double, std::milli>(
+		  std::chrono::steady_clock::now() - startTime).count();
+		llvm::outs() << std::format("commands: {}\n",
+		  binDatabase->getNumCommands())
+		  << std::format("distinct strings: {}\n",
+		  binDatabase->getNumStrings())
+		  << std::format("distinct argument vectors: {}\n",
+		  binDatabase->getNumArgVectors())
+		  << std::format("conversion time: {:.3f} ms\n", time);
+	}
+	return 0;
+}
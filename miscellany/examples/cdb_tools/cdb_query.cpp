@@ -0,0 +1,108 @@
+#include <chrono>
+#include <format>
+#include <memory>
+#include <string>
+#include <vector>
+#include <clang/Tooling/CompilationDatabase.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cal/main.hpp>
+#include "utility.hpp"
+
+namespace lc = llvm::cl;
+namespace ct = clang::tooling;
+
+static lc::opt<std::string> databasePath(lc::Positional,
+  lc::desc("<compilation database>"), lc::Required);
+static lc::list<std::string> sourcePaths(lc::Positional,
+  lc::desc("<source file>..."), lc::ZeroOrMore);
+static lc::opt<bool> listFiles("files",
+  lc::desc("List all of the files in the database"));
+static lc::opt<bool> printTime("time",
+  lc::desc("Print the time taken to load and query the database"));
+static lc::opt<bool> expandResponseFiles("expand-response-files",
+  lc::desc("Expand response files in the commands"));
+static lc::opt<std::string> responseFileCacheDir("response-file-cache-dir",
+  lc::desc("Directory in which tokenized response files are cached "
+  "(implies -expand-response-files)"));
+static lc::opt<bool> intern("intern",
+  lc::desc("Hold the database in interned form"));
+static lc::opt<bool> printFlagSets("flag-sets",
+  lc::desc("Print the groups of files that share a flag set "
+  "(implies -intern)"));
+
+// Print the flag sets of a database along with the files for each flag set.
+void printFlagSetGroups(llvm::raw_ostream& out,
+  const cal::InterningCompilationDatabase& compDatabase) {
+	out << std::format("strings: {}\n", compDatabase.getNumStrings())
+	  << std::format("argument-trie nodes: {}\n",
+	  compDatabase.getNumArgNodes())
+	  << std::format("flag sets: {}\n", compDatabase.getFlagSets().size());
+	for (const auto& flagSet : compDatabase.getFlagSets()) {
+		out << std::format("flag set {:016x} ({} commands):\n", flagSet.hash,
+		  flagSet.commands.size());
+		for (unsigned index : flagSet.commands) {
+			out << std::format("  {}\n",
+			  compDatabase.getCommand(index).Filename);
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	lc::ParseCommandLineOptions(argc, argv,
+	  "Query a (JSON or binary) compilation database\n");
+	auto startTime = std::chrono::steady_clock::now();
+	std::string errString;
+	std::unique_ptr<ct::CompilationDatabase> compDatabase =
+	  loadCompDatabase(databasePath, errString);
+	if (!compDatabase) {
+		llvm::errs() << std::format("ERROR: {}\n", errString);
+		return 1;
+	}
+	std::shared_ptr<cal::ResponseFileCache> responseFileCache;
+	if (expandResponseFiles || !responseFileCacheDir.empty()) {
+		responseFileCache = std::make_shared<cal::ResponseFileCache>(
+		  responseFileCacheDir);
+		compDatabase = std::make_unique<cal::ResponseFileExpandingDatabase>(
+		  std::move(compDatabase), responseFileCache);
+	}
+	if (intern || printFlagSets) {
+		compDatabase = std::make_unique<cal::InterningCompilationDatabase>(
+		  *compDatabase);
+	}
+	auto loadTime = std::chrono::steady_clock::now();
+	if (printFlagSets) {
+		printFlagSetGroups(llvm::outs(),
+		  static_cast<const cal::InterningCompilationDatabase&>(
+		  *compDatabase));
+	}
+	if (listFiles) {
+		for (const auto& sourcePath : compDatabase->getAllFiles()) {
+			llvm::outs() << std::format("{}\n", sourcePath);
+		}
+	}
+	if (sourcePaths.empty()) {
+		printCompCommands(llvm::outs(), compDatabase->getAllCompileCommands());
+	}
+	for (const auto& sourcePath : sourcePaths) {
+		std::vector<ct::CompileCommand> compCommands =
+		  compDatabase->getCompileCommands(sourcePath);
+		if (compCommands.empty()) {
+			llvm::errs() << std::format("no commands for {}\n", sourcePath);
+		}
+		printCompCommands(llvm::outs(), compCommands);
+	}
+	auto endTime = std::chrono::steady_clock::now();
+	if (printTime) {
+		llvm::outs() << std::format("load time: {:.3f} ms\n",
+		  std::chrono::duration<double, std::milli>(loadTime -
+		  startTime).count())
+		  << std::format("query time: {:.3f} ms\n",
+		  std::chrono::duration<double, std::milli>(endTime -
+		  loadTime).count());
+	}
+	if (responseFileCache && printTime) {
+		responseFileCache->printStats(llvm::outs());
+	}
+	return 0;
+}
@@ -0,0 +1,50 @@
+#include <format>
+#include <string>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cal/main.hpp>
+
+namespace lc = llvm::cl;
+
+static lc::opt<std::string> inPath(lc::Positional,
+  lc::desc("<compilation database>"), lc::Required);
+static lc::opt<bool> checkExists("check-exists",
+  lc::desc("Check that the files named by the entries exist"));
+static lc::opt<unsigned> maxProblems("max-problems",
+  lc::desc("Maximum number of problems to report (0 for no limit)"),
+  lc::init(0));
+static lc::opt<bool> verbose("v", lc::desc("Verbose"));
+
+int main(int argc, char** argv) {
+	lc::ParseCommandLineOptions(argc, argv,
+	  "Validate a JSON compilation database\n");
+	cal::CdbValidationOptions options{
+		.checkFilesExist = checkExists,
+		.maxProblems = maxProblems,
+	};
+	llvm::Expected<cal::CdbValidationResult> result =
+	  cal::validateCompilationDatabase(inPath, options,
+	  [](const cal::CdbDiagnostic& diag) {
+		if (diag.entry >= 0) {
+			llvm::errs() << std::format("{}:{}: entry {}: {}\n",
+			  std::string(inPath), diag.offset, diag.entry, diag.message);
+		} else {
+			llvm::errs() << std::format("{}:{}: {}\n", std::string(inPath),
+			  diag.offset, diag.message);
+		}
+	});
+	if (!result) {
+		llvm::errs() << std::format("ERROR: {}\n",
+		  llvm::toString(result.takeError()));
+		return 2;
+	}
+	if (verbose) {
+		llvm::outs() << std::format("entries: {}\n", result->numEntries)
+		  << std::format("problems: {}\n", result->numProblems);
+		if (result->stopped) {
+			llvm::outs() << "validation stopped early\n";
+		}
+	}
+	return result->numProblems ? 1 : 0;
+}
@@ -0,0 +1,46 @@
+#include <format>
+#include <memory>
+#include <string>
+#include <vector>
+#include <clang/Tooling/CompilationDatabase.h>
+#include <clang/Tooling/JSONCompilationDatabase.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cal/main.hpp>
+#include "utility.hpp"
+
+namespace ct = clang::tooling;
+
+std::unique_ptr<ct::CompilationDatabase> loadCompDatabase(
+  llvm::StringRef path, std::string& errString) {
+	errString.clear();
+	if (llvm::sys::path::extension(path) == ".bcdb") {
+		return cal::BinaryCompilationDatabase::loadFromFile(path, errString);
+	}
+	return ct::JSONCompilationDatabase::loadFromFile(path, errString,
+	  ct::JSONCommandLineSyntax::AutoDetect);
+}
+
+bool printCompCommands(llvm::raw_ostream& out,
+  const std::vector<ct::CompileCommand>& compCommands) {
+	for (auto compCommand = compCommands.begin();
+	  compCommand != compCommands.end(); ++compCommand) {
+		out << "command:\n"
+		  << std::format("  filename: {}\n", compCommand->Filename)
+		  << std::format("  directory: {}\n", compCommand->Directory);
+		out << "  command line:";
+		for (auto word : compCommand->CommandLine) {out << " " << word;}
+		out << '\n';
+		if (!compCommand->Output.empty()) {
+			out << std::format("  output: {}\n", compCommand->Output);
+		} else {
+			out << "  no output\n";
+		}
+		if (!compCommand->Heuristic.empty()) {
+			out << std::format("  heuristic: {}\n", compCommand->Heuristic);
+		} else {
+			out << "  no heuristic\n";
+		}
+	}
+	return !out.has_error();
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <clang/Tooling/CompilationDatabase.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Load a compilation database from a file.
+// A file with the extension ".bcdb" is loaded as a binary compilation
+// database.  Any other file is loaded as a JSON compilation database.
+std::unique_ptr<clang::tooling::CompilationDatabase> loadCompDatabase(
+  llvm::StringRef path, std::string& errString);
+
+bool printCompCommands(llvm::raw_ostream& out,
+  const std::vector<clang::tooling::CompileCommand>& compCommands);
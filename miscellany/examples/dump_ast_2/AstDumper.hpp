@@ -173,10 +173,6 @@ public:
 		return ++nextNodeId_;
 	}
 
-	static std::string newlineTerm(const std::string& s) {
-		return s.ends_with('\n') ? s : s + "\n";
-	}
-
 	std::string makeDesc(const std::string& label,
 	  clang::SourceRange sourceRange = {}) const {
 		std::string desc;
@@ -184,8 +180,12 @@ public:
 			  getCurNodeId(), getCurParentNodeId(), getCurLevel(), label);
 		if (sourceRange.isValid()) {
 			desc += "====\n";
-			desc += newlineTerm(getSourceText(*sourceManager_, *langOpts_,
-			  sourceRange));
+			llvm::StringRef text = getSourceText(*sourceManager_, *langOpts_,
+			  sourceRange);
+			desc += text;
+			if (!text.ends_with('\n')) {
+				desc += '\n';
+			}
 			desc += "====\n";
 		}
 		return desc;
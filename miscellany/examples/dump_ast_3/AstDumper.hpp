@@ -131,7 +131,7 @@ public:
 		};
 		if (sourceRange.isValid()) {
 			desc.push_back("====");
-			desc.push_back(getSourceText(*sourceManager_, *langOpts_,
+			desc.emplace_back(getSourceText(*sourceManager_, *langOpts_,
 			  sourceRange));
 			desc.push_back("====");
 		}
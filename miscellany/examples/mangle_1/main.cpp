@@ -3,7 +3,10 @@
 \****************************************************************************/
 
 #include <format>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <clang/AST/Mangle.h>
 #include <clang/ASTMatchers/ASTMatchers.h>
@@ -16,6 +19,9 @@
 #include <clang/Tooling/Tooling.h>
 #include <llvm/Demangle/Demangle.h>
 #include <llvm/Support/CommandLine.h>
+#include <llvm/Support/VirtualFileSystem.h>
+
+#include <cal/main.hpp>
 
 /****************************************************************************\
 \****************************************************************************/
@@ -72,6 +78,51 @@ static lc::list<MatcherId> clMatcherIds(
   lc::ZeroOrMore
 );
 
+static lc::opt<std::string> clQueryFile(
+  "query-file",
+  lc::desc("File of named matcher queries (which must bind the nodes to be "
+  "mangled to type, var, or func)"),
+  lc::value_desc("path"),
+  lc::cat(optionCategory)
+);
+
+static lc::opt<bool> clProfileMatchers(
+  "profile-matchers",
+  lc::desc("Print the time spent in each matcher (aggregated over all "
+  "source files)"),
+  lc::cat(optionCategory),
+  lc::init(false)
+);
+
+static lc::opt<std::string> clProfileJson(
+  "profile-json",
+  lc::desc("Write the time spent in each matcher as JSON to the specified "
+  "file"),
+  lc::value_desc("path"),
+  lc::cat(optionCategory)
+);
+
+static lc::opt<std::string> clTimeTrace(
+  "time-trace",
+  lc::desc("Write a Chrome trace of the tool phases to the specified file"),
+  lc::value_desc("path"),
+  lc::cat(optionCategory)
+);
+
+static lc::opt<unsigned> clTimeTraceGranularity(
+  "time-trace-granularity",
+  lc::desc("Minimum duration of a traced span (in microseconds)"),
+  lc::cat(optionCategory),
+  lc::init(500)
+);
+
+static lc::opt<bool> clCacheFileSystem(
+  "cache-fs",
+  lc::desc("Cache file status and contents across TUs"),
+  lc::cat(optionCategory),
+  lc::init(false)
+);
+
 static lc::opt<bool> clVerbose(
   "v",
   lc::desc("Increase verbosity level"),
@@ -86,19 +137,17 @@ static lc::opt<bool> clVerbose(
 * Source-Manager Related Code.
 \****************************************************************************/
 
-std::pair<std::string, bool> getSourceText(const clang::ASTContext&
+// NOTE: The text returned refers to the buffer of the source manager (i.e.,
+// it is not copied).
+std::pair<llvm::StringRef, bool> getSourceText(const clang::ASTContext&
   astContext, clang::SourceRange sourceRange, const clang::LangOptions*
   langOptions = nullptr)
 {
-	bool invalid = true;
-	std::string buffer;
-	if (sourceRange.isValid()) {
-		buffer = clang::Lexer::getSourceText(
-		  clang::CharSourceRange::getTokenRange(sourceRange),
-		  astContext.getSourceManager(),
-		  langOptions ? *langOptions : astContext.getLangOpts(), &invalid);
-	}
-	return {buffer, !invalid};
+	cal::SourceText sourceText = cal::getSourceText(
+	  astContext.getSourceManager(), sourceRange,
+	  langOptions ? langOptions : &astContext.getLangOpts(),
+	  cal::MacroRangePolicy::expansion);
+	return {sourceText.text, static_cast<bool>(sourceText)};
 }
 
 std::string expLocToString(const clang::SourceManager& sourceManager,
@@ -246,6 +295,25 @@ struct MyMatchCallback : public cam::MatchFinder::MatchCallback {
 	unsigned count;
 };
 
+// A match callback that forwards each match to another callback under its
+// own ID (so that matcher profiling can record each matcher separately).
+class NamedMatchCallback : public cam::MatchFinder::MatchCallback {
+public:
+	NamedMatchCallback(std::string id, cam::MatchFinder::MatchCallback&
+	  callback) : id_(std::move(id)), callback_(callback) {}
+	void run(const cam::MatchFinder::MatchResult& result) override
+	{
+		callback_.run(result);
+	}
+	llvm::StringRef getID() const override
+	{
+		return id_;
+	}
+private:
+	std::string id_;
+	cam::MatchFinder::MatchCallback& callback_;
+};
+
 void MyMatchCallback::run(const cam::MatchFinder::MatchResult& result)
 {
 	++count;
@@ -320,8 +388,8 @@ void MyMatchCallback::run(const cam::MatchFinder::MatchResult& result)
 		llvm::outs() << dumpOutput;
 	}
 	if (sourceTextValid) {
-		llvm::outs() << std::format("{}\n{}\n",
-		  expLocToString(sourceManager, sourceRange.getBegin()), sourceText);
+		llvm::outs() << expLocToString(sourceManager, sourceRange.getBegin())
+		  << '\n' << sourceText << '\n';
 	}
 	if (!mangledName.empty()) {
 		std::string s = getDemangledName(mangledName);
@@ -389,22 +457,92 @@ int main(int argc, const char **argv)
 		llvm::outs() << std::format("verbosity level: {}\n",
 		  clVerbosityLevel);
 	}
+	if (!clTimeTrace.empty()) {
+		cal::startTimeTrace("mangle_1", clTimeTraceGranularity);
+	}
+	std::shared_ptr<cal::FileSystemCache> fileSysCache;
+	llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fileSys =
+	  llvm::vfs::getRealFileSystem();
+	if (clCacheFileSystem) {
+		fileSysCache = std::make_shared<cal::FileSystemCache>();
+		fileSys = cal::createCachingFileSystem(fileSysCache, fileSys);
+	}
 	ct::ClangTool tool(optParser->getCompilations(),
-	  optParser->getSourcePathList());
+	  optParser->getSourcePathList(),
+	  std::make_shared<clang::PCHContainerOperations>(), fileSys);
+	std::unique_ptr<cal::MatcherProfiler> profiler;
+	if (clProfileMatchers || !clProfileJson.empty()) {
+		profiler = std::make_unique<cal::MatcherProfiler>();
+	}
 	MyMatchCallback matchCallback;
-	cam::MatchFinder matchFinder;
+	// NOTE: Each matcher has its own (forwarding) callback, so that the
+	// matchers can be distinguished when profiling.
+	std::vector<std::unique_ptr<NamedMatchCallback>> namedCallbacks;
+	cam::MatchFinder matchFinder(profiler ? profiler->getFinderOptions() :
+	  cam::MatchFinder::MatchFinderOptions());
+	std::vector<cal::MatcherQuery> queries;
+	if (!clQueryFile.empty()) {
+		llvm::Expected<std::vector<cal::MatcherQuery>> fileQueries =
+		  cal::loadMatcherQueries(clQueryFile);
+		if (!fileQueries) {
+			llvm::errs() << llvm::toString(fileQueries.takeError()) << '\n';
+			return 1;
+		}
+		queries = std::move(*fileQueries);
+	}
+	// NOTE: The built-in matchers are used by default only if there are no
+	// queries.
 	std::vector<MatcherId> matcherIds(!clMatcherIds.empty() ? clMatcherIds :
-	  defaultMatcherIds);
+	  (queries.empty() ? defaultMatcherIds : std::vector<MatcherId>{}));
 	for (auto id : matcherIds) {
 		if (clVerbosityLevel >= 1) {
 			llvm::outs() << std::format("enabling matcher {}\n",
 			  matcherIdToName(id));
 		}
+		namedCallbacks.push_back(std::make_unique<NamedMatchCallback>(
+		  matcherIdToName(id), matchCallback));
 		matchFinder.addDynamicMatcher(*getMatcher(id).getSingleMatcher(),
-		  &matchCallback);
+		  namedCallbacks.back().get());
+	}
+	// NOTE: The queries are added to the same finder as the built-in
+	// matchers, so that all of them share a single traversal of the AST.
+	for (const auto& query : queries) {
+		if (clVerbosityLevel >= 1) {
+			llvm::outs() << std::format("enabling query {}\n", query.name);
+		}
+		namedCallbacks.push_back(std::make_unique<NamedMatchCallback>(
+		  "query " + query.name, matchCallback));
+		if (!matchFinder.addDynamicMatcher(query.matcher,
+		  namedCallbacks.back().get())) {
+			llvm::errs() << std::format("query {} matches an unsupported "
+			  "node kind\n", query.name);
+			return 1;
+		}
 	}
-	int status = tool.run(ct::newFrontendActionFactory(&matchFinder).get());
+	std::unique_ptr<ct::FrontendActionFactory> actionFactory =
+	  ct::newFrontendActionFactory(&matchFinder,
+	  profiler ? profiler->getSourceFileCallbacks() : nullptr);
+	cal::TimeTracingActionFactory tracingActionFactory(*actionFactory);
+	int status = tool.run(&tracingActionFactory);
 	llvm::outs() << std::format("number of matches: {}\n",
 	  matchCallback.count);
+	if (profiler && clProfileMatchers) {
+		profiler->printReport(llvm::outs());
+	}
+	if (profiler && !clProfileJson.empty()) {
+		if (llvm::Error error = profiler->writeJson(clProfileJson)) {
+			llvm::errs() << llvm::toString(std::move(error)) << '\n';
+			return 1;
+		}
+	}
+	if (fileSysCache && clVerbosityLevel >= 1) {
+		fileSysCache->printStats(llvm::outs());
+	}
+	if (!clTimeTrace.empty()) {
+		if (llvm::Error error = cal::finishTimeTrace(clTimeTrace)) {
+			llvm::errs() << llvm::toString(std::move(error)) << '\n';
+			return 1;
+		}
+	}
 	return !status ? 0 : 1;
 }
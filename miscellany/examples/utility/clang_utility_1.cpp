@@ -1,16 +1,14 @@
-#include <memory>
-#include <string>
+#include <cassert>
 
 #include <clang/Basic/LangOptions.h>
 #include <clang/Basic/SourceLocation.h>
 #include <clang/Basic/SourceManager.h>
 #include <clang/Lex/Lexer.h>
 #include <llvm/ADT/StringRef.h>
-#include <llvm/Support/raw_ostream.h>
 
 #include "clang_utility_1.hpp"
 
-std::string getSourceText(const clang::SourceManager &sourceManager,
+llvm::StringRef getSourceText(const clang::SourceManager &sourceManager,
   const clang::LangOptions& langOpts, clang::SourceRange sourceRange) {
 
 	assert(sourceRange.isValid());
@@ -25,16 +23,12 @@ std::string getSourceText(const clang::SourceManager &sourceManager,
 	endLoc = clang::Lexer::getLocForEndOfToken(endLoc, 0, sourceManager,
 	  langOpts);
 	assert(beginLoc.isValid() && endLoc.isValid());
-	clang::FileID beginFileId = sourceManager.getFileID(beginLoc);
-	clang::FileID endFileId = sourceManager.getFileID(endLoc);
+	auto [beginFileId, beginOffset] = sourceManager.getDecomposedLoc(beginLoc);
+	auto [endFileId, endOffset] = sourceManager.getDecomposedLoc(endLoc);
 	if (beginFileId != endFileId) {
 		return "@@SOURCE::SPANS_FILES@@";
 	}
 
-	assert(beginLoc.isValid() && endLoc.isValid());
-	unsigned beginOffset = sourceManager.getFileOffset(beginLoc);
-	unsigned endOffset = sourceManager.getFileOffset(endLoc);
-	std::size_t length = endOffset - beginOffset;
 	llvm::StringRef buffer = sourceManager.getBufferData(beginFileId);
-	return std::string(buffer.substr(beginOffset, length));
+	return buffer.slice(beginOffset, endOffset);
 }
@@ -5,8 +5,13 @@
 #include <clang/Basic/LangOptions.h>
 #include <clang/Basic/SourceLocation.h>
 #include <clang/Basic/SourceManager.h>
+#include <llvm/ADT/StringRef.h>
 
-std::string getSourceText(const clang::SourceManager &sourceManager,
+// Get the source text of a (token) range, or a placeholder if the range
+// involves a macro expansion or spans files.
+// The text returned refers to the buffer of the source manager (i.e., it is
+// not copied).
+llvm::StringRef getSourceText(const clang::SourceManager &sourceManager,
   const clang::LangOptions& langOpts, clang::SourceRange sourceRange);
 
 #endif
@@ -36,7 +36,7 @@ struct MyMatchCallback : public cam::MatchFinder::MatchCallback {
 			  endLoc);
 			unsigned int startLineNo = sourceManager.getSpellingLineNumber(
 			  lineStartLoc);
-			std::string text = getSourceText(sourceManager,
+			llvm::StringRef text = getSourceText(sourceManager,
 			  clang::SourceRange(lineStartLoc, lineEndLoc));
 			llvm::outs() << addLineNumbers(text, startLineNo) << "\n";
 		}
@@ -4,10 +4,16 @@
 #include <clang/Lex/Lexer.h>
 #include "utilities2.hpp"
 
+// NOTE: The language options are constructed once (rather than per call).
+static const clang::LangOptions& getLangOptions() {
+	static const clang::LangOptions langOpts;
+	return langOpts;
+}
+
 clang::SourceLocation getEndOfToken(const clang::SourceManager& sourceManager,
   clang::SourceLocation startOfToken) {
 	return clang::Lexer::getLocForEndOfToken(startOfToken, 0, sourceManager,
-	  clang::LangOptions());
+	  getLangOptions());
 }
 
 std::tuple<std::string, unsigned, unsigned> getFlc(const clang::SourceManager&
@@ -43,12 +49,12 @@ std::string rangeToString(const clang::SourceManager& sourceManager,
 	  beginColumnNum, endLineNum, endColumnNum);
 }
 
-std::string getSourceTextRaw(const clang::SourceManager& sourceManager,
+llvm::StringRef getSourceTextRaw(const clang::SourceManager& sourceManager,
   clang::SourceRange sourceRange) {
 	assert(sourceRange.isValid());
-	return std::string(clang::Lexer::getSourceText(
+	return clang::Lexer::getSourceText(
 	  clang::CharSourceRange::getCharRange(sourceRange), sourceManager,
-	  clang::LangOptions()));
+	  getLangOptions());
 }
 
 std::string getSourceText(const clang::SourceManager& sourceManager,
@@ -63,11 +69,11 @@ std::string getSourceText(const clang::SourceManager& sourceManager,
 	if (!check) {
 		return "[invalid !isWrittenInSameFile]";
 	}
-	std::string result = std::string(clang::Lexer::getSourceText(
+	llvm::StringRef text = clang::Lexer::getSourceText(
 	  clang::CharSourceRange::getCharRange(sourceRange), sourceManager,
-	  clang::LangOptions(), &invalid));
+	  getLangOptions(), &invalid);
 	//assert(!invalid || (invalid && !check));
-	return !invalid ? result :
+	return !invalid ? std::string(text) :
 	  std::format("[invalid getSourceText failed {} {} {} {}]", check,
 	  beginFileId.isValid(), endFileId.isValid(), beginFileId == endFileId);
 }
@@ -1,8 +1,9 @@
 #include <string>
 #include <clang/Basic/SourceManager.h>
 #include <clang/Basic/SourceLocation.h>
+#include <llvm/ADT/StringRef.h>
 
-std::string getSourceTextRaw(const clang::SourceManager& sourceManager,
+llvm::StringRef getSourceTextRaw(const clang::SourceManager& sourceManager,
   clang::SourceRange sourceRange);
 clang::SourceLocation getEndOfToken(const clang::SourceManager& sourceManager,
   clang::SourceLocation startOfToken);
@@ -1,13 +1,24 @@
+#include <algorithm>
 #include <format>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 #include <clang/ASTMatchers/ASTMatchers.h>
 #include <clang/ASTMatchers/ASTMatchFinder.h>
+#include <clang/ASTMatchers/Dynamic/Diagnostics.h>
+#include <clang/ASTMatchers/Dynamic/Parser.h>
 #include <clang/ASTMatchers/Dynamic/VariantValue.h>
 #include <clang/AST/Type.h>
 #include <clang/Frontend/FrontendActions.h>
 #include <clang/Tooling/CommonOptionsParser.h>
 #include <clang/Tooling/Tooling.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
 #include <llvm/Support/CommandLine.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Timer.h>
 
 namespace ct = clang::tooling;
 namespace cam = clang::ast_matchers;
@@ -43,6 +54,55 @@ cam::dynamic::VariantMatcher traverse(clang::TraversalKind kind,
 	return matcher;
 }
 
+struct Query {
+	std::string name;
+	cam::internal::DynTypedMatcher matcher;
+};
+
+// Load the named queries from a file in which each query has the form:
+//   query <name> <matcher expression>
+// where a line that starts with whitespace continues the previous query and
+// a line that starts with # is a comment.
+// The matcher expressions use the same language as clang-query.
+bool loadQueries(const std::string& path, std::vector<Query>& queries) {
+	auto buffer = llvm::MemoryBuffer::getFile(path);
+	if (!buffer) {
+		llvm::errs() << std::format("cannot read {}\n", path);
+		return false;
+	}
+	std::vector<std::string> stmts;
+	llvm::SmallVector<llvm::StringRef> lines;
+	(*buffer)->getBuffer().split(lines, '\n');
+	for (auto line : lines) {
+		if (line.trim().empty() || line.trim().starts_with("#")) {
+			continue;
+		}
+		if ((line.front() == ' ' || line.front() == '\t') && !stmts.empty()) {
+			(stmts.back() += ' ') += line.trim();
+		} else {
+			stmts.push_back(std::string(line.trim()));
+		}
+	}
+	for (const auto& stmt : stmts) {
+		auto [keyword, rest] = llvm::StringRef(stmt).split(' ');
+		auto [name, code] = rest.ltrim().split(' ');
+		if (keyword != "query" || name.empty()) {
+			llvm::errs() << std::format("invalid query: {}\n", stmt);
+			return false;
+		}
+		cam::dynamic::Diagnostics diag;
+		auto matcher = cam::dynamic::Parser::parseMatcherExpression(code,
+		  nullptr, nullptr, &diag);
+		if (!matcher) {
+			llvm::errs() << std::format("invalid query {}:\n{}\n",
+			  std::string(name), diag.toStringFull());
+			return false;
+		}
+		queries.push_back(Query{std::string(name), *matcher});
+	}
+	return true;
+}
+
 struct MyMatchCallback : public cam::MatchFinder::MatchCallback {
 	MyMatchCallback() : count(0) {}
 	void run(const cam::MatchFinder::MatchResult& result) override;
@@ -69,9 +129,58 @@ void MyMatchCallback::run(const cam::MatchFinder::MatchResult& result) {
 	++count;
 }
 
+// A match callback that forwards each match to another callback under its
+// own ID (so that matcher profiling can record each matcher separately).
+struct NamedMatchCallback : public cam::MatchFinder::MatchCallback {
+	NamedMatchCallback(std::string id, cam::MatchFinder::MatchCallback&
+	  callback) : id(std::move(id)), callback(callback) {}
+	void run(const cam::MatchFinder::MatchResult& result) override {
+		callback.run(result);
+	}
+	llvm::StringRef getID() const override {return id;}
+	std::string id;
+	cam::MatchFinder::MatchCallback& callback;
+};
+
+// Source-file callbacks that accumulate the matcher timings of each
+// translation unit.
+// NOTE: The MatchFinder replaces (rather than adds to) its timings for
+// each translation unit.
+struct ProfileCollector : public ct::SourceFileCallbacks {
+	void handleEndSource() override {
+		for (const auto& record : records) {
+			totals[record.first()] += record.second;
+		}
+		records.clear();
+	}
+	void print(llvm::raw_ostream& out) const {
+		std::vector<std::pair<std::string, llvm::TimeRecord>> entries;
+		for (const auto& total : totals) {
+			entries.emplace_back(std::string(total.first()), total.second);
+		}
+		std::sort(entries.begin(), entries.end(), [](const auto& a,
+		  const auto& b) {
+			return a.second.getWallTime() > b.second.getWallTime();
+		});
+		out << "matcher profile (wall/user/system time in seconds):\n";
+		for (const auto& [id, time] : entries) {
+			out << std::format("{:10.6f} {:10.6f} {:10.6f} {}\n",
+			  time.getWallTime(), time.getUserTime(), time.getSystemTime(),
+			  id);
+		}
+	}
+	llvm::StringMap<llvm::TimeRecord> records;
+	llvm::StringMap<llvm::TimeRecord> totals;
+};
+
 static lc::OptionCategory optionCategory("Tool options");
 static lc::list<int> clMatcherIds("m", lc::desc("Matcher ID"),
   lc::cat(optionCategory), lc::ZeroOrMore);
+static lc::opt<std::string> clQueryFile("query-file",
+  lc::desc("File of named matcher queries (which must bind qt, v, or f)"),
+  lc::value_desc("path"), lc::cat(optionCategory));
+static lc::opt<bool> clProfileMatchers("profile-matchers",
+  lc::desc("Print the time spent in each matcher"), lc::cat(optionCategory));
 static lc::opt<bool> clAsIs("i", lc::desc("Implicit nodes"),
   lc::cat(optionCategory));
 
@@ -85,14 +194,43 @@ int main(int argc, const char **argv) {
 	ct::ClangTool tool(optParser->getCompilations(),
 	  optParser->getSourcePathList());
 	MyMatchCallback matchCallback;
-	cam::MatchFinder matchFinder;
+	ProfileCollector profileCollector;
+	cam::MatchFinder::MatchFinderOptions finderOptions;
+	if (clProfileMatchers) {
+		finderOptions.CheckProfiling.emplace(profileCollector.records);
+	}
+	cam::MatchFinder matchFinder(finderOptions);
+	std::vector<std::unique_ptr<NamedMatchCallback>> namedCallbacks;
 	for (auto id : clMatcherIds) {
+		namedCallbacks.push_back(std::make_unique<NamedMatchCallback>(
+		  std::format("matcher {}", id), matchCallback));
 		matchFinder.addDynamicMatcher(*traverse(
 		  clAsIs ? clang::TK_AsIs : clang::TK_IgnoreUnlessSpelledInSource,
-		  getMatcher(id)).getSingleMatcher(), &matchCallback);
+		  getMatcher(id)).getSingleMatcher(), namedCallbacks.back().get());
 	}
-	int status = tool.run(ct::newFrontendActionFactory(&matchFinder).get());
+	// NOTE: All of the queries are added to the same finder, so that they
+	// share a single traversal of the AST.
+	std::vector<Query> queries;
+	if (!clQueryFile.empty() && !loadQueries(clQueryFile, queries)) {
+		return 1;
+	}
+	for (const auto& query : queries) {
+		namedCallbacks.push_back(std::make_unique<NamedMatchCallback>(
+		  "query " + query.name, matchCallback));
+		if (!matchFinder.addDynamicMatcher(query.matcher.withTraversalKind(
+		  clAsIs ? clang::TK_AsIs : clang::TK_IgnoreUnlessSpelledInSource),
+		  namedCallbacks.back().get())) {
+			llvm::errs() << std::format("query {} matches an unsupported "
+			  "node kind\n", query.name);
+			return 1;
+		}
+	}
+	int status = tool.run(ct::newFrontendActionFactory(&matchFinder,
+	  &profileCollector).get());
 	llvm::outs() << std::format("number of matches: {}\n",
 	  matchCallback.count);
+	if (clProfileMatchers) {
+		profileCollector.print(llvm::outs());
+	}
 	return !status ? 0 : 1;
 }
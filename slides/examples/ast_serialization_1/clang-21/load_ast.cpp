@@ -1,6 +1,10 @@
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 #include <clang/AST/ASTContext.h>
+#include <clang/AST/DeclBase.h>
+#include <clang/AST/ExternalASTSource.h>
 #include <clang/AST/RecursiveASTVisitor.h>
 #include <clang/Basic/Diagnostic.h>
 #include <clang/Basic/DiagnosticOptions.h>
@@ -12,16 +16,25 @@
 #include <clang/Lex/Lexer.h>
 #include <clang/Serialization/PCHContainerOperations.h>
 #include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/ADT/SmallVector.h>
 #include <llvm/ADT/StringRef.h>
 #include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
 #include <llvm/Support/raw_ostream.h>
 
 namespace lc = llvm::cl;
 
 static lc::opt<std::string> InputASTFile(lc::Positional,
   lc::desc("input AST file"), lc::Required);
+static lc::list<std::string> lookupNames("lookup",
+  lc::desc("Load only the declarations with the specified qualified name"),
+  lc::value_desc("qualified_name"), lc::ZeroOrMore);
+static lc::opt<bool> printStats("stats",
+  lc::desc("Print statistics on how much of the AST file was read"));
 
-std::string getSourceText(const clang::SourceManager &sourceManager,
+// NOTE: The text refers to the buffer of the source manager (i.e., it is not
+// copied).
+llvm::StringRef getSourceText(const clang::SourceManager &sourceManager,
   const clang::LangOptions& langOpts, clang::SourceRange sourceRange) {
 	assert(sourceRange.isValid());
 	clang::SourceLocation beginLoc = sourceRange.getBegin();
@@ -32,15 +45,11 @@ std::string getSourceText(const clang::SourceManager &sourceManager,
 	endLoc = clang::Lexer::getLocForEndOfToken(endLoc, 0, sourceManager,
 	  langOpts);
 	assert(beginLoc.isValid() && endLoc.isValid());
-	clang::FileID beginFileId = sourceManager.getFileID(beginLoc);
-	clang::FileID endFileId = sourceManager.getFileID(endLoc);
+	auto [beginFileId, beginOffset] = sourceManager.getDecomposedLoc(beginLoc);
+	auto [endFileId, endOffset] = sourceManager.getDecomposedLoc(endLoc);
 	if (beginFileId != endFileId) {return "@@SOURCE::SPANS_FILES@@";}
-	assert(beginLoc.isValid() && endLoc.isValid());
-	unsigned beginOffset = sourceManager.getFileOffset(beginLoc);
-	unsigned endOffset = sourceManager.getFileOffset(endLoc);
-	std::size_t length = endOffset - beginOffset;
 	llvm::StringRef buffer = sourceManager.getBufferData(beginFileId);
-	return std::string(buffer.substr(beginOffset, length));
+	return buffer.slice(beginOffset, endOffset);
 }
 
 class MyASTVisitor : public clang::RecursiveASTVisitor<MyASTVisitor> {
@@ -76,7 +85,7 @@ private:
 };
 
 std::unique_ptr<clang::ASTUnit> loadAstUnitFromFile(
-  const std::string& astFile) {
+  const std::string& astFile, clang::ASTUnit::WhatToLoad whatToLoad) {
 	auto diagOpts = std::make_shared<clang::DiagnosticOptions>();
 	llvm::IntrusiveRefCntPtr<clang::DiagnosticIDs> diagIDs(
 	  new clang::DiagnosticIDs());
@@ -87,13 +96,46 @@ std::unique_ptr<clang::ASTUnit> loadAstUnitFromFile(
 	clang::FileSystemOptions fileSysOpts;
 	clang::HeaderSearchOptions headerSearchOpts;
 	return clang::ASTUnit::LoadFromASTFile(astFile,
-	  pchContainerOps.getRawReader(), clang::ASTUnit::LoadEverything,
-	  diagOpts, diagEngine, fileSysOpts, headerSearchOpts, nullptr);
+	  pchContainerOps.getRawReader(), whatToLoad, diagOpts, diagEngine,
+	  fileSysOpts, headerSearchOpts, nullptr);
+}
+
+// Look up the declarations with a given qualified name (e.g., "ns::f").
+// The lookup is performed using the lookup tables in the AST file, so only
+// the declarations found (and the declaration contexts that enclose them)
+// are deserialized.
+std::vector<clang::NamedDecl*> lookupQualifiedName(
+  clang::ASTContext& astContext, llvm::StringRef qualifiedName) {
+	qualifiedName.consume_front("::");
+	llvm::SmallVector<llvm::StringRef, 4> components;
+	qualifiedName.split(components, "::");
+	std::vector<clang::DeclContext*> declContexts{
+	  astContext.getTranslationUnitDecl()};
+	std::vector<clang::NamedDecl*> result;
+	for (std::size_t i = 0; i < components.size(); ++i) {
+		clang::DeclarationName name(&astContext.Idents.get(components[i]));
+		bool last = (i + 1 == components.size());
+		std::vector<clang::DeclContext*> nextDeclContexts;
+		for (clang::DeclContext* declContext : declContexts) {
+			for (clang::NamedDecl* decl : declContext->lookup(name)) {
+				if (last) {
+					result.push_back(decl);
+				} else if (auto p = llvm::dyn_cast<clang::DeclContext>(decl)) {
+					nextDeclContexts.push_back(p);
+				}
+			}
+		}
+		declContexts = std::move(nextDeclContexts);
+	}
+	return result;
 }
 
 int main(int argc, const char** argv) {
 	lc::ParseCommandLineOptions(argc, argv, "AST deserializer\n");
-	auto astUnit = loadAstUnitFromFile(InputASTFile);
+	// When only selected declarations are wanted, the Sema state need not
+	// be restored, as Sema would eagerly deserialize some declarations.
+	auto astUnit = loadAstUnitFromFile(InputASTFile, lookupNames.empty() ?
+	  clang::ASTUnit::LoadEverything : clang::ASTUnit::LoadASTOnly);
 	if (!astUnit) {
 		llvm::errs() << "cannot load AST file\n";
 		return 1;
@@ -109,6 +151,32 @@ int main(int argc, const char** argv) {
 	llvm::outs() << std::format("language standard unspecified: {}\n",
 	  langOpts.LangStd == clang::LangStandard::Kind::lang_unspecified);
 	MyASTVisitor visitor(*astUnit);
-	visitor.TraverseDecl(tuDecl);
-	return 0;
+	int status = 0;
+	if (lookupNames.empty()) {
+		visitor.TraverseDecl(tuDecl);
+	} else {
+		for (const auto& lookupName : lookupNames) {
+			std::vector<clang::NamedDecl*> decls =
+			  lookupQualifiedName(astContext, lookupName);
+			if (decls.empty()) {
+				llvm::errs() << std::format("no declaration found for {}\n",
+				  lookupName);
+				status = 1;
+			}
+			for (clang::NamedDecl* decl : decls) {
+				visitor.TraverseDecl(decl);
+			}
+		}
+	}
+	if (printStats) {
+		std::uint64_t fileSize = 0;
+		if (!llvm::sys::fs::file_size(InputASTFile, fileSize)) {
+			llvm::errs() << std::format("AST file size: {}\n", fileSize);
+		}
+		if (clang::ExternalASTSource* externalSource =
+		  astContext.getExternalSource()) {
+			externalSource->PrintStats();
+		}
+	}
+	return status;
 }
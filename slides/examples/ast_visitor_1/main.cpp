@@ -1,3 +1,4 @@
+#include <chrono>
 #include <format>
 #include <clang/AST/ASTConsumer.h>
 #include <clang/AST/RecursiveASTVisitor.h>
@@ -6,13 +7,31 @@
 #include <clang/Tooling/CommonOptionsParser.h>
 #include <clang/Tooling/Tooling.h>
 #include <llvm/Config/llvm-config.h>
+#include <llvm/Support/Casting.h>
 #include <llvm/Support/CommandLine.h>
 
 namespace ct = clang::tooling;
 
+static llvm::cl::OptionCategory toolOptions("Tool Options");
+static llvm::cl::opt<bool> mainFileOnlyOption("main-file-only",
+  llvm::cl::init(true), llvm::cl::desc("Only traverse the top-level "
+  "declarations of the main file."), llvm::cl::cat(toolOptions));
+static llvm::cl::opt<bool> timeOption("time", llvm::cl::init(false),
+  llvm::cl::desc("Print the traversal time."), llvm::cl::cat(toolOptions));
+
 class MyAstVisitor : public clang::RecursiveASTVisitor<MyAstVisitor> {
 public:
 	MyAstVisitor(clang::ASTContext& astContext) : astContext_(&astContext) {}
+	// Prune the top-level declarations that are not in the main file.
+	bool TraverseDecl(clang::Decl* decl) {
+		if (mainFileOnlyOption && decl && llvm::isa_and_nonnull<
+		  clang::TranslationUnitDecl>(decl->getLexicalDeclContext()) &&
+		  !astContext_->getSourceManager().isInMainFile(
+		  decl->getLocation())) {
+			return true;
+		}
+		return clang::RecursiveASTVisitor<MyAstVisitor>::TraverseDecl(decl);
+	}
 	bool VisitFunctionDecl(clang::FunctionDecl* funcDecl) {
 		const auto& fileId = astContext_->getSourceManager().getFileID(
 		  funcDecl->getLocation());
@@ -32,7 +51,13 @@ public:
 		clang::TranslationUnitDecl* tuDecl =
 		  astContext.getTranslationUnitDecl();
 		MyAstVisitor visitor(astContext);
+		auto startTime = std::chrono::steady_clock::now();
 		visitor.TraverseDecl(tuDecl);
+		if (timeOption) {
+			llvm::errs() << std::format("traversal time: {:.6f} s\n",
+			  std::chrono::duration<double>(std::chrono::steady_clock::now() -
+			  startTime).count());
+		}
 	}
 };
 
@@ -44,8 +69,6 @@ public:
 	}
 };
 
-static llvm::cl::OptionCategory toolOptions("Tool Options");
-
 int main(int argc, char** argv) {
 	auto expectedOptionsParser = ct::CommonOptionsParser::create(argc,
 	  const_cast<const char**>(argv), toolOptions);
@@ -1,5 +1,6 @@
 #include <format>
 #include <map>
+#include <memory>
 #include <string>
 #include <clang/Analysis/CFG.h>
 #include <clang/AST/ASTContext.h>
@@ -10,6 +11,7 @@
 #include <clang/Tooling/Tooling.h>
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/raw_ostream.h>
+#include "skip_header_bodies.hpp"
 
 namespace lc = llvm::cl;
 namespace ct = clang::tooling;
@@ -17,6 +19,9 @@ namespace cam = clang::ast_matchers;
 
 static lc::OptionCategory toolCategory("Tool Options");
 static lc::opt<std::string> clFuncName("f", lc::cat(toolCategory));
+static lc::opt<bool> clSkipHeaderBodies("skip-header-bodies",
+  lc::cat(toolCategory), lc::init(false), lc::desc("Skip parsing the bodies "
+  "of the functions outside the main file."));
 
 std::string toString(clang::CFGElement::Kind kind) {
 	const std::map<clang::CFGElement::Kind, std::string> lut{
@@ -70,10 +75,13 @@ struct MyMatchCallback : public cam::MatchFinder::MatchCallback {
 	virtual void run(const cam::MatchFinder::MatchResult& result) final {
 		if (const auto* funcDecl =
 		  result.Nodes.getNodeAs<clang::FunctionDecl>("func")) {
+			if (funcDecl->hasSkippedBody()) {++numSkipped;}
 			if (const clang::Stmt *funcBody = funcDecl->getBody())
 			  {processFunc(*funcDecl, *result.Context);}
 		}
 	}
+	// The number of matched functions whose body was skipped.
+	int numSkipped = 0;
 };
 
 int main(int argc, char** argv) {
@@ -90,7 +98,13 @@ int main(int argc, char** argv) {
 	MyMatchCallback matchCallback;
 	cam::MatchFinder finder;
 	finder.addMatcher(funcMatcher, &matchCallback);
-	int status = tool.run(ct::newFrontendActionFactory(&finder).get());
+	if (clSkipHeaderBodies) {
+		tool.appendArgumentsAdjuster(getSkipFunctionBodiesAdjuster());
+	}
+	SkipHeaderBodiesConsumerFactory consumerFactory{&finder,
+	  clSkipHeaderBodies, &matchCallback.numSkipped};
+	int status =
+	  tool.run(ct::newFrontendActionFactory(&consumerFactory).get());
 	if (status) {llvm::errs() << "error occurred\n";}
 	return !status ? 0 : 1;
 }
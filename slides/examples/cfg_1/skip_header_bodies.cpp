@@ -0,0 +1 @@
+../clang_utilities/skip_header_bodies.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../clang_utilities/skip_header_bodies.hpp
\ No newline at end of file
@@ -0,0 +1,34 @@
+#include <format>
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/DeclBase.h>
+#include <clang/Basic/SourceManager.h>
+#include <clang/Tooling/ArgumentsAdjusters.h>
+#include <llvm/Support/raw_ostream.h>
+#include "skip_header_bodies.hpp"
+
+clang::tooling::ArgumentsAdjuster getSkipFunctionBodiesAdjuster() {
+	return clang::tooling::getInsertArgumentAdjuster(
+	  {"-Xclang", "-skip-function-bodies"},
+	  clang::tooling::ArgumentInsertPosition::END);
+}
+
+bool SkipHeaderBodiesConsumer::shouldSkipFunctionBody(clang::Decl* decl) {
+	if (decl->getASTContext().getSourceManager().isInMainFile(
+	  decl->getLocation())) {return false;}
+	++numSkipped_;
+	return true;
+}
+
+void SkipHeaderBodiesConsumer::HandleTranslationUnit(
+  clang::ASTContext& astContext) {
+	*numMatchedSkipped_ = 0;
+	finder_->matchAST(astContext);
+	if (skipBodies_) {
+		llvm::errs() << std::format("note: skipped {} function bodies "
+		  "outside the main file\n", numSkipped_);
+	}
+	if (*numMatchedSkipped_) {
+		llvm::errs() << std::format("warning: {} matched functions not "
+		  "processed as their bodies were skipped\n", *numMatchedSkipped_);
+	}
+}
@@ -0,0 +1,42 @@
+#include <memory>
+#include <clang/AST/ASTConsumer.h>
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/DeclBase.h>
+#include <clang/ASTMatchers/ASTMatchFinder.h>
+#include <clang/Tooling/ArgumentsAdjusters.h>
+
+// Get an arguments adjuster that enables the skipping of function bodies.
+// NOTE: The parser only consults the AST consumer about skipping a function
+// body (i.e., calls shouldSkipFunctionBody) if skipping is enabled in the
+// frontend options, which is what the -skip-function-bodies option of the
+// frontend does.
+clang::tooling::ArgumentsAdjuster getSkipFunctionBodiesAdjuster();
+
+// An AST consumer that runs a match finder and, when the parser is asked to
+// skip function bodies (i.e., with getSkipFunctionBodiesAdjuster), only
+// allows it to skip the bodies of the functions outside the main file.
+// The match callback is expected to count the matched functions whose body
+// was skipped in numMatchedSkipped (which is reset before matching), and
+// a warning is printed if there are any.
+struct SkipHeaderBodiesConsumer : public clang::ASTConsumer {
+	SkipHeaderBodiesConsumer(clang::ast_matchers::MatchFinder& finder,
+	  bool skipBodies, int& numMatchedSkipped) : finder_(&finder),
+	  skipBodies_(skipBodies), numMatchedSkipped_(&numMatchedSkipped) {}
+	bool shouldSkipFunctionBody(clang::Decl* decl) final;
+	void HandleTranslationUnit(clang::ASTContext& astContext) final;
+	clang::ast_matchers::MatchFinder* finder_;
+	bool skipBodies_;
+	int* numMatchedSkipped_;
+	int numSkipped_ = 0;
+};
+
+// The factory for the AST consumer (for use with newFrontendActionFactory).
+struct SkipHeaderBodiesConsumerFactory {
+	std::unique_ptr<clang::ASTConsumer> newASTConsumer() {
+		return std::make_unique<SkipHeaderBodiesConsumer>(*finder, skipBodies,
+		  *numMatchedSkipped);
+	}
+	clang::ast_matchers::MatchFinder* finder;
+	bool skipBodies;
+	int* numMatchedSkipped;
+};
@@ -1,7 +1,13 @@
+#include <charconv>
+#include <cstddef>
+#include <cstring>
 #include <format>
+#include <string>
 #include <clang/Basic/SourceManager.h>
 #include <clang/Basic/SourceLocation.h>
 #include <clang/Lex/Lexer.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
 
 std::string locationToString(const clang::SourceManager& sourceManager,
   clang::SourceLocation sourceLoc) {
@@ -24,21 +30,45 @@ std::string rangeToString(const clang::SourceManager& sourceManager,
 	  sourceManager.getSpellingColumnNumber(sourceRange.getEnd()));
 }
 
-std::string getSourceText(const clang::SourceManager& sourceManager,
+llvm::StringRef getSourceText(const clang::SourceManager& sourceManager,
   clang::SourceRange range) {
-	return std::string(clang::Lexer::getSourceText(
-	  clang::CharSourceRange::getTokenRange(range), sourceManager,
-	  clang::LangOptions()));
+	static const clang::LangOptions langOpts;
+	return clang::Lexer::getSourceText(
+	  clang::CharSourceRange::getTokenRange(range), sourceManager, langOpts);
 }
 
-std::string addLineNumbers(const std::string& source, unsigned int start) {
+// Append a line number (right-aligned in a field of width four) and its
+// separator.
+static void appendLineNumber(std::string& result, unsigned int lineNo) {
+	char buffer[16];
+	char* end = std::to_chars(buffer, buffer + sizeof(buffer), lineNo).ptr;
+	std::size_t size = end - buffer;
+	if (size < 4) {result.append(4 - size, ' ');}
+	result.append(buffer, size);
+	result += ": ";
+}
+
+std::string addLineNumbers(llvm::StringRef source, unsigned int start) {
+	// NOTE: Since this is used for every match, the text is scanned for
+	// newlines once (with memchr), recording their positions, so that the
+	// result can be reserved exactly (assuming line numbers of at most four
+	// digits) before it is built.
+	const char* begin = source.data();
+	const char* end = begin + source.size();
+	llvm::SmallVector<const char*, 64> newlines;
+	for (const char* p = begin; (p = static_cast<const char*>(
+	  std::memchr(p, '\n', end - p))); ++p) {
+		newlines.push_back(p);
+	}
 	std::string result;
-	result += std::format("{:4d}: ", start);
-	for (auto c : source) {
-		if (c == '\n') {
-			++start;
-			result += std::format("\n{:4d}: ", start);
-		} else {result += c;}
+	result.reserve(source.size() + 6 * (newlines.size() + 1));
+	appendLineNumber(result, start);
+	const char* p = begin;
+	for (const char* newline : newlines) {
+		result.append(p, newline + 1 - p);
+		appendLineNumber(result, ++start);
+		p = newline + 1;
 	}
+	result.append(p, end - p);
 	return result;
 }
@@ -1,6 +1,7 @@
 #include <string>
 #include <clang/Basic/SourceManager.h>
 #include <clang/Basic/SourceLocation.h>
+#include <llvm/ADT/StringRef.h>
 
 std::string locationToString(const clang::SourceManager& sourceManager,
   clang::SourceLocation sourceLoc);
@@ -8,10 +9,11 @@ std::string locationToString(const clang::SourceManager& sourceManager,
 std::string rangeToString(const clang::SourceManager& sourceManager,
   clang::SourceRange sourceRange);
 
-std::string getSourceTextRaw(const clang::SourceManager& sm,
+llvm::StringRef getSourceTextRaw(const clang::SourceManager& sm,
   clang::SourceRange range);
 
-std::string getSourceText(const clang::SourceManager& sm,
+// NOTE: The text refers to the source buffer (i.e., it is not copied).
+llvm::StringRef getSourceText(const clang::SourceManager& sm,
   clang::SourceRange range);
 
-std::string addLineNumbers(const std::string& source, unsigned int start);
+std::string addLineNumbers(llvm::StringRef source, unsigned int start);
@@ -1,5 +1,9 @@
+#include <chrono>
 #include <format>
+#include <memory>
+#include <vector>
 #include <clang/Analysis/CFG.h>
+#include <clang/AST/ASTConsumer.h>
 #include <clang/AST/ASTContext.h>
 #include <clang/ASTMatchers/ASTMatchers.h>
 #include <clang/ASTMatchers/ASTMatchFinder.h>
@@ -7,6 +11,7 @@
 #include <clang/Tooling/Tooling.h>
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/raw_ostream.h>
+#include "skip_header_bodies.hpp"
 
 namespace ct = clang::tooling;
 namespace cam = clang::ast_matchers;
@@ -15,6 +20,14 @@ static llvm::cl::OptionCategory toolCategory("Tool Options");
 static llvm::cl::opt<unsigned int> thresholdOption("t",
   llvm::cl::init(0), llvm::cl::desc("Set complexity threshold."),
   llvm::cl::cat(toolCategory));
+static llvm::cl::opt<bool> mainFileOnlyOption("main-file-only",
+  llvm::cl::init(true), llvm::cl::desc("Only traverse the top-level "
+  "declarations of the main file."), llvm::cl::cat(toolCategory));
+static llvm::cl::opt<bool> timeOption("time", llvm::cl::init(false),
+  llvm::cl::desc("Print the matching time."), llvm::cl::cat(toolCategory));
+static llvm::cl::opt<bool> skipHeaderBodiesOption("skip-header-bodies",
+  llvm::cl::init(false), llvm::cl::desc("Skip parsing the bodies of the "
+  "functions outside the main file."), llvm::cl::cat(toolCategory));
 
 int cyclomaticComplexity(const clang::FunctionDecl& funcDecl,
   clang::ASTContext& astContext) {
@@ -42,6 +55,55 @@ struct MyMatchCallback : public cam::MatchFinder::MatchCallback {
 	}
 };
 
+// An AST consumer that runs a match finder (optionally restricting the
+// traversal scope to the top-level declarations of the main file).
+struct MyAstConsumer : public clang::ASTConsumer {
+	MyAstConsumer(cam::MatchFinder& matchFinder) :
+	  matchFinder_(&matchFinder) {}
+	// Only allow the parser (when asked to skip function bodies) to skip
+	// the bodies of the functions outside the main file, which are never
+	// analyzed.
+	bool shouldSkipFunctionBody(clang::Decl* decl) final {
+		if (decl->getASTContext().getSourceManager().isInMainFile(
+		  decl->getLocation())) {return false;}
+		++numSkipped_;
+		return true;
+	}
+	void HandleTranslationUnit(clang::ASTContext& astContext) final {
+		auto startTime = std::chrono::steady_clock::now();
+		if (mainFileOnlyOption) {
+			const auto& sourceManager = astContext.getSourceManager();
+			std::vector<clang::Decl*> decls;
+			for (auto decl : astContext.getTranslationUnitDecl()->decls()) {
+				if (sourceManager.isInMainFile(decl->getLocation())) {
+					decls.push_back(decl);
+				}
+			}
+			astContext.setTraversalScope(decls);
+		}
+		matchFinder_->matchAST(astContext);
+		if (timeOption) {
+			llvm::errs() << std::format("matching time: {:.6f} s\n",
+			  std::chrono::duration<double>(std::chrono::steady_clock::now() -
+			  startTime).count());
+		}
+		if (skipHeaderBodiesOption) {
+			llvm::errs() << std::format("note: skipped {} function bodies "
+			  "outside the main file\n", numSkipped_);
+		}
+	}
+	cam::MatchFinder* matchFinder_;
+	int numSkipped_ = 0;
+};
+
+// The factory for the AST consumer (for use with newFrontendActionFactory).
+struct MyAstConsumerFactory {
+	std::unique_ptr<clang::ASTConsumer> newASTConsumer() {
+		return std::make_unique<MyAstConsumer>(*matchFinder);
+	}
+	cam::MatchFinder* matchFinder;
+};
+
 int main(int argc, char** argv) {
 	auto expectedOptionsParser = ct::CommonOptionsParser::create(argc,
 	const_cast<const char**>(argv), toolCategory);
@@ -57,8 +119,12 @@ int main(int argc, char** argv) {
 	matchFinder.addMatcher(matcher, &matchCallback);
 	ct::ClangTool tool(optionsParser.getCompilations(),
 	  optionsParser.getSourcePathList());
+	if (skipHeaderBodiesOption) {
+		tool.appendArgumentsAdjuster(getSkipFunctionBodiesAdjuster());
+	}
+	MyAstConsumerFactory consumerFactory{&matchFinder};
 	auto status =
-	  tool.run(ct::newFrontendActionFactory(&matchFinder).get());
+	  tool.run(ct::newFrontendActionFactory(&consumerFactory).get());
     if (status) {llvm::errs() << "error detected\n";}
 	return !status ? 0 : 1;
 }
@@ -1,15 +1,29 @@
+#include <chrono>
 #include <format>
+#include <memory>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <tuple>
 #include <clang/Analysis/CFG.h>
 #include <clang/AST/ASTConsumer.h>
 #include <clang/AST/ASTContext.h>
+#include <clang/AST/ODRHash.h>
 #include <clang/AST/RecursiveASTVisitor.h>
-#include <clang/Frontend/CompilerInstance.h>
-#include <clang/Frontend/FrontendAction.h>
+#include <clang/Basic/Version.h>
+#include <clang/Index/USRGeneration.h>
 #include <clang/Tooling/CommonOptionsParser.h>
 #include <clang/Tooling/Tooling.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringMap.h>
 #include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Support/Casting.h>
 #include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/raw_ostream.h>
+#include "skip_header_bodies.hpp"
 
 namespace ct = clang::tooling;
 
@@ -17,6 +31,26 @@ static llvm::cl::OptionCategory toolCategory("Tool Options");
 static llvm::cl::opt<unsigned int> thresholdOption("t",
   llvm::cl::init(0), llvm::cl::desc("Set complexity threshold."),
   llvm::cl::cat(toolCategory));
+static llvm::cl::opt<bool> mainFileOnlyOption("main-file-only",
+  llvm::cl::init(true), llvm::cl::desc("Only traverse the top-level "
+  "declarations of the main file."), llvm::cl::cat(toolCategory));
+static llvm::cl::opt<bool> timeOption("time", llvm::cl::init(false),
+  llvm::cl::desc("Print the traversal time."), llvm::cl::cat(toolCategory));
+static llvm::cl::opt<bool> skipHeaderBodiesOption("skip-header-bodies",
+  llvm::cl::init(false), llvm::cl::desc("Skip parsing the bodies of the "
+  "functions outside the main file."), llvm::cl::cat(toolCategory));
+static llvm::cl::opt<bool> headersOption("headers", llvm::cl::init(false),
+  llvm::cl::desc("Also report the functions defined in (nonsystem) headers "
+  "(once each)."), llvm::cl::cat(toolCategory));
+static llvm::cl::opt<std::string> cacheOption("cache", llvm::cl::init(""),
+  llvm::cl::desc("Set the file in which complexities are cached between "
+  "runs."), llvm::cl::cat(toolCategory));
+
+// NOTE: The cache format must be changed if the CFG build options used by
+// cyclomaticComplexity (or the way in which function bodies are hashed)
+// change.
+static const char cacheFormat[] =
+  "cyclomatic_complexity cache 2 (default CFG build options)";
 
 int cyclomaticComplexity(const clang::FunctionDecl& funcDecl,
   clang::ASTContext& astContext) {
@@ -30,41 +64,236 @@ int cyclomaticComplexity(const clang::FunctionDecl& funcDecl,
 	return numEdges - numNodes + (2 * 1); // E - V + 2 * P
 }
 
+// Add to a hash whether each function called in a statement is noreturn.
+// The CFG ends a block at a call to a noreturn function, but the ODRHash of
+// a statement only records the names of the functions that it calls (and
+// the noreturn attribute of a function is declared outside the body).
+void addCalleeNoReturn(clang::ODRHash& odrHash, const clang::Stmt* stmt) {
+	if (!stmt) {return;}
+	if (const auto* callExpr = llvm::dyn_cast<clang::CallExpr>(stmt)) {
+		const auto* callee = llvm::dyn_cast_or_null<clang::FunctionDecl>(
+		  callExpr->getCalleeDecl());
+		odrHash.AddBoolean(callee && callee->isNoReturn());
+	}
+	for (const clang::Stmt* child : stmt->children())
+	  {addCalleeNoReturn(odrHash, child);}
+}
+
+// A persistent cache of the complexities of functions.
+// Each entry is keyed by the USR of a function and holds a structural hash
+// of the function body (i.e., its ODRHash, which depends only on the
+// structure of the body and the names that it references, combined with
+// whether each function that it calls is noreturn), so that the entry is
+// only used while the body (and so its CFG) is unchanged.
+// The whole cache is discarded if it was produced by a different Clang
+// version or with different CFG build options.
+class ComplexityCache {
+public:
+	// Load the cache from a file (where a file that does not exist yields
+	// an empty cache).
+	void load(const std::string& path) {
+		auto buffer = llvm::MemoryBuffer::getFile(path);
+		if (!buffer) {
+			if (buffer.getError() != std::errc::no_such_file_or_directory) {
+				llvm::errs() << std::format("warning: cannot read cache {}\n",
+				  path);
+			}
+			return;
+		}
+		llvm::StringRef text = (*buffer)->getBuffer();
+		llvm::StringRef line;
+		std::tie(line, text) = text.split('\n');
+		if (line != getHeader()) {return;}
+		while (!text.empty()) {
+			std::tie(line, text) = text.split('\n');
+			// Each line has the form: <hash> <complexity> <USR>
+			auto [hashText, rest] = line.split(' ');
+			auto [complexityText, usr] = rest.split(' ');
+			Entry entry;
+			if (hashText.getAsInteger(16, entry.hash) ||
+			  complexityText.getAsInteger(10, entry.complexity) ||
+			  usr.empty()) {
+				llvm::errs() << std::format("warning: ignoring corrupt cache "
+				  "{}\n", path);
+				entries_.clear();
+				return;
+			}
+			entries_[usr] = entry;
+		}
+	}
+	// Save the cache to a file (if it has changed).
+	// The file is replaced atomically, so that an interrupted run cannot
+	// leave a partially written cache.  The cache is written to a uniquely
+	// named file in the same directory (so that concurrent runs do not
+	// write to the same temporary file), which is renamed over the cache.
+	bool save(const std::string& path) const {
+		if (!modified_) {return true;}
+		int fd;
+		llvm::SmallString<256> tempPath;
+		if (llvm::sys::fs::createUniqueFile(path + "-%%%%%%%%.tmp", fd,
+		  tempPath)) {return false;}
+		{
+			llvm::raw_fd_ostream out(fd, true);
+			out << getHeader() << '\n';
+			for (const auto& entry : entries_) {
+				out << std::format("{:08x} {} ", entry.second.hash,
+				  entry.second.complexity) << entry.first() << '\n';
+			}
+			out.close();
+			if (out.has_error()) {
+				out.clear_error();
+				llvm::sys::fs::remove(tempPath);
+				return false;
+			}
+		}
+		if (llvm::sys::fs::rename(tempPath, path)) {
+			llvm::sys::fs::remove(tempPath);
+			return false;
+		}
+		return true;
+	}
+	// Get the cached complexity of the function with the specified USR and
+	// body hash (if any).
+	std::optional<int> lookup(llvm::StringRef usr, unsigned hash) {
+		auto i = entries_.find(usr);
+		if (i == entries_.end() || i->second.hash != hash) {
+			++numMisses;
+			return std::nullopt;
+		}
+		++numHits;
+		return i->second.complexity;
+	}
+	void insert(llvm::StringRef usr, unsigned hash, int complexity) {
+		entries_[usr] = Entry{hash, complexity};
+		modified_ = true;
+	}
+	int numHits = 0;
+	int numMisses = 0;
+private:
+	struct Entry {
+		unsigned hash;
+		int complexity;
+	};
+	static std::string getHeader() {
+		return std::format("{} {}", cacheFormat,
+		  clang::getClangFullVersion());
+	}
+	llvm::StringMap<Entry> entries_;
+	bool modified_ = false;
+};
+
+// The state shared by all of the translation units.
+struct SharedState {
+	// The complexity cache (or null if caching is disabled).
+	ComplexityCache* cache = nullptr;
+	// The USRs of the header functions that have already been reported.
+	llvm::StringSet<> reportedUsrs;
+};
+
 class MyAstVisitor : public clang::RecursiveASTVisitor<MyAstVisitor> {
 public:
-	MyAstVisitor(clang::ASTContext& astContext) : astContext_(&astContext) {}
+	MyAstVisitor(clang::ASTContext& astContext, SharedState& state) :
+	  astContext_(&astContext), state_(&state) {}
+	// Prune the top-level declarations that are not in the main file (or,
+	// when header functions are reported, those in system headers).
+	bool TraverseDecl(clang::Decl* decl) {
+		if (mainFileOnlyOption && decl && llvm::isa_and_nonnull<
+		  clang::TranslationUnitDecl>(decl->getLexicalDeclContext()) &&
+		  !isAnalyzed(decl->getLocation())) {
+			return true;
+		}
+		return clang::RecursiveASTVisitor<MyAstVisitor>::TraverseDecl(decl);
+	}
 	bool VisitFunctionDecl(clang::FunctionDecl* funcDecl) {
-		const auto& fileId = astContext_->getSourceManager().getFileID(
-		  funcDecl->getLocation());
-		if (fileId == astContext_->getSourceManager().getMainFileID()) {
-			std::string s = funcDecl->getQualifiedNameAsString();
-			int complexity = cyclomaticComplexity(*funcDecl,
-			  *astContext_);
-			if (complexity >= 0 && complexity >= thresholdOption) {
-				llvm::outs() << std::format("{} {}\n", s, complexity);
-			}
+		const auto& sourceManager = astContext_->getSourceManager();
+		const bool inMainFile = sourceManager.getFileID(
+		  funcDecl->getLocation()) == sourceManager.getMainFileID();
+		if (!inMainFile && !(headersOption &&
+		  isAnalyzed(funcDecl->getLocation()))) {return true;}
+		llvm::SmallString<128> usr;
+		if ((!inMainFile || state_->cache) &&
+		  clang::index::generateUSRForDecl(funcDecl, usr)) {usr.clear();}
+		// Report each header function only once (rather than once for
+		// each translation unit that includes the header).
+		if (!inMainFile && !usr.empty() &&
+		  !state_->reportedUsrs.insert(usr).second) {return true;}
+		std::string s = funcDecl->getQualifiedNameAsString();
+		int complexity = getComplexity(*funcDecl, usr);
+		if (complexity >= 0 && complexity >= thresholdOption) {
+			llvm::outs() << std::format("{} {}\n", s, complexity);
 		}
 		return true;
 	}
 	bool shouldVisitTemplateInstantiations() const {return true;}
 private:
+	// Check if the functions at a location may be analyzed.
+	bool isAnalyzed(clang::SourceLocation loc) const {
+		const auto& sourceManager = astContext_->getSourceManager();
+		return sourceManager.isInMainFile(loc) || (headersOption &&
+		  loc.isValid() && !sourceManager.isInSystemHeader(loc));
+	}
+	// Get the complexity of a function (using the cache, if enabled, so
+	// that the CFG is only built for new or changed functions).
+	int getComplexity(const clang::FunctionDecl& funcDecl,
+	  llvm::StringRef usr) {
+		const clang::Stmt* body = funcDecl.getBody();
+		if (!body) {return -1;}
+		if (!state_->cache || usr.empty())
+		  {return cyclomaticComplexity(funcDecl, *astContext_);}
+		// NOTE: The USR of a template specialization includes the template
+		// arguments, so the instantiations of a template are distinct.
+		clang::ODRHash odrHash;
+		odrHash.AddStmt(body);
+		addCalleeNoReturn(odrHash, body);
+		const unsigned hash = odrHash.CalculateHash();
+		if (auto complexity = state_->cache->lookup(usr, hash))
+		  {return *complexity;}
+		int complexity = cyclomaticComplexity(funcDecl, *astContext_);
+		state_->cache->insert(usr, hash, complexity);
+		return complexity;
+	}
 	clang::ASTContext* astContext_;
+	SharedState* state_;
 };
 
 struct MyAstConsumer : public clang::ASTConsumer {
+	MyAstConsumer(SharedState& state) : state_(&state) {}
+	// Only allow the parser (when asked to skip function bodies) to skip
+	// the bodies of the functions that are never analyzed.
+	bool shouldSkipFunctionBody(clang::Decl* decl) final {
+		const auto& sourceManager = decl->getASTContext().getSourceManager();
+		clang::SourceLocation loc = decl->getLocation();
+		if (sourceManager.isInMainFile(loc) || (headersOption &&
+		  !sourceManager.isInSystemHeader(loc))) {return false;}
+		++numSkipped_;
+		return true;
+	}
 	void HandleTranslationUnit(clang::ASTContext& astContext) final {
 		clang::TranslationUnitDecl* tuDecl =
 		  astContext.getTranslationUnitDecl();
-		MyAstVisitor astVisitor(astContext);
+		MyAstVisitor astVisitor(astContext, *state_);
+		auto startTime = std::chrono::steady_clock::now();
 		astVisitor.TraverseDecl(tuDecl);
+		if (timeOption) {
+			llvm::errs() << std::format("traversal time: {:.6f} s\n",
+			  std::chrono::duration<double>(std::chrono::steady_clock::now() -
+			  startTime).count());
+		}
+		if (skipHeaderBodiesOption) {
+			llvm::errs() << std::format("note: skipped {} function bodies "
+			  "outside the main file\n", numSkipped_);
+		}
 	}
+	SharedState* state_;
+	int numSkipped_ = 0;
 };
 
-struct MyFrontendAction : public clang::ASTFrontendAction {
-	std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(
-	  clang::CompilerInstance& compilerInstance, llvm::StringRef) override {
-		return std::make_unique<MyAstConsumer>();
+// The factory for the AST consumer (for use with newFrontendActionFactory).
+struct MyAstConsumerFactory {
+	std::unique_ptr<clang::ASTConsumer> newASTConsumer() {
+		return std::make_unique<MyAstConsumer>(*state);
 	}
+	SharedState* state;
 };
 
 int main(int argc, char** argv) {
@@ -77,8 +306,29 @@ int main(int argc, char** argv) {
 	ct::CommonOptionsParser& optionsParser = *expectedOptionsParser;
 	ct::ClangTool tool(optionsParser.getCompilations(),
 	optionsParser.getSourcePathList());
+	if (skipHeaderBodiesOption) {
+		tool.appendArgumentsAdjuster(getSkipFunctionBodiesAdjuster());
+	}
+	ComplexityCache cache;
+	SharedState state;
+	if (!cacheOption.empty()) {
+		cache.load(cacheOption);
+		state.cache = &cache;
+	}
+	MyAstConsumerFactory consumerFactory{&state};
 	auto status =
-	  tool.run(ct::newFrontendActionFactory<MyFrontendAction>().get());
+	  tool.run(ct::newFrontendActionFactory(&consumerFactory).get());
     if (status) {llvm::errs() << "error detected\n";}
+	if (state.cache) {
+		if (!cache.save(cacheOption)) {
+			llvm::errs() << std::format("cannot write cache {}\n",
+			  std::string(cacheOption));
+			status = 1;
+		}
+		if (timeOption) {
+			llvm::errs() << std::format("cache: {} hits, {} misses\n",
+			  cache.numHits, cache.numMisses);
+		}
+	}
 	return !status ? 0 : 1;
 }
@@ -1,4 +1,5 @@
 #include <format>
+#include <memory>
 #include <string>
 #include <clang/Analysis/CFG.h>
 #include <clang/ASTMatchers/ASTMatchers.h>
@@ -8,6 +9,7 @@
 #include <clang/Tooling/CommonOptionsParser.h>
 #include <clang/Tooling/Tooling.h>
 #include <llvm/Support/CommandLine.h>
+#include "skip_header_bodies.hpp"
 
 namespace cam = clang::ast_matchers;
 namespace ct = clang::tooling;
@@ -17,6 +19,9 @@ static lc::OptionCategory toolCategory("Tool Options");
 static lc::opt<std::string> clFuncNamePattern("f", lc::cat(toolCategory),
   lc::init(".*"));
 static lc::opt<bool> clUseColor("c", lc::cat(toolCategory), lc::init(false));
+static lc::opt<bool> clSkipHeaderBodies("skip-header-bodies",
+  lc::cat(toolCategory), lc::init(false), lc::desc("Skip parsing the bodies "
+  "of the functions outside the main file."));
 
 cam::DeclarationMatcher getFuncMatcher(const std::string& namePattern)
   {return cam::functionDecl(cam::matchesName(namePattern)).bind("func");}
@@ -26,6 +31,7 @@ struct MyMatchCallback : public cam::MatchFinder::MatchCallback {
 		if (const auto* funcDecl =
 		  result.Nodes.getNodeAs<clang::FunctionDecl>("func")) {
 			clang::ASTContext *astContext = result.Context;
+			if (funcDecl->hasSkippedBody()) {++numSkipped;}
 			clang::Stmt *funcBody = funcDecl->getBody();
 			if (!funcBody) {return;}
 			llvm::outs() << std::format("FUNCTION: {}\n",
@@ -40,6 +46,8 @@ struct MyMatchCallback : public cam::MatchFinder::MatchCallback {
 			cfg->print(llvm::outs(), langOpts, clUseColor);
 		}
 	}
+	// The number of matched functions whose body was skipped.
+	int numSkipped = 0;
 };
 
 int main(int argc, const char **argv) {
@@ -56,7 +64,13 @@ int main(int argc, const char **argv) {
 	MyMatchCallback matchCallback;
 	cam::MatchFinder finder;
 	finder.addMatcher(funcMatcher, &matchCallback);
-	int status = tool.run(ct::newFrontendActionFactory(&finder).get());
+	if (clSkipHeaderBodies) {
+		tool.appendArgumentsAdjuster(getSkipFunctionBodiesAdjuster());
+	}
+	SkipHeaderBodiesConsumerFactory consumerFactory{&finder,
+	  clSkipHeaderBodies, &matchCallback.numSkipped};
+	int status =
+	  tool.run(ct::newFrontendActionFactory(&consumerFactory).get());
 	if (status) {llvm::errs() << "error occurred\n";}
 	return !status ? 0 : 1;
 }
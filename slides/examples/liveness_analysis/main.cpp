@@ -1,4 +1,5 @@
 #include <format>
+#include <memory>
 #include <string>
 #include <clang/ASTMatchers/ASTMatchers.h>
 #include <clang/ASTMatchers/ASTMatchFinder.h>
@@ -7,6 +8,7 @@
 #include <clang/Tooling/Tooling.h>
 #include <llvm/Support/CommandLine.h>
 #include "analyze.hpp"
+#include "skip_header_bodies.hpp"
 
 namespace cam = clang::ast_matchers;
 namespace ct = clang::tooling;
@@ -16,12 +18,16 @@ static lc::OptionCategory toolCategory("Tool Options");
 static lc::opt<std::string> clFuncNamePattern("f", lc::cat(toolCategory),
   lc::init(".*"));
 static lc::opt<bool> clPrintCfg("c", lc::cat(toolCategory), lc::init(false));
+static lc::opt<bool> clSkipHeaderBodies("skip-header-bodies",
+  lc::cat(toolCategory), lc::init(false), lc::desc("Skip parsing the bodies "
+  "of the functions outside the main file."));
 
 struct MyMatchCallback : public cam::MatchFinder::MatchCallback {
 	virtual void run(const cam::MatchFinder::MatchResult& result) final {
 		if (auto funcDecl =
 		  result.Nodes.getNodeAs<clang::FunctionDecl>("func")) {
 			clang::ASTContext *astContext = result.Context;
+			if (funcDecl->hasSkippedBody()) {++numSkipped;}
 			clang::Stmt *funcBody = funcDecl->getBody();
 			if (!funcBody) {return;}
 			llvm::outs() << std::format("FUNCTION: {}\n",
@@ -29,6 +35,8 @@ struct MyMatchCallback : public cam::MatchFinder::MatchCallback {
 			analyzeFunc(*astContext, funcDecl, clPrintCfg);
 		}
 	}
+	// The number of matched functions whose body was skipped.
+	int numSkipped = 0;
 };
 
 cam::DeclarationMatcher getFuncMatcher(const std::string& namePattern)
@@ -48,7 +56,13 @@ int main(int argc, const char **argv) {
 	MyMatchCallback matchCallback;
 	cam::MatchFinder finder;
 	finder.addMatcher(funcMatcher, &matchCallback);
-	int status = tool.run(ct::newFrontendActionFactory(&finder).get());
+	if (clSkipHeaderBodies) {
+		tool.appendArgumentsAdjuster(getSkipFunctionBodiesAdjuster());
+	}
+	SkipHeaderBodiesConsumerFactory consumerFactory{&finder,
+	  clSkipHeaderBodies, &matchCallback.numSkipped};
+	int status =
+	  tool.run(ct::newFrontendActionFactory(&consumerFactory).get());
 	if (status) {llvm::errs() << "error occurred\n";}
 	return !status ? 0 : 1;
 }